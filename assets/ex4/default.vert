@@ -3,13 +3,22 @@
 // Input data
 layout(location = 0) in vec3 iPosition;  // 3D position
 layout(location = 1) in vec3 iColor;     // Color
+layout(location = 2) in uint iDrawId;    // Per-draw ID (via base instance)
 
-uniform mat4 uProjCameraWorld;           // Projection-View-Model matrix
+// Per-frame data. Matrices are stored row-major on the CPU (Mat44f).
+layout( std140, row_major, binding = 0 ) uniform FrameData
+{
+    mat4 uProjCamera;                    // Projection-View matrix
+};
+
+#include "object_data.glsl"
 
 out vec3 v2fColor; // v2f = vertex to fragment
 
 void main()
 {
-    v2fColor = iColor;
-    gl_Position = uProjCameraWorld * vec4(iPosition, 1.0); // Apply transformation
+    ObjectData object = uObjects[iDrawId];
+
+    v2fColor = object.baseColor.rgb * iColor;
+    gl_Position = uProjCamera * (object.model2world * vec4(iPosition, 1.0)); // Apply transformation
 }
@@ -0,0 +1,12 @@
+// Per-object data, indexed by draw ID. Shared by default.vert and cull.comp;
+// see ObjectUniforms in exercise4/main.cpp.
+struct ObjectData
+{
+    mat4 model2world;
+    vec4 baseColor;
+};
+
+layout( std430, row_major, binding = 1 ) readonly buffer ObjectBuffer
+{
+    ObjectData uObjects[];
+};
@@ -0,0 +1,82 @@
+#include "bench.hpp"
+
+#include <numbers>
+#include <algorithm>
+
+#include <cmath>
+#include <cstdio>
+
+BenchCamera bench_camera_at( std::size_t aFrame, std::size_t aFrameCount ) noexcept
+{
+	constexpr float kPi = std::numbers::pi_v<float>;
+
+	// One full orbit around the scene over the course of the run. The camera
+	// moves in and out twice and bobs up and down three times, such that both
+	// close-ups and views of the whole scene are included.
+	float const t = float(aFrame) / float(std::max<std::size_t>( aFrameCount, 1 ));
+
+	BenchCamera ret;
+	ret.phi = 2.f * kPi * t;
+	ret.theta = 0.35f * std::sin( 3.f * 2.f * kPi * t );
+	ret.radius = 8.f + 4.f * std::cos( 2.f * 2.f * kPi * t );
+	return ret;
+}
+
+
+FrameStats compute_frame_stats( std::vector<double> aSamplesMs )
+{
+	FrameStats ret{};
+	ret.count = aSamplesMs.size();
+
+	if( aSamplesMs.empty() )
+		return ret;
+
+	std::sort( aSamplesMs.begin(), aSamplesMs.end() );
+
+	auto const rank = [&] (double aPercentile) {
+		auto const n = aSamplesMs.size();
+		auto const r = std::size_t(std::ceil( aPercentile / 100.0 * double(n) ));
+		return aSamplesMs[std::clamp<std::size_t>( r, 1, n ) - 1];
+	};
+
+	ret.min = aSamplesMs.front();
+	ret.median = rank( 50.0 );
+	ret.p95 = rank( 95.0 );
+	ret.p99 = rank( 99.0 );
+	ret.max = aSamplesMs.back();
+
+	double sum = 0.0;
+	for( auto const sample : aSamplesMs )
+		sum += sample;
+
+	ret.mean = sum / double(aSamplesMs.size());
+	return ret;
+}
+
+void print_bench_report( BenchConfig const& aConfig, std::vector<double> const& aCpuMs, std::vector<double> const& aGpuMs )
+{
+	std::printf( "BENCH %dx%d, %zu frames (+%zu warm-up), %s\n", 
+		aConfig.width, aConfig.height, 
+		aConfig.frames, aConfig.warmupFrames,
+		aConfig.headless ? "headless" : "hidden window"
+	);
+
+	std::printf( "BENCH %-8s %9s %9s %9s %9s %9s %9s\n", "(ms)", "min", "median", "p95", "p99", "max", "mean" );
+
+	auto const print_row = [] (char const* aName, std::vector<double> const& aSamples) {
+		auto const stats = compute_frame_stats( aSamples );
+		if( 0 == stats.count )
+		{
+			std::printf( "BENCH %-8s %9s\n", aName, "n/a" );
+			return;
+		}
+
+		std::printf( "BENCH %-8s %9.3f %9.3f %9.3f %9.3f %9.3f %9.3f\n", aName, 
+			stats.min, stats.median, stats.p95, stats.p99, stats.max, stats.mean
+		);
+	};
+
+	print_row( "CPU", aCpuMs );
+	print_row( "GPU", aGpuMs );
+}
+
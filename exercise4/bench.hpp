@@ -0,0 +1,55 @@
+#ifndef BENCH_HPP_F74CB900_7E84_4B60_B61B_8C508C50945E
+#define BENCH_HPP_F74CB900_7E84_4B60_B61B_8C508C50945E
+
+#include <vector>
+
+#include <cstddef>
+
+// Benchmark mode
+//
+// Enabled with --bench. The scene is rendered into an offscreen render target
+// of a fixed size, with V-Sync disabled, for a fixed number of frames along a
+// scripted camera path. Frame times are reported at the end. See options.hpp
+// for the command line options.
+struct BenchConfig
+{
+	bool enabled = false;
+	bool headless = false;
+
+	int width = 1920;
+	int height = 1080;
+
+	std::size_t frames = 1000;
+	std::size_t warmupFrames = 60;
+};
+
+
+// Scripted camera path. Depends only on the frame index, so that all runs
+// render exactly the same sequence of frames.
+struct BenchCamera
+{
+	float phi, theta;
+	float radius;
+};
+
+BenchCamera bench_camera_at( std::size_t aFrame, std::size_t aFrameCount ) noexcept;
+
+
+// Summary statistics of a series of frame times (in milliseconds).
+// Percentiles use the nearest-rank method.
+struct FrameStats
+{
+	std::size_t count;
+	double min, median, p95, p99, max;
+	double mean;
+};
+
+FrameStats compute_frame_stats( std::vector<double> aSamplesMs );
+
+void print_bench_report( 
+	BenchConfig const&, 
+	std::vector<double> const& aCpuMs, 
+	std::vector<double> const& aGpuMs
+);
+
+#endif // BENCH_HPP_F74CB900_7E84_4B60_B61B_8C508C50945E
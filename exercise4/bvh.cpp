@@ -0,0 +1,770 @@
+#include "bvh.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+#include <cmath>
+#include <cassert>
+
+#if defined(__SSE2__)
+#	include <immintrin.h>
+#endif
+
+#include "../support/error.hpp"
+
+namespace
+{
+	constexpr std::size_t kBins_ = 16; // per axis
+
+	// Leaves hold at most this many triangles, unless the tree would get
+	// deeper than kMaxDepth_. The depth limit bounds the traversal stack:
+	// each level of the 4-wide tree pushes at most three extra entries.
+	constexpr std::uint32_t kMaxLeafSize_ = 4;
+	constexpr std::size_t kMaxDepth_ = 64;
+	constexpr std::size_t kStackSize_ = 3*kMaxDepth_ + 1;
+
+	// Cost of visiting a node, relative to one triangle test
+	constexpr float kTraversalCost_ = 1.f;
+
+	// Subtrees with fewer triangles than this aren't split off as a separate
+	// task. Triangle setup is distributed in chunks of this size, too.
+	constexpr std::uint32_t kMinTaskSize_ = 4096;
+
+	constexpr float kInf_ = std::numeric_limits<float>::infinity();
+
+	using Node4_ = Bvh::Node4_;
+	using Triangle_ = Bvh::Triangle_;
+
+	// Binary node. Inner nodes have count == 0 and their children at first
+	// and first+1; leaves refer to count triangles in Build_::order.
+	struct Node2_
+	{
+		MeshBounds box;
+		std::uint32_t first;
+		std::uint32_t count;
+	};
+
+	struct Build_
+	{
+		std::vector<MeshBounds> boxes; // per triangle
+		std::vector<Vec3f> centroids;
+
+		std::vector<std::uint32_t> order; // triangle indices, in leaf order
+
+		// Preallocated (a binary tree with N leaves has 2N-1 nodes), so that
+		// threads can allocate nodes without locking.
+		std::vector<Node2_> nodes;
+		std::atomic<std::uint32_t> nextNode;
+	};
+
+	MeshBounds empty_box_() noexcept;
+	void grow_( MeshBounds&, MeshBounds const& ) noexcept;
+	float half_area_( MeshBounds const& ) noexcept;
+
+	// Splits the leaf aNode in two, if that is cheaper according to the SAH.
+	// Returns false if it stays a leaf.
+	bool split_( Build_&, std::uint32_t aNode, std::size_t aDepth ) noexcept;
+	void build_subtree_( Build_&, std::uint32_t aNode, std::size_t aDepth ) noexcept;
+
+	// Converts the binary subtree at aNode into 4-wide nodes. Returns the
+	// index of the new node.
+	std::uint32_t collapse_( Build_ const&, std::uint32_t aNode, std::size_t aDepth, std::vector<Node4_>&, BvhStats& );
+
+	struct RayData_
+	{
+		Vec3f origin;
+		Vec3f direction;
+		Vec3f invDirection;
+	};
+
+	// Tests the ray against the four child boxes of a node. Returns a bit
+	// mask of the children that are hit within [0, aMaxT], and their entry
+	// distances in aNear.
+	unsigned slabs_( Node4_ const&, RayData_ const&, float aMaxT, float (&aNear)[4] ) noexcept;
+
+	// Squared distances from aPoint to the four child boxes of a node.
+	// Returns a bit mask of the children within aMaxDistance2.
+	unsigned box_distances_( Node4_ const&, Vec3f aPoint, float aMaxDistance2, float (&aDistance2)[4] ) noexcept;
+
+	bool intersect_( Triangle_ const&, RayData_ const&, float aMaxT, BvhHit& ) noexcept;
+	Vec3f closest_point_( Triangle_ const&, Vec3f aPoint ) noexcept;
+
+	// Sorts aCount (<= 4) children by key, ascending.
+	void sort_children_( std::uint32_t (&aIndex)[4], float const (&aKey)[4], std::size_t aCount ) noexcept;
+}
+
+Bvh::Bvh( std::span<Vec3f const> aPositions, JobSystem& aJobs )
+	: mBounds{ { 0.f, 0.f, 0.f }, { 0.f, 0.f, 0.f } }
+	, mStats{}
+{
+	if( 0 != aPositions.size() % 3 )
+		throw Error( "Bvh: %zu vertices don't form whole triangles", aPositions.size() );
+	if( aPositions.size() / 3 >= std::numeric_limits<std::uint32_t>::max() / 2 )
+		throw Error( "Bvh: too many triangles (%zu)", aPositions.size() / 3 );
+
+	auto const startTime = std::chrono::steady_clock::now();
+
+	auto const threads = aJobs.thread_count();
+
+	auto const triangles = std::uint32_t(aPositions.size() / 3);
+	mStats.triangles = triangles;
+	mStats.threads = threads;
+
+	if( 0 == triangles )
+		return;
+
+	// Per-triangle bounds and centroids
+	Build_ build;
+	build.boxes.resize( triangles );
+	build.centroids.resize( triangles );
+	build.order.resize( triangles );
+
+	aJobs.parallel_for( triangles, [&] (std::size_t aBegin, std::size_t aEnd) {
+		for( auto i = std::uint32_t(aBegin); i < aEnd; ++i )
+		{
+			Vec3f const a = aPositions[3*i+0];
+			Vec3f const b = aPositions[3*i+1];
+			Vec3f const c = aPositions[3*i+2];
+
+			auto& box = build.boxes[i];
+			box.min = { std::min( { a.x, b.x, c.x } ), std::min( { a.y, b.y, c.y } ), std::min( { a.z, b.z, c.z } ) };
+			box.max = { std::max( { a.x, b.x, c.x } ), std::max( { a.y, b.y, c.y } ), std::max( { a.z, b.z, c.z } ) };
+
+			build.centroids[i] = 0.5f * (box.min + box.max);
+			build.order[i] = i;
+		}
+	}, kMinTaskSize_ );
+
+	MeshBounds root = empty_box_();
+	for( auto const& box : build.boxes )
+		grow_( root, box );
+
+	build.nodes.resize( 2*std::size_t(triangles) - 1 );
+	build.nodes[0] = Node2_{ root, 0, triangles };
+	build.nextNode.store( 1, std::memory_order_relaxed );
+
+	// Split the top of the tree on this thread, until there are enough
+	// subtrees for all threads. Then build the subtrees in parallel, largest
+	// first.
+	struct Task_
+	{
+		std::uint32_t node;
+		std::size_t depth;
+	};
+
+	std::vector<Task_> tasks{ Task_{ 0, 0 } };
+	std::vector<Task_> finished; // too small to split further here
+
+	std::size_t const targetTasks = threads > 1 ? 4*threads : 1;
+	while( !tasks.empty() && tasks.size() + finished.size() < targetTasks )
+	{
+		auto const largest = std::max_element( tasks.begin(), tasks.end(), [&] (Task_ const& aA, Task_ const& aB) {
+			return build.nodes[aA.node].count < build.nodes[aB.node].count;
+		} );
+
+		auto const task = *largest;
+		tasks.erase( largest );
+
+		if( build.nodes[task.node].count < kMinTaskSize_ || !split_( build, task.node, task.depth ) )
+		{
+			finished.emplace_back( task );
+			continue;
+		}
+
+		auto const children = build.nodes[task.node].first;
+		tasks.emplace_back( Task_{ children+0, task.depth+1 } );
+		tasks.emplace_back( Task_{ children+1, task.depth+1 } );
+	}
+
+	tasks.insert( tasks.end(), finished.begin(), finished.end() );
+	std::sort( tasks.begin(), tasks.end(), [&] (Task_ const& aA, Task_ const& aB) {
+		return build.nodes[aA.node].count > build.nodes[aB.node].count;
+	} );
+
+	aJobs.parallel_for( tasks.size(), [&] (std::size_t aTask, std::size_t) {
+		build_subtree_( build, tasks[aTask].node, tasks[aTask].depth );
+	}, 1 );
+
+	// Convert to the 4-wide layout, and copy the triangles in leaf order.
+	mNodes.reserve( build.nextNode.load( std::memory_order_relaxed ) / 2 + 1 );
+	collapse_( build, 0, 0, mNodes, mStats );
+
+	mTriangles.resize( triangles );
+	aJobs.parallel_for( triangles, [&] (std::size_t aBegin, std::size_t aEnd) {
+		for( auto i = std::uint32_t(aBegin); i < aEnd; ++i )
+		{
+			auto const index = build.order[i];
+			Vec3f const v0 = aPositions[3*index+0];
+			mTriangles[i] = Triangle_{ v0, aPositions[3*index+1] - v0, aPositions[3*index+2] - v0, index };
+		}
+	} );
+
+	mBounds = root;
+	mStats.nodes = mNodes.size();
+	mStats.buildMs = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - startTime ).count();
+}
+
+std::optional<BvhHit> Bvh::intersect( Ray const& aRay, float aMaxT ) const noexcept
+{
+	if( mNodes.empty() )
+		return {};
+
+	// Avoid infinities in the slab test (0 * inf = NaN for rays that start
+	// on a box's plane). The tiny bias doesn't matter for any real ray.
+	auto const rcp = [] (float aX) {
+		constexpr float kMin = 1e-30f;
+		return 1.f / (std::abs( aX ) > kMin ? aX : std::copysign( kMin, aX ));
+	};
+
+	RayData_ const ray{
+		aRay.origin,
+		aRay.direction,
+		Vec3f{ rcp( aRay.direction.x ), rcp( aRay.direction.y ), rcp( aRay.direction.z ) }
+	};
+
+	struct Entry_
+	{
+		std::uint32_t child, count;
+		float t;
+	};
+
+	Entry_ stack[kStackSize_];
+	std::size_t top = 0;
+	stack[top++] = Entry_{ 0, 0, 0.f };
+
+	std::optional<BvhHit> ret;
+	float best = aMaxT;
+
+	while( top )
+	{
+		auto const entry = stack[--top];
+		if( entry.t > best )
+			continue;
+
+		if( entry.count )
+		{
+			for( std::uint32_t i = 0; i < entry.count; ++i )
+			{
+				BvhHit hit;
+				if( intersect_( mTriangles[entry.child+i], ray, best, hit ) )
+				{
+					best = hit.t;
+					ret = hit;
+				}
+			}
+
+			continue;
+		}
+
+		auto const& node = mNodes[entry.child];
+
+		float near[4];
+		unsigned const mask = slabs_( node, ray, best, near );
+
+		// Push the nearest child last, so that it is visited first.
+		std::uint32_t hits[4];
+		std::size_t count = 0;
+		for( std::uint32_t i = 0; i < 4; ++i )
+		{
+			if( mask & (1u << i) )
+				hits[count++] = i;
+		}
+
+		sort_children_( hits, near, count );
+
+		while( count )
+		{
+			auto const i = hits[--count];
+			assert( top < kStackSize_ );
+			stack[top++] = Entry_{ node.child[i], node.count[i], near[i] };
+		}
+	}
+
+	return ret;
+}
+
+std::optional<BvhNearest> Bvh::nearest( Vec3f aPoint, float aMaxDistance ) const noexcept
+{
+	if( mNodes.empty() )
+		return {};
+
+	struct Entry_
+	{
+		std::uint32_t child, count;
+		float distance2;
+	};
+
+	Entry_ stack[kStackSize_];
+	std::size_t top = 0;
+	stack[top++] = Entry_{ 0, 0, 0.f };
+
+	std::optional<BvhNearest> ret;
+	float best2 = aMaxDistance * aMaxDistance;
+
+	while( top )
+	{
+		auto const entry = stack[--top];
+		if( entry.distance2 > best2 )
+			continue;
+
+		if( entry.count )
+		{
+			for( std::uint32_t i = 0; i < entry.count; ++i )
+			{
+				auto const& triangle = mTriangles[entry.child+i];
+
+				Vec3f const point = closest_point_( triangle, aPoint );
+				Vec3f const delta = point - aPoint;
+
+				float const distance2 = dot( delta, delta );
+				if( distance2 <= best2 )
+				{
+					best2 = distance2;
+					ret = BvhNearest{ 0.f, triangle.index, point };
+				}
+			}
+
+			continue;
+		}
+
+		auto const& node = mNodes[entry.child];
+
+		float distance2[4];
+		unsigned const mask = box_distances_( node, aPoint, best2, distance2 );
+
+		std::uint32_t hits[4];
+		std::size_t count = 0;
+		for( std::uint32_t i = 0; i < 4; ++i )
+		{
+			if( mask & (1u << i) )
+				hits[count++] = i;
+		}
+
+		sort_children_( hits, distance2, count );
+
+		while( count )
+		{
+			auto const i = hits[--count];
+			assert( top < kStackSize_ );
+			stack[top++] = Entry_{ node.child[i], node.count[i], distance2[i] };
+		}
+	}
+
+	if( ret )
+		ret->distance = std::sqrt( best2 );
+
+	return ret;
+}
+
+MeshBounds Bvh::bounds() const noexcept
+{
+	return mBounds;
+}
+BvhStats const& Bvh::stats() const noexcept
+{
+	return mStats;
+}
+
+
+namespace
+{
+	MeshBounds empty_box_() noexcept
+	{
+		return MeshBounds{ { kInf_, kInf_, kInf_ }, { -kInf_, -kInf_, -kInf_ } };
+	}
+
+	void grow_( MeshBounds& aBox, MeshBounds const& aOther ) noexcept
+	{
+		aBox.min = { std::min( aBox.min.x, aOther.min.x ), std::min( aBox.min.y, aOther.min.y ), std::min( aBox.min.z, aOther.min.z ) };
+		aBox.max = { std::max( aBox.max.x, aOther.max.x ), std::max( aBox.max.y, aOther.max.y ), std::max( aBox.max.z, aOther.max.z ) };
+	}
+
+	float half_area_( MeshBounds const& aBox ) noexcept
+	{
+		Vec3f const d = aBox.max - aBox.min;
+		if( d.x < 0.f || d.y < 0.f || d.z < 0.f )
+			return 0.f;
+
+		return d.x*d.y + d.y*d.z + d.z*d.x;
+	}
+
+	bool split_( Build_& aBuild, std::uint32_t aNode, std::size_t aDepth ) noexcept
+	{
+		auto& node = aBuild.nodes[aNode];
+		if( node.count <= 1 || aDepth >= kMaxDepth_ )
+			return false;
+
+		auto* const begin = aBuild.order.data() + node.first;
+		auto* const end = begin + node.count;
+
+		// Bin by centroid, so that each triangle falls into exactly one bin.
+		MeshBounds centroids = empty_box_();
+		for( auto* it = begin; it != end; ++it )
+		{
+			auto const c = aBuild.centroids[*it];
+			grow_( centroids, MeshBounds{ c, c } );
+		}
+
+		auto const bin_of = [&] (std::uint32_t aTriangle, std::size_t aAxis, float aScale) {
+			auto const offset = aBuild.centroids[aTriangle][aAxis] - centroids.min[aAxis];
+			return std::min( std::size_t(offset * aScale), kBins_-1 );
+		};
+
+		float bestCost = kInf_;
+		std::size_t bestAxis = 3, bestSplit = 0;
+		float bestScale = 0.f;
+		MeshBounds bestLeft{}, bestRight{};
+		std::uint32_t bestLeftCount = 0;
+
+		for( std::size_t axis = 0; axis < 3; ++axis )
+		{
+			float const extent = centroids.max[axis] - centroids.min[axis];
+			if( extent <= 0.f )
+				continue;
+
+			float const scale = float(kBins_) / extent;
+
+			std::uint32_t counts[kBins_] = {};
+			MeshBounds boxes[kBins_];
+			std::fill( std::begin( boxes ), std::end( boxes ), empty_box_() );
+
+			for( auto* it = begin; it != end; ++it )
+			{
+				auto const bin = bin_of( *it, axis, scale );
+				++counts[bin];
+				grow_( boxes[bin], aBuild.boxes[*it] );
+			}
+
+			// Sweep from the right, then from the left. Split i puts bins
+			// [0, i) to the left.
+			MeshBounds rightBoxes[kBins_];
+			float rightAreas[kBins_];
+			std::uint32_t rightCounts[kBins_];
+
+			MeshBounds accum = empty_box_();
+			std::uint32_t accumCount = 0;
+			for( std::size_t i = kBins_-1; i > 0; --i )
+			{
+				grow_( accum, boxes[i] );
+				accumCount += counts[i];
+
+				rightBoxes[i] = accum;
+				rightAreas[i] = half_area_( accum );
+				rightCounts[i] = accumCount;
+			}
+
+			accum = empty_box_();
+			accumCount = 0;
+			for( std::size_t i = 1; i < kBins_; ++i )
+			{
+				grow_( accum, boxes[i-1] );
+				accumCount += counts[i-1];
+
+				if( 0 == accumCount || 0 == rightCounts[i] )
+					continue;
+
+				float const cost = half_area_( accum ) * float(accumCount) + rightAreas[i] * float(rightCounts[i]);
+				if( cost < bestCost )
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = i;
+					bestScale = scale;
+					bestLeft = accum;
+					bestRight = rightBoxes[i];
+					bestLeftCount = accumCount;
+				}
+			}
+		}
+
+		std::uint32_t* middle = nullptr;
+		if( 3 == bestAxis )
+		{
+			// All centroids coincide. The SAH can't tell the triangles apart,
+			// so just halve the range if it's too large for a leaf.
+			if( node.count <= kMaxLeafSize_ )
+				return false;
+
+			middle = begin + node.count/2;
+
+			bestLeft = empty_box_();
+			for( auto* it = begin; it != middle; ++it )
+				grow_( bestLeft, aBuild.boxes[*it] );
+
+			bestRight = empty_box_();
+			for( auto* it = middle; it != end; ++it )
+				grow_( bestRight, aBuild.boxes[*it] );
+		}
+		else
+		{
+			float const area = half_area_( node.box );
+			float const leafCost = area * float(node.count);
+			float const splitCost = kTraversalCost_ * area + bestCost;
+
+			if( node.count <= kMaxLeafSize_ && leafCost <= splitCost )
+				return false;
+
+			middle = std::partition( begin, end, [&] (std::uint32_t aTriangle) {
+				return bin_of( aTriangle, bestAxis, bestScale ) < bestSplit;
+			} );
+
+			assert( std::uint32_t(middle - begin) == bestLeftCount );
+			(void)bestLeftCount;
+		}
+
+		auto const children = aBuild.nextNode.fetch_add( 2, std::memory_order_relaxed );
+		assert( children + 1 < aBuild.nodes.size() );
+
+		auto const leftCount = std::uint32_t(middle - begin);
+		aBuild.nodes[children+0] = Node2_{ bestLeft, node.first, leftCount };
+		aBuild.nodes[children+1] = Node2_{ bestRight, node.first + leftCount, node.count - leftCount };
+
+		node.first = children;
+		node.count = 0;
+		return true;
+	}
+
+	void build_subtree_( Build_& aBuild, std::uint32_t aNode, std::size_t aDepth ) noexcept
+	{
+		if( !split_( aBuild, aNode, aDepth ) )
+			return;
+
+		auto const children = aBuild.nodes[aNode].first;
+		build_subtree_( aBuild, children+0, aDepth+1 );
+		build_subtree_( aBuild, children+1, aDepth+1 );
+	}
+
+	std::uint32_t collapse_( Build_ const& aBuild, std::uint32_t aNode, std::size_t aDepth, std::vector<Node4_>& aOut, BvhStats& aStats )
+	{
+		// Pull grandchildren up into this node, opening the inner child with
+		// the largest surface area first (it's the most likely to be hit).
+		// A root that is a leaf ends up as the only child.
+		std::uint32_t slots[4] = { aNode };
+		std::size_t count = 1;
+
+		while( count < 4 )
+		{
+			std::size_t open = 4;
+			float openArea = -1.f;
+			for( std::size_t i = 0; i < count; ++i )
+			{
+				auto const& child = aBuild.nodes[slots[i]];
+				if( 0 == child.count && half_area_( child.box ) > openArea )
+				{
+					open = i;
+					openArea = half_area_( child.box );
+				}
+			}
+
+			if( 4 == open )
+				break;
+
+			auto const first = aBuild.nodes[slots[open]].first;
+			slots[open] = first;
+			slots[count++] = first+1;
+		}
+
+		auto const index = std::uint32_t(aOut.size());
+		aOut.emplace_back();
+
+		aStats.depth = std::max( aStats.depth, aDepth+1 );
+
+		for( std::size_t i = 0; i < 4; ++i )
+		{
+			MeshBounds box = empty_box_();
+			std::uint32_t child = 0, triangles = 0;
+
+			if( i < count )
+			{
+				auto const& node = aBuild.nodes[slots[i]];
+				box = node.box;
+
+				if( node.count )
+				{
+					child = node.first;
+					triangles = node.count;
+					++aStats.leaves;
+				}
+				else
+				{
+					child = collapse_( aBuild, slots[i], aDepth+1, aOut, aStats );
+				}
+			}
+
+			// aOut may have been reallocated by the recursion.
+			auto& out = aOut[index];
+			out.minX[i] = box.min.x; out.minY[i] = box.min.y; out.minZ[i] = box.min.z;
+			out.maxX[i] = box.max.x; out.maxY[i] = box.max.y; out.maxZ[i] = box.max.z;
+			out.child[i] = child;
+			out.count[i] = triangles;
+		}
+
+		return index;
+	}
+
+	// The slab test takes the near and far planes of each box according to
+	// the direction's signs, rather than min/max of both. This way, the empty
+	// boxes of unused slots (min = +inf, max = -inf) are always missed.
+#	if defined(__SSE2__)
+	unsigned slabs_( Node4_ const& aNode, RayData_ const& aRay, float aMaxT, float (&aNear)[4] ) noexcept
+	{
+		bool const nx = aRay.invDirection.x < 0.f, ny = aRay.invDirection.y < 0.f, nz = aRay.invDirection.z < 0.f;
+
+		__m128 const ox = _mm_set1_ps( aRay.origin.x ), oy = _mm_set1_ps( aRay.origin.y ), oz = _mm_set1_ps( aRay.origin.z );
+		__m128 const ix = _mm_set1_ps( aRay.invDirection.x ), iy = _mm_set1_ps( aRay.invDirection.y ), iz = _mm_set1_ps( aRay.invDirection.z );
+
+		__m128 const t0x = _mm_mul_ps( _mm_sub_ps( _mm_load_ps( nx ? aNode.maxX : aNode.minX ), ox ), ix );
+		__m128 const t1x = _mm_mul_ps( _mm_sub_ps( _mm_load_ps( nx ? aNode.minX : aNode.maxX ), ox ), ix );
+		__m128 const t0y = _mm_mul_ps( _mm_sub_ps( _mm_load_ps( ny ? aNode.maxY : aNode.minY ), oy ), iy );
+		__m128 const t1y = _mm_mul_ps( _mm_sub_ps( _mm_load_ps( ny ? aNode.minY : aNode.maxY ), oy ), iy );
+		__m128 const t0z = _mm_mul_ps( _mm_sub_ps( _mm_load_ps( nz ? aNode.maxZ : aNode.minZ ), oz ), iz );
+		__m128 const t1z = _mm_mul_ps( _mm_sub_ps( _mm_load_ps( nz ? aNode.minZ : aNode.maxZ ), oz ), iz );
+
+		__m128 const tmin = _mm_max_ps( _mm_max_ps( t0x, t0y ), _mm_max_ps( t0z, _mm_setzero_ps() ) );
+		__m128 const tmax = _mm_min_ps( _mm_min_ps( t1x, t1y ), _mm_min_ps( t1z, _mm_set1_ps( aMaxT ) ) );
+
+		_mm_storeu_ps( aNear, tmin );
+		return unsigned(_mm_movemask_ps( _mm_cmple_ps( tmin, tmax ) ));
+	}
+
+	unsigned box_distances_( Node4_ const& aNode, Vec3f aPoint, float aMaxDistance2, float (&aDistance2)[4] ) noexcept
+	{
+		__m128 const px = _mm_set1_ps( aPoint.x ), py = _mm_set1_ps( aPoint.y ), pz = _mm_set1_ps( aPoint.z );
+		__m128 const zero = _mm_setzero_ps();
+
+		__m128 const dx = _mm_max_ps( _mm_max_ps( _mm_sub_ps( _mm_load_ps( aNode.minX ), px ), _mm_sub_ps( px, _mm_load_ps( aNode.maxX ) ) ), zero );
+		__m128 const dy = _mm_max_ps( _mm_max_ps( _mm_sub_ps( _mm_load_ps( aNode.minY ), py ), _mm_sub_ps( py, _mm_load_ps( aNode.maxY ) ) ), zero );
+		__m128 const dz = _mm_max_ps( _mm_max_ps( _mm_sub_ps( _mm_load_ps( aNode.minZ ), pz ), _mm_sub_ps( pz, _mm_load_ps( aNode.maxZ ) ) ), zero );
+
+		__m128 const d2 = _mm_add_ps( _mm_add_ps( _mm_mul_ps( dx, dx ), _mm_mul_ps( dy, dy ) ), _mm_mul_ps( dz, dz ) );
+
+		_mm_storeu_ps( aDistance2, d2 );
+		return unsigned(_mm_movemask_ps( _mm_cmple_ps( d2, _mm_set1_ps( aMaxDistance2 ) ) ));
+	}
+#	else // !__SSE2__
+	unsigned slabs_( Node4_ const& aNode, RayData_ const& aRay, float aMaxT, float (&aNear)[4] ) noexcept
+	{
+		bool const nx = aRay.invDirection.x < 0.f, ny = aRay.invDirection.y < 0.f, nz = aRay.invDirection.z < 0.f;
+
+		unsigned mask = 0;
+		for( std::size_t i = 0; i < 4; ++i )
+		{
+			float const t0x = ((nx ? aNode.maxX[i] : aNode.minX[i]) - aRay.origin.x) * aRay.invDirection.x;
+			float const t1x = ((nx ? aNode.minX[i] : aNode.maxX[i]) - aRay.origin.x) * aRay.invDirection.x;
+			float const t0y = ((ny ? aNode.maxY[i] : aNode.minY[i]) - aRay.origin.y) * aRay.invDirection.y;
+			float const t1y = ((ny ? aNode.minY[i] : aNode.maxY[i]) - aRay.origin.y) * aRay.invDirection.y;
+			float const t0z = ((nz ? aNode.maxZ[i] : aNode.minZ[i]) - aRay.origin.z) * aRay.invDirection.z;
+			float const t1z = ((nz ? aNode.minZ[i] : aNode.maxZ[i]) - aRay.origin.z) * aRay.invDirection.z;
+
+			float const tmin = std::max( { t0x, t0y, t0z, 0.f } );
+			float const tmax = std::min( { t1x, t1y, t1z, aMaxT } );
+
+			aNear[i] = tmin;
+			if( tmin <= tmax )
+				mask |= 1u << i;
+		}
+
+		return mask;
+	}
+
+	unsigned box_distances_( Node4_ const& aNode, Vec3f aPoint, float aMaxDistance2, float (&aDistance2)[4] ) noexcept
+	{
+		unsigned mask = 0;
+		for( std::size_t i = 0; i < 4; ++i )
+		{
+			float const dx = std::max( { aNode.minX[i] - aPoint.x, aPoint.x - aNode.maxX[i], 0.f } );
+			float const dy = std::max( { aNode.minY[i] - aPoint.y, aPoint.y - aNode.maxY[i], 0.f } );
+			float const dz = std::max( { aNode.minZ[i] - aPoint.z, aPoint.z - aNode.maxZ[i], 0.f } );
+
+			aDistance2[i] = dx*dx + dy*dy + dz*dz;
+			if( aDistance2[i] <= aMaxDistance2 )
+				mask |= 1u << i;
+		}
+
+		return mask;
+	}
+#	endif // ~ __SSE2__
+
+	bool intersect_( Triangle_ const& aTriangle, RayData_ const& aRay, float aMaxT, BvhHit& aHit ) noexcept
+	{
+		// Moeller-Trumbore. Both sides of the triangle are hit.
+		Vec3f const p = cross( aRay.direction, aTriangle.e2 );
+		float const det = dot( aTriangle.e1, p );
+		if( 0.f == det )
+			return false;
+
+		float const invDet = 1.f / det;
+
+		Vec3f const s = aRay.origin - aTriangle.v0;
+		float const u = dot( s, p ) * invDet;
+		if( u < 0.f || u > 1.f )
+			return false;
+
+		Vec3f const q = cross( s, aTriangle.e1 );
+		float const v = dot( aRay.direction, q ) * invDet;
+		if( v < 0.f || u + v > 1.f )
+			return false;
+
+		float const t = dot( aTriangle.e2, q ) * invDet;
+		if( t < 0.f || t > aMaxT )
+			return false;
+
+		aHit = BvhHit{ t, aTriangle.index, u, v };
+		return true;
+	}
+
+	Vec3f closest_point_( Triangle_ const& aTriangle, Vec3f aPoint ) noexcept
+	{
+		// Ericson, Real-Time Collision Detection, 5.1.5: find the Voronoi
+		// region of the triangle that contains the point.
+		Vec3f const a = aTriangle.v0;
+		Vec3f const ab = aTriangle.e1;
+		Vec3f const ac = aTriangle.e2;
+
+		Vec3f const ap = aPoint - a;
+		float const d1 = dot( ab, ap );
+		float const d2 = dot( ac, ap );
+		if( d1 <= 0.f && d2 <= 0.f )
+			return a;
+
+		Vec3f const bp = ap - ab;
+		float const d3 = dot( ab, bp );
+		float const d4 = dot( ac, bp );
+		if( d3 >= 0.f && d4 <= d3 )
+			return a + ab;
+
+		float const vc = d1*d4 - d3*d2;
+		if( vc <= 0.f && d1 >= 0.f && d3 <= 0.f )
+			return a + (d1 / (d1 - d3)) * ab;
+
+		Vec3f const cp = ap - ac;
+		float const d5 = dot( ab, cp );
+		float const d6 = dot( ac, cp );
+		if( d6 >= 0.f && d5 <= d6 )
+			return a + ac;
+
+		float const vb = d5*d2 - d1*d6;
+		if( vb <= 0.f && d2 >= 0.f && d6 <= 0.f )
+			return a + (d2 / (d2 - d6)) * ac;
+
+		float const va = d3*d6 - d5*d4;
+		if( va <= 0.f && (d4 - d3) >= 0.f && (d5 - d6) >= 0.f )
+			return a + ab + ((d4 - d3) / ((d4 - d3) + (d5 - d6))) * (ac - ab);
+
+		float const denom = 1.f / (va + vb + vc);
+		return a + (vb * denom) * ab + (vc * denom) * ac;
+	}
+
+	void sort_children_( std::uint32_t (&aIndex)[4], float const (&aKey)[4], std::size_t aCount ) noexcept
+	{
+		for( std::size_t i = 1; i < aCount; ++i )
+		{
+			auto const index = aIndex[i];
+			std::size_t j = i;
+			for( ; j > 0 && aKey[aIndex[j-1]] > aKey[index]; --j )
+				aIndex[j] = aIndex[j-1];
+			aIndex[j] = index;
+		}
+	}
+}
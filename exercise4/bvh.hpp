@@ -0,0 +1,115 @@
+#ifndef BVH_HPP_9C3F5E12_4B7A_4D80_A6E1_3D28F0B7C945
+#define BVH_HPP_9C3F5E12_4B7A_4D80_A6E1_3D28F0B7C945
+
+#include <span>
+#include <limits>
+#include <vector>
+#include <optional>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "simple_mesh.hpp"
+
+#include "../support/job_system.hpp"
+
+#include "../vmlib/vec3.hpp"
+
+// Ray: origin + t * direction, for t >= 0. The direction doesn't need to be
+// normalized; distances along the ray (t) are in units of its length.
+struct Ray
+{
+	Vec3f origin;
+	Vec3f direction;
+};
+
+struct BvhHit
+{
+	float t;
+	std::uint32_t triangle; // index in the mesh (vertex / 3)
+	float u, v; // barycentric coordinates of vertices 1 and 2
+};
+
+struct BvhNearest
+{
+	float distance;
+	std::uint32_t triangle;
+	Vec3f point; // closest point on the triangle
+};
+
+struct BvhStats
+{
+	std::size_t triangles;
+	std::size_t nodes; // 4-wide
+	std::size_t leaves;
+	std::size_t depth;
+
+	std::size_t threads;
+	double buildMs;
+};
+
+// Bounding volume hierarchy over the triangles of a mesh
+//
+// Built in two steps:
+//  1. A binary BVH, using the surface area heuristic (SAH) evaluated on 16
+//     bins per axis over the triangles' centroids. The top levels are split
+//     on the calling thread until there are enough subtrees to keep all
+//     threads busy; the subtrees are then built as parallel jobs.
+//  2. The binary tree is collapsed into a 4-wide tree. Each node stores the
+//     bounding boxes of its four children as arrays of each coordinate
+//     (structure of arrays), so that a ray is tested against all four
+//     boxes at once. With SSE, these tests are 4-wide vector operations;
+//     otherwise, a scalar fallback is used.
+//
+// Triangles are copied into leaf order, in a form suited to the ray test.
+// The BVH doesn't refer to the mesh after construction.
+//
+// Queries are const and may be made from any number of threads.
+class Bvh final
+{
+	public:
+		// aPositions: a triangle soup, as in SimpleMeshData (three vertices
+		// per triangle).
+		Bvh( std::span<Vec3f const> aPositions, JobSystem& );
+
+	public:
+		// Closest hit with t in [0, aMaxT].
+		std::optional<BvhHit> intersect( Ray const&, float aMaxT = std::numeric_limits<float>::infinity() ) const noexcept;
+
+		// Closest point on the mesh to aPoint, if any is within aMaxDistance.
+		std::optional<BvhNearest> nearest( Vec3f aPoint, float aMaxDistance = std::numeric_limits<float>::infinity() ) const noexcept;
+
+		MeshBounds bounds() const noexcept;
+		BvhStats const& stats() const noexcept;
+
+	public:
+		// Four children. count[i] > 0: leaf with count[i] triangles starting
+		// at child[i]; count[i] == 0: inner node child[i]. Unused slots have
+		// empty (inverted) boxes, which no ray or point query enters.
+		struct alignas(16) Node4_
+		{
+			float minX[4], minY[4], minZ[4];
+			float maxX[4], maxY[4], maxZ[4];
+
+			std::uint32_t child[4];
+			std::uint32_t count[4];
+		};
+
+		static_assert( sizeof(Node4_) == 128 );
+
+		// Triangle in the form used by the ray test (Moeller-Trumbore)
+		struct Triangle_
+		{
+			Vec3f v0, e1, e2; // e1 = v1-v0, e2 = v2-v0
+			std::uint32_t index;
+		};
+
+	private:
+		std::vector<Node4_> mNodes; // [0] = root
+		std::vector<Triangle_> mTriangles;
+
+		MeshBounds mBounds;
+		BvhStats mStats;
+};
+
+#endif // BVH_HPP_9C3F5E12_4B7A_4D80_A6E1_3D28F0B7C945
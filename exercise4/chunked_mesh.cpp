@@ -0,0 +1,423 @@
+#include "chunked_mesh.hpp"
+
+#include <limits>
+#include <memory>
+#include <string>
+#include <algorithm>
+
+#include <cstring>
+#include <cassert>
+
+#include "../support/error.hpp"
+
+namespace
+{
+	constexpr std::size_t kBlockTriangles_ = 4096; // read at once while splitting
+	constexpr std::size_t kFileBuffer_ = 256*1024; // per file being written
+
+	// Beyond this depth, nodes aren't split spatially anymore
+	constexpr std::size_t kMaxDepth_ = 24;
+
+	struct Triangle_
+	{
+		ChunkVertex v[3];
+	};
+
+	static_assert( sizeof(Triangle_) == 3*sizeof(ChunkVertex) );
+
+	struct FileCloser_
+	{
+		void operator()( std::FILE* aFile ) const noexcept { std::fclose( aFile ); }
+	};
+
+	using File_ = std::unique_ptr<std::FILE, FileCloser_>;
+
+	File_ open_( std::filesystem::path const&, char const* aMode );
+
+	void write_( std::FILE*, void const*, std::size_t aBytes, std::filesystem::path const& );
+	void read_( std::FILE*, void*, std::size_t aBytes, std::filesystem::path const& );
+	void seek_( std::FILE*, std::uint64_t aOffset );
+
+	// Closes a file that was written, and reports errors that only show up
+	// when the buffered data is flushed.
+	void close_written_( File_&, std::filesystem::path const& );
+
+	MeshBounds empty_box_() noexcept;
+	void grow_( MeshBounds&, Vec3f ) noexcept;
+
+	Vec3f centroid_( Triangle_ const& ) noexcept;
+}
+
+ChunkedMeshWriter::ChunkedMeshWriter( std::filesystem::path aPath, ChunkedMeshConfig const& aConfig )
+	: mPath( std::move(aPath) )
+	, mConfig( aConfig )
+	, mSpill( nullptr )
+	, mTriangles( 0 )
+	, mBounds( empty_box_() )
+	, mCentroids( empty_box_() )
+	, mOut( nullptr )
+	, mOutOffset( 0 )
+	, mStats{}
+	, mTempCounter( 0 )
+{
+	if( 0 == mConfig.maxChunkTriangles || mConfig.maxChunkTriangles > std::numeric_limits<std::uint32_t>::max() / 3 )
+		throw Error( "ChunkedMeshWriter: invalid chunk size %zu", mConfig.maxChunkTriangles );
+
+	mSpillPath = temp_path_();
+	mSpill = open_( mSpillPath, "wb" ).release();
+	std::setvbuf( mSpill, nullptr, _IOFBF, kFileBuffer_ );
+}
+
+ChunkedMeshWriter::~ChunkedMeshWriter()
+{
+	if( mSpill )
+		std::fclose( mSpill );
+	if( mOut )
+		std::fclose( mOut );
+
+	std::error_code ec;
+	for( auto const& path : mTemporaries )
+		std::filesystem::remove( path, ec );
+}
+
+void ChunkedMeshWriter::add( std::span<Vec3f const> aPositions, std::span<Vec3f const> aColors )
+{
+	if( !mSpill )
+		throw Error( "ChunkedMeshWriter::add(): already finished" );
+	if( 0 != aPositions.size() % 3 || aColors.size() != aPositions.size() )
+		throw Error( "ChunkedMeshWriter::add(): expected whole triangles with one color per vertex (%zu positions, %zu colors)", aPositions.size(), aColors.size() );
+
+	for( std::size_t i = 0; i < aPositions.size(); i += 3 )
+	{
+		Triangle_ const triangle{ {
+			{ aPositions[i+0], aColors[i+0] },
+			{ aPositions[i+1], aColors[i+1] },
+			{ aPositions[i+2], aColors[i+2] }
+		} };
+
+		write_( mSpill, &triangle, sizeof(triangle), mSpillPath );
+
+		for( auto const& vertex : triangle.v )
+			grow_( mBounds, vertex.position );
+
+		grow_( mCentroids, centroid_( triangle ) );
+	}
+
+	mTriangles += aPositions.size() / 3;
+}
+
+ChunkedMeshStats ChunkedMeshWriter::finish()
+{
+	if( !mSpill )
+		throw Error( "ChunkedMeshWriter::finish(): already finished" );
+
+	File_ spill( std::exchange( mSpill, nullptr ) );
+	close_written_( spill, mSpillPath );
+
+	File_ out = open_( mPath, "wb" );
+	mOut = out.get();
+
+	// The header is rewritten once the node table is complete.
+	ChunkedMeshHeader header{};
+	write_( mOut, &header, sizeof(header), mPath );
+	mOutOffset = sizeof(header);
+
+	mNodes.assign( 1, ChunkedMeshNode{} );
+	if( mTriangles )
+	{
+		mNodes[0].bounds = mBounds;
+		build_( 0, mSpillPath, mTriangles, mCentroids, 0 );
+	}
+	else
+	{
+		mNodes[0].bounds = MeshBounds{ { 0.f, 0.f, 0.f }, { 0.f, 0.f, 0.f } };
+
+		std::filesystem::remove( mSpillPath );
+		std::erase( mTemporaries, mSpillPath );
+	}
+
+	std::memcpy( header.magic, kChunkedMeshMagic, sizeof(header.magic) );
+	header.version = kChunkedMeshVersion;
+	header.nodeCount = std::uint32_t(mNodes.size());
+	header.chunkCount = std::uint32_t(mStats.chunks);
+	header.triangles = mTriangles;
+	header.nodeOffset = mOutOffset;
+	header.bounds = mNodes[0].bounds;
+
+	for( auto const& node : mNodes )
+		header.maxChunkVertices = std::max( header.maxChunkVertices, node.vertexCount );
+
+	write_( mOut, mNodes.data(), mNodes.size() * sizeof(ChunkedMeshNode), mPath );
+
+	seek_( mOut, 0 );
+	write_( mOut, &header, sizeof(header), mPath );
+
+	mOut = nullptr;
+	close_written_( out, mPath );
+
+	mStats.triangles = std::size_t(mTriangles);
+	mStats.nodes = mNodes.size();
+	mStats.bytes = mOutOffset + mNodes.size() * sizeof(ChunkedMeshNode);
+	return mStats;
+}
+
+std::filesystem::path ChunkedMeshWriter::temp_path_()
+{
+	auto path = mPath;
+	path += ".tmp" + std::to_string( mTempCounter++ );
+
+	mTemporaries.emplace_back( path );
+	return path;
+}
+
+void ChunkedMeshWriter::build_( std::uint32_t aNode, std::filesystem::path const& aInput, std::uint64_t aTriangles, MeshBounds const& aCentroids, std::size_t aDepth )
+{
+	if( aTriangles <= mConfig.maxChunkTriangles || aDepth >= kMaxDepth_ )
+	{
+		write_leaves_( aNode, aInput, aTriangles, aDepth );
+		return;
+	}
+
+	// Distribute the triangles into octants around the center of their
+	// centroids. Unless all centroids coincide, at least two octants end up
+	// non-empty.
+	Vec3f const center = 0.5f * (aCentroids.min + aCentroids.max);
+
+	std::filesystem::path paths[8];
+	File_ files[8];
+	std::uint64_t counts[8] = {};
+	MeshBounds boxes[8], centroids[8];
+	std::fill( std::begin( boxes ), std::end( boxes ), empty_box_() );
+	std::fill( std::begin( centroids ), std::end( centroids ), empty_box_() );
+
+	{
+		File_ in = open_( aInput, "rb" );
+
+		std::vector<Triangle_> block( kBlockTriangles_ );
+		while( auto const count = std::fread( block.data(), sizeof(Triangle_), block.size(), in.get() ) )
+		{
+			for( std::size_t i = 0; i < count; ++i )
+			{
+				auto const& triangle = block[i];
+				Vec3f const c = centroid_( triangle );
+
+				std::size_t const octant = (c.x > center.x ? 1 : 0) | (c.y > center.y ? 2 : 0) | (c.z > center.z ? 4 : 0);
+				if( !files[octant] )
+				{
+					paths[octant] = temp_path_();
+					files[octant] = open_( paths[octant], "wb" );
+					std::setvbuf( files[octant].get(), nullptr, _IOFBF, kFileBuffer_ );
+				}
+
+				write_( files[octant].get(), &triangle, sizeof(triangle), paths[octant] );
+
+				++counts[octant];
+				for( auto const& vertex : triangle.v )
+					grow_( boxes[octant], vertex.position );
+				grow_( centroids[octant], c );
+			}
+		}
+
+		if( std::ferror( in.get() ) )
+			throw Error( "Unable to read '%s'", aInput.string().c_str() );
+	}
+
+	for( std::size_t i = 0; i < 8; ++i )
+	{
+		if( files[i] )
+			close_written_( files[i], paths[i] );
+	}
+
+	std::filesystem::remove( aInput );
+	std::erase( mTemporaries, aInput );
+
+	auto const children = std::size_t(std::count_if( std::begin( counts ), std::end( counts ), [] (std::uint64_t aCount) { return 0 != aCount; } ));
+	if( 1 == children )
+	{
+		// Can't be split spatially (centroids too close together).
+		auto const octant = std::size_t(std::find_if( std::begin( counts ), std::end( counts ), [] (std::uint64_t aCount) { return 0 != aCount; } ) - std::begin( counts ));
+		write_leaves_( aNode, paths[octant], aTriangles, aDepth );
+		return;
+	}
+
+	// Children are allocated together, so that they are contiguous. mNodes
+	// may be reallocated by the recursion; only use indices.
+	auto const first = std::uint32_t(mNodes.size());
+	mNodes.resize( mNodes.size() + children );
+	mNodes[aNode].firstChild = first;
+	mNodes[aNode].childCount = std::uint32_t(children);
+
+	std::uint32_t child = first;
+	for( std::size_t i = 0; i < 8; ++i )
+	{
+		if( 0 == counts[i] )
+			continue;
+
+		mNodes[child].bounds = boxes[i];
+		build_( child, paths[i], counts[i], centroids[i], aDepth+1 );
+		++child;
+	}
+}
+
+void ChunkedMeshWriter::write_leaves_( std::uint32_t aNode, std::filesystem::path const& aInput, std::uint64_t aTriangles, std::size_t aDepth )
+{
+	auto const perChunk = std::uint64_t(mConfig.maxChunkTriangles);
+	auto const pieces = (aTriangles + perChunk - 1) / perChunk;
+
+	// More than one chunk: this node gets the chunks as its children.
+	std::uint32_t first = aNode;
+	if( pieces > 1 )
+	{
+		first = std::uint32_t(mNodes.size());
+		mNodes.resize( mNodes.size() + pieces );
+		mNodes[aNode].firstChild = first;
+		mNodes[aNode].childCount = std::uint32_t(pieces);
+	}
+
+	File_ in = open_( aInput, "rb" );
+
+	std::vector<Triangle_> chunk( std::size_t(std::min( aTriangles, perChunk )) );
+	for( std::uint64_t i = 0; i < pieces; ++i )
+	{
+		auto const count = std::size_t(std::min( perChunk, aTriangles - i*perChunk ));
+		read_( in.get(), chunk.data(), count * sizeof(Triangle_), aInput );
+
+		auto& node = mNodes[first + i];
+		if( pieces > 1 )
+		{
+			node.bounds = empty_box_();
+			for( std::size_t j = 0; j < count; ++j )
+			{
+				for( auto const& vertex : chunk[j].v )
+					grow_( node.bounds, vertex.position );
+			}
+		}
+
+		node.dataOffset = mOutOffset;
+		node.vertexCount = std::uint32_t(3*count);
+
+		write_( mOut, chunk.data(), count * sizeof(Triangle_), mPath );
+		mOutOffset += count * sizeof(Triangle_);
+
+		++mStats.chunks;
+	}
+
+	in.reset();
+	std::filesystem::remove( aInput );
+	std::erase( mTemporaries, aInput );
+
+	mStats.depth = std::max( mStats.depth, aDepth + (pieces > 1 ? 2 : 1) );
+}
+
+
+ChunkedMeshStats write_chunked_mesh( std::filesystem::path const& aPath, SimpleMeshData const& aMesh, ChunkedMeshConfig const& aConfig )
+{
+	ChunkedMeshWriter writer( aPath, aConfig );
+	writer.add( aMesh.positions, aMesh.colors );
+	return writer.finish();
+}
+
+ChunkedMeshIndex read_chunked_mesh_index( std::filesystem::path const& aPath )
+{
+	File_ in = open_( aPath, "rb" );
+
+	ChunkedMeshIndex ret;
+	read_( in.get(), &ret.header, sizeof(ret.header), aPath );
+
+	auto const& header = ret.header;
+	if( 0 != std::memcmp( header.magic, kChunkedMeshMagic, sizeof(header.magic) ) || kChunkedMeshVersion != header.version )
+		throw Error( "'%s': not a chunked mesh file (or an unsupported version)", aPath.string().c_str() );
+
+	if( 0 == header.nodeCount )
+		throw Error( "'%s': no nodes", aPath.string().c_str() );
+
+	ret.nodes.resize( header.nodeCount );
+
+	seek_( in.get(), header.nodeOffset );
+	read_( in.get(), ret.nodes.data(), ret.nodes.size() * sizeof(ChunkedMeshNode), aPath );
+
+	// Enough checking that traversing the tree and reading chunks stays in
+	// bounds. Children must come after their parent, so the tree can't
+	// contain cycles and traversals terminate.
+	for( std::size_t i = 0; i < ret.nodes.size(); ++i )
+	{
+		auto const& node = ret.nodes[i];
+		bool const childrenValid = std::uint64_t(node.firstChild) + node.childCount <= header.nodeCount && (0 == node.childCount || node.firstChild > i);
+		bool const dataValid = 0 != node.childCount || (node.vertexCount <= header.maxChunkVertices && node.dataOffset + std::uint64_t(node.vertexCount) * sizeof(ChunkVertex) <= header.nodeOffset);
+
+		if( !childrenValid || !dataValid )
+			throw Error( "'%s': corrupt node table", aPath.string().c_str() );
+	}
+
+	return ret;
+}
+
+void read_chunk( std::FILE* aFile, ChunkedMeshNode const& aNode, ChunkVertex* aOut )
+{
+	assert( 0 == aNode.childCount );
+
+	seek_( aFile, aNode.dataOffset );
+
+	std::size_t const bytes = aNode.vertexCount * sizeof(ChunkVertex);
+	if( bytes && 1 != std::fread( aOut, bytes, 1, aFile ) )
+		throw Error( "Unable to read chunk at offset %llu (truncated file?)", static_cast<unsigned long long>(aNode.dataOffset) );
+}
+
+
+namespace
+{
+	File_ open_( std::filesystem::path const& aPath, char const* aMode )
+	{
+		File_ ret( std::fopen( aPath.string().c_str(), aMode ) );
+		if( !ret )
+			throw Error( "Unable to open '%s'", aPath.string().c_str() );
+
+		return ret;
+	}
+
+	void write_( std::FILE* aFile, void const* aData, std::size_t aBytes, std::filesystem::path const& aPath )
+	{
+		if( aBytes && 1 != std::fwrite( aData, aBytes, 1, aFile ) )
+			throw Error( "Unable to write to '%s'", aPath.string().c_str() );
+	}
+	void read_( std::FILE* aFile, void* aData, std::size_t aBytes, std::filesystem::path const& aPath )
+	{
+		if( aBytes && 1 != std::fread( aData, aBytes, 1, aFile ) )
+			throw Error( "Unable to read from '%s' (truncated file?)", aPath.string().c_str() );
+	}
+
+	void seek_( std::FILE* aFile, std::uint64_t aOffset )
+	{
+#		if defined(_WIN32)
+		int const ret = _fseeki64( aFile, static_cast<__int64>(aOffset), SEEK_SET );
+#		else
+		int const ret = fseeko( aFile, static_cast<off_t>(aOffset), SEEK_SET );
+#		endif
+
+		if( 0 != ret )
+			throw Error( "Unable to seek to offset %llu", static_cast<unsigned long long>(aOffset) );
+	}
+
+	void close_written_( File_& aFile, std::filesystem::path const& aPath )
+	{
+		if( 0 != std::fclose( aFile.release() ) )
+			throw Error( "Unable to write to '%s'", aPath.string().c_str() );
+	}
+
+	MeshBounds empty_box_() noexcept
+	{
+		constexpr float kInf = std::numeric_limits<float>::infinity();
+		return MeshBounds{ { kInf, kInf, kInf }, { -kInf, -kInf, -kInf } };
+	}
+
+	void grow_( MeshBounds& aBox, Vec3f aPoint ) noexcept
+	{
+		aBox.min = { std::min( aBox.min.x, aPoint.x ), std::min( aBox.min.y, aPoint.y ), std::min( aBox.min.z, aPoint.z ) };
+		aBox.max = { std::max( aBox.max.x, aPoint.x ), std::max( aBox.max.y, aPoint.y ), std::max( aBox.max.z, aPoint.z ) };
+	}
+
+	Vec3f centroid_( Triangle_ const& aTriangle ) noexcept
+	{
+		return (aTriangle.v[0].position + aTriangle.v[1].position + aTriangle.v[2].position) / 3.f;
+	}
+}
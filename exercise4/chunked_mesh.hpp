@@ -0,0 +1,164 @@
+#ifndef CHUNKED_MESH_HPP_4E8B2D71_C0A3_49F6_8D15_6A7E93B2F04C
+#define CHUNKED_MESH_HPP_4E8B2D71_C0A3_49F6_8D15_6A7E93B2F04C
+
+#include <span>
+#include <vector>
+#include <filesystem>
+
+#include <cstdio>
+#include <cstddef>
+#include <cstdint>
+
+#include "simple_mesh.hpp"
+
+#include "../vmlib/vec3.hpp"
+
+// Chunked mesh file
+//
+// A triangle soup, split spatially into chunks of at most a fixed number of
+// triangles, so that a mesh can be loaded (and rendered) piecewise. Chunks
+// are the leaves of an octree; each node stores the bounds of the triangles
+// below it.
+//
+// File layout:
+//   ChunkedMeshHeader
+//   chunk data: per leaf, vertexCount ChunkVertex (three per triangle)
+//   ChunkedMeshNode[nodeCount], at header.nodeOffset; the root comes first
+//
+// The children of a node are stored contiguously. Inner nodes usually have
+// up to eight children (one per non-empty octant); nodes whose triangles
+// can't be split spatially (e.g., all centroids coincide, or the depth limit
+// was reached) instead have as many leaf children as needed.
+//
+// All values are in the byte order of the machine that wrote the file.
+struct ChunkVertex
+{
+	Vec3f position;
+	Vec3f color;
+};
+
+static_assert( sizeof(ChunkVertex) == 24 );
+
+struct ChunkedMeshHeader
+{
+	char magic[8]; // kChunkedMeshMagic
+	std::uint32_t version;
+
+	std::uint32_t nodeCount;
+	std::uint32_t chunkCount;
+	std::uint32_t maxChunkVertices; // largest chunk in the file
+
+	std::uint64_t triangles;
+	std::uint64_t nodeOffset;
+
+	MeshBounds bounds;
+};
+
+struct ChunkedMeshNode
+{
+	MeshBounds bounds;
+
+	std::uint32_t firstChild; // index of the first child
+	std::uint32_t childCount; // 0 = leaf
+
+	std::uint64_t dataOffset; // leaves only, in bytes from the file start
+	std::uint32_t vertexCount; // leaves only
+	std::uint32_t reserved;
+};
+
+static_assert( sizeof(ChunkedMeshHeader) == 64 );
+static_assert( sizeof(ChunkedMeshNode) == 48 );
+
+inline constexpr char kChunkedMeshMagic[8] = { 'X', 'C', 'H', 'U', 'N', 'K', 'S', '\0' };
+inline constexpr std::uint32_t kChunkedMeshVersion = 1;
+
+
+struct ChunkedMeshConfig
+{
+	std::size_t maxChunkTriangles = 16384;
+};
+
+struct ChunkedMeshStats
+{
+	std::size_t triangles;
+	std::size_t chunks;
+	std::size_t nodes;
+	std::size_t depth;
+
+	std::uint64_t bytes; // file size
+};
+
+// Writes a chunked mesh file, without ever holding the whole mesh in memory
+//
+// Triangles passed to add() are appended to a temporary file. finish() then
+// builds the octree top-down: each node's triangles are read back in blocks
+// and distributed into one temporary file per octant (split at the center of
+// the triangles' centroids), until a node's triangles fit into a chunk. Only
+// one chunk and a few I/O buffers are held in memory at any time; temporary
+// files need about twice the size of the mesh on disk.
+//
+// Temporary files are placed next to the output (<path>.tmp<N>), and are
+// removed by finish() or, if it wasn't called, by the destructor.
+class ChunkedMeshWriter final
+{
+	public:
+		explicit ChunkedMeshWriter( std::filesystem::path, ChunkedMeshConfig const& = {} );
+		~ChunkedMeshWriter();
+
+		ChunkedMeshWriter( ChunkedMeshWriter const& ) = delete;
+		ChunkedMeshWriter& operator= (ChunkedMeshWriter const&) = delete;
+
+	public:
+		// Appends whole triangles (aPositions.size() must be a multiple of
+		// three; aColors must have the same size).
+		void add( std::span<Vec3f const> aPositions, std::span<Vec3f const> aColors );
+
+		// Builds and writes the file. The writer can't be used afterwards.
+		ChunkedMeshStats finish();
+
+	private:
+		std::filesystem::path temp_path_();
+
+		void build_( std::uint32_t aNode, std::filesystem::path const& aInput, std::uint64_t aTriangles, MeshBounds const& aCentroids, std::size_t aDepth );
+
+		// Writes the triangles of aInput as one or more leaves.
+		void write_leaves_( std::uint32_t aNode, std::filesystem::path const& aInput, std::uint64_t aTriangles, std::size_t aDepth );
+
+	private:
+		std::filesystem::path mPath;
+		ChunkedMeshConfig mConfig;
+
+		std::FILE* mSpill; // triangles from add()
+		std::filesystem::path mSpillPath;
+
+		std::uint64_t mTriangles;
+		MeshBounds mBounds, mCentroids;
+
+		std::FILE* mOut;
+		std::uint64_t mOutOffset;
+
+		std::vector<ChunkedMeshNode> mNodes;
+		ChunkedMeshStats mStats;
+
+		std::size_t mTempCounter;
+		std::vector<std::filesystem::path> mTemporaries; // not yet removed
+};
+
+// Convenience: writes aMesh with a ChunkedMeshWriter.
+ChunkedMeshStats write_chunked_mesh( std::filesystem::path const&, SimpleMeshData const&, ChunkedMeshConfig const& = {} );
+
+
+// Header and node table of a chunked mesh file. Chunk data isn't loaded.
+struct ChunkedMeshIndex
+{
+	ChunkedMeshHeader header;
+	std::vector<ChunkedMeshNode> nodes;
+};
+
+ChunkedMeshIndex read_chunked_mesh_index( std::filesystem::path const& );
+
+// Reads the vertices of the leaf aNode from a file opened in binary mode.
+// aOut must have space for aNode.vertexCount vertices.
+void read_chunk( std::FILE*, ChunkedMeshNode const& aNode, ChunkVertex* aOut );
+
+#endif // CHUNKED_MESH_HPP_4E8B2D71_C0A3_49F6_8D15_6A7E93B2F04C
@@ -0,0 +1,87 @@
+#include "dynamic_resolution.hpp"
+
+#include <algorithm>
+
+#include <cmath>
+
+#include "../support/error.hpp"
+
+namespace
+{
+	constexpr double kHighWater_ = 0.95; // scale down above this (x target)
+	constexpr double kLowWater_ = 0.75; // scale up below this (x target)
+	constexpr double kAim_ = 0.85; // aim for this (x target) when changing
+
+	constexpr double kSmoothing_ = 0.15; // weight of a new sample
+
+	constexpr std::size_t kCooldownSamples_ = 10;
+
+	// Limit each step, so that a single outlier can't change the resolution
+	// drastically. Increases are more careful than decreases.
+	constexpr double kMaxDecrease_ = 0.75;
+	constexpr double kMaxIncrease_ = 1.1;
+
+	// Scales are rounded to multiples of this, so that tiny changes are not
+	// applied at all.
+	constexpr float kScaleQuantum_ = 1.f / 32.f;
+}
+
+ResolutionController::ResolutionController( DynamicResolutionConfig const& aConfig )
+	: mConfig( aConfig )
+	, mScale( aConfig.maxScale )
+	, mSmoothedMs( 0.0 )
+	, mSamples( 0 )
+	, mCooldown( 0 )
+{
+	if( !(mConfig.targetMs > 0.f) )
+		throw Error( "ResolutionController: target frame time must be positive (got %f ms)", double(mConfig.targetMs) );
+	if( !(mConfig.minScale > 0.f) || mConfig.minScale > mConfig.maxScale )
+		throw Error( "ResolutionController: invalid scale range [%f, %f]", double(mConfig.minScale), double(mConfig.maxScale) );
+}
+
+bool ResolutionController::update( double aGpuMs ) noexcept
+{
+	mSmoothedMs = (0 == mSamples++) ? aGpuMs : mSmoothedMs + kSmoothing_ * (aGpuMs - mSmoothedMs);
+
+	if( mCooldown )
+	{
+		--mCooldown;
+		return false;
+	}
+
+	double const target = double(mConfig.targetMs);
+	if( mSmoothedMs <= kHighWater_ * target && mSmoothedMs >= kLowWater_ * target )
+		return false;
+
+	// Time ~ pixels ~ scale^2
+	double const factor = std::clamp( std::sqrt( kAim_ * target / std::max( mSmoothedMs, 1e-3 ) ), kMaxDecrease_, kMaxIncrease_ );
+
+	float scale = std::round( float(mScale * factor) / kScaleQuantum_ ) * kScaleQuantum_;
+	scale = std::clamp( scale, mConfig.minScale, mConfig.maxScale );
+
+	if( scale == mScale )
+		return false;
+
+	// Predict the effect of the change, so that the next decision doesn't
+	// start from stale data.
+	double const ratio = double(scale) / double(mScale);
+	mSmoothedMs *= ratio * ratio;
+
+	mScale = scale;
+	mCooldown = kCooldownSamples_;
+	return true;
+}
+
+float ResolutionController::scale() const noexcept
+{
+	return mScale;
+}
+double ResolutionController::smoothed_ms() const noexcept
+{
+	return mSmoothedMs;
+}
+
+int ResolutionController::scaled( int aOutputSize ) const noexcept
+{
+	return std::max( 1, int(std::lround( float(aOutputSize) * mScale )) );
+}
@@ -0,0 +1,50 @@
+#ifndef DYNAMIC_RESOLUTION_HPP_9A41E6D2_2F7B_4C53_B1E8_5C0D7F3A6E14
+#define DYNAMIC_RESOLUTION_HPP_9A41E6D2_2F7B_4C53_B1E8_5C0D7F3A6E14
+
+#include <cstddef>
+
+struct DynamicResolutionConfig
+{
+	bool enabled = false;
+
+	float targetMs = 1000.f / 60.f; // GPU time budget per frame
+	float minScale = 0.5f;
+	float maxScale = 1.f;
+};
+
+// Picks the internal render resolution from measured GPU frame times.
+//
+// The scene is rendered at scale() times the output resolution (per axis),
+// and upscaled to the output afterwards. GPU time is assumed to be roughly
+// proportional to the number of pixels, i.e., to the square of the scale.
+//
+// To avoid oscillation, the controller
+//  - smooths the measured times (exponential moving average),
+//  - only reacts when the smoothed time leaves a band around the target
+//    (hysteresis): it scales down above 95% of the target and up below 75%,
+//  - waits for a number of samples after each change, since GPU timings
+//    arrive a few frames late and the new resolution needs to take effect.
+class ResolutionController final
+{
+	public:
+		explicit ResolutionController( DynamicResolutionConfig const& );
+
+	public:
+		// Feed a new GPU frame time. Returns true if scale() changed.
+		bool update( double aGpuMs ) noexcept;
+
+		float scale() const noexcept;
+		double smoothed_ms() const noexcept;
+
+		// Render size for the given output size at the current scale.
+		int scaled( int aOutputSize ) const noexcept;
+
+	private:
+		DynamicResolutionConfig mConfig;
+
+		float mScale;
+		double mSmoothedMs;
+		std::size_t mSamples, mCooldown;
+};
+
+#endif // DYNAMIC_RESOLUTION_HPP_9A41E6D2_2F7B_4C53_B1E8_5C0D7F3A6E14
@@ -0,0 +1,316 @@
+#include "frame_capture.hpp"
+
+#include <utility>
+#include <algorithm>
+#include <system_error>
+
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+
+#include <stb_image_write.h>
+
+#include "../support/error.hpp"
+#include "../support/checkpoint.hpp"
+
+namespace
+{
+	constexpr GLuint64 kFenceTimeoutNs_ = 1'000'000'000; // 1s
+
+	// Alpha is dropped: the scene is cleared to a transparent color, which
+	// would make the background transparent in the images.
+	constexpr std::size_t kBytesPerPixel_ = 3; // RGB8
+}
+
+FrameCapture::FrameCapture( GpuResources& aResources, CaptureConfig const& aConfig, std::size_t aRingSize, std::size_t aEncoderCount, std::size_t aMaxQueuedFrames )
+	: mResources( aResources )
+	, mConfig( aConfig )
+	, mSlots( aRingSize )
+	, mOldest( 0 )
+	, mInFlight( 0 )
+	, mMaxQueued( aMaxQueuedFrames )
+	, mBusy( 0 )
+	, mStop( false )
+	, mFailed( 0 )
+	, mErrorReported( false )
+	, mStats{}
+{
+	if( 0 == aRingSize || 0 == aEncoderCount || 0 == aMaxQueuedFrames )
+		throw Error( "FrameCapture: invalid configuration (%zu buffers, %zu encoders, %zu queued)", aRingSize, aEncoderCount, aMaxQueuedFrames );
+
+	if( 0 == mConfig.every )
+		mConfig.every = 1;
+
+	std::error_code ec;
+	std::filesystem::create_directories( mConfig.directory, ec );
+	if( ec )
+		throw Error( "FrameCapture: unable to create directory '%s': %s", mConfig.directory.string().c_str(), ec.message().c_str() );
+
+	mEncoders.reserve( aEncoderCount );
+	for( std::size_t i = 0; i < aEncoderCount; ++i )
+		mEncoders.emplace_back( [this] { encoder_(); } );
+}
+
+FrameCapture::~FrameCapture()
+{
+	{
+		std::scoped_lock lock( mMutex );
+		mStop = true;
+	}
+
+	mWorkCv.notify_all();
+	mSpaceCv.notify_all();
+
+	for( auto& encoder : mEncoders )
+		encoder.join();
+
+	// The buffers are released with the slots.
+	for( auto& slot : mSlots )
+	{
+		if( slot.fence )
+			glDeleteSync( slot.fence );
+	}
+}
+
+void FrameCapture::capture( GLuint aFramebuffer, int aWidth, int aHeight, std::size_t aFrameIndex )
+{
+	report_errors_();
+
+	if( 0 != aFrameIndex % mConfig.every )
+		return;
+
+	// Ring full: the oldest readback must complete before its buffer can be
+	// reused.
+	if( mInFlight == mSlots.size() )
+	{
+		++mStats.readbackStalls;
+		retire_( mSlots[mOldest], true );
+	}
+
+	auto& slot = mSlots[(mOldest + mInFlight) % mSlots.size()];
+	assert( !slot.fence );
+
+	auto const bytes = GLsizeiptr(std::size_t(aWidth) * std::size_t(aHeight) * kBytesPerPixel_);
+
+	if( bytes > slot.capacity )
+	{
+		slot.buffer = mResources.create_buffer( GpuMemoryCategory::other, bytes, nullptr, GL_MAP_READ_BIT );
+		slot.capacity = bytes;
+	}
+
+	glBindBuffer( GL_PIXEL_PACK_BUFFER, slot.buffer.id() );
+
+	glBindFramebuffer( GL_READ_FRAMEBUFFER, aFramebuffer );
+	glReadBuffer( 0 == aFramebuffer ? GL_BACK : GL_COLOR_ATTACHMENT0 );
+
+	glPixelStorei( GL_PACK_ALIGNMENT, 1 );
+	glReadPixels( 0, 0, aWidth, aHeight, GL_RGB, GL_UNSIGNED_BYTE, nullptr );
+	glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+
+	slot.fence = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+	slot.width = aWidth;
+	slot.height = aHeight;
+	slot.frameIndex = aFrameIndex;
+
+	++mInFlight;
+}
+
+void FrameCapture::poll()
+{
+	report_errors_();
+
+	// retire_() would wait for space in a full queue.
+	while( mInFlight && !queue_full_() )
+	{
+		auto& slot = mSlots[mOldest];
+
+		auto const res = glClientWaitSync( slot.fence, 0, 0 );
+		if( GL_ALREADY_SIGNALED != res && GL_CONDITION_SATISFIED != res )
+			break;
+
+		retire_( slot, false );
+	}
+}
+
+void FrameCapture::finish()
+{
+	while( mInFlight )
+		retire_( mSlots[mOldest], true );
+
+	{
+		std::unique_lock lock( mMutex );
+		mIdleCv.wait( lock, [this] { return mQueue.empty() && 0 == mBusy; } );
+	}
+
+	report_errors_();
+}
+
+CaptureStats FrameCapture::stats() const noexcept
+{
+	return mStats;
+}
+
+void FrameCapture::retire_( Slot_& aSlot, bool aWait )
+{
+	assert( &aSlot == &mSlots[mOldest] && mInFlight );
+
+	if( aWait )
+	{
+		// See wait_and_delete_() in support/uniform_ring.cpp
+		GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+		for( ;; )
+		{
+			auto const res = glClientWaitSync( aSlot.fence, flags, kFenceTimeoutNs_ );
+			if( GL_ALREADY_SIGNALED == res || GL_CONDITION_SATISFIED == res )
+				break;
+
+			if( GL_WAIT_FAILED == res )
+				throw Error( "FrameCapture: glClientWaitSync() failed" );
+
+			flags = 0;
+		}
+	}
+
+	glDeleteSync( aSlot.fence );
+	aSlot.fence = nullptr;
+
+	mOldest = (mOldest + 1) % mSlots.size();
+	--mInFlight;
+
+	// Wait for space in the queue before mapping, so that the buffer isn't
+	// kept mapped while waiting. A pixel buffer is reused if one is free.
+	Job_ job{ {}, aSlot.width, aSlot.height, aSlot.frameIndex };
+	{
+		std::unique_lock lock( mMutex );
+		if( mQueue.size() >= mMaxQueued )
+		{
+			++mStats.encoderStalls;
+			mSpaceCv.wait( lock, [this] { return mQueue.size() < mMaxQueued || mStop; } );
+		}
+
+		if( !mFreePixels.empty() )
+		{
+			job.pixels = std::move(mFreePixels.back());
+			mFreePixels.pop_back();
+		}
+	}
+
+	auto const rowBytes = std::size_t(aSlot.width) * kBytesPerPixel_;
+	auto const bytes = rowBytes * std::size_t(aSlot.height);
+	job.pixels.resize( bytes );
+
+	glBindBuffer( GL_PIXEL_PACK_BUFFER, aSlot.buffer.id() );
+	auto const* src = static_cast<std::uint8_t const*>(glMapBufferRange( GL_PIXEL_PACK_BUFFER, 0, GLsizeiptr(bytes), GL_MAP_READ_BIT ));
+	if( !src )
+	{
+		glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+		throw Error( "FrameCapture: glMapBufferRange() failed" );
+	}
+
+	// GL returns the bottom row first; images are stored top row first.
+	for( int y = 0; y < aSlot.height; ++y )
+		std::memcpy( job.pixels.data() + std::size_t(aSlot.height-1-y) * rowBytes, src + std::size_t(y) * rowBytes, rowBytes );
+
+	glUnmapBuffer( GL_PIXEL_PACK_BUFFER );
+	glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+
+	{
+		std::scoped_lock lock( mMutex );
+		mQueue.emplace_back( std::move(job) );
+		++mStats.captured;
+	}
+
+	mWorkCv.notify_one();
+}
+
+void FrameCapture::encoder_()
+{
+	for( ;; )
+	{
+		Job_ job;
+		{
+			std::unique_lock lock( mMutex );
+			mWorkCv.wait( lock, [this] { return !mQueue.empty() || mStop; } );
+
+			if( mQueue.empty() )
+				return;
+
+			job = std::move(mQueue.front());
+			mQueue.pop_front();
+			++mBusy;
+		}
+
+		mSpaceCv.notify_one();
+
+		std::string error;
+		try
+		{
+			write_( job );
+		}
+		catch( std::exception const& eErr )
+		{
+			error = eErr.what();
+		}
+
+		{
+			std::scoped_lock lock( mMutex );
+			--mBusy;
+
+			if( !error.empty() )
+			{
+				++mFailed;
+				if( mFirstError.empty() )
+					mFirstError = std::move(error);
+			}
+
+			mFreePixels.emplace_back( std::move(job.pixels) );
+		}
+
+		mIdleCv.notify_all();
+	}
+}
+
+void FrameCapture::write_( Job_ const& aJob ) const
+{
+	char name[64];
+	if( CaptureFormat::png == mConfig.format )
+		std::snprintf( name, sizeof(name), "frame_%06zu.png", aJob.frameIndex );
+	else
+		std::snprintf( name, sizeof(name), "frame_%06zu_%dx%d.rgb", aJob.frameIndex, aJob.width, aJob.height );
+
+	auto const path = (mConfig.directory / name).string();
+
+	if( CaptureFormat::png == mConfig.format )
+	{
+		int const stride = aJob.width * int(kBytesPerPixel_);
+		if( !stbi_write_png( path.c_str(), aJob.width, aJob.height, int(kBytesPerPixel_), aJob.pixels.data(), stride ) )
+			throw Error( "FrameCapture: unable to write '%s'", path.c_str() );
+	}
+	else
+	{
+		std::FILE* file = std::fopen( path.c_str(), "wb" );
+		if( !file )
+			throw Error( "FrameCapture: unable to open '%s' for writing", path.c_str() );
+
+		auto const written = std::fwrite( aJob.pixels.data(), 1, aJob.pixels.size(), file );
+		std::fclose( file );
+
+		if( written != aJob.pixels.size() )
+			throw Error( "FrameCapture: unable to write '%s'", path.c_str() );
+	}
+}
+
+bool FrameCapture::queue_full_()
+{
+	std::scoped_lock lock( mMutex );
+	return mQueue.size() >= mMaxQueued;
+}
+
+void FrameCapture::report_errors_()
+{
+	std::scoped_lock lock( mMutex );
+	mStats.failed = mFailed;
+
+	if( !mFirstError.empty() && !std::exchange( mErrorReported, true ) )
+		std::fprintf( stderr, "Warning: %s. Frames that can't be written are dropped.\n", mFirstError.c_str() );
+}
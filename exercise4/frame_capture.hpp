@@ -0,0 +1,150 @@
+#ifndef FRAME_CAPTURE_HPP_3F0C2E71_8B6D_4C1A_9E55_7D2A1B64C0F9
+#define FRAME_CAPTURE_HPP_3F0C2E71_8B6D_4C1A_9E55_7D2A1B64C0F9
+
+#include <glad/glad.h>
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <filesystem>
+#include <condition_variable>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "../support/gpu_resources.hpp"
+
+enum class CaptureFormat
+{
+	png,
+	raw     // tightly packed RGB8, top row first
+};
+
+struct CaptureConfig
+{
+	bool enabled = false;
+
+	std::filesystem::path directory;
+	CaptureFormat format = CaptureFormat::png;
+
+	std::size_t every = 1; // capture every N-th frame
+};
+
+struct CaptureStats
+{
+	std::size_t captured; // frames handed to the encoders
+	std::size_t readbackStalls; // waits for a pack buffer that wasn't ready
+	std::size_t encoderStalls; // waits for space in the encoder queue
+	std::size_t failed; // frames that the encoders couldn't write
+};
+
+// Asynchronous frame capture
+//
+// glReadPixels() into client memory waits for the GPU to finish the frame.
+// Instead, capture() reads into one of a ring of pixel pack buffers and
+// inserts a fence. The buffer is mapped a few frames later, once the fence
+// has signalled, and its contents are handed to background threads that
+// encode and write the image with stb_image_write.
+//
+// Frames are written to <directory>/frame_<index>.png (or .rgb for raw
+// frames). Raw frames have no header; the size is included in the name.
+//
+// If the GPU falls behind by more than the ring size, or the encoders by
+// more than the queue size, capture() waits. stats() reports how often that
+// happened. poll() never waits; it leaves readbacks in flight while the
+// encoder queue is full.
+//
+// Frames that can't be written (e.g., disk full) are dropped. The first
+// error is printed to stderr; later ones are only counted (see
+// CaptureStats::failed), so that capturing doesn't end the application.
+//
+// The pack buffers come from a GpuResources (category "other"). A buffer is
+// replaced by a larger one when the frame size grows; the old one is deleted
+// once the GPU is done with it.
+//
+// Call finish() before destroying the FrameCapture; readbacks that are still
+// in flight are otherwise dropped.
+class FrameCapture final
+{
+	public:
+		FrameCapture(
+			GpuResources&,
+			CaptureConfig const&,
+			std::size_t aRingSize = 3,
+			std::size_t aEncoderCount = 2,
+			std::size_t aMaxQueuedFrames = 8
+		);
+		~FrameCapture();
+
+		FrameCapture( FrameCapture const& ) = delete;
+		FrameCapture& operator= (FrameCapture const&) = delete;
+
+	public:
+		// Reads the color buffer of aFramebuffer (0 = the default
+		// framebuffer's back buffer). Frames that aren't a multiple of
+		// CaptureConfig::every are skipped.
+		void capture( GLuint aFramebuffer, int aWidth, int aHeight, std::size_t aFrameIndex );
+
+		// Hands any completed readbacks to the encoders without waiting,
+		// as long as there is space in the encoder queue. Call once per
+		// frame.
+		void poll();
+
+		// Waits for all outstanding readbacks and for the encoders to write
+		// all queued frames.
+		void finish();
+
+		CaptureStats stats() const noexcept;
+
+	private:
+		struct Slot_
+		{
+			GpuBuffer buffer;
+			GLsizeiptr capacity = 0;
+			GLsync fence = nullptr;
+
+			int width = 0, height = 0;
+			std::size_t frameIndex = 0;
+		};
+
+		struct Job_
+		{
+			std::vector<std::uint8_t> pixels;
+			int width, height;
+			std::size_t frameIndex;
+		};
+
+		void retire_( Slot_&, bool aWait );
+		void encoder_();
+		void write_( Job_ const& ) const;
+
+		bool queue_full_();
+		void report_errors_();
+
+	private:
+		GpuResources& mResources;
+		CaptureConfig mConfig;
+
+		std::vector<Slot_> mSlots;
+		std::size_t mOldest, mInFlight;
+
+		std::vector<std::thread> mEncoders;
+		std::size_t mMaxQueued;
+
+		std::mutex mMutex;
+		std::condition_variable mWorkCv, mSpaceCv, mIdleCv;
+		std::deque<Job_> mQueue;
+		std::vector<std::vector<std::uint8_t>> mFreePixels;
+		std::size_t mBusy;
+		bool mStop;
+
+		std::size_t mFailed;
+		std::string mFirstError; // printed once by report_errors_()
+		bool mErrorReported;
+
+		CaptureStats mStats; // main thread only
+};
+
+#endif // FRAME_CAPTURE_HPP_3F0C2E71_8B6D_4C1A_9E55_7D2A1B64C0F9
@@ -0,0 +1,136 @@
+#include "frame_pipeline.hpp"
+
+#include <algorithm>
+
+namespace
+{
+	// Objects per chunk. Large enough to amortize the per-chunk overheads
+	// (queue sort, merge), small enough to balance the load across threads.
+	constexpr std::size_t kChunkSize_ = 1024;
+
+	Mat44fAffine model_to_world_( SceneObject const& aObject, float aTime ) noexcept
+	{
+		return make_translation( aObject.position ) 
+			* make_rotation_y( aObject.spin * aTime ) 
+			* make_scaling( aObject.scale, aObject.scale, aObject.scale )
+		;
+	}
+}
+
+FramePipeline::FramePipeline( JobSystem& aJobs )
+	: mJobs( aJobs )
+{}
+
+FramePipelineStats FramePipeline::build( std::span<SceneMesh const> aMeshes, std::span<SceneObject const> aObjects, FrameView const& aView, ObjectUniforms* aObjectData, RenderQueue& aQueue )
+{
+	auto const chunkCount = (aObjects.size() + kChunkSize_-1) / kChunkSize_;
+
+	if( mChunkQueues.size() < chunkCount )
+		mChunkQueues.resize( chunkCount );
+
+	mChunkStats.assign( chunkCount, FramePipelineStats{} );
+
+	// One chunk per job.
+	mJobs.parallel_for( chunkCount, [&] (std::size_t aChunk, std::size_t) {
+		auto& queue = mChunkQueues[aChunk];
+		auto& stats = mChunkStats[aChunk];
+
+		queue.clear();
+
+		auto const begin = aChunk * kChunkSize_;
+		auto const end = std::min( begin + kChunkSize_, aObjects.size() );
+
+		for( std::size_t i = begin; i < end; ++i )
+		{
+			auto const& object = aObjects[i];
+			auto const& mesh = aMeshes[object.mesh];
+
+			Mat44fAffine const model2world = model_to_world_( object, aView.time );
+			Mat44f const model2clip = aView.projCamera * model2world;
+
+			if( outside_frustum( model2clip, mesh.bounds ) )
+			{
+				++stats.culled;
+				continue;
+			}
+
+			++stats.visible;
+
+			// Draw ID = object index. Only visible objects' slots are written.
+			aObjectData[i] = ObjectUniforms{ model2world, object.baseColor };
+
+			// For a perspective projection, clip-space w is the view depth.
+			Vec3f const center = 0.5f * (mesh.bounds.min + mesh.bounds.max);
+			Vec4f const clip = model2clip * Vec4f{ center.x, center.y, center.z, 1.f };
+
+			queue.push( DrawItem{
+				make_sort_key( RenderPass::opaque, aView.program, mesh.vao, clip.w / aView.farPlane ),
+				aView.program, mesh.vao,
+				GL_TRIANGLES, mesh.first, mesh.count,
+				GLuint(i)
+			} );
+		}
+
+		queue.sort();
+	}, 1 );
+
+	aQueue.merge_sorted( std::span<RenderQueue const>( mChunkQueues.data(), chunkCount ) );
+
+	FramePipelineStats ret{};
+	for( auto const& stats : mChunkStats )
+	{
+		ret.visible += stats.visible;
+		ret.culled += stats.culled;
+	}
+
+	return ret;
+}
+
+void FramePipeline::write_objects( std::span<SceneObject const> aObjects, FrameView const& aView, ObjectUniforms* aObjectData )
+{
+	mJobs.parallel_for( aObjects.size(), [&] (std::size_t aBegin, std::size_t aEnd) {
+		for( std::size_t i = aBegin; i < aEnd; ++i )
+		{
+			auto const& object = aObjects[i];
+			aObjectData[i] = ObjectUniforms{ model_to_world_( object, aView.time ), object.baseColor };
+		}
+	}, kChunkSize_ );
+}
+
+std::size_t FramePipeline::thread_count() const noexcept
+{
+	return mJobs.thread_count();
+}
+
+bool outside_frustum( Mat44f const& aModel2Clip, MeshBounds const& aBounds ) noexcept
+{
+	// Transform the box's corners to clip space. The box is outside if
+	// all corners are on the outside of the same frustum plane. This is
+	// conservative: some boxes that are outside are not rejected.
+	Vec4f corners[8];
+	for( std::size_t i = 0; i < 8; ++i )
+	{
+		Vec4f const corner{
+			(i & 1) ? aBounds.max.x : aBounds.min.x,
+			(i & 2) ? aBounds.max.y : aBounds.min.y,
+			(i & 4) ? aBounds.max.z : aBounds.min.z,
+			1.f
+		};
+		corners[i] = aModel2Clip * corner;
+	}
+
+	for( std::size_t axis = 0; axis < 3; ++axis )
+	{
+		bool allBelow = true, allAbove = true;
+		for( auto const& c : corners )
+		{
+			allBelow = allBelow && c[axis] < -c.w;
+			allAbove = allAbove && c[axis] > c.w;
+		}
+
+		if( allBelow || allAbove )
+			return true;
+	}
+
+	return false;
+}
@@ -0,0 +1,88 @@
+#ifndef FRAME_PIPELINE_HPP_525758A5_78A7_46C8_A236_EAF76B7EFA67
+#define FRAME_PIPELINE_HPP_525758A5_78A7_46C8_A236_EAF76B7EFA67
+
+#include <glad/glad.h>
+
+#include <span>
+#include <vector>
+
+#include <cstddef>
+
+#include "scene.hpp"
+#include "render_queue.hpp"
+
+#include "../support/job_system.hpp"
+
+#include "../vmlib/mat44.hpp"
+
+// Builds the frame's draw list in parallel
+//
+// The scene's objects are split into fixed-size chunks. The job system's
+// threads (including the calling thread) pick up chunks and, for each object
+// in the chunk,
+//  - compute the model-to-world and model-to-clip matrices,
+//  - cull the object's bounding box against the view frustum,
+//  - write the object's shader data to its slot (= draw ID) in the
+//    per-frame object array, and
+//  - emit a draw item into the chunk's render queue.
+// Each chunk's queue is sorted on the worker. The calling (GL) thread then
+// only has to merge the sorted chunks and submit the result.
+//
+// No GL calls are made from the jobs.
+struct FrameView
+{
+	Mat44f projCamera;
+	float farPlane;
+	float time; // seconds
+
+	GLuint program;
+};
+
+struct FramePipelineStats
+{
+	std::size_t visible;
+	std::size_t culled;
+};
+
+class FramePipeline final
+{
+	public:
+		explicit FramePipeline( JobSystem& );
+
+		FramePipeline( FramePipeline const& ) = delete;
+		FramePipeline& operator= (FramePipeline const&) = delete;
+
+	public:
+		// aObjectData must point to (at least) aObjects.size() elements. On
+		// return, aQueue holds the sorted draws of all visible objects.
+		FramePipelineStats build( 
+			std::span<SceneMesh const> aMeshes,
+			std::span<SceneObject const> aObjects,
+			FrameView const& aView,
+			ObjectUniforms* aObjectData,
+			RenderQueue& aQueue
+		);
+
+		// Only computes and writes the shader data of all objects (visible
+		// or not), without culling or building a draw list. Used when culling
+		// is done on the GPU.
+		void write_objects(
+			std::span<SceneObject const> aObjects,
+			FrameView const& aView,
+			ObjectUniforms* aObjectData
+		);
+
+		std::size_t thread_count() const noexcept;
+
+	private:
+		JobSystem& mJobs;
+
+		std::vector<RenderQueue> mChunkQueues;
+		std::vector<FramePipelineStats> mChunkStats;
+};
+
+// Conservative test of a box (in model space) against the view frustum:
+// returns true only if the box is entirely outside.
+bool outside_frustum( Mat44f const& aModel2Clip, MeshBounds const& ) noexcept;
+
+#endif // FRAME_PIPELINE_HPP_525758A5_78A7_46C8_A236_EAF76B7EFA67
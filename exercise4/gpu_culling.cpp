@@ -0,0 +1,269 @@
+#include "gpu_culling.hpp"
+
+#include <new>
+#include <vector>
+#include <algorithm>
+
+#include <cassert>
+#include <cstdint>
+
+#include "../support/error.hpp"
+#include "../support/checkpoint.hpp"
+
+namespace
+{
+	constexpr GLuint kCullLocalSize_ = 64; // see cull.comp
+	constexpr GLuint kHiZLocalSize_ = 8; // see hiz_build.comp
+
+	// hiz_build.comp
+	constexpr UniformName kSourceLevel_{ "uSourceLevel" };
+	constexpr UniformName kSourceWidth_{ "uSourceWidth" };
+	constexpr UniformName kSourceHeight_{ "uSourceHeight" };
+	ShaderDefine const kHiZReduceDefines_[] = { { "HIZ_REDUCE", "1" } };
+
+	// Layouts, see assets/ex4/cull.comp
+	struct CullObject_
+	{
+		float boundsMin[4];
+		float boundsMax[4];
+		std::uint32_t first, count;
+		std::uint32_t pad0, pad1;
+	};
+
+	struct CullData_
+	{
+		Mat44f projCamera;
+		Mat44f prevProjCamera;
+		float viewportSize[2];
+		std::uint32_t objectCount;
+		std::uint32_t hizLevels;
+	};
+
+	struct DrawArraysIndirectCommand_
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint first;
+		GLuint baseInstance;
+	};
+
+	static_assert( sizeof(CullObject_) == 48 );
+	static_assert( sizeof(CullData_) == 144 );
+	static_assert( sizeof(DrawArraysIndirectCommand_) == 16 );
+
+}
+
+GpuCuller::GpuCuller( GpuResources& aResources, std::span<SceneMesh const> aMeshes, std::span<SceneObject const> aObjects, ProgramBinaryCache* aCache )
+	: mResources( aResources )
+	, mCullProgram( { { GL_COMPUTE_SHADER, "assets/ex4/cull.comp" } }, aCache, {}, &aResources )
+	, mHiZPrograms( { { GL_COMPUTE_SHADER, "assets/ex4/hiz_build.comp" } }, aCache, &aResources )
+	, mHiZCopy( &mHiZPrograms.get() )
+	, mHiZReduce( &mHiZPrograms.get( kHiZReduceDefines_ ) )
+	, mObjectCount( aObjects.size() )
+	, mHiZTextureWidth( 0 )
+	, mHiZTextureHeight( 0 )
+	, mHiZTextureLevels( 0 )
+	, mHiZWidth( 0 )
+	, mHiZHeight( 0 )
+	, mHiZLevels( 0 )
+	, mHiZValid( false )
+	, mPrevProjCamera( kIdentity44f )
+	, mCullDataBuffer( 0 )
+	, mCullData{}
+{
+	for( auto const& mesh : aMeshes )
+	{
+		if( mesh.vao != aMeshes.front().vao )
+			throw Error( "GpuCuller: all meshes must share one VAO (found %u and %u)", aMeshes.front().vao, mesh.vao );
+	}
+
+	// Static per-object data
+	std::vector<CullObject_> objects;
+	objects.reserve( aObjects.size() );
+
+	for( auto const& object : aObjects )
+	{
+		auto const& mesh = aMeshes[object.mesh];
+		objects.emplace_back( CullObject_{
+			{ mesh.bounds.min.x, mesh.bounds.min.y, mesh.bounds.min.z, 1.f },
+			{ mesh.bounds.max.x, mesh.bounds.max.y, mesh.bounds.max.z, 1.f },
+			std::uint32_t(mesh.first), std::uint32_t(mesh.count),
+			0, 0
+		} );
+	}
+
+	OGL_CHECKPOINT_ALWAYS();
+
+	auto const objectBytes = GLsizeiptr(std::max<std::size_t>( 1, objects.size() ) * sizeof(CullObject_));
+	mCullObjects = aResources.create_buffer( GpuMemoryCategory::indirect, objectBytes, objects.empty() ? nullptr : objects.data() );
+
+	auto const commandBytes = GLsizeiptr(std::max<std::size_t>( 1, mObjectCount ) * sizeof(DrawArraysIndirectCommand_));
+	mCommands = aResources.create_buffer( GpuMemoryCategory::indirect, commandBytes );
+
+	mDrawCount = aResources.create_buffer( GpuMemoryCategory::indirect, sizeof(GLuint) );
+
+	// The programs were compiling in the background in the meantime.
+	mCullProgram.wait();
+	mHiZPrograms.wait();
+
+	// prepare() allocates sizeof(CullData_) for the block.
+	auto const* cullData = mCullProgram.find_uniform_block( "CullData" );
+	if( !cullData || cullData->dataSize > GLint(sizeof(CullData_)) )
+		throw Error( "GpuCuller: CullData block in cull.comp is missing or larger than CullData_ (%d bytes, expected %zu)", cullData ? cullData->dataSize : -1, sizeof(CullData_) );
+
+	OGL_CHECKPOINT_ALWAYS();
+}
+
+GpuCuller::~GpuCuller() = default;
+
+void GpuCuller::prepare( UniformRing& aRing, Mat44f const& aProjCamera )
+{
+	// The viewport size is that of the pyramid, which may differ from this
+	// frame's (dynamic resolution). The test itself is in NDC.
+	mCullDataBuffer = aRing.bufferId();
+	mCullData = aRing.allocate( sizeof(CullData_) );
+	new (mCullData.data) CullData_{
+		aProjCamera,
+		mPrevProjCamera,
+		{ float(mHiZWidth), float(mHiZHeight) },
+		std::uint32_t(mObjectCount),
+		mHiZValid ? std::uint32_t(mHiZLevels) : 0u
+	};
+}
+
+void GpuCuller::cull( GLStateCache& aState )
+{
+	// Reset the output. Commands past the final draw count keep an instance
+	// count of zero, so they're no-ops when drawing a fixed number of them.
+	aState.bind_buffer( GL_COPY_WRITE_BUFFER, mCommands.id() );
+	glClearBufferData( GL_COPY_WRITE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr );
+	aState.bind_buffer( GL_COPY_WRITE_BUFFER, mDrawCount.id() );
+	glClearBufferData( GL_COPY_WRITE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr );
+	aState.bind_buffer( GL_COPY_WRITE_BUFFER, 0 );
+
+	aState.use_program( mCullProgram.programId() );
+
+	aState.bind_buffer_range( GL_UNIFORM_BUFFER, 2, mCullDataBuffer, mCullData.offset, mCullData.size );
+	aState.bind_buffer_base( GL_SHADER_STORAGE_BUFFER, 2, mCullObjects.id() );
+	aState.bind_buffer_base( GL_SHADER_STORAGE_BUFFER, 3, mCommands.id() );
+	aState.bind_buffer_base( GL_SHADER_STORAGE_BUFFER, 4, mDrawCount.id() );
+
+	glActiveTexture( GL_TEXTURE0 );
+	glBindTexture( GL_TEXTURE_2D, mHiZ.id() );
+
+	auto const groups = GLuint((mObjectCount + kCullLocalSize_-1) / kCullLocalSize_);
+	if( groups )
+		glDispatchCompute( groups, 1, 1 );
+
+	glBindTexture( GL_TEXTURE_2D, 0 );
+}
+
+void GpuCuller::draw( GLStateCache& aState, GLuint aProgram, GLuint aVao )
+{
+	// The commands and the draw count are consumed as indirect parameters;
+	// the object data is still read through the SSBO.
+	glMemoryBarrier( GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT );
+
+	aState.use_program( aProgram );
+	aState.bind_vertex_array( aVao );
+	aState.bind_buffer( GL_DRAW_INDIRECT_BUFFER, mCommands.id() );
+
+	if( GLAD_GL_VERSION_4_6 )
+	{
+		// Only process as many commands as survived culling.
+		aState.bind_buffer( GL_PARAMETER_BUFFER, mDrawCount.id() );
+		glMultiDrawArraysIndirectCount( GL_TRIANGLES, nullptr, 0, GLsizei(mObjectCount), 0 );
+	}
+	else
+	{
+		glMultiDrawArraysIndirect( GL_TRIANGLES, nullptr, GLsizei(mObjectCount), 0 );
+	}
+}
+
+void GpuCuller::update_depth_pyramid( GLStateCache& aState, RenderTarget const& aTarget, int aWidth, int aHeight, Mat44f const& aProjCamera )
+{
+	assert( aWidth <= aTarget.width() && aHeight <= aTarget.height() );
+
+	// Only reallocated when the target is, i.e., not when the resolution
+	// scale changes.
+	if( aTarget.width() != mHiZTextureWidth || aTarget.height() != mHiZTextureHeight )
+		allocate_pyramid_( aTarget.width(), aTarget.height() );
+
+	mHiZWidth = aWidth;
+	mHiZHeight = aHeight;
+	mPrevProjCamera = aProjCamera;
+
+	mHiZLevels = 1;
+	while( std::max( aWidth, aHeight ) >> mHiZLevels )
+		++mHiZLevels;
+
+	assert( mHiZLevels <= mHiZTextureLevels );
+
+	glActiveTexture( GL_TEXTURE0 );
+
+	for( int level = 0; level < mHiZLevels; ++level )
+	{
+		int const width = std::max( 1, mHiZWidth >> level );
+		int const height = std::max( 1, mHiZHeight >> level );
+
+		// Level 0 is a copy of the depth buffer. Other levels reduce the
+		// previous level. Reading one level of mHiZ while writing another
+		// is fine; the barrier makes the previous level's writes visible.
+		ShaderProgram* program = mHiZCopy;
+		GLuint source = aTarget.depthTextureId();
+		int sourceWidth = width, sourceHeight = height;
+
+		if( 0 != level )
+		{
+			glMemoryBarrier( GL_TEXTURE_FETCH_BARRIER_BIT );
+
+			program = mHiZReduce;
+			source = mHiZ.id();
+			sourceWidth = std::max( 1, mHiZWidth >> (level-1) );
+			sourceHeight = std::max( 1, mHiZHeight >> (level-1) );
+		}
+
+		aState.use_program( program->programId() );
+		glBindTexture( GL_TEXTURE_2D, source );
+		program->set_uniform( kSourceLevel_, std::max( 0, level-1 ) );
+		program->set_uniform( kSourceWidth_, sourceWidth );
+		program->set_uniform( kSourceHeight_, sourceHeight );
+
+		glBindImageTexture( 0, mHiZ.id(), level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F );
+		glDispatchCompute( 
+			GLuint(width + kHiZLocalSize_-1) / kHiZLocalSize_, 
+			GLuint(height + kHiZLocalSize_-1) / kHiZLocalSize_, 
+			1 
+		);
+	}
+
+	// Next frame's culling samples the pyramid.
+	glMemoryBarrier( GL_TEXTURE_FETCH_BARRIER_BIT );
+
+	glBindImageTexture( 0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F );
+	glBindTexture( GL_TEXTURE_2D, 0 );
+
+	mHiZValid = true;
+}
+
+void GpuCuller::allocate_pyramid_( int aWidth, int aHeight )
+{
+	mHiZTextureWidth = aWidth;
+	mHiZTextureHeight = aHeight;
+
+	mHiZTextureLevels = 1;
+	while( std::max( aWidth, aHeight ) >> mHiZTextureLevels )
+		++mHiZTextureLevels;
+
+	// The old pyramid (if any) is deleted once the GPU is done with it.
+	mHiZ = mResources.create_texture_2d( GpuMemoryCategory::texture, mHiZTextureLevels, GL_R32F, aWidth, aHeight );
+
+	glBindTexture( GL_TEXTURE_2D, mHiZ.id() );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+	glBindTexture( GL_TEXTURE_2D, 0 );
+
+	mHiZValid = false;
+}
@@ -0,0 +1,108 @@
+#ifndef GPU_CULLING_HPP_4D2BB1B6_D53E_4694_AEA3_201A59F1BC5C
+#define GPU_CULLING_HPP_4D2BB1B6_D53E_4694_AEA3_201A59F1BC5C
+
+#include <glad/glad.h>
+
+#include <span>
+
+#include <cstddef>
+
+#include "scene.hpp"
+#include "render_target.hpp"
+
+#include "../support/program.hpp"
+#include "../support/gl_state.hpp"
+#include "../support/shader_variants.hpp"
+#include "../support/uniform_ring.hpp"
+#include "../support/gpu_resources.hpp"
+
+#include "../vmlib/mat44.hpp"
+
+// GPU-driven culling
+//
+// A compute shader (assets/ex4/cull.comp) tests each object's bounding box
+// against the view frustum and against a hierarchical depth (Hi-Z) pyramid
+// built from the previous frame's depth buffer. Surviving objects are
+// compacted into a GL_DRAW_INDIRECT_BUFFER, which is drawn with a single
+// multi-draw-indirect call. The draw ID reaches the vertex shader through each
+// command's baseInstance (see DrawIdBuffer).
+//
+// The occlusion test uses the previous frame's depth and camera. Objects that
+// become visible this frame may therefore appear one frame late.
+//
+// All meshes must live in a single VAO, since a multi-draw cannot switch
+// VAOs.
+//
+// Per frame:
+//
+//	culler.prepare( ring, projCamera ); // before ring.flush()
+//	culler.cull( state );  // object data must be bound at SSBO binding 1
+//	culler.draw( state, program, vao );
+//	culler.update_depth_pyramid( state, target, width, height, projCamera );
+//
+// Pass the camera that the frame is actually drawn with (e.g., after a late
+// latch) to both prepare() and update_depth_pyramid(). The occlusion test
+// reprojects into the view that the pyramid was built from.
+//
+// The pyramid texture has the size of the render target. With dynamic
+// resolution, only the rendered part of it is built and sampled, so changing
+// the resolution scale doesn't reallocate it. The occlusion test works in
+// normalized coordinates and can use a pyramid built at a different scale.
+class GpuCuller final
+{
+	public:
+		GpuCuller( 
+			GpuResources&,
+			std::span<SceneMesh const> aMeshes,
+			std::span<SceneObject const> aObjects,
+			ProgramBinaryCache* = nullptr
+		);
+		~GpuCuller();
+
+		GpuCuller( GpuCuller const& ) = delete;
+		GpuCuller& operator= (GpuCuller const&) = delete;
+
+	public:
+		void prepare( UniformRing& aRing, Mat44f const& aProjCamera );
+
+		void cull( GLStateCache& );
+		void draw( GLStateCache&, GLuint aProgram, GLuint aVao );
+
+		// Builds the Hi-Z pyramid from the lower left aWidth x aHeight
+		// pixels of aTarget's depth for use in the next frame. aProjCamera
+		// is the matrix that the depth was rendered with.
+		void update_depth_pyramid( GLStateCache&, RenderTarget const& aTarget, int aWidth, int aHeight, Mat44f const& aProjCamera );
+
+	private:
+		void allocate_pyramid_( int aWidth, int aHeight );
+
+	private:
+		GpuResources& mResources;
+
+		ShaderProgram mCullProgram;
+
+		// hiz_build.comp, with and without HIZ_REDUCE
+		ShaderVariants mHiZPrograms;
+		ShaderProgram* mHiZCopy;
+		ShaderProgram* mHiZReduce;
+
+		std::size_t mObjectCount;
+
+		GpuBuffer mCullObjects;
+		GpuBuffer mCommands;
+		GpuBuffer mDrawCount;
+
+		GpuTexture mHiZ;
+		int mHiZTextureWidth, mHiZTextureHeight, mHiZTextureLevels;
+
+		// Part of mHiZ that was built last (see update_depth_pyramid())
+		int mHiZWidth, mHiZHeight, mHiZLevels;
+		bool mHiZValid;
+
+		Mat44f mPrevProjCamera; // of the pyramid
+
+		GLuint mCullDataBuffer;
+		RingAllocation mCullData;
+};
+
+#endif // GPU_CULLING_HPP_4D2BB1B6_D53E_4694_AEA3_201A59F1BC5C
@@ -0,0 +1,171 @@
+#include "latency.hpp"
+
+#include <chrono>
+
+#include "../support/error.hpp"
+
+namespace
+{
+	// The GPU's and the CPU's clocks drift apart slowly.
+	constexpr auto kCalibrationInterval_ = std::chrono::seconds( 1 );
+
+	double ms_( Clock::duration aDuration ) noexcept
+	{
+		return std::chrono::duration<double, std::milli>( aDuration ).count();
+	}
+}
+
+LatencyMonitor::LatencyMonitor( std::filesystem::path const& aLogFile )
+	: mPath( aLogFile )
+	, mLog( nullptr )
+	, mFrame( 0 )
+	, mEvents( 0 )
+	, mGpuOffset( 0 )
+{
+	mLog = std::fopen( mPath.string().c_str(), "w" );
+	if( !mLog )
+		throw Error( "Unable to open '%s' for writing", mPath.string().c_str() );
+
+	std::fprintf( mLog, "frame,events,input_to_latch_ms,input_to_swap_ms,input_to_gpu_ms\n" );
+
+	calibrate_();
+}
+
+LatencyMonitor::~LatencyMonitor()
+{
+	if( mCurrent )
+		mQueries.emplace_back( mCurrent->query );
+	for( auto const& frame : mInFlight )
+		mQueries.emplace_back( frame.query );
+
+	glDeleteQueries( GLsizei(mQueries.size()), mQueries.data() );
+
+	std::fclose( mLog );
+}
+
+void LatencyMonitor::input( std::uint64_t aSequence, Clock::time_point aTime )
+{
+	mInputs.emplace_back( Input_{ aSequence, aTime } );
+}
+
+void LatencyMonitor::latched( std::uint64_t aIncluded, Clock::time_point aTime )
+{
+	if( mInputs.empty() || mInputs.front().sequence >= aIncluded )
+		return;
+
+	Frame_ frame{ mFrame, 0, mInputs.front().time, aTime, {}, 0 };
+	while( !mInputs.empty() && mInputs.front().sequence < aIncluded )
+	{
+		mInputs.pop_front();
+		++frame.events;
+	}
+
+	// Several latches per frame are fine; the frame shows all of them.
+	if( mCurrent )
+	{
+		mCurrent->events += frame.events;
+		mCurrent->latch = aTime;
+	}
+	else
+	{
+		mCurrent = frame;
+	}
+}
+
+void LatencyMonitor::swapped( Clock::time_point aTime )
+{
+	if( mCurrent )
+	{
+		if( mQueries.empty() )
+		{
+			mQueries.emplace_back();
+			glGenQueries( 1, &mQueries.back() );
+		}
+
+		mCurrent->swap = aTime;
+		mCurrent->query = mQueries.back();
+		mQueries.pop_back();
+
+		glQueryCounter( mCurrent->query, GL_TIMESTAMP );
+
+		mInFlight.emplace_back( *mCurrent );
+		mCurrent.reset();
+	}
+
+	++mFrame;
+
+	collect_( false );
+
+	if( aTime - mCalibrated >= kCalibrationInterval_ )
+		calibrate_();
+}
+
+void LatencyMonitor::finish()
+{
+	collect_( true );
+
+	if( 0 != std::fflush( mLog ) || std::ferror( mLog ) )
+		throw Error( "LatencyMonitor: error writing '%s'", mPath.string().c_str() );
+}
+
+LatencyStats LatencyMonitor::stats() const
+{
+	LatencyStats ret{};
+	ret.frames = mToSwapMs.size();
+	ret.events = mEvents;
+	ret.toLatch = compute_frame_stats( mToLatchMs );
+	ret.toSwap = compute_frame_stats( mToSwapMs );
+	ret.toGpu = compute_frame_stats( mToGpuMs );
+	return ret;
+}
+
+void LatencyMonitor::calibrate_()
+{
+	// GL_TIMESTAMP returns the GPU's current time, without waiting for
+	// previous commands to complete. The CPU time is taken on either side,
+	// and the midpoint is used.
+	auto const before = Clock::now();
+	GLint64 gpuNs = 0;
+	glGetInteger64v( GL_TIMESTAMP, &gpuNs );
+	auto const after = Clock::now();
+
+	auto const cpu = before + (after - before) / 2;
+	mGpuOffset = cpu.time_since_epoch() - std::chrono::duration_cast<Clock::duration>( std::chrono::nanoseconds( gpuNs ) );
+	mCalibrated = after;
+}
+
+void LatencyMonitor::collect_( bool aWait )
+{
+	// In order, so that the log is sorted by frame.
+	while( !mInFlight.empty() )
+	{
+		auto const& frame = mInFlight.front();
+
+		if( !aWait )
+		{
+			GLuint available = GL_FALSE;
+			glGetQueryObjectuiv( frame.query, GL_QUERY_RESULT_AVAILABLE, &available );
+			if( GL_TRUE != available )
+				break;
+		}
+
+		GLuint64 gpuNs = 0;
+		glGetQueryObjectui64v( frame.query, GL_QUERY_RESULT, &gpuNs );
+
+		auto const done = Clock::time_point( mGpuOffset + std::chrono::duration_cast<Clock::duration>( std::chrono::nanoseconds( gpuNs ) ) );
+
+		auto const toLatch = ms_( frame.latch - frame.input );
+		auto const toSwap = ms_( frame.swap - frame.input );
+		auto const toGpu = ms_( done - frame.input );
+
+		mToLatchMs.emplace_back( toLatch );
+		mToSwapMs.emplace_back( toSwap );
+		mToGpuMs.emplace_back( toGpu );
+		mEvents += frame.events;
+
+		std::fprintf( mLog, "%zu,%zu,%.3f,%.3f,%.3f\n", frame.index, frame.events, toLatch, toSwap, toGpu );
+
+		mQueries.emplace_back( frame.query );
+		mInFlight.pop_front();
+	}
+}
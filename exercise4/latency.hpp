@@ -0,0 +1,116 @@
+#ifndef LATENCY_HPP_4C8E1F73_A26D_4B95_9E07_5D3B81F2C6A4
+#define LATENCY_HPP_4C8E1F73_A26D_4B95_9E07_5D3B81F2C6A4
+
+#include <glad/glad.h>
+
+#include <deque>
+#include <vector>
+#include <optional>
+#include <filesystem>
+
+#include <cstdio>
+#include <cstddef>
+#include <cstdint>
+
+#include "bench.hpp"
+#include "defaults.hpp"
+
+struct LatencyConfig
+{
+	// Sample the camera again right before the frame's draws are submitted,
+	// see Simulation::sample_latest().
+	bool lateLatch = true;
+
+	std::size_t framesInFlight = 0; // 0 = no limit, see support/frame_pacer.hpp
+
+	std::filesystem::path logFile; // empty = no measurements
+};
+
+struct LatencyStats
+{
+	std::size_t frames; // frames that showed new input
+	std::size_t events;
+
+	// Milliseconds from the oldest input that a frame shows to the camera
+	// being latched, to glfwSwapBuffers() returning, and to the GPU having
+	// finished the frame.
+	FrameStats toLatch, toSwap, toGpu;
+};
+
+// Input-to-display latency measurement
+//
+// input() timestamps each look event as the main thread receives it (in the
+// GLFW callback); latched() then tells which of the events the frame's camera
+// includes (see Simulation::sampled_inputs()). For each frame that shows new
+// input, the latency is measured from the oldest of those events to the
+// latch, to the return from glfwSwapBuffers(), and to the GPU completing the
+// frame. The latter is taken from a GL_TIMESTAMP query issued after the
+// swap, and converted to CPU time with an offset that is calibrated
+// regularly against glGetInteger64v( GL_TIMESTAMP ).
+//
+// The GPU completion time is the closest that we get to the photons; the
+// scan-out and the display itself add their (constant) latency on top. The
+// time that events spend in the window system's queue before GLFW delivers
+// them is not included either.
+//
+// Each measured frame is written as a line of CSV to the log file once its
+// query result is available. Must only be used from the thread of the GL
+// context.
+class LatencyMonitor final
+{
+	public:
+		explicit LatencyMonitor( std::filesystem::path const& aLogFile );
+		~LatencyMonitor();
+
+		LatencyMonitor( LatencyMonitor const& ) = delete;
+		LatencyMonitor& operator= (LatencyMonitor const&) = delete;
+
+	public:
+		void input( std::uint64_t aSequence, Clock::time_point );
+		void latched( std::uint64_t aIncluded, Clock::time_point );
+
+		// Call right after the swap.
+		void swapped( Clock::time_point );
+
+		// Waits for the outstanding queries and writes their frames.
+		void finish();
+
+		LatencyStats stats() const;
+
+	private:
+		struct Input_
+		{
+			std::uint64_t sequence;
+			Clock::time_point time;
+		};
+
+		struct Frame_
+		{
+			std::size_t index;
+			std::size_t events;
+			Clock::time_point input, latch, swap;
+			GLuint query;
+		};
+
+		void calibrate_();
+		void collect_( bool aWait );
+
+	private:
+		std::filesystem::path mPath;
+		std::FILE* mLog;
+
+		std::deque<Input_> mInputs; // not shown yet
+		std::optional<Frame_> mCurrent; // latched, not yet swapped
+		std::deque<Frame_> mInFlight;
+		std::vector<GLuint> mQueries; // unused
+
+		std::size_t mFrame;
+		std::size_t mEvents;
+
+		Clock::duration mGpuOffset; // CPU time = GPU time + offset
+		Clock::time_point mCalibrated;
+
+		std::vector<double> mToLatchMs, mToSwapMs, mToGpuMs;
+};
+
+#endif // LATENCY_HPP_4C8E1F73_A26D_4B95_9E07_5D3B81F2C6A4
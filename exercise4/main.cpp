@@ -1,25 +1,58 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include <new>
+#include <span>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <iterator>
 #include <numbers>
+#include <optional>
 #include <typeinfo>
 #include <stdexcept>
 
+#include <cmath>
 #include <cstdio>
 #include <cstdlib>
 
 #include "../support/error.hpp"
 #include "../support/program.hpp"
+#include "../support/program_cache.hpp"
+#include "../support/gpu_timer.hpp"
+#include "../support/frame_pacer.hpp"
+#include "../support/job_system.hpp"
+#include "../support/task_graph.hpp"
 #include "../support/checkpoint.hpp"
+#include "../support/uniform_ring.hpp"
+#include "../support/gl_state.hpp"
+#include "../support/gl_capture.hpp"
+#include "../support/gpu_resources.hpp"
 #include "../support/debug_output.hpp"
 
 #include "../vmlib/vec4.hpp"
 #include "../vmlib/mat44.hpp"
 
+#include "scene.hpp"
+#include "bench.hpp"
+#include "options.hpp"
 #include "defaults.hpp"
+#include "render_queue.hpp"
+#include "render_target.hpp"
+#include "gpu_culling.hpp"
+#include "frame_capture.hpp"
+#include "soft_raster.hpp"
+#include "dynamic_resolution.hpp"
+#include "simulation.hpp"
+#include "latency.hpp"
+#include "frame_pipeline.hpp"
 #include "cone.hpp"
 #include "cylinder.hpp"
 #include "loadobj.hpp"
+#include "bvh.hpp"
+#include "chunked_mesh.hpp"
+#include "mesh_streamer.hpp"
+#include "texture_loader.hpp"
 
 
 
@@ -27,20 +60,48 @@ namespace
 {
 	constexpr char const* kWindowTitle = "Meshes";
 
-	constexpr float kMovementPerSecond_ = 5.f; // units per second
-	constexpr float kMouseSensitivity_ = 0.01f; // radians per pixel
+	constexpr float kNearPlane_ = 0.1f;
+	constexpr float kFarPlane_ = 100.f;
+	constexpr float kFieldOfView_ = 60.f * std::numbers::pi_v<float> / 180.f; // vertical
 
+	// With late latching, the CPU culls with a field of view that is wider by
+	// this much on each side, since the camera may still turn before the
+	// frame is drawn. 0.1 radians are ten pixels of mouse motion (see
+	// simulation.cpp).
+	constexpr float kLateLatchCullMargin_ = 0.1f;
+
+	constexpr float kBenchTimeStep_ = 1.f / 60.f; // seconds per frame in --bench
+
+	constexpr GLuint kDrawIdAttribLocation_ = 2; // see assets/ex4/default.vert
+
+	constexpr float kInstanceSpacing_ = 12.f; // units between --instances
+
+	constexpr float kInitialRadius_ = 10.f;
+
+	// --on-demand: frames rendered after the last change (the occlusion
+	// culling uses the previous frame's depth), and the longest sleep while
+	// idle.
+	constexpr std::size_t kSettleFrames_ = 2;
+	constexpr double kIdleTimeout_ = 0.5; // seconds
+
+	// While a shader reload is compiling, check for it this often even if
+	// idle (seconds).
+	constexpr double kReloadPollInterval_ = 0.01;
+
+	// The camera itself is updated by the simulation thread (see
+	// simulation.hpp); the callbacks only forward input to it.
 	struct State_
 	{
 		ShaderProgram* prog;
+		Simulation* sim;
+		LatencyMonitor* latency; // optional
+
+		bool dirty; // needs to be redrawn, see --on-demand
+		bool pick; // left click, handled by the main loop
 
 		struct CamCtrl_
 		{
 			bool cameraActive;
-			bool actionZoomIn, actionZoomOut;
-			
-			float phi, theta;
-			float radius;
 
 			float lastX, lastY;
 		} camControl;
@@ -50,6 +111,18 @@ namespace
 
 	void glfw_callback_key_( GLFWwindow*, int, int, int, int );
 	void glfw_callback_motion_( GLFWwindow*, double, double );
+	void glfw_callback_button_( GLFWwindow*, int, int, int );
+	void glfw_callback_framebuffer_size_( GLFWwindow*, int, int );
+	void glfw_callback_refresh_( GLFWwindow* );
+
+	void render_software_( SoftwareConfig const&, std::span<SimpleMeshData const* const>, std::span<SceneObject const>, JobSystem& );
+
+	// Casts a ray from the camera through the cursor, and prints the closest
+	// object that it hits. aBvhs are indexed by SceneObject::mesh.
+	void pick_( GLFWwindow*, State_ const&, CameraState const&, std::span<std::optional<Bvh> const> aBvhs, std::span<SceneObject const>, float aSceneTime );
+
+	// Once all startup tasks have finished.
+	void print_startup_stats_( TaskGraph const& );
 
 	struct GLFWCleanupHelper
 	{
@@ -62,9 +135,164 @@ namespace
 	};
 }
 
-int main() try
+int main( int aArgc, char* aArgv[] ) try
 {
+	auto const startTime = Clock::now();
+
+	Options const options = parse_options( aArgc, aArgv );
+	BenchConfig const& bench = options.bench;
+
+	// All CPU work that runs in parallel goes through this, see job_system.hpp.
+	JobSystem jobs( options.threads );
+
+	// Startup work that doesn't need OpenGL runs as tasks, in parallel with
+	// each other and with the creation of the window and context below. The
+	// OpenGL parts only wait for the tasks whose results they need next. See
+	// task_graph.hpp.
+	SimpleMeshData allArrows, armadillo;
+	MeshBounds arrowBounds{}, armadilloBounds{};
+
+	SimpleMeshData sceneMesh; // all meshes, for the shared VAO
+	std::optional<Bvh> meshBvhs[2]; // for picking, by mesh index
+
+	TaskGraph startup( jobs );
+
+	// Create meshes. These only exist on the CPU so far; the VAO is created
+	// once there is an OpenGL context.
+	auto const arrowsTask = startup.add( "arrows", [&] {
+		auto xcyl = make_cylinder(true, 16, {1.f, 0.f, 0.f}, make_scaling(5.f, 0.1f, 0.1f));
+		auto xcone = make_cone(true, 16, {0.f, 0.f, 0.f}, make_scaling(1.f, 0.3f, 0.3f) * make_translation({5.f, 0.f,  0.f}));
+		auto xarrow = concatenate(std::move(xcyl), xcone);
+
+		// Create Y-axis arrow (green)
+		auto ycyl = make_cylinder(true, 16, {0.f, 1.f, 0.f}, make_rotation_z(std::numbers::pi_v<float> / 2.f) * make_scaling(5.f, 0.1f, 0.1f));
+		auto ycone = make_cone(true, 16, {0.f, 0.f, 0.f}, make_rotation_z(std::numbers::pi_v<float> / 2.f) * make_scaling(1.f, 0.3f, 0.3f) * make_translation({5.f, 0.f, 0.f}));
+		auto yarrow = concatenate(std::move(ycyl), ycone);
+
+		// Create Z-axis arrow (blue)
+		auto zcyl = make_cylinder(true, 16, {0.f, 0.f, 1.f}, make_rotation_y(-std::numbers::pi_v<float> / 2.f) * make_scaling(5.f, 0.1f, 0.1f));
+		auto zcone = make_cone(true, 16, {0.f, 0.f, 0.f}, make_rotation_y(-std::numbers::pi_v<float> / 2.f) * make_scaling(1.f, 0.3f, 0.3f) * make_translation({5.f, 0.f, 0.f}));
+		auto zarrow = concatenate(std::move(zcyl), zcone);
+
+		// Merge all three arrows into a single mesh
+		allArrows = concatenate(std::move(xarrow), concatenate(std::move(yarrow), zarrow));
+		arrowBounds = compute_bounds(allArrows);
+	} );
+
+	// With --stream, the streamed mesh takes the Armadillo's place (see
+	// below). The software renderer doesn't stream, and always draws it.
+	bool const drawsArmadillo = options.software.enabled || !options.stream.enabled;
+
+	std::optional<TaskGraph::Task> armadilloTask;
+	if( drawsArmadillo )
+	{
+		armadilloTask = startup.add( "Armadillo", [&] {
+			armadillo = load_wavefront_obj("assets/ex4/Armadillo.obj");
+			armadilloBounds = compute_bounds(armadillo);
+		} );
+	}
+
+	// Scene: the arrows and the Armadillo at the origin, plus any extra
+	// instances of the arrows requested on the command line. Mesh indices
+	// are 0 = arrows, 1 = Armadillo.
+	std::vector<SceneObject> sceneObjects{
+		{ 0, { 0.f, 0.f, 0.f }, 1.f, 0.f, { 0.2f, 1.f, 1.f, 1.f } },
+		{ 1, { 0.f, 0.f, 0.f }, 1.f, 0.f, { 0.2f, 1.f, 1.f, 1.f } }
+	};
+
+	if( options.instances )
+	{
+		auto const side = std::size_t(std::ceil( std::sqrt( double(options.instances) ) ));
+		for( std::size_t i = 0; i < options.instances; ++i )
+		{
+			float const x = (float(i % side) - 0.5f*float(side-1)) * kInstanceSpacing_;
+			float const z = (float(i / side) - 0.5f*float(side-1)) * kInstanceSpacing_;
+			float const spin = 0.25f + 0.5f * float(i % 7) / 6.f;
+			sceneObjects.push_back( { 0, { x, -6.f, z }, 0.5f, spin, { 1.f, 1.f, 1.f, 1.f } } );
+		}
+	}
+
+	// The software renderer doesn't need OpenGL (or GLFW) at all.
+	if( options.software.enabled )
+	{
+		startup.wait( arrowsTask );
+		startup.wait( *armadilloTask );
+
+		SimpleMeshData const* const meshData[] = { &allArrows, &armadillo };
+		render_software_( options.software, meshData, sceneObjects, jobs );
+		return 0;
+	}
+
+	// The arrows are copied, since the BVH task below reads them at the
+	// same time. Without the Armadillo, the scene mesh is just the arrows
+	// (mesh 1 is then empty and unused).
+	auto const sceneMeshTask = armadilloTask
+		? startup.add( "scene mesh", [&] {
+			sceneMesh = concatenate( allArrows, armadillo );
+		}, { arrowsTask, *armadilloTask } )
+		: startup.add( "scene mesh", [&] {
+			sceneMesh = allArrows;
+		}, { arrowsTask } )
+	;
+
+	// Streamed mesh, see mesh_streamer.hpp. It takes the Armadillo's place;
+	// it is drawn with an identity model-to-world transform. Building the
+	// file (if requested) doesn't need OpenGL.
+	std::optional<TaskGraph::Task> chunkedMeshTask;
+	if( options.stream.enabled )
+	{
+		if( !options.stream.source.empty() )
+		{
+			chunkedMeshTask = startup.add( "chunked mesh", [&options] {
+				auto const source = load_wavefront_obj( options.stream.source.string().c_str() );
+				auto const stats = write_chunked_mesh( options.stream.path, source, ChunkedMeshConfig{ options.stream.chunkTriangles } );
+
+				std::printf( "Wrote '%s': %zu triangles in %zu chunks, %zu nodes, depth %zu, %.1f MiB\n", options.stream.path.string().c_str(), stats.triangles, stats.chunks, stats.nodes, stats.depth, double(stats.bytes) / (1024.*1024.) );
+			} );
+		}
+
+		sceneObjects.erase( sceneObjects.begin() + 1 );
+	}
+
+	// BVHs for picking, in the same order as the meshes. Benchmarks don't
+	// pick, so don't spend the time on them there. Nothing waits for them
+	// before the first frame has been drawn, so they run in the background
+	// and the main thread doesn't pick them up while it waits for the tasks
+	// it does need. Each frame picks up the ones that have finished by then
+	// (see below). Meshes without a BVH (not
+	// drawn, or its build failed) can't be picked.
+	std::vector<std::optional<Bvh>> pickBvhs;
+	std::vector<std::pair<std::size_t, TaskGraph::Task>> bvhTasks; // mesh, task
+	if( !bench.enabled )
+	{
+		bvhTasks.emplace_back( 0, startup.add_background( "arrows BVH", [&] {
+			meshBvhs[0].emplace( allArrows.positions, jobs );
+		}, { arrowsTask } ) );
+
+		if( armadilloTask )
+		{
+			bvhTasks.emplace_back( 1, startup.add_background( "Armadillo BVH", [&] {
+				meshBvhs[1].emplace( armadillo.positions, jobs );
+			}, { *armadilloTask } ) );
+		}
+	}
+
+	// Textures are decoded in the background from here on, and uploaded a
+	// bit per frame once there is a context.
+	std::optional<TextureDecoder> textureDecoder;
+	if( !options.textures.files.empty() )
+		textureDecoder.emplace( jobs, options.textures );
+
 	// Initialize GLFW
+	if( bench.headless )
+	{
+		// No window system available. GLFW's null platform creates the
+		// context through EGL instead; with Mesa, this yields a surfaceless
+		// context (llvmpipe if there is no GPU). There is no default
+		// framebuffer in this case, so all rendering goes to an FBO.
+		glfwInitHint( GLFW_PLATFORM, GLFW_PLATFORM_NULL );
+	}
+
 	if( GLFW_TRUE != glfwInit() )
 	{
 		char const* msg = nullptr;
@@ -102,8 +330,29 @@ int main() try
 	// enables additional debugging features. However, this can carry extra
 	// overheads. We therefore do not do this for release builds.
 	glfwWindowHint( GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE );
+#	elif !defined(OGL_NO_ERROR)
+	// Deferred error reporting relies on debug output, which drivers are
+	// only required to produce in a debug context. Ask for one when it was
+	// selected explicitly.
+	if( GLDebugMode::deferred == options.glErrors )
+		glfwWindowHint( GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE );
 #	endif // ~ !NDEBUG
 
+#	if defined(OGL_NO_ERROR)
+	// Errors result in undefined behaviour instead of being reported. The
+	// driver can skip its validation. See checkpoint.hpp.
+	glfwWindowHint( GLFW_CONTEXT_NO_ERROR, GLFW_TRUE );
+#	endif // ~ OGL_NO_ERROR
+
+	if( bench.enabled )
+	{
+		// The benchmark renders offscreen. The window only exists to provide
+		// an OpenGL context, so don't show it.
+		glfwWindowHint( GLFW_VISIBLE, GLFW_FALSE );
+	}
+	if( bench.headless )
+		glfwWindowHint( GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API );
+
 	glfwWindowHint(GLFW_DEPTH_BITS, 24);
 	GLFWwindow* window = glfwCreateWindow(
 		1280,
@@ -128,14 +377,21 @@ int main() try
 
 	glfwSetKeyCallback( window, &glfw_callback_key_ );
 	glfwSetCursorPosCallback( window, &glfw_callback_motion_ );
+	glfwSetMouseButtonCallback( window, &glfw_callback_button_ );
+	glfwSetFramebufferSizeCallback( window, &glfw_callback_framebuffer_size_ );
+	glfwSetWindowRefreshCallback( window, &glfw_callback_refresh_ );
 
 	// Set up drawing stuff
 	glfwMakeContextCurrent( window );
-	glfwSwapInterval( 1 ); // V-Sync is on.
+	// V-Sync is on, except when benchmarking. There, frame times must not be
+	// capped by the display's refresh rate.
+	glfwSwapInterval( bench.enabled ? 0 : 1 );
 
 	// Initialize GLAD
 	// This will load the OpenGL API. We mustn't make any OpenGL calls before this!
-	if( !gladLoadGLLoader( (GLADloadproc)&glfwGetProcAddress ) )
+	// When capturing, glad gets recording wrappers, see gl_capture.hpp.
+	auto const loader = (GLADloadproc)&glfwGetProcAddress;
+	if( !gladLoadGLLoader( options.glCapture.enabled ? gl_capture_begin( options.glCapture, loader ) : loader ) )
 		throw Error( "gladLoaDGLLoader() failed - cannot load GL API!" );
 
 	std::printf( "RENDERER %s\n", glGetString( GL_RENDERER ) );
@@ -144,18 +400,21 @@ int main() try
 	std::printf( "SHADING_LANGUAGE_VERSION %s\n", glGetString( GL_SHADING_LANGUAGE_VERSION ) );
 
 	// Ddebug output
-#	if !defined(NDEBUG)
-	setup_gl_debug_output();
-#	endif // ~ !NDEBUG
+	setup_gl_debug_output( options.glErrors );
 
 	// Global GL state
 	OGL_CHECKPOINT_ALWAYS();
 
+	// Per-frame state changes go through glState, which skips the ones
+	// that wouldn't change anything.
+	GLStateCache glState;
+
 	// TODO: global GL setup goes here
-	glEnable( GL_FRAMEBUFFER_SRGB);
-	//glEnable( GL_CULL_FACE);
-	glEnable( GL_DEPTH_TEST);
-	glClearColor( 0.2f, 0.2f, 0.2f, 0.0f );
+	glState.enable( GL_FRAMEBUFFER_SRGB );
+	//glState.enable( GL_CULL_FACE );
+	glState.enable( GL_DEPTH_TEST );
+	glState.clear_color( 0.2f, 0.2f, 0.2f, 0.0f );
+	glState.polygon_mode( GL_FILL );
 
 	OGL_CHECKPOINT_ALWAYS();
 
@@ -166,62 +425,245 @@ int main() try
 	int iwidth, iheight;
 	glfwGetFramebufferSize( window, &iwidth, &iheight );
 
-	glViewport( 0, 0, iwidth, iheight );
+	glState.viewport( 0, 0, iwidth, iheight );
+
+	// Linked programs are cached on disk, so that later runs don't need to
+	// compile them again.
+	std::optional<ProgramBinaryCache> programCache;
+	if( !options.shaderCache.empty() )
+		programCache.emplace( options.shaderCache );
+
+	ProgramBinaryCache* const programCachePtr = programCache ? &*programCache : nullptr;
+
+	// Buffers, VAOs and programs released while frames may still be in
+	// flight are deleted once the GPU is done with them. Must outlive all
+	// of them.
+	GpuResources gpuResources( options.gpuMemory );
+
+	std::optional<TextureLoader> textureLoader;
+	if( textureDecoder )
+		textureLoader.emplace( gpuResources, *textureDecoder );
+
+	// Programs are built in the background where possible. All programs are
+	// started before waiting for any, so that their compilation overlaps.
+	if( enable_parallel_shader_compile() )
+		std::printf( "Parallel shader compilation enabled\n" );
 
 	// Load shader program
 	ShaderProgram prog( {
 		{ GL_VERTEX_SHADER, "assets/ex4/default.vert" },
 		{ GL_FRAGMENT_SHADER, "assets/ex4/default.frag" }
-	} );
+	}, programCachePtr, {}, &gpuResources );
 
 	state.prog = &prog;
-	state.camControl.radius = 10.f;
-
-	// Animation state
-	auto last = Clock::now();
-
-	float angle = 0.f;
-
-	// Create vertex buffers and VAO
-	//TODO: create VBOs and VAO
-	auto xcyl = make_cylinder(true, 16, {1.f, 0.f, 0.f}, make_scaling(5.f, 0.1f, 0.1f));
-	auto xcone = make_cone(true, 16, {0.f, 0.f, 0.f}, make_scaling(1.f, 0.3f, 0.3f) * make_translation({5.f, 0.f,  0.f}));
-	auto xarrow = concatenate(std::move(xcyl), xcone);
-
-	// Create Y-axis arrow (green)
-	auto ycyl = make_cylinder(true, 16, {0.f, 1.f, 0.f}, make_rotation_z(std::numbers::pi_v<float> / 2.f) * make_scaling(5.f, 0.1f, 0.1f));
-	auto ycone = make_cone(true, 16, {0.f, 0.f, 0.f}, make_rotation_z(std::numbers::pi_v<float> / 2.f) * make_scaling(1.f, 0.3f, 0.3f) * make_translation({5.f, 0.f, 0.f}));
-	auto yarrow = concatenate(std::move(ycyl), ycone);
-
-	// Create Z-axis arrow (blue)
-	auto zcyl = make_cylinder(true, 16, {0.f, 0.f, 1.f}, make_rotation_y(-std::numbers::pi_v<float> / 2.f) * make_scaling(5.f, 0.1f, 0.1f));
-	auto zcone = make_cone(true, 16, {0.f, 0.f, 0.f}, make_rotation_y(-std::numbers::pi_v<float> / 2.f) * make_scaling(1.f, 0.3f, 0.3f) * make_translation({5.f, 0.f, 0.f}));
-	auto zarrow = concatenate(std::move(zcyl), zcone);
-
-	// Merge all three arrows into a single mesh
-	auto allArrows = concatenate(std::move(xarrow), concatenate(std::move(yarrow), zarrow));
-	GLuint vao = create_vao(allArrows);
-	std::size_t vertexCount = allArrows.positions.size();
-
-	auto armadillo = load_wavefront_obj("assets/ex4/Armadillo.obj");
-	auto armadilloarrow = concatenate(std::move(allArrows), armadillo);
-	GLuint armadillovao = create_vao(armadilloarrow);
-	std::size_t drawArmadillo = armadilloarrow.positions.size();
+
+	// All meshes share one VAO; each mesh is a range of vertices in it. This
+	// avoids VAO switches and is required for multi-draw indirect.
+	startup.wait( sceneMeshTask );
+
+	std::size_t const vertexCount = allArrows.positions.size();
+	std::size_t const drawArmadillo = armadillo.positions.size();
+
+	SimpleMeshBuffers const sceneBuffers = create_vao( gpuResources, std::move(sceneMesh) );
+	GLuint const vao = sceneBuffers.vao.id();
+
+	std::vector<SceneMesh> const sceneMeshes{
+		{ vao, 0, GLsizei(vertexCount), arrowBounds },
+		{ vao, GLint(vertexCount), GLsizei(drawArmadillo), armadilloBounds }
+	};
+
+	std::optional<MeshStreamer> streamer;
+	if( options.stream.enabled )
+	{
+		if( chunkedMeshTask )
+			startup.wait( *chunkedMeshTask );
+
+		streamer.emplace( gpuResources, options.stream.path, options.stream.poolBytes );
+
+		auto const& stats = streamer->stats();
+		std::printf( "Streaming '%s': %zu chunks, GPU pool of %zu chunks (%.1f MiB)\n", options.stream.path.string().c_str(), stats.chunks, stats.slots, double(stats.poolBytes) / (1024.*1024.) );
+	}
+
+	// Per-frame shader data is written to a persistently mapped ring buffer.
+	// Each object's draw ID (= its index in sceneObjects) indexes its entry in
+	// the object array. The streamed mesh comes last.
+	std::size_t const objectCount = sceneObjects.size() + (streamer ? 1 : 0);
+
+	UniformRing uniformRing( sizeof(FrameUniforms) + objectCount*sizeof(ObjectUniforms) + 1024 );
+	DrawIdBuffer drawIds( objectCount );
+	drawIds.attach( vao, kDrawIdAttribLocation_ );
+
+	if( streamer )
+		drawIds.attach( streamer->vao(), kDrawIdAttribLocation_ );
+
+	FramePipeline framePipeline( jobs );
+	RenderQueue renderQueue;
+
+	// GPU culling reads the depth buffer, and dynamic resolution renders at
+	// a different size than the output. Both render the scene to an
+	// offscreen target first, which is then blitted to the output (the window
+	// or, in the benchmark, the benchmark's target).
+	std::optional<GpuCuller> gpuCuller;
+	if( options.gpuCulling )
+		gpuCuller.emplace( gpuResources, sceneMeshes, sceneObjects, programCachePtr );
+
+	prog.wait();
+
+	if( programCache && programCache->enabled() )
+	{
+		auto const stats = programCache->stats();
+		std::printf( "Shader cache: %zu programs loaded from cache, %zu compiled (%zu binaries rejected)\n", stats.hits, stats.misses, stats.rejected );
+	}
+
+	std::optional<ResolutionController> resolution;
+	if( options.dynamicResolution.enabled )
+		resolution.emplace( options.dynamicResolution );
+
+	std::optional<RenderTarget> sceneTarget;
+	if( resolution || (gpuCuller && !bench.enabled) )
+	{
+		if( bench.enabled )
+			sceneTarget.emplace( bench.width, bench.height );
+		else
+			sceneTarget.emplace( iwidth, iheight );
+	}
+
+	// Camera and animation. Interactively, these are advanced at a fixed
+	// rate by the simulation thread. The benchmark instead follows a fixed
+	// path with a fixed step per frame, so that each run renders the same
+	// frames regardless of how fast it is.
+	std::optional<Simulation> simulation;
+	if( !bench.enabled )
+	{
+		simulation.emplace( SimState{ CameraState{ 0.f, 0.f, kInitialRadius_ }, 0.0 }, options.tickRate );
+		state.sim = &*simulation;
+	}
+
+	// Render on demand: only draw when something changed. This requires a
+	// static scene; animated objects need every frame.
+	bool const sceneAnimated = std::any_of( sceneObjects.begin(), sceneObjects.end(), [] (SceneObject const& aObject) {
+		return 0.f != aObject.spin;
+	} );
+
+	bool const onDemand = options.onDemand && !bench.enabled;
+	std::size_t redrawFrames = kSettleFrames_;
+
+	if( onDemand && !sceneAnimated )
+		simulation->set_parking_allowed( true );
+
+	// Input latency: see latency.hpp. With late latching, the camera is
+	// sampled once more right before the draws are submitted, and written to
+	// the frame's (persistently mapped) uniforms only then. Limiting the
+	// frames in flight keeps the driver from queueing up frames, each of
+	// which would add a frame of latency.
+	bool const lateLatch = simulation && options.latency.lateLatch;
+
+	std::optional<LatencyMonitor> latency;
+	if( !options.latency.logFile.empty() )
+	{
+		latency.emplace( options.latency.logFile );
+		state.latency = &*latency;
+	}
+
+	std::optional<FramePacer> framePacer;
+	if( options.latency.framesInFlight )
+		framePacer.emplace( options.latency.framesInFlight );
+
+	double sceneTime = 0.0;
+
+	// Benchmark: offscreen target and frame timing. GPU times are also needed
+	// by the dynamic resolution controller.
+	std::optional<RenderTarget> benchTarget;
+	std::optional<GpuFrameTimer> gpuTimer;
+	std::vector<double> benchCpuMs;
+
+	std::size_t const benchFrameCount = bench.warmupFrames + bench.frames;
+	std::size_t frameIndex = 0;
+
+	if( bench.enabled )
+	{
+		benchTarget.emplace( bench.width, bench.height );
+		benchCpuMs.reserve( benchFrameCount );
+	}
+
+	// Only the benchmark report needs all frame times.
+	if( bench.enabled || resolution )
+		gpuTimer.emplace( 4, bench.enabled );
+
+	std::vector<double> newGpuMs;
+
+	// The scene is drawn to target (null = the default framebuffer). The
+	// final image ends up in outputFramebuffer.
+	RenderTarget* const target = sceneTarget ? &*sceneTarget : (bench.enabled ? &*benchTarget : nullptr);
+	GLuint const outputFramebuffer = bench.enabled ? benchTarget->framebufferId() : 0;
+
+	std::optional<FrameCapture> frameCapture;
+	if( options.capture.enabled )
+		frameCapture.emplace( gpuResources, options.capture );
+
+	OGL_CHECKPOINT_ALWAYS();
+
+	// Ends the captured setup, if capturing.
+	gl_capture_frame();
+
 	// Main loop
-	while( !glfwWindowShouldClose( window ) )
+	while( bench.enabled ? frameIndex < benchFrameCount : !glfwWindowShouldClose( window ) )
 	{
-		// Let GLFW process events
-		glfwPollEvents();
+		// Wait for the GPU first, so that the input sampled below is fresh.
+		if( framePacer )
+			framePacer->wait();
+
+		// Let GLFW process events. When rendering on demand and nothing has
+		// changed, sleep until something happens instead.
+		bool const streaming = (streamer && streamer->busy()) || (textureLoader && 0 != textureLoader->pending());
+		if( onDemand && 0 == redrawFrames )
+			glfwWaitEventsTimeout( prog.pending() || streaming ? kReloadPollInterval_ : kIdleTimeout_ );
+		else
+			glfwPollEvents();
+
+		// Swap in reloaded shaders once the driver has finished building
+		// them. Until then, the old ones stay in use.
+		try
+		{
+			if( prog.poll() )
+			{
+				std::fprintf( stderr, "Shaders reloaded and recompiled.\n" );
+				state.dirty = true;
+			}
+		}
+		catch( std::exception const& eErr )
+		{
+			std::fprintf( stderr, "Error when reloading shader:\n" );
+			std::fprintf( stderr, "%s\n", eErr.what() );
+			std::fprintf( stderr, "Keeping old shader.\n" );
+		}
+
+		if( onDemand )
+		{
+			bool const dirty = std::exchange( state.dirty, false );
+			// Streamed chunks and textures show up over several frames.
+			if( dirty || sceneAnimated || !simulation->settled() || streaming )
+				redrawFrames = kSettleFrames_;
+
+			if( 0 == redrawFrames )
+				continue;
+
+			--redrawFrames;
+		}
+
+		auto const frameStart = Clock::now();
 		
 		// Check if window was resized.
-		float fbwidth, fbheight;
+		int nwidth, nheight;
+		if( bench.enabled )
+		{
+			nwidth = benchTarget->width();
+			nheight = benchTarget->height();
+		}
+		else
 		{
-			int nwidth, nheight;
 			glfwGetFramebufferSize( window, &nwidth, &nheight );
 
-			fbwidth = float(nwidth);
-			fbheight = float(nheight);
-
 			if( 0 == nwidth || 0 == nheight )
 			{
 				// Window minimized? Pause until it is unminimized.
@@ -232,65 +674,359 @@ int main() try
 					glfwGetFramebufferSize( window, &nwidth, &nheight );
 				} while( 0 == nwidth || 0 == nheight );
 			}
-
-			glViewport( 0, 0, nwidth, nheight );
 		}
 
-		// Update state
-		auto const now = Clock::now();
-		float dt = std::chrono::duration_cast<Secondsf>(now-last).count();
-		last = now;
+		// The scene target has the size of the output. With dynamic
+		// resolution, only a part of it is rendered to.
+		if( sceneTarget )
+			sceneTarget->resize( nwidth, nheight );
 
+		int const rwidth = resolution ? resolution->scaled( nwidth ) : nwidth;
+		int const rheight = resolution ? resolution->scaled( nheight ) : nheight;
 
-		angle += dt * std::numbers::pi_v<float> * 0.3f;
-		if( angle >= 2.f*std::numbers::pi_v<float> )
-			angle -= 2.f*std::numbers::pi_v<float>;
+		float const fbwidth = float(nwidth);
+		float const fbheight = float(nheight);
 
-		// Update camera state
-		if( state.camControl.actionZoomIn )
-			state.camControl.radius -= kMovementPerSecond_ * dt;
-		else if( state.camControl.actionZoomOut )
-			state.camControl.radius += kMovementPerSecond_ * dt;
+		glBindFramebuffer( GL_FRAMEBUFFER, target ? target->framebufferId() : 0 );
+		glState.viewport( 0, 0, rwidth, rheight );
+
+		// Update state
+		CameraState camera;
+		Clock::time_point latchTime;
+		if( simulation )
+		{
+			latchTime = Clock::now();
 
-		if( state.camControl.radius <= 0.1f )
-			state.camControl.radius = 0.1f;
+			auto const sim = simulation->sample( latchTime );
+			camera = sim.camera;
+			sceneTime = sim.sceneTime;
+		}
+		else
+		{
+			auto const cam = bench_camera_at( frameIndex, benchFrameCount );
+			camera = CameraState{ cam.phi, cam.theta, cam.radius };
+			sceneTime += kBenchTimeStep_;
+		}
 
 		// Update: compute matrices
-		//TODO: define and compute projCameraWorld matrix
-		Mat44f model2world = make_rotation_y(0);
-		Mat44f world2camera = make_rotation_x(state.camControl.theta) * make_rotation_y(state.camControl.phi) * make_translation({0.f, 0.f, -state.camControl.radius});
-		Mat44f projection = make_perspective_projection(
-			60.f * std::numbers::pi_v<float> / 180.f,
+		Mat44fAffine world2camera = make_rotation_x(camera.theta) * make_rotation_y(camera.phi) * make_translation({0.f, 0.f, -camera.radius});
+		Mat44fPerspective projection = make_perspective_projection(
+			kFieldOfView_,
 			fbwidth/float(fbheight),
-			0.1f, 100.0f
+			kNearPlane_, kFarPlane_
 		);
-		Mat44f projCameraWorld = projection * world2camera * model2world;
+		Mat44f projCamera = projection * world2camera;
+
+		// Culling on the CPU happens before the late latch; see below.
+		Mat44f const cullProjCamera = !lateLatch ? projCamera : make_perspective_projection(
+			kFieldOfView_ + 2.f*kLateLatchCullMargin_,
+			fbwidth/float(fbheight),
+			kNearPlane_, kFarPlane_
+		) * world2camera;
+
+		// Pick up the BVHs that have finished building, without waiting for
+		// the others. Picking is optional: until its BVH is there, or if
+		// building it failed, a mesh just can't be picked.
+		if( !bvhTasks.empty() )
+		{
+			pickBvhs.resize( std::size(meshBvhs) );
+
+			std::erase_if( bvhTasks, [&] (std::pair<std::size_t, TaskGraph::Task> const& aEntry) {
+				auto const [mesh, task] = aEntry;
+				if( !startup.done( task ) )
+					return false;
+
+				try
+				{
+					startup.wait( task );
+					pickBvhs[mesh] = std::move(meshBvhs[mesh]);
+
+					auto const& stats = pickBvhs[mesh]->stats();
+					std::printf( "BVH: %zu triangles, %zu nodes, %zu leaves, depth %zu; built in %.1f ms on %zu threads\n", stats.triangles, stats.nodes, stats.leaves, stats.depth, stats.buildMs, stats.threads );
+				}
+				catch( std::exception const& eErr )
+				{
+					std::fprintf( stderr, "Warning: no picking for mesh %zu; building its BVH failed:\n", mesh );
+					std::fprintf( stderr, "%s\n", eErr.what() );
+				}
+
+				return true;
+			} );
+
+			// All startup tasks are done now.
+			if( bvhTasks.empty() )
+				print_startup_stats_( startup );
+		}
+
+		if( std::exchange( state.pick, false ) && !pickBvhs.empty() )
+			pick_( window, state, camera, pickBvhs, sceneObjects, float(sceneTime) );
+
 		// Draw scene
 		OGL_CHECKPOINT_DEBUG();
 
 		//TODO: draw frame
+		if( gpuTimer )
+			gpuTimer->begin_frame();
+
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		glUseProgram(prog.programId());
 
-		static float const baseColor[] = {0.2f, 1.f, 1.f};
-		glUniform3fv(3, 1, baseColor);
-		glBindVertexArray( vao );
-		glBindVertexArray( armadillovao );
+		if( textureLoader && textureLoader->pending() )
+		{
+			textureLoader->update();
 
-		glUniformMatrix4fv(0, 1, GL_TRUE, projCameraWorld.v);
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-		
+			if( 0 == textureLoader->pending() )
+				std::printf( "Textures: all loaded by frame %zu\n", frameIndex );
+		}
+
+		// Write all shader data for this frame at once. Per-object data and
+		// the sorted draw list are produced by the frame pipeline's workers.
+		uniformRing.begin_frame();
+
+		auto const frameData = uniformRing.allocate( sizeof(FrameUniforms) );
+		auto const objectData = uniformRing.allocate( objectCount * sizeof(ObjectUniforms) );
+
+		FrameView const view{ cullProjCamera, kFarPlane_, float(sceneTime), prog.programId() };
+		auto* objects = static_cast<ObjectUniforms*>(objectData.data);
+
+		if( gpuCuller )
+		{
+			framePipeline.write_objects( sceneObjects, view, objects );
+		}
+		else
+		{
+			framePipeline.build( sceneMeshes, sceneObjects, view, objects, renderQueue );
+		}
+
+		if( streamer )
+		{
+			// Tinted like the Armadillo. The camera sits at (0, 0, radius) and
+			// turns in place, see world2camera.
+			new (objects + sceneObjects.size()) ObjectUniforms{ kIdentity44f, { 0.2f, 1.f, 1.f, 1.f } };
+			streamer->update( cullProjCamera, Vec3f{ 0.f, 0.f, camera.radius } );
+		}
 
-		glDrawArrays(GL_TRIANGLES, 0, vertexCount);
-		glDrawArrays(GL_TRIANGLES, 0, drawArmadillo);
+		// Late latch: pick up the newest cursor motion and write the camera
+		// just before submitting. The draw list and the streamed chunks above
+		// were culled with the camera from the start of the frame, but with a
+		// wider frustum (kLateLatchCullMargin_). Turns faster than that margin
+		// may still make objects at the edge of the screen pop in a frame
+		// late. The GPU culler runs after the latch and uses the latched
+		// camera.
+		if( lateLatch )
+		{
+			glfwPollEvents();
+
+			latchTime = Clock::now();
+
+			auto const latest = simulation->sample_latest( latchTime ).camera;
+			world2camera = make_rotation_x(latest.theta) * make_rotation_y(latest.phi) * make_translation({0.f, 0.f, -latest.radius});
+			projCamera = projection * world2camera;
+		}
+
+		new (frameData.data) FrameUniforms{ projCamera };
+
+		if( gpuCuller )
+			gpuCuller->prepare( uniformRing, projCamera );
+
+		if( latency )
+			latency->latched( simulation->sampled_inputs(), latchTime );
+
+		uniformRing.flush();
+
+		glState.bind_buffer_range( GL_UNIFORM_BUFFER, 0, uniformRing.bufferId(), frameData.offset, frameData.size );
+		glState.bind_buffer_range( GL_SHADER_STORAGE_BUFFER, 1, uniformRing.bufferId(), objectData.offset, objectData.size );
+
+		if( gpuCuller )
+		{
+			gpuCuller->cull( glState );
+			gpuCuller->draw( glState, prog.programId(), vao );
+		}
+		else
+		{
+			renderQueue.submit( glState );
+		}
+
+		if( streamer )
+			streamer->draw( glState, prog.programId(), GLuint(sceneObjects.size()) );
+
+		// The next frame's occlusion culling includes the streamed mesh.
+		if( gpuCuller )
+			gpuCuller->update_depth_pyramid( glState, *target, rwidth, rheight, projCamera );
+
+		uniformRing.end_frame();
 		OGL_CHECKPOINT_DEBUG();
 
+		// Upscale (or copy) the scene to the output. Bilinear filtering is
+		// cheap and good enough for moderate scales.
+		if( sceneTarget )
+		{
+			bool const scaled = rwidth != nwidth || rheight != nheight;
+
+			glBindFramebuffer( GL_READ_FRAMEBUFFER, sceneTarget->framebufferId() );
+			glBindFramebuffer( GL_DRAW_FRAMEBUFFER, outputFramebuffer );
+			glBlitFramebuffer( 0, 0, rwidth, rheight, 0, 0, nwidth, nheight, GL_COLOR_BUFFER_BIT, scaled ? GL_LINEAR : GL_NEAREST );
+		}
+
+		// Capture before the frame is presented, while it is still in the
+		// back buffer/output target.
+		if( frameCapture )
+		{
+			frameCapture->poll();
+			frameCapture->capture( outputFramebuffer, nwidth, nheight, frameIndex );
+		}
+
+		drain_gl_debug_output();
+		glState.end_frame();
+
+		// Deleted names may be reused; see GpuResources.
+		if( gpuResources.end_frame() )
+			glState.invalidate();
+		gl_capture_frame();
+
+		if( gpuTimer )
+		{
+			gpuTimer->end_frame();
+
+			// Timings arrive a few frames late. Only new ones are passed to
+			// the controller.
+			gpuTimer->take_new_samples_ms( newGpuMs );
+			for( auto const ms : newGpuMs )
+			{
+				if( resolution )
+					resolution->update( ms );
+			}
+		}
+
 		// Display results
-		glfwSwapBuffers( window );
+		if( bench.enabled )
+		{
+			// Nothing to present. Flush, so that the GPU starts working on
+			// the frame right away.
+			glFlush();
+
+			if( frameIndex >= bench.warmupFrames )
+			{
+				auto const frameEnd = Clock::now();
+				benchCpuMs.emplace_back( std::chrono::duration<double, std::milli>(frameEnd-frameStart).count() );
+			}
+		}
+		else
+		{
+			glfwSwapBuffers( window );
+
+			if( latency )
+				latency->swapped( Clock::now() );
+		}
+
+		if( framePacer )
+			framePacer->end_frame();
+
+		// The first frame only waited for the startup tasks that it needed.
+		// Without BVHs, there are no others.
+		if( 0 == frameIndex )
+		{
+			std::printf( "Startup: first frame after %.1f ms\n", std::chrono::duration<double, std::milli>( Clock::now() - startTime ).count() );
+
+			if( pickBvhs.empty() && bvhTasks.empty() )
+				print_startup_stats_( startup );
+		}
+
+		++frameIndex;
+	}
+
+	if( bench.enabled )
+	{
+		gpuTimer->finish();
+
+		// Drop the warm-up frames from the GPU timings as well.
+		auto const& gpuSamples = gpuTimer->samples_ms();
+		std::vector<double> benchGpuMs( gpuSamples.begin() + std::ptrdiff_t(bench.warmupFrames), gpuSamples.end() );
+
+		print_bench_report( bench, benchCpuMs, benchGpuMs );
+
+		if( resolution )
+			std::printf( "BENCH final resolution scale %.3f (%dx%d)\n", double(resolution->scale()), resolution->scaled( bench.width ), resolution->scaled( bench.height ) );
+	}
+
+	if( frameCapture )
+	{
+		frameCapture->finish();
+
+		auto const stats = frameCapture->stats();
+		std::printf( "Captured %zu frames to '%s' (%zu readback stalls, %zu encoder stalls, %zu failed)\n", stats.captured, options.capture.directory.string().c_str(), stats.readbackStalls, stats.encoderStalls, stats.failed );
+	}
+
+	if( latency )
+	{
+		latency->finish();
+
+		auto const stats = latency->stats();
+		std::printf( "Latency: %zu frames showed %zu input events (%s); from input to latch median %.2f ms, to swap median %.2f ms (p95 %.2f ms), to GPU done median %.2f ms (p95 %.2f ms). Written to '%s'\n", stats.frames, stats.events, lateLatch ? "late latched" : "sampled at frame start", stats.toLatch.median, stats.toSwap.median, stats.toSwap.p95, stats.toGpu.median, stats.toGpu.p95, options.latency.logFile.string().c_str() );
+	}
+
+	if( framePacer )
+		std::printf( "Frame pacing (%zu in flight): waited for the GPU in %zu frames, %.1f ms in total\n", options.latency.framesInFlight, framePacer->stalls(), framePacer->waited_ms() );
+
+	drain_gl_debug_output();
+
+	if( options.glCapture.enabled )
+	{
+		gl_capture_end();
+
+		auto const stats = gl_capture_stats();
+		std::printf( "GL capture: %zu frames, %zu calls, %.1f MiB (%.1f KiB from mapped memory) written to '%s'\n", stats.frames, stats.calls, double(stats.bytes) / (1024.*1024.), double(stats.mappedBytes) / 1024., options.glCapture.path.string().c_str() );
+	}
+
+	if( textureLoader )
+	{
+		auto const stats = textureLoader->stats();
+		std::printf( "Textures: %zu of %zu loaded (%zu from cache, %zu cooked, %zu failed), %.1f MiB uploaded in %zu frames (%zu skipped, staging busy); decode job time: decode %.1f ms, mips %.1f ms\n", stats.completed, stats.requested, stats.cacheHits, stats.cooked, stats.failed, double(stats.uploadedBytes) / (1024.*1024.), stats.uploadFrames, stats.busyFrames, stats.decodeMs, stats.mipMs );
+	}
+
+	{
+		auto const stats = jobs.stats();
+		std::printf( "Jobs: %zu run (%zu stolen), %zu in the background, on %zu threads\n", stats.jobs, stats.stolen, stats.background, jobs.thread_count() );
+	}
+
+	if( streamer )
+	{
+		auto const& stats = streamer->stats();
+		std::printf( "Streaming: %zu chunks loaded (%.1f MiB), %zu evicted, %zu frames short of slots; last frame: %zu of %zu visible chunks drawn, %zu resident\n", stats.loads, double(stats.bytesLoaded) / (1024.*1024.), stats.evictions, stats.starved, stats.drawn, stats.visible, stats.resident );
+	}
+
+	{
+		auto const& stats = gpuResources.stats();
+		auto const budget = gpuResources.config().budget;
+
+		std::printf( "GPU memory: %.2f MiB in use, peak %.2f MiB", double(stats.total_bytes()) / (1024.*1024.), double(stats.peakBytes) / (1024.*1024.) );
+		if( budget )
+			std::printf( ", budget %.2f MiB (exceeded by %zu allocations)", double(budget) / (1024.*1024.), stats.overBudget );
+		std::printf( "\n" );
+
+		for( std::size_t i = 0; i < std::size_t(GpuMemoryCategory::count); ++i )
+		{
+			if( stats.bytes[i] )
+				std::printf( "  %-16s %10.2f MiB\n", gpu_memory_category_name( GpuMemoryCategory(i) ), double(stats.bytes[i]) / (1024.*1024.) );
+		}
+
+		std::printf( "  %zu buffers, %zu VAOs, %zu programs, %zu textures live; %zu objects deleted, %zu pending\n", stats.objects[std::size_t(GpuResourceType::buffer)], stats.objects[std::size_t(GpuResourceType::vertexArray)], stats.objects[std::size_t(GpuResourceType::program)], stats.objects[std::size_t(GpuResourceType::texture)], stats.deleted, stats.pendingObjects );
+	}
+
+	if( auto const frames = glState.frames() )
+	{
+		auto const& stats = glState.total_stats();
+		std::printf( "GL state: %.1f calls issued, %.1f elided per frame\n", double(stats.total_issued()) / double(frames), double(stats.total_elided()) / double(frames) );
+
+		for( std::size_t i = 0; i < std::size_t(GLStateCall::count); ++i )
+		{
+			if( stats.issued[i] || stats.elided[i] )
+				std::printf( "  %-16s %8.1f %8.1f\n", gl_state_call_name( GLStateCall(i) ), double(stats.issued[i]) / double(frames), double(stats.elided[i]) / double(frames) );
+		}
 	}
 
 	// Cleanup.
 	state.prog = nullptr;
+	state.sim = nullptr;
 
 	//TODO: additional cleanup
 	
@@ -322,7 +1058,10 @@ namespace
 
 		if( auto* state = static_cast<State_*>(glfwGetWindowUserPointer( aWindow )) )
 		{
-			// R-key reloads shaders.
+			state->dirty = true;
+
+			// R-key reloads shaders. This only starts compiling them; the
+			// main loop swaps them in when they are ready.
 			if( GLFW_KEY_R == aKey && GLFW_PRESS == aAction )
 			{
 				if( state->prog )
@@ -330,7 +1069,6 @@ namespace
 					try
 					{
 						state->prog->reload();
-						std::fprintf( stderr, "Shaders reloaded and recompiled.\n" );
 					}
 					catch( std::exception const& eErr )
 					{
@@ -353,22 +1091,14 @@ namespace
 			}
 
 			// Camera controls if camera is active
-			if( state->camControl.cameraActive )
+			if( state->camControl.cameraActive && state->sim && GLFW_REPEAT != aAction )
 			{
+				bool const pressed = GLFW_PRESS == aAction;
+
 				if( GLFW_KEY_W == aKey )
-				{
-					if( GLFW_PRESS == aAction )
-						state->camControl.actionZoomIn = true;
-					else if( GLFW_RELEASE == aAction )
-						state->camControl.actionZoomIn = false;
-				}
+					state->sim->push( InputEvent{ InputEvent::Type::zoomIn, pressed, 0.f, 0.f } );
 				else if( GLFW_KEY_S == aKey )
-				{
-					if( GLFW_PRESS == aAction )
-						state->camControl.actionZoomOut = true;
-					else if( GLFW_RELEASE == aAction )
-						state->camControl.actionZoomOut = false;
-				}
+					state->sim->push( InputEvent{ InputEvent::Type::zoomOut, pressed, 0.f, 0.f } );
 			}
 		}
 	}
@@ -377,24 +1107,173 @@ namespace
 	{
 		if( auto* state = static_cast<State_*>(glfwGetWindowUserPointer( aWindow )) )
 		{
-			if( state->camControl.cameraActive )
+			if( state->camControl.cameraActive && state->sim )
 			{
 				auto const dx = float(aX-state->camControl.lastX);
 				auto const dy = float(aY-state->camControl.lastY);
 
-				state->camControl.phi += dx*kMouseSensitivity_;
-				
-				state->camControl.theta += dy*kMouseSensitivity_;
-				if( state->camControl.theta > std::numbers::pi_v<float>/2.f )
-					state->camControl.theta = std::numbers::pi_v<float>/2.f;
-				else if( state->camControl.theta < -std::numbers::pi_v<float>/2.f )
-					state->camControl.theta = -std::numbers::pi_v<float>/2.f;
+				if( state->sim->push( InputEvent{ InputEvent::Type::look, false, dx, dy } ) && state->latency )
+					state->latency->input( state->sim->pushed()-1, Clock::now() );
 			}
 
 			state->camControl.lastX = float(aX);
 			state->camControl.lastY = float(aY);
 		}
 	}
+
+	void glfw_callback_button_( GLFWwindow* aWindow, int aButton, int aAction, int )
+	{
+		if( auto* state = static_cast<State_*>(glfwGetWindowUserPointer( aWindow )) )
+		{
+			// Left click picks, unless the cursor is steering the camera.
+			if( GLFW_MOUSE_BUTTON_LEFT == aButton && GLFW_PRESS == aAction && !state->camControl.cameraActive )
+			{
+				state->pick = true;
+				state->dirty = true;
+			}
+		}
+	}
+
+	void glfw_callback_framebuffer_size_( GLFWwindow* aWindow, int, int )
+	{
+		if( auto* state = static_cast<State_*>(glfwGetWindowUserPointer( aWindow )) )
+			state->dirty = true;
+	}
+	void glfw_callback_refresh_( GLFWwindow* aWindow )
+	{
+		if( auto* state = static_cast<State_*>(glfwGetWindowUserPointer( aWindow )) )
+			state->dirty = true;
+	}
+}
+
+namespace
+{
+	void render_software_( SoftwareConfig const& aConfig, std::span<SimpleMeshData const* const> aMeshes, std::span<SceneObject const> aObjects, JobSystem& aJobs )
+	{
+		SoftFramebuffer framebuffer( aConfig.width, aConfig.height );
+		SoftRasterizer rasterizer( aJobs );
+
+		std::printf( "SOFTWARE %dx%d, %zu threads, %s\n", aConfig.width, aConfig.height, rasterizer.thread_count(), SoftRasterizer::uses_avx2() ? "AVX2" : "scalar" );
+
+		// Same camera path and projection as --bench
+		Mat44fPerspective const projection = make_perspective_projection(
+			kFieldOfView_,
+			float(aConfig.width)/float(aConfig.height),
+			kNearPlane_, kFarPlane_
+		);
+
+		std::vector<double> frameMs;
+		frameMs.reserve( aConfig.frames );
+
+		SoftRasterStats stats{};
+		float sceneTime = 0.f;
+		for( std::size_t frame = 0; frame < aConfig.frames; ++frame )
+		{
+			auto const frameStart = Clock::now();
+
+			auto const cam = bench_camera_at( frame, aConfig.frames );
+			sceneTime += kBenchTimeStep_;
+
+			Mat44fAffine const world2camera = make_rotation_x(cam.theta) * make_rotation_y(cam.phi) * make_translation({0.f, 0.f, -cam.radius});
+			Mat44f const projCamera = projection * world2camera;
+
+			// See SceneObject for the model-to-world transform.
+			for( auto const& object : aObjects )
+			{
+				Mat44fAffine const model2world = make_translation( object.position )
+					* make_rotation_y( object.spin * sceneTime )
+					* make_scaling( object.scale, object.scale, object.scale )
+				;
+
+				Vec3f const tint{ object.baseColor.x, object.baseColor.y, object.baseColor.z };
+				rasterizer.draw( *aMeshes[object.mesh], projCamera * model2world, tint );
+			}
+
+			framebuffer.clear( { 0.2f, 0.2f, 0.2f, 0.f } );
+			stats = rasterizer.render( framebuffer );
+
+			frameMs.emplace_back( std::chrono::duration<double, std::milli>(Clock::now()-frameStart).count() );
+		}
+
+		auto const timing = compute_frame_stats( frameMs );
+		std::printf( "SOFTWARE frames %zu: min %.3f ms, median %.3f ms, mean %.3f ms, max %.3f ms\n", timing.count, timing.min, timing.median, timing.mean, timing.max );
+		std::printf( "SOFTWARE last frame: %zu triangles, %zu culled, %zu tile bins\n", stats.triangles, stats.culled, stats.binned );
+
+		auto depthPath = aConfig.path;
+		depthPath.replace_extension( ".depth.png" );
+
+		framebuffer.write_color_png( aConfig.path );
+		framebuffer.write_depth_png( depthPath, kNearPlane_, kFarPlane_ );
+
+		std::printf( "SOFTWARE wrote '%s' and '%s'\n", aConfig.path.string().c_str(), depthPath.string().c_str() );
+	}
+
+	void pick_( GLFWwindow* aWindow, State_ const& aState, CameraState const& aCamera, std::span<std::optional<Bvh> const> aBvhs, std::span<SceneObject const> aObjects, float aSceneTime )
+	{
+		// The cursor position is in screen coordinates, which may differ
+		// from framebuffer pixels (e.g., on high-DPI displays).
+		int width, height;
+		glfwGetWindowSize( aWindow, &width, &height );
+		if( 0 == width || 0 == height )
+			return;
+
+		float const x = 2.f * aState.camControl.lastX / float(width) - 1.f;
+		float const y = 1.f - 2.f * aState.camControl.lastY / float(height);
+
+		// Invert the projection and world2camera from main().
+		float const tanHalfFov = std::tan( 0.5f * kFieldOfView_ );
+		Vec4f const direction{ x * tanHalfFov * float(width) / float(height), y * tanHalfFov, -1.f, 0.f };
+
+		Mat44fAffine const camera2world = make_translation( { 0.f, 0.f, aCamera.radius } ) * make_rotation_y( -aCamera.phi ) * make_rotation_x( -aCamera.theta );
+
+		Vec4f const worldOrigin = camera2world * Vec4f{ 0.f, 0.f, 0.f, 1.f };
+		Vec4f const worldDirection = camera2world * direction;
+
+		auto const start = Clock::now();
+
+		// Test each object in its model space. The inverse model transform
+		// (see SceneObject) maps the ray without changing t, so hits of
+		// different objects compare directly.
+		std::optional<BvhHit> closest;
+		std::size_t closestObject = 0;
+		for( std::size_t i = 0; i < aObjects.size(); ++i )
+		{
+			auto const& object = aObjects[i];
+			if( object.mesh >= aBvhs.size() || !aBvhs[object.mesh] )
+				continue;
+
+			Mat44fAffine const world2model = make_scaling( 1.f / object.scale, 1.f / object.scale, 1.f / object.scale )
+				* make_rotation_y( -object.spin * aSceneTime )
+				* make_translation( -object.position );
+
+			Vec4f const origin = world2model * worldOrigin;
+			Vec4f const dir = world2model * worldDirection;
+
+			Ray const ray{ { origin.x, origin.y, origin.z }, { dir.x, dir.y, dir.z } };
+			if( auto const hit = aBvhs[object.mesh]->intersect( ray, closest ? closest->t : kFarPlane_ ) )
+			{
+				closest = hit;
+				closestObject = i;
+			}
+		}
+
+		auto const us = std::chrono::duration<double, std::micro>( Clock::now() - start ).count();
+
+		if( !closest )
+		{
+			std::printf( "Pick: nothing (%zu objects tested in %.1f us)\n", aObjects.size(), us );
+			return;
+		}
+
+		Vec4f const point = worldOrigin + closest->t * worldDirection;
+		std::printf( "Pick: object %zu (mesh %u), triangle %u at (%.3f, %.3f, %.3f), distance %.3f (%zu objects tested in %.1f us)\n", closestObject, aObjects[closestObject].mesh, closest->triangle, double(point.x), double(point.y), double(point.z), double(closest->t * length( Vec3f{ worldDirection.x, worldDirection.y, worldDirection.z } )), aObjects.size(), us );
+	}
+
+	void print_startup_stats_( TaskGraph const& aStartup )
+	{
+		auto const stats = aStartup.stats();
+		std::printf( "Startup: %zu tasks, %.1f ms of work in %.1f ms; longest chain %.1f ms (%s); main thread waited %.1f ms\n", stats.tasks, stats.workMs, stats.elapsedMs, stats.criticalMs, aStartup.critical_path().c_str(), stats.waitedMs );
+	}
 }
 
 namespace
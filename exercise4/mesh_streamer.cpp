@@ -0,0 +1,405 @@
+#include "mesh_streamer.hpp"
+
+#include <utility>
+#include <algorithm>
+#include <exception>
+
+#include <cmath>
+#include <cassert>
+#include <cstddef>
+
+#include "frame_pipeline.hpp"
+
+#include "../support/error.hpp"
+
+namespace
+{
+	// Distance from aPoint to the box; zero inside.
+	float distance_( MeshBounds const& aBox, Vec3f aPoint ) noexcept
+	{
+		Vec3f const d{
+			std::max( { aBox.min.x - aPoint.x, aPoint.x - aBox.max.x, 0.f } ),
+			std::max( { aBox.min.y - aPoint.y, aPoint.y - aBox.max.y, 0.f } ),
+			std::max( { aBox.min.z - aPoint.z, aPoint.z - aBox.max.z, 0.f } )
+		};
+		return length( d );
+	}
+}
+
+MeshStreamer::MeshStreamer( GpuResources& aResources, std::filesystem::path const& aPath, std::size_t aPoolBytes, std::size_t aMaxLoads )
+	: mIndex( read_chunked_mesh_index( aPath ) )
+	, mSlotVertices( mIndex.header.maxChunkVertices )
+	, mMaxLoads( std::max<std::size_t>( 1, aMaxLoads ) )
+	, mFrame( 0 )
+	, mStarved( false )
+	, mStats{}
+	, mQuit( false )
+	, mFile( nullptr )
+{
+	mNodeChunks.assign( mIndex.nodes.size(), kNoSlot_ );
+	for( std::uint32_t i = 0; i < mIndex.nodes.size(); ++i )
+	{
+		auto const& node = mIndex.nodes[i];
+		if( 0 == node.childCount && 0 != node.vertexCount )
+		{
+			mNodeChunks[i] = std::uint32_t(mChunks.size());
+			mChunks.emplace_back( Chunk_{ i, kNoSlot_, ChunkState_::unloaded, 0, 0.f } );
+		}
+	}
+
+	mStats.chunks = mChunks.size();
+
+	if( mChunks.empty() )
+		return;
+
+	// More slots than chunks would never be used.
+	auto const slotBytes = mSlotVertices * sizeof(ChunkVertex);
+	auto const slots = std::min( aPoolBytes / slotBytes, mChunks.size() );
+	if( 0 == slots )
+		throw Error( "MeshStreamer: a pool of %zu bytes can't hold a single chunk (%zu bytes)", aPoolBytes, slotBytes );
+
+	mPool = aResources.create_buffer( GpuMemoryCategory::vertex, GLsizeiptr(slots * slotBytes), nullptr, GL_DYNAMIC_STORAGE_BIT );
+	mVao = aResources.create_vertex_array();
+
+	glBindVertexArray( mVao.id() );
+	glBindBuffer( GL_ARRAY_BUFFER, mPool.id() );
+
+	glVertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, sizeof(ChunkVertex), reinterpret_cast<void const*>(offsetof(ChunkVertex, position)) );
+	glEnableVertexAttribArray( 0 );
+	glVertexAttribPointer( 1, 3, GL_FLOAT, GL_FALSE, sizeof(ChunkVertex), reinterpret_cast<void const*>(offsetof(ChunkVertex, color)) );
+	glEnableVertexAttribArray( 1 );
+
+	glBindVertexArray( 0 );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+	// Hand out slot 0 first.
+	for( std::size_t i = slots; i > 0; --i )
+		mFreeSlots.emplace_back( std::uint32_t(i-1) );
+
+	mSlotChunks.assign( slots, kNoSlot_ );
+	mStats.slots = slots;
+	mStats.poolBytes = slots * slotBytes;
+
+	mFile = std::fopen( aPath.string().c_str(), "rb" );
+	if( !mFile )
+		throw Error( "Unable to open '%s'", aPath.string().c_str() );
+
+	mThread = std::thread( [this] { io_(); } );
+}
+
+MeshStreamer::~MeshStreamer()
+{
+	{
+		std::scoped_lock lock( mMutex );
+		mQuit = true;
+	}
+
+	mWake.notify_all();
+
+	if( mThread.joinable() )
+		mThread.join();
+
+	if( mFile )
+		std::fclose( mFile );
+}
+
+void MeshStreamer::update( Mat44f const& aModel2Clip, Vec3f aEye )
+{
+	{
+		std::scoped_lock lock( mMutex );
+		if( !mError.empty() )
+			throw Error( "MeshStreamer: %s", mError.c_str() );
+	}
+
+	upload_completed_();
+
+	++mFrame;
+
+	// Visible chunks
+	mVisible.clear();
+	mScratch.clear();
+
+	if( !mChunks.empty() )
+		mScratch.emplace_back( 0 );
+
+	while( !mScratch.empty() )
+	{
+		auto const index = mScratch.back();
+		mScratch.pop_back();
+
+		auto const& node = mIndex.nodes[index];
+		if( outside_frustum( aModel2Clip, node.bounds ) )
+			continue;
+
+		if( node.childCount )
+		{
+			for( std::uint32_t i = 0; i < node.childCount; ++i )
+				mScratch.emplace_back( node.firstChild + i );
+			continue;
+		}
+
+		auto const chunk = mNodeChunks[index];
+		if( kNoSlot_ == chunk )
+			continue;
+
+		auto& state = mChunks[chunk];
+		state.lastVisible = mFrame;
+		state.distance = distance_( node.bounds, aEye );
+
+		mVisible.emplace_back( chunk );
+	}
+
+	std::sort( mVisible.begin(), mVisible.end(), [this] (std::uint32_t aA, std::uint32_t aB) {
+		return mChunks[aA].distance < mChunks[aB].distance;
+	} );
+
+	// Draw what is there; load what is missing.
+	mDraws.clear();
+
+	bool starved = false;
+	for( auto const chunk : mVisible )
+	{
+		auto const& state = mChunks[chunk];
+		if( ChunkState_::resident == state.state )
+		{
+			mDraws.emplace_back( chunk );
+			continue;
+		}
+
+		if( ChunkState_::unloaded != state.state || starved || mStats.loading >= mMaxLoads )
+			continue;
+
+		std::uint32_t slot = kNoSlot_;
+		if( !mFreeSlots.empty() )
+		{
+			slot = mFreeSlots.back();
+			mFreeSlots.pop_back();
+		}
+		else
+		{
+			slot = evict_();
+		}
+
+		if( kNoSlot_ == slot )
+		{
+			starved = true;
+			continue;
+		}
+
+		request_( chunk, slot );
+	}
+
+	if( starved )
+		++mStats.starved;
+
+	mStarved = starved;
+
+	// Prefetch into the remaining free slots, nearest first.
+	if( !mFreeSlots.empty() && mStats.loading < mMaxLoads )
+	{
+		mScratch.clear();
+		for( std::uint32_t i = 0; i < mChunks.size(); ++i )
+		{
+			auto& state = mChunks[i];
+			if( ChunkState_::unloaded != state.state || mFrame == state.lastVisible )
+				continue;
+
+			state.distance = distance_( mIndex.nodes[state.node].bounds, aEye );
+			mScratch.emplace_back( i );
+		}
+
+		auto const count = std::min( { mScratch.size(), mFreeSlots.size(), mMaxLoads - mStats.loading } );
+		std::partial_sort( mScratch.begin(), mScratch.begin() + std::ptrdiff_t(count), mScratch.end(), [this] (std::uint32_t aA, std::uint32_t aB) {
+			return mChunks[aA].distance < mChunks[aB].distance;
+		} );
+
+		for( std::size_t i = 0; i < count; ++i )
+		{
+			auto const slot = mFreeSlots.back();
+			mFreeSlots.pop_back();
+
+			request_( mScratch[i], slot );
+		}
+	}
+
+	mStats.visible = mVisible.size();
+	mStats.drawn = mDraws.size();
+	mStats.resident = mSlotChunks.size() - mFreeSlots.size() - mStats.loading;
+}
+
+void MeshStreamer::draw( GLStateCache& aState, GLuint aProgram, GLuint aDrawId ) const
+{
+	if( mDraws.empty() )
+		return;
+
+	aState.use_program( aProgram );
+	aState.bind_vertex_array( mVao.id() );
+
+	for( auto const chunk : mDraws )
+	{
+		auto const& state = mChunks[chunk];
+		auto const& node = mIndex.nodes[state.node];
+
+		glDrawArraysInstancedBaseInstance( GL_TRIANGLES, GLint(state.slot * mSlotVertices), GLsizei(node.vertexCount), 1, aDrawId );
+	}
+}
+
+GLuint MeshStreamer::vao() const noexcept
+{
+	return mVao.id();
+}
+
+bool MeshStreamer::busy() const noexcept
+{
+	return 0 != mStats.loading || (mStats.drawn < mStats.visible && !mStarved);
+}
+
+MeshBounds const& MeshStreamer::bounds() const noexcept
+{
+	return mIndex.header.bounds;
+}
+
+StreamStats const& MeshStreamer::stats() const noexcept
+{
+	return mStats;
+}
+
+void MeshStreamer::upload_completed_()
+{
+	std::deque<Load_> completed;
+	{
+		std::scoped_lock lock( mMutex );
+		completed.swap( mCompleted );
+	}
+
+	if( completed.empty() )
+		return;
+
+	glBindBuffer( GL_COPY_WRITE_BUFFER, mPool.id() );
+
+	for( auto const& load : completed )
+	{
+		auto& state = mChunks[load.chunk];
+		assert( ChunkState_::loading == state.state );
+
+		auto const bytes = load.data.size() * sizeof(ChunkVertex);
+		glBufferSubData( GL_COPY_WRITE_BUFFER, GLintptr(state.slot * mSlotVertices * sizeof(ChunkVertex)), GLsizeiptr(bytes), load.data.data() );
+
+		state.state = ChunkState_::resident;
+
+		--mStats.loading;
+		++mStats.loads;
+		mStats.bytesLoaded += bytes;
+	}
+
+	glBindBuffer( GL_COPY_WRITE_BUFFER, 0 );
+
+	// Recycle the staging buffers.
+	std::scoped_lock lock( mMutex );
+	for( auto& load : completed )
+		mBuffers.emplace_back( std::move(load.data) );
+}
+
+void MeshStreamer::request_( std::uint32_t aChunk, std::uint32_t aSlot )
+{
+	auto& state = mChunks[aChunk];
+	assert( ChunkState_::unloaded == state.state );
+
+	state.state = ChunkState_::loading;
+	state.slot = aSlot;
+	mSlotChunks[aSlot] = aChunk;
+
+	++mStats.loading;
+
+	{
+		std::scoped_lock lock( mMutex );
+
+		Load_ load{ aChunk, state.node, {} };
+		if( !mBuffers.empty() )
+		{
+			load.data = std::move(mBuffers.back());
+			mBuffers.pop_back();
+		}
+
+		mRequests.emplace_back( std::move(load) );
+	}
+
+	mWake.notify_one();
+}
+
+std::uint32_t MeshStreamer::evict_()
+{
+	// Longest out of view first; among those, the farthest.
+	std::uint32_t victim = kNoSlot_;
+	for( std::uint32_t slot = 0; slot < mSlotChunks.size(); ++slot )
+	{
+		auto const chunk = mSlotChunks[slot];
+		if( kNoSlot_ == chunk )
+			continue;
+
+		auto const& state = mChunks[chunk];
+		if( ChunkState_::resident != state.state || mFrame == state.lastVisible )
+			continue;
+
+		if( kNoSlot_ != victim )
+		{
+			auto const& best = mChunks[mSlotChunks[victim]];
+			if( state.lastVisible > best.lastVisible || (state.lastVisible == best.lastVisible && state.distance <= best.distance) )
+				continue;
+		}
+
+		victim = slot;
+	}
+
+	if( kNoSlot_ == victim )
+		return kNoSlot_;
+
+	auto& state = mChunks[mSlotChunks[victim]];
+	state.state = ChunkState_::unloaded;
+	state.slot = kNoSlot_;
+
+	mSlotChunks[victim] = kNoSlot_;
+	++mStats.evictions;
+
+	return victim;
+}
+
+void MeshStreamer::io_()
+{
+	for( ;; )
+	{
+		Load_ load;
+
+		{
+			std::unique_lock lock( mMutex );
+			mWake.wait( lock, [this] { return mQuit || !mRequests.empty(); } );
+
+			if( mQuit )
+				return;
+
+			load = std::move(mRequests.front());
+			mRequests.pop_front();
+		}
+
+		// Buffers are recycled, so this only allocates until there is one
+		// per possible load.
+		auto const& node = mIndex.nodes[load.node];
+		load.data.reserve( mSlotVertices );
+		load.data.resize( node.vertexCount );
+
+		try
+		{
+			read_chunk( mFile, node, load.data.data() );
+		}
+		catch( std::exception const& eErr )
+		{
+			std::scoped_lock lock( mMutex );
+			if( mError.empty() )
+				mError = eErr.what();
+			continue;
+		}
+
+		std::scoped_lock lock( mMutex );
+		mCompleted.emplace_back( std::move(load) );
+	}
+}
@@ -0,0 +1,184 @@
+#ifndef MESH_STREAMER_HPP_B7D02E5C_61F9_4A3B_8C47_E25A0D9F13B6
+#define MESH_STREAMER_HPP_B7D02E5C_61F9_4A3B_8C47_E25A0D9F13B6
+
+#include <glad/glad.h>
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <filesystem>
+#include <condition_variable>
+
+#include <cstdio>
+#include <cstddef>
+#include <cstdint>
+
+#include "chunked_mesh.hpp"
+
+#include "../vmlib/vec3.hpp"
+#include "../vmlib/mat44.hpp"
+
+#include "../support/gl_state.hpp"
+#include "../support/gpu_resources.hpp"
+
+struct StreamConfig
+{
+	bool enabled = false;
+
+	std::filesystem::path path; // chunked mesh file, see chunked_mesh.hpp
+	std::filesystem::path source; // if set, OBJ file that path is built from
+
+	std::size_t poolBytes = 64*1024*1024;
+	std::size_t chunkTriangles = ChunkedMeshConfig{}.maxChunkTriangles; // when building
+};
+
+struct StreamStats
+{
+	std::size_t chunks; // in the file
+	std::size_t slots; // in the GPU pool
+	std::size_t poolBytes;
+
+	// Current frame
+	std::size_t visible; // chunks in the view frustum
+	std::size_t drawn; // visible and resident
+	std::size_t resident;
+	std::size_t loading;
+
+	// Totals
+	std::size_t loads;
+	std::size_t evictions;
+	std::size_t starved; // frames in which the pool was too small for the visible chunks
+	std::uint64_t bytesLoaded;
+};
+
+// Renders a chunked mesh with bounded memory
+//
+// The GPU keeps a fixed-size pool of chunks: one vertex buffer, divided into
+// slots that each hold the largest chunk of the file. Each frame, update()
+//  1. uploads chunks that have finished loading into their slots,
+//  2. walks the file's octree and selects the leaves (chunks) that are in
+//     the view frustum; the resident ones are drawn, nearest first,
+//  3. requests the missing visible chunks, nearest first. If there is no
+//     free slot, the chunk that has been out of view the longest (farthest
+//     first) is evicted. Visible chunks are never evicted; if the pool is
+//     full of them, the rest isn't loaded (see StreamStats::starved).
+//  4. requests chunks that are out of view, nearest first, as long as there
+//     are free slots (prefetching; never evicts anything).
+//
+// Chunks are read from the file by a background thread, into a bounded
+// number of staging buffers; update() never waits for I/O. The chunk index
+// (header and node table) is the only part of the file that is kept in
+// memory.
+//
+// Evicted slots may still be in use by earlier frames that the GPU hasn't
+// finished yet. They are overwritten with glBufferSubData(), which the
+// driver orders after those draws.
+//
+// Must only be used from the thread of the GL context.
+class MeshStreamer final
+{
+	public:
+		// aMaxLoads: chunks that may be loading at the same time (and number
+		// of staging buffers).
+		MeshStreamer( GpuResources&, std::filesystem::path const&, std::size_t aPoolBytes, std::size_t aMaxLoads = 8 );
+		~MeshStreamer();
+
+		MeshStreamer( MeshStreamer const& ) = delete;
+		MeshStreamer& operator= (MeshStreamer const&) = delete;
+
+	public:
+		// aModel2Clip is used for frustum culling; aEye is the camera's
+		// position in model space, for priorities. Throws if loading a chunk
+		// failed.
+		void update( Mat44f const& aModel2Clip, Vec3f aEye );
+
+		// Draws the chunks selected by the last update(). aDrawId is passed
+		// through the base instance, as by RenderQueue.
+		void draw( GLStateCache&, GLuint aProgram, GLuint aDrawId ) const;
+
+		// For DrawIdBuffer::attach()
+		GLuint vao() const noexcept;
+
+		// True while chunks are loading, or while visible chunks are missing
+		// that could still be loaded (i.e., not for lack of slots). Further
+		// update()s are needed to bring the image up to date.
+		bool busy() const noexcept;
+
+		MeshBounds const& bounds() const noexcept;
+		StreamStats const& stats() const noexcept;
+
+	private:
+		void upload_completed_();
+		void request_( std::uint32_t aChunk, std::uint32_t aSlot );
+
+		// Frees a slot by evicting a chunk that isn't visible. Returns
+		// kNoSlot_ if there is none.
+		std::uint32_t evict_();
+
+		void io_();
+
+	private:
+		static constexpr std::uint32_t kNoSlot_ = ~std::uint32_t(0);
+
+		enum class ChunkState_ : std::uint8_t
+		{
+			unloaded,
+			loading,
+			resident
+		};
+
+		struct Chunk_
+		{
+			std::uint32_t node;
+			std::uint32_t slot;
+			ChunkState_ state;
+
+			std::uint64_t lastVisible; // frame
+			float distance; // to the eye, as of lastVisible (or the last prefetch pass)
+		};
+
+		struct Load_
+		{
+			std::uint32_t chunk;
+			std::uint32_t node;
+			std::vector<ChunkVertex> data;
+		};
+
+		ChunkedMeshIndex mIndex;
+		std::vector<Chunk_> mChunks;
+		std::vector<std::uint32_t> mNodeChunks; // chunk of each leaf, or kNoSlot_
+
+		GpuBuffer mPool;
+		GpuVertexArray mVao;
+
+		std::size_t mSlotVertices;
+		std::vector<std::uint32_t> mFreeSlots;
+		std::vector<std::uint32_t> mSlotChunks; // chunk in each slot, or kNoSlot_
+
+		std::size_t mMaxLoads;
+		std::uint64_t mFrame;
+		bool mStarved; // in the last update()
+
+		std::vector<std::uint32_t> mVisible; // this frame, nearest first
+		std::vector<std::uint32_t> mDraws;
+		std::vector<std::uint32_t> mScratch;
+
+		StreamStats mStats;
+
+		// Shared with the I/O thread
+		std::mutex mMutex;
+		std::condition_variable mWake;
+
+		std::deque<Load_> mRequests, mCompleted;
+		std::vector<std::vector<ChunkVertex>> mBuffers; // unused staging buffers
+
+		std::string mError; // first I/O error
+		bool mQuit;
+
+		std::FILE* mFile; // only used by the I/O thread
+		std::thread mThread;
+};
+
+#endif // MESH_STREAMER_HPP_B7D02E5C_61F9_4A3B_8C47_E25A0D9F13B6
@@ -0,0 +1,275 @@
+#include "options.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "../support/error.hpp"
+
+namespace
+{
+	std::size_t parse_count_( char const* aOption, char const* aValue );
+	float parse_positive_( char const* aOption, char const* aValue );
+}
+
+Options parse_options( int aArgc, char* aArgv[] )
+{
+	Options ret;
+	BenchConfig& bench = ret.bench;
+
+	bool forceHeadless = false;
+	for( int i = 1; i < aArgc; ++i )
+	{
+		char const* arg = aArgv[i];
+
+		// Returns the value of an option that takes an argument.
+		auto const value = [&] () -> char const* {
+			if( i+1 >= aArgc )
+				throw Error( "Option '%s' requires an argument", arg );
+			return aArgv[++i];
+		};
+
+		if( 0 == std::strcmp( arg, "--bench" ) )
+		{
+			bench.enabled = true;
+		}
+		else if( 0 == std::strcmp( arg, "--headless" ) )
+		{
+			forceHeadless = true;
+		}
+		else if( 0 == std::strcmp( arg, "--bench-size" ) )
+		{
+			char const* size = value();
+			if( 2 != std::sscanf( size, "%dx%d", &bench.width, &bench.height ) || bench.width <= 0 || bench.height <= 0 )
+				throw Error( "Option '--bench-size': expected WIDTHxHEIGHT, got '%s'", size );
+		}
+		else if( 0 == std::strcmp( arg, "--bench-frames" ) )
+		{
+			bench.frames = parse_count_( arg, value() );
+			if( 0 == bench.frames )
+				throw Error( "Option '--bench-frames': need at least one frame" );
+		}
+		else if( 0 == std::strcmp( arg, "--bench-warmup" ) )
+		{
+			bench.warmupFrames = parse_count_( arg, value() );
+		}
+		else if( 0 == std::strcmp( arg, "--instances" ) )
+		{
+			ret.instances = parse_count_( arg, value() );
+		}
+		else if( 0 == std::strcmp( arg, "--threads" ) )
+		{
+			ret.threads = parse_count_( arg, value() );
+		}
+		else if( 0 == std::strcmp( arg, "--tick-rate" ) )
+		{
+			ret.tickRate = parse_positive_( arg, value() );
+		}
+		else if( 0 == std::strcmp( arg, "--on-demand" ) )
+		{
+			ret.onDemand = true;
+		}
+		else if( 0 == std::strcmp( arg, "--gpu-culling" ) )
+		{
+			ret.gpuCulling = true;
+		}
+		else if( 0 == std::strcmp( arg, "--shader-cache" ) )
+		{
+			ret.shaderCache = value();
+			if( ret.shaderCache.empty() )
+				throw Error( "Option '--shader-cache': expected a directory" );
+		}
+		else if( 0 == std::strcmp( arg, "--no-shader-cache" ) )
+		{
+			ret.shaderCache.clear();
+		}
+		else if( 0 == std::strcmp( arg, "--gpu-budget" ) )
+		{
+			ret.gpuMemory.budget = std::size_t(double(parse_positive_( arg, value() )) * 1024. * 1024.);
+		}
+		else if( 0 == std::strcmp( arg, "--gl-errors" ) )
+		{
+			char const* mode = value();
+			if( 0 == std::strcmp( mode, "sync" ) )
+				ret.glErrors = GLDebugMode::synchronous;
+			else if( 0 == std::strcmp( mode, "deferred" ) )
+				ret.glErrors = GLDebugMode::deferred;
+			else
+				throw Error( "Option '--gl-errors': expected 'sync' or 'deferred', got '%s'", mode );
+		}
+		else if( 0 == std::strcmp( arg, "--dynamic-resolution" ) )
+		{
+			ret.dynamicResolution.enabled = true;
+		}
+		else if( 0 == std::strcmp( arg, "--frame-budget" ) )
+		{
+			ret.dynamicResolution.targetMs = parse_positive_( arg, value() );
+		}
+		else if( 0 == std::strcmp( arg, "--min-scale" ) )
+		{
+			ret.dynamicResolution.minScale = parse_positive_( arg, value() );
+			if( ret.dynamicResolution.minScale > ret.dynamicResolution.maxScale )
+				throw Error( "Option '--min-scale': must not exceed %g", double(ret.dynamicResolution.maxScale) );
+		}
+		else if( 0 == std::strcmp( arg, "--no-late-latch" ) )
+		{
+			ret.latency.lateLatch = false;
+		}
+		else if( 0 == std::strcmp( arg, "--frames-in-flight" ) )
+		{
+			ret.latency.framesInFlight = parse_count_( arg, value() );
+		}
+		else if( 0 == std::strcmp( arg, "--latency-log" ) )
+		{
+			ret.latency.logFile = value();
+			if( ret.latency.logFile.empty() )
+				throw Error( "Option '--latency-log': expected a file name" );
+		}
+		else if( 0 == std::strcmp( arg, "--capture" ) )
+		{
+			ret.capture.enabled = true;
+			ret.capture.directory = value();
+		}
+		else if( 0 == std::strcmp( arg, "--capture-format" ) )
+		{
+			char const* format = value();
+			if( 0 == std::strcmp( format, "png" ) )
+				ret.capture.format = CaptureFormat::png;
+			else if( 0 == std::strcmp( format, "raw" ) )
+				ret.capture.format = CaptureFormat::raw;
+			else
+				throw Error( "Option '--capture-format': expected 'png' or 'raw', got '%s'", format );
+		}
+		else if( 0 == std::strcmp( arg, "--capture-every" ) )
+		{
+			ret.capture.every = parse_count_( arg, value() );
+			if( 0 == ret.capture.every )
+				throw Error( "Option '--capture-every': expected a positive integer" );
+		}
+		else if( 0 == std::strcmp( arg, "--gl-capture" ) )
+		{
+			ret.glCapture.enabled = true;
+			ret.glCapture.path = value();
+		}
+		else if( 0 == std::strcmp( arg, "--gl-capture-frames" ) )
+		{
+			ret.glCapture.frames = parse_count_( arg, value() );
+			if( 0 == ret.glCapture.frames )
+				throw Error( "Option '--gl-capture-frames': need at least one frame" );
+		}
+		else if( 0 == std::strcmp( arg, "--stream" ) )
+		{
+			ret.stream.enabled = true;
+			ret.stream.path = value();
+		}
+		else if( 0 == std::strcmp( arg, "--stream-source" ) )
+		{
+			ret.stream.source = value();
+		}
+		else if( 0 == std::strcmp( arg, "--stream-pool" ) )
+		{
+			ret.stream.poolBytes = std::size_t(double(parse_positive_( arg, value() )) * 1024. * 1024.);
+		}
+		else if( 0 == std::strcmp( arg, "--stream-chunk" ) )
+		{
+			ret.stream.chunkTriangles = parse_count_( arg, value() );
+			if( 0 == ret.stream.chunkTriangles )
+				throw Error( "Option '--stream-chunk': need at least one triangle" );
+		}
+		else if( 0 == std::strcmp( arg, "--texture" ) )
+		{
+			ret.textures.files.emplace_back( value() );
+		}
+		else if( 0 == std::strcmp( arg, "--texture-cache" ) )
+		{
+			ret.textures.cacheDirectory = value();
+			if( ret.textures.cacheDirectory.empty() )
+				throw Error( "Option '--texture-cache': expected a directory" );
+		}
+		else if( 0 == std::strcmp( arg, "--no-texture-cache" ) )
+		{
+			ret.textures.cacheDirectory.clear();
+		}
+		else if( 0 == std::strcmp( arg, "--texture-filter" ) )
+		{
+			char const* filter = value();
+			if( 0 == std::strcmp( filter, "box" ) )
+				ret.textures.filter = MipFilter::box;
+			else if( 0 == std::strcmp( filter, "kaiser" ) )
+				ret.textures.filter = MipFilter::kaiser;
+			else
+				throw Error( "Option '--texture-filter': expected 'box' or 'kaiser', got '%s'", filter );
+		}
+		else if( 0 == std::strcmp( arg, "--texture-upload" ) )
+		{
+			ret.textures.uploadBytes = std::size_t(double(parse_positive_( arg, value() )) * 1024. * 1024.);
+		}
+		else if( 0 == std::strcmp( arg, "--software" ) )
+		{
+			ret.software.enabled = true;
+			ret.software.path = value();
+		}
+		else if( 0 == std::strcmp( arg, "--software-size" ) )
+		{
+			char const* size = value();
+			if( 2 != std::sscanf( size, "%dx%d", &ret.software.width, &ret.software.height ) || ret.software.width <= 0 || ret.software.height <= 0 )
+				throw Error( "Option '--software-size': expected WIDTHxHEIGHT, got '%s'", size );
+		}
+		else if( 0 == std::strcmp( arg, "--software-frames" ) )
+		{
+			ret.software.frames = parse_count_( arg, value() );
+			if( 0 == ret.software.frames )
+				throw Error( "Option '--software-frames': need at least one frame" );
+		}
+		else
+		{
+			throw Error( "Unknown command line argument '%s'", arg );
+		}
+	}
+
+	if( ret.software.enabled && bench.enabled )
+		throw Error( "Options '--software' and '--bench' are mutually exclusive" );
+
+	if( !ret.stream.source.empty() && !ret.stream.enabled )
+		throw Error( "Option '--stream-source' requires '--stream'" );
+
+	if( !ret.latency.logFile.empty() && bench.enabled )
+		throw Error( "Option '--latency-log' measures mouse input, and can't be combined with '--bench'" );
+
+	if( bench.enabled )
+	{
+		// Without a display server, GLFW's X11/Wayland backends cannot create
+		// a window, so fall back to a surfaceless context.
+		bool const haveDisplay = std::getenv( "DISPLAY" ) || std::getenv( "WAYLAND_DISPLAY" );
+		bench.headless = forceHeadless || !haveDisplay;
+	}
+	else if( forceHeadless )
+	{
+		throw Error( "Option '--headless' is only supported together with '--bench'" );
+	}
+
+	return ret;
+}
+
+namespace
+{
+	std::size_t parse_count_( char const* aOption, char const* aValue )
+	{
+		char* end = nullptr;
+		auto const count = std::strtoull( aValue, &end, 10 );
+		if( end == aValue || '\0' != *end || '-' == aValue[0] )
+			throw Error( "Option '%s': expected a non-negative integer, got '%s'", aOption, aValue );
+
+		return std::size_t(count);
+	}
+
+	float parse_positive_( char const* aOption, char const* aValue )
+	{
+		char* end = nullptr;
+		auto const value = std::strtof( aValue, &end );
+		if( end == aValue || '\0' != *end || !(value > 0.f) )
+			throw Error( "Option '%s': expected a positive number, got '%s'", aOption, aValue );
+
+		return value;
+	}
+}
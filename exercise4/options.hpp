@@ -0,0 +1,122 @@
+#ifndef OPTIONS_HPP_A6A47417_F88C_49D5_9274_5ACD8D016612
+#define OPTIONS_HPP_A6A47417_F88C_49D5_9274_5ACD8D016612
+
+#include <filesystem>
+
+#include <cstddef>
+
+#include "bench.hpp"
+#include "latency.hpp"
+#include "soft_raster.hpp"
+#include "mesh_streamer.hpp"
+#include "texture_loader.hpp"
+#include "frame_capture.hpp"
+#include "dynamic_resolution.hpp"
+
+#include "../support/gl_capture.hpp"
+#include "../support/gpu_resources.hpp"
+#include "../support/debug_output.hpp"
+
+// Command line options
+//
+//   --bench              enable benchmark mode (see bench.hpp)
+//   --bench-size WxH     offscreen resolution (default: 1920x1080)
+//   --bench-frames N     number of measured frames (default: 1000)
+//   --bench-warmup N     number of unmeasured warm-up frames (default: 60)
+//   --headless           create the context without a window system (GLFW
+//                        null platform + EGL). This is the default for
+//                        --bench if neither DISPLAY nor WAYLAND_DISPLAY is set.
+//
+//   --instances N        add N extra instances of the axis arrows to the
+//                        scene, laid out on a grid (default: 0)
+//   --threads N          number of threads of the job system that runs all
+//                        parallel CPU work (draw lists, BVHs, software
+//                        rendering, texture decoding), including the main
+//                        thread (default: 0, one per hardware thread)
+//   --tick-rate HZ       simulation rate (camera, animation) in interactive
+//                        mode (default: 120)
+//   --on-demand          only redraw when something changed (input, resize,
+//                        shader reload, animation), and sleep otherwise
+//   --gpu-culling        cull on the GPU (frustum + Hi-Z occlusion) and draw
+//                        with multi-draw indirect, see gpu_culling.hpp
+//   --shader-cache DIR   directory for cached program binaries (default:
+//                        shadercache), see support/program_cache.hpp
+//   --no-shader-cache    always compile shaders from source
+//   --gpu-budget MB      GPU memory budget for buffers; exceeding it prints a
+//                        warning (default: none, see
+//                        support/gpu_resources.hpp)
+//   --gl-errors MODE     sync (default): check glGetError() at checkpoints
+//                        (and, in debug builds, print debug output as it
+//                        happens); deferred: collect debug output without
+//                        synchronizing, and print it once per frame (see
+//                        support/debug_output.hpp)
+//
+//   --dynamic-resolution render at a reduced resolution when the GPU can't
+//                        keep up, and upscale (see dynamic_resolution.hpp)
+//   --frame-budget MS    GPU time budget per frame (default: 16.7)
+//   --min-scale S        lowest resolution scale per axis (default: 0.5)
+//
+//   --no-late-latch      only sample the camera at the start of each frame,
+//                        not again right before the draws are submitted
+//   --frames-in-flight N let the CPU run at most N frames ahead of the GPU
+//                        (default: 0, no limit; see support/frame_pacer.hpp)
+//   --latency-log FILE   measure the latency from mouse input to the swap and
+//                        to the GPU finishing the frame, and write it to FILE
+//                        as CSV (interactive only, see latency.hpp)
+//
+//   --capture DIR        write rendered frames to DIR (see frame_capture.hpp)
+//   --capture-format F   png (default) or raw
+//   --capture-every N    only capture every N-th frame (default: 1)
+//
+//   --gl-capture FILE    record the GL calls of the setup and of the first
+//                        frames to FILE, for the glreplay tool (see
+//                        support/gl_capture.hpp)
+//   --gl-capture-frames N  number of recorded frames (default: 10)
+//
+//   --stream FILE        render the chunked mesh FILE in place of the
+//                        Armadillo, streaming it through a fixed-size GPU
+//                        pool (see mesh_streamer.hpp)
+//   --stream-source OBJ  first (re)build FILE from OBJ (see chunked_mesh.hpp)
+//   --stream-pool MB     size of the GPU pool (default: 64)
+//   --stream-chunk N     triangles per chunk when building (default: 16384)
+//
+//   --texture FILE       load the image FILE as a texture in the background;
+//                        may be given several times (see texture_loader.hpp)
+//   --texture-cache DIR  directory for cooked textures (default: texturecache)
+//   --no-texture-cache   always decode images and generate mipmaps
+//   --texture-filter F   mipmap filter: box (default) or kaiser
+//   --texture-upload MB  texture data uploaded per frame (default: 8)
+//
+//   --software FILE      render on the CPU instead, without OpenGL, and write
+//                        the result to FILE (PNG, see soft_raster.hpp)
+//   --software-size WxH  resolution (default: 1920x1080)
+//   --software-frames N  number of frames along the benchmark's camera path;
+//                        each is timed, the last one is written (default: 1)
+struct Options
+{
+	BenchConfig bench;
+	CaptureConfig capture;
+	GLCaptureConfig glCapture;
+	SoftwareConfig software;
+	StreamConfig stream;
+	TextureConfig textures;
+	DynamicResolutionConfig dynamicResolution;
+	LatencyConfig latency;
+
+	std::size_t instances = 0;
+	std::size_t threads = 0;
+
+	double tickRate = 120.0;
+
+	std::filesystem::path shaderCache = "shadercache"; // empty = disabled
+
+	GLDebugMode glErrors = GLDebugMode::synchronous;
+	GpuMemoryConfig gpuMemory;
+
+	bool onDemand = false;
+	bool gpuCulling = false;
+};
+
+Options parse_options( int aArgc, char* aArgv[] );
+
+#endif // OPTIONS_HPP_A6A47417_F88C_49D5_9274_5ACD8D016612
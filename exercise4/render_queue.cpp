@@ -0,0 +1,201 @@
+#include "render_queue.hpp"
+
+#include <utility>
+#include <algorithm>
+
+#include <cassert>
+
+namespace
+{
+	// Below this, the histogram setup of the radix sort costs more than it
+	// saves.
+	constexpr std::size_t kRadixSortThreshold_ = 128;
+
+	template< typename tEntry >
+	void radix_sort_( std::vector<tEntry>&, std::vector<tEntry>& );
+}
+
+std::uint64_t make_sort_key( RenderPass aPass, GLuint aProgram, GLuint aVao, float aDepth01 ) noexcept
+{
+	constexpr std::uint32_t kDepthMax = (1u << 24) - 1;
+
+	float const clamped = std::clamp( aDepth01, 0.f, 1.f );
+	auto depth = std::uint32_t(clamped * float(kDepthMax));
+
+	// Transparent geometry must be blended back-to-front.
+	if( RenderPass::transparent == aPass )
+		depth = kDepthMax - depth;
+
+	return (std::uint64_t(aPass) & 0x3) << 62
+		| (std::uint64_t(aProgram) & 0x3fff) << 48
+		| (std::uint64_t(aVao) & 0xffff) << 32
+		| std::uint64_t(depth) << 8
+	;
+}
+
+
+void RenderQueue::clear() noexcept
+{
+	mItems.clear();
+	mOrder.clear();
+}
+
+void RenderQueue::push( DrawItem const& aItem )
+{
+	mItems.emplace_back( aItem );
+}
+
+void RenderQueue::sort()
+{
+	mOrder.resize( mItems.size() );
+	for( std::size_t i = 0; i < mItems.size(); ++i )
+		mOrder[i] = Entry_{ mItems[i].key, std::uint32_t(i) };
+
+	if( mOrder.size() < kRadixSortThreshold_ )
+	{
+		// Stable, to match the radix sort's behaviour for equal keys.
+		std::stable_sort( mOrder.begin(), mOrder.end(), [] (Entry_ const& aX, Entry_ const& aY) {
+			return aX.key < aY.key;
+		} );
+	}
+	else
+	{
+		radix_sort_( mOrder, mScratch );
+	}
+}
+
+void RenderQueue::merge_sorted( std::span<RenderQueue const> aSorted )
+{
+	mItems.clear();
+	mOrder.clear();
+
+	// Cursor into each source queue. Sources are typically few (one per
+	// chunk of objects), so a binary heap over them is cheap.
+	struct Cursor_
+	{
+		std::uint64_t key;
+		std::size_t source, pos;
+		std::uint32_t base;
+	};
+
+	std::vector<Cursor_> heap;
+	heap.reserve( aSorted.size() );
+
+	std::size_t total = 0;
+	for( std::size_t i = 0; i < aSorted.size(); ++i )
+	{
+		auto const& source = aSorted[i];
+		assert( source.mOrder.size() == source.mItems.size() );
+
+		if( !source.mOrder.empty() )
+			heap.emplace_back( Cursor_{ source.mOrder.front().key, i, 0, std::uint32_t(total) } );
+
+		mItems.insert( mItems.end(), source.mItems.begin(), source.mItems.end() );
+		total += source.mItems.size();
+	}
+
+	// Min-heap on key. Ties are broken by source index, which keeps the
+	// merge stable.
+	auto const greater = [] (Cursor_ const& aX, Cursor_ const& aY) {
+		return aX.key != aY.key ? aX.key > aY.key : aX.source > aY.source;
+	};
+	std::make_heap( heap.begin(), heap.end(), greater );
+
+	mOrder.reserve( total );
+	while( !heap.empty() )
+	{
+		std::pop_heap( heap.begin(), heap.end(), greater );
+		auto& cursor = heap.back();
+
+		auto const& order = aSorted[cursor.source].mOrder;
+		mOrder.emplace_back( Entry_{ cursor.key, cursor.base + order[cursor.pos].item } );
+
+		if( ++cursor.pos < order.size() )
+		{
+			cursor.key = order[cursor.pos].key;
+			std::push_heap( heap.begin(), heap.end(), greater );
+		}
+		else
+		{
+			heap.pop_back();
+		}
+	}
+}
+
+RenderQueueStats RenderQueue::submit( GLStateCache& aState ) const
+{
+	assert( mOrder.size() == mItems.size() );
+
+	RenderQueueStats stats{};
+
+	for( auto const& entry : mOrder )
+	{
+		auto const& item = mItems[entry.item];
+
+		if( aState.use_program( item.program ) )
+			++stats.programBinds;
+		if( aState.bind_vertex_array( item.vao ) )
+			++stats.vaoBinds;
+
+		glDrawArraysInstancedBaseInstance( item.mode, item.first, item.count, 1, item.drawId );
+		++stats.draws;
+	}
+
+	return stats;
+}
+
+std::size_t RenderQueue::size() const noexcept
+{
+	return mItems.size();
+}
+
+namespace
+{
+	template< typename tEntry >
+	void radix_sort_( std::vector<tEntry>& aEntries, std::vector<tEntry>& aScratch )
+	{
+		// LSD radix sort, 8 bits per pass. The histograms for all passes are
+		// computed in a single sweep over the data. Passes where all keys
+		// have the same digit (very common for the upper bits, e.g. when
+		// there's only a single pass and few programs) are skipped.
+		constexpr std::size_t kPasses = 8;
+		constexpr std::size_t kBuckets = 256;
+
+		auto const count = aEntries.size();
+		if( 0 == count )
+			return;
+
+		aScratch.resize( count );
+
+		std::vector<std::size_t> histograms( kPasses * kBuckets, 0 );
+		for( auto const& entry : aEntries )
+		{
+			for( std::size_t pass = 0; pass < kPasses; ++pass )
+				++histograms[pass*kBuckets + ((entry.key >> (pass*8)) & 0xff)];
+		}
+
+		tEntry* src = aEntries.data();
+		tEntry* dst = aScratch.data();
+
+		for( std::size_t pass = 0; pass < kPasses; ++pass )
+		{
+			std::size_t* hist = histograms.data() + pass*kBuckets;
+
+			auto const shift = pass*8;
+			if( hist[(src[0].key >> shift) & 0xff] == count )
+				continue;
+
+			std::size_t offset = 0;
+			for( std::size_t i = 0; i < kBuckets; ++i )
+				offset += std::exchange( hist[i], offset );
+
+			for( std::size_t i = 0; i < count; ++i )
+				dst[hist[(src[i].key >> shift) & 0xff]++] = src[i];
+
+			std::swap( src, dst );
+		}
+
+		if( src != aEntries.data() )
+			aEntries.swap( aScratch );
+	}
+}
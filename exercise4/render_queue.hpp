@@ -0,0 +1,109 @@
+#ifndef RENDER_QUEUE_HPP_7D1A9C3E_52B8_4F0D_9E61_0C2F8B4A6D17
+#define RENDER_QUEUE_HPP_7D1A9C3E_52B8_4F0D_9E61_0C2F8B4A6D17
+
+#include <glad/glad.h>
+
+#include <span>
+#include <vector>
+
+#include <cstdint>
+#include <cstddef>
+
+#include "../support/gl_state.hpp"
+
+// Render queue
+//
+// Draws are collected as DrawItems, each tagged with a 64-bit sort key. The
+// queue sorts the items by key (radix sort) and then submits them in order.
+// State changes (program, VAO) go through a GLStateCache, so they are only
+// issued when the state actually differs from that of the previous draw.
+//
+// Per-draw data is not uploaded by the queue. Instead, each item carries a
+// draw ID, which is passed to the vertex shader through the base instance
+// (see DrawIdBuffer in support/uniform_ring.hpp). Shaders use it to index
+// per-object data in a shader storage buffer.
+//
+// Sort key layout (most significant bits first):
+//
+//   63..62  pass       RenderPass; passes are drawn in order
+//   61..48  program    (low bits of) the GL program name
+//   47..32  vao        (low bits of) the GL vertex array name
+//   31..8   depth      24-bit view depth; front-to-back for opaque passes,
+//                      back-to-front for the transparent pass
+//    7..0   reserved
+//
+// Sorting by program and VAO first groups draws that share state. Within a
+// group, opaque geometry is drawn front-to-back, so that early-Z rejects as
+// many hidden fragments as possible.
+enum class RenderPass : std::uint8_t
+{
+	opaque = 0,
+	transparent = 1,
+	overlay = 2
+};
+
+std::uint64_t make_sort_key( 
+	RenderPass aPass,
+	GLuint aProgram,
+	GLuint aVao,
+	float aDepth01 // view depth, normalized to [0,1]
+) noexcept;
+
+
+struct DrawItem
+{
+	std::uint64_t key;
+
+	GLuint program;
+	GLuint vao;
+
+	GLenum mode;
+	GLint first;
+	GLsizei count;
+
+	GLuint drawId;
+};
+
+// Number of GL calls issued by a RenderQueue::submit().
+struct RenderQueueStats
+{
+	std::size_t draws;
+	std::size_t programBinds;
+	std::size_t vaoBinds;
+};
+
+class RenderQueue final
+{
+	public:
+		RenderQueue() = default;
+
+	public:
+		void clear() noexcept;
+
+		void push( DrawItem const& );
+
+		void sort();
+
+		// Replaces the contents of this queue with the items of aSorted, in
+		// key order. Each queue in aSorted must have been sorted. The result
+		// is ready for submit().
+		void merge_sorted( std::span<RenderQueue const> aSorted );
+
+		// Requires sort(). Leaves the last program and VAO bound.
+		RenderQueueStats submit( GLStateCache& ) const;
+
+		std::size_t size() const noexcept;
+
+	private:
+		struct Entry_
+		{
+			std::uint64_t key;
+			std::uint32_t item;
+		};
+
+		std::vector<DrawItem> mItems;
+
+		std::vector<Entry_> mOrder, mScratch;
+};
+
+#endif // RENDER_QUEUE_HPP_7D1A9C3E_52B8_4F0D_9E61_0C2F8B4A6D17
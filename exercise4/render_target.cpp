@@ -0,0 +1,109 @@
+#include "render_target.hpp"
+
+#include "../support/error.hpp"
+#include "../support/checkpoint.hpp"
+
+RenderTarget::RenderTarget( int aWidth, int aHeight )
+	: mFramebuffer( 0 )
+	, mColor( 0 )
+	, mDepth( 0 )
+	, mWidth( aWidth )
+	, mHeight( aHeight )
+{
+	allocate_();
+}
+
+RenderTarget::~RenderTarget()
+{
+	release_();
+}
+
+void RenderTarget::resize( int aWidth, int aHeight )
+{
+	if( aWidth == mWidth && aHeight == mHeight )
+		return;
+
+	release_();
+
+	mWidth = aWidth;
+	mHeight = aHeight;
+	allocate_();
+}
+
+GLuint RenderTarget::framebufferId() const noexcept
+{
+	return mFramebuffer;
+}
+GLuint RenderTarget::colorTextureId() const noexcept
+{
+	return mColor;
+}
+GLuint RenderTarget::depthTextureId() const noexcept
+{
+	return mDepth;
+}
+
+int RenderTarget::width() const noexcept
+{
+	return mWidth;
+}
+int RenderTarget::height() const noexcept
+{
+	return mHeight;
+}
+
+void RenderTarget::allocate_()
+{
+	if( mWidth <= 0 || mHeight <= 0 )
+		throw Error( "RenderTarget: invalid size %dx%d", mWidth, mHeight );
+
+	OGL_CHECKPOINT_ALWAYS();
+
+	glGenTextures( 1, &mColor );
+	glBindTexture( GL_TEXTURE_2D, mColor );
+	glTexImage2D( GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, mWidth, mHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0 );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+	glBindTexture( GL_TEXTURE_2D, 0 );
+
+	glGenTextures( 1, &mDepth );
+	glBindTexture( GL_TEXTURE_2D, mDepth );
+	glTexImage2D( GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, mWidth, mHeight, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0 );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+	glBindTexture( GL_TEXTURE_2D, 0 );
+
+	glGenFramebuffers( 1, &mFramebuffer );
+	glBindFramebuffer( GL_FRAMEBUFFER, mFramebuffer );
+	glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mColor, 0 );
+	glFramebufferTexture2D( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, mDepth, 0 );
+
+	auto const status = glCheckFramebufferStatus( GL_FRAMEBUFFER );
+	glBindFramebuffer( GL_FRAMEBUFFER, 0 );
+
+	if( GL_FRAMEBUFFER_COMPLETE != status )
+	{
+		release_();
+		throw Error( "RenderTarget: framebuffer incomplete (status %#x) for %dx%d", status, mWidth, mHeight );
+	}
+
+	OGL_CHECKPOINT_ALWAYS();
+}
+
+void RenderTarget::release_() noexcept
+{
+	if( mFramebuffer )
+		glDeleteFramebuffers( 1, &mFramebuffer );
+	if( mDepth )
+		glDeleteTextures( 1, &mDepth );
+	if( mColor )
+		glDeleteTextures( 1, &mColor );
+
+	mFramebuffer = mDepth = mColor = 0;
+}
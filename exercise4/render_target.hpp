@@ -0,0 +1,44 @@
+#ifndef RENDER_TARGET_HPP_C4C4C982_1100_450B_B31F_ED114F447906
+#define RENDER_TARGET_HPP_C4C4C982_1100_450B_B31F_ED114F447906
+
+#include <glad/glad.h>
+
+// Offscreen render target: an sRGB color texture and a 24-bit depth texture
+// attached to a framebuffer object.
+//
+// Both attachments are textures (rather than renderbuffers), so that the
+// results can be sampled later (e.g., the depth buffer when building the
+// depth pyramid for occlusion culling).
+class RenderTarget final
+{
+	public:
+		RenderTarget( int aWidth, int aHeight );
+		~RenderTarget();
+
+		RenderTarget( RenderTarget const& ) = delete;
+		RenderTarget& operator= (RenderTarget const&) = delete;
+
+	public:
+		// Reallocates the attachments if the size differs from the current
+		// one. Contents are undefined afterwards.
+		void resize( int aWidth, int aHeight );
+
+		GLuint framebufferId() const noexcept;
+		GLuint colorTextureId() const noexcept;
+		GLuint depthTextureId() const noexcept;
+
+		int width() const noexcept;
+		int height() const noexcept;
+
+	private:
+		void allocate_();
+		void release_() noexcept;
+
+	private:
+		GLuint mFramebuffer;
+		GLuint mColor, mDepth;
+
+		int mWidth, mHeight;
+};
+
+#endif // RENDER_TARGET_HPP_C4C4C982_1100_450B_B31F_ED114F447906
@@ -0,0 +1,57 @@
+#ifndef SCENE_HPP_1D47C6C6_9BC6_4F08_BBBF_771F9A1D5CB0
+#define SCENE_HPP_1D47C6C6_9BC6_4F08_BBBF_771F9A1D5CB0
+
+#include <glad/glad.h>
+
+#include <cstdint>
+
+#include "simple_mesh.hpp"
+
+#include "../vmlib/vec3.hpp"
+#include "../vmlib/vec4.hpp"
+#include "../vmlib/mat44.hpp"
+
+// Shader data, see assets/ex4/default.vert. FrameUniforms is bound as the
+// uniform block at binding 0, and an array of ObjectUniforms (indexed by draw
+// ID) as the shader storage block at binding 1. Both are declared row_major
+// in the shader, so that Mat44f can be copied as is.
+struct FrameUniforms
+{
+	Mat44f projCamera;
+};
+struct ObjectUniforms
+{
+	Mat44f model2world;
+	Vec4f baseColor;
+};
+
+static_assert( sizeof(ObjectUniforms) == 80, "must match std430 layout of ObjectData" );
+
+
+// Mesh that has been uploaded to the GPU
+struct SceneMesh
+{
+	GLuint vao;
+	GLint first;
+	GLsizei count;
+
+	MeshBounds bounds; // object space
+};
+
+// Instance of a SceneMesh. The object's model-to-world transform is
+//
+//	translation(position) * rotation_y(spin * time) * scaling(scale)
+//
+// with time in seconds.
+struct SceneObject
+{
+	std::uint32_t mesh; // index into the scene's mesh array
+
+	Vec3f position;
+	float scale;
+	float spin; // radians per second
+
+	Vec4f baseColor;
+};
+
+#endif // SCENE_HPP_1D47C6C6_9BC6_4F08_BBBF_771F9A1D5CB0
@@ -1,5 +1,7 @@
 #include "simple_mesh.hpp"
 
+#include <algorithm>
+
 // Concatenate two SimpleMeshData objects
 SimpleMeshData concatenate(SimpleMeshData aM, SimpleMeshData const& aN)
 {
@@ -8,38 +10,48 @@ SimpleMeshData concatenate(SimpleMeshData aM, SimpleMeshData const& aN)
     return aM;
 }
 
+// Compute the axis-aligned bounding box of the mesh's positions
+MeshBounds compute_bounds(SimpleMeshData const& aMeshData)
+{
+    if (aMeshData.positions.empty())
+        return MeshBounds{ {0.f, 0.f, 0.f}, {0.f, 0.f, 0.f} };
+
+    MeshBounds ret{ aMeshData.positions.front(), aMeshData.positions.front() };
+    for (auto const& p : aMeshData.positions)
+    {
+        ret.min = Vec3f{ std::min(ret.min.x, p.x), std::min(ret.min.y, p.y), std::min(ret.min.z, p.z) };
+        ret.max = Vec3f{ std::max(ret.max.x, p.x), std::max(ret.max.y, p.y), std::max(ret.max.z, p.z) };
+    }
+    return ret;
+}
+
 // Create a VAO from SimpleMeshData
-GLuint create_vao(SimpleMeshData const& aMeshData)
+SimpleMeshBuffers create_vao(GpuResources& aResources, SimpleMeshData const& aMeshData)
 {
-    GLuint vao = 0;
-    GLuint positionVBO = 0;
-    GLuint colorVBO = 0;
+    SimpleMeshBuffers ret;
 
-    // Generate and bind the VAO
-    glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
-
-    // Generate and fill position VBO
-    glGenBuffers(1, &positionVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
-    glBufferData(
-        GL_ARRAY_BUFFER,
-        aMeshData.positions.size() * sizeof(Vec3f), // Size of position data
-        aMeshData.positions.data(),                // Pointer to position data
-        GL_STATIC_DRAW
+    // Generate and fill the VBOs. Their storage is immutable, and their size
+    // is accounted for by aResources.
+    ret.positions = aResources.create_buffer(
+        GpuMemoryCategory::vertex,
+        GLsizeiptr(aMeshData.positions.size() * sizeof(Vec3f)), // Size of position data
+        aMeshData.positions.data()                             // Pointer to position data
     );
+    ret.colors = aResources.create_buffer(
+        GpuMemoryCategory::vertex,
+        GLsizeiptr(aMeshData.colors.size() * sizeof(Vec3f)), // Size of color data
+        aMeshData.colors.data()                             // Pointer to color data
+    );
+
+    // Generate and bind the VAO
+    ret.vao = aResources.create_vertex_array();
+    glBindVertexArray(ret.vao.id());
+
+    glBindBuffer(GL_ARRAY_BUFFER, ret.positions.id());
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr); // Attribute location 0
     glEnableVertexAttribArray(0);
 
-    // Generate and fill color VBO
-    glGenBuffers(1, &colorVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, colorVBO);
-    glBufferData(
-        GL_ARRAY_BUFFER,
-        aMeshData.colors.size() * sizeof(Vec3f), // Size of color data
-        aMeshData.colors.data(),                // Pointer to color data
-        GL_STATIC_DRAW
-    );
+    glBindBuffer(GL_ARRAY_BUFFER, ret.colors.id());
     glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, nullptr); // Attribute location 1
     glEnableVertexAttribArray(1);
 
@@ -47,5 +59,5 @@ GLuint create_vao(SimpleMeshData const& aMeshData)
     glBindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-    return vao;
+    return ret;
 }
@@ -7,6 +7,8 @@
 
 #include "../vmlib/vec3.hpp"
 
+#include "../support/gpu_resources.hpp"
+
 struct SimpleMeshData
 {
 	std::vector<Vec3f> positions;
@@ -15,7 +17,23 @@ struct SimpleMeshData
 
 SimpleMeshData concatenate( SimpleMeshData, SimpleMeshData const& );
 
+// Axis-aligned bounding box
+struct MeshBounds
+{
+	Vec3f min, max;
+};
+
+MeshBounds compute_bounds( SimpleMeshData const& );
+
+
+// GPU copy of a SimpleMeshData: positions at attribute 0, colors at 1
+struct SimpleMeshBuffers
+{
+	GpuVertexArray vao;
+	GpuBuffer positions;
+	GpuBuffer colors;
+};
 
-GLuint create_vao( SimpleMeshData const& );
+SimpleMeshBuffers create_vao( GpuResources&, SimpleMeshData const& );
 
 #endif // SIMPLE_MESH_HPP_C6B749D6_C83B_434C_9E58_F05FC27FEFC9
@@ -0,0 +1,291 @@
+#include "simulation.hpp"
+
+#include <algorithm>
+#include <numbers>
+
+#include "../support/error.hpp"
+
+namespace
+{
+	constexpr float kMovementPerSecond_ = 5.f; // units per second
+	constexpr float kMouseSensitivity_ = 0.01f; // radians per pixel
+
+	constexpr float kMinRadius_ = 0.1f;
+
+	// If the simulation falls behind (e.g., the process was suspended), it
+	// runs at most this many ticks at once and drops the rest.
+	constexpr std::size_t kMaxCatchUpTicks_ = 8;
+
+	// While parked, wake up occasionally regardless. This only guards
+	// against missed wake-ups; push() normally wakes the thread.
+	constexpr auto kParkTimeout_ = std::chrono::milliseconds( 250 );
+
+	constexpr std::uint32_t kFresh_ = 4;
+	constexpr std::uint32_t kSlotMask_ = 3;
+
+	void look_( CameraState& aCamera, float aDx, float aDy ) noexcept
+	{
+		aCamera.phi += aDx * kMouseSensitivity_;
+		aCamera.theta = std::clamp(
+			aCamera.theta + aDy * kMouseSensitivity_,
+			-std::numbers::pi_v<float>/2.f,
+			std::numbers::pi_v<float>/2.f
+		);
+	}
+
+	SimState lerp_( SimState const& aA, SimState const& aB, float aT ) noexcept
+	{
+		auto const mix = [aT] (auto aX, auto aY) { return aX + (aY-aX) * decltype(aX)(aT); };
+		return SimState{
+			CameraState{
+				mix( aA.camera.phi, aB.camera.phi ),
+				mix( aA.camera.theta, aB.camera.theta ),
+				mix( aA.camera.radius, aB.camera.radius )
+			},
+			mix( aA.sceneTime, aB.sceneTime )
+		};
+	}
+}
+
+Simulation::Simulation( SimState const& aInitial, double aTickRateHz )
+	: mDropped( 0 )
+	, mPushed( 0 )
+	, mSampledInputs( 0 )
+	, mState( aInitial )
+	, mPrevious( aInitial )
+	, mZoomIn( false )
+	, mZoomOut( false )
+	, mInputs( 0 )
+	, mBack( 0 )
+	, mMiddle( 1 )
+	, mFront( 2 )
+	, mTicks( 0 )
+	, mQuit( false )
+	, mParkingAllowed( false )
+	, mParked( false )
+	, mWake( false )
+{
+	if( !(aTickRateHz > 0.0) )
+		throw Error( "Simulation: tick rate must be positive (got %f Hz)", aTickRateHz );
+
+	mTickLength = std::chrono::duration_cast<Clock::duration>( std::chrono::duration<double>( 1.0 / aTickRateHz ) );
+
+	auto const now = Clock::now();
+	mSnapshots.fill( Snapshot_{ aInitial, aInitial, now, 0 } );
+
+	mThread = std::thread( [this] { run_(); } );
+}
+
+Simulation::~Simulation()
+{
+	{
+		std::scoped_lock lock( mParkMutex );
+		mQuit.store( true, std::memory_order_relaxed );
+	}
+
+	mParkCv.notify_one();
+	mThread.join();
+}
+
+bool Simulation::push( InputEvent const& aEvent ) noexcept
+{
+	if( !mInput.try_push( aEvent ) )
+	{
+		++mDropped;
+		return false;
+	}
+
+	if( InputEvent::Type::look == aEvent.type )
+		mLooks.emplace_back( Look_{ mPushed, aEvent.dx, aEvent.dy } );
+
+	++mPushed;
+
+	// Pairs with the fence in park_(): either the simulation thread sees the
+	// new event before it sleeps, or we see that it is parked.
+	std::atomic_thread_fence( std::memory_order_seq_cst );
+	if( mParked.load( std::memory_order_relaxed ) )
+	{
+		{
+			std::scoped_lock lock( mParkMutex );
+			mWake = true;
+		}
+
+		mParkCv.notify_one();
+	}
+
+	return true;
+}
+
+SimState Simulation::sample( Clock::time_point aNow ) noexcept
+{
+	// The current state belongs to the time of its tick. Rendering one tick
+	// behind means that there is always a state on either side.
+	auto const& snapshot = latest_();
+	float const t = std::chrono::duration<float>( aNow - snapshot.currentTime ) / std::chrono::duration<float>( mTickLength );
+
+	// Look events are only kept for sample_latest() until a tick has
+	// processed them.
+	while( !mLooks.empty() && mLooks.front().sequence < snapshot.inputs )
+		mLooks.pop_front();
+
+	mSampledInputs = snapshot.inputs;
+	return lerp_( snapshot.previous, snapshot.current, std::clamp( t, 0.f, 1.f ) );
+}
+SimState Simulation::sample_latest( Clock::time_point aNow ) noexcept
+{
+	auto ret = sample( aNow );
+
+	// Replay the look events that the snapshot doesn't include yet, exactly
+	// like the next tick will. sample() has already picked up the latest
+	// snapshot and dropped the processed events.
+	auto const& snapshot = mSnapshots[mFront];
+	ret.camera.phi = snapshot.current.camera.phi;
+	ret.camera.theta = snapshot.current.camera.theta;
+
+	for( auto const& look : mLooks )
+		look_( ret.camera, look.dx, look.dy );
+
+	mSampledInputs = mPushed;
+	return ret;
+}
+
+std::uint64_t Simulation::sampled_inputs() const noexcept
+{
+	return mSampledInputs;
+}
+std::uint64_t Simulation::pushed() const noexcept
+{
+	return mPushed;
+}
+
+bool Simulation::settled() noexcept
+{
+	auto const& snapshot = latest_();
+	auto const& a = snapshot.previous.camera;
+	auto const& b = snapshot.current.camera;
+
+	return snapshot.inputs == mPushed && a.phi == b.phi && a.theta == b.theta && a.radius == b.radius;
+}
+
+void Simulation::set_parking_allowed( bool aAllowed ) noexcept
+{
+	mParkingAllowed.store( aAllowed, std::memory_order_relaxed );
+}
+
+std::uint64_t Simulation::ticks() const noexcept
+{
+	return mTicks.load( std::memory_order_relaxed );
+}
+std::size_t Simulation::dropped_events() const noexcept
+{
+	return mDropped;
+}
+
+void Simulation::run_()
+{
+	float const dt = std::chrono::duration<float>( mTickLength ).count();
+
+	auto next = Clock::now() + mTickLength;
+	while( !mQuit.load( std::memory_order_relaxed ) )
+	{
+		std::this_thread::sleep_until( next );
+
+		bool active = false;
+
+		auto const now = Clock::now();
+		for( std::size_t i = 0; i < kMaxCatchUpTicks_ && next <= now; ++i )
+		{
+			active = tick_( dt ) || active;
+			publish_( next );
+			next += mTickLength;
+		}
+
+		if( next <= now )
+			next = now + mTickLength;
+
+		// Nothing happened; the published snapshot already has identical
+		// previous and current states, so the renderer has settled too.
+		if( !active && mParkingAllowed.load( std::memory_order_relaxed ) )
+		{
+			park_();
+			next = Clock::now() + mTickLength;
+		}
+	}
+}
+
+bool Simulation::tick_( float aDt ) noexcept
+{
+	mPrevious = mState;
+
+	bool active = mZoomIn || mZoomOut;
+
+	InputEvent event;
+	while( mInput.try_pop( event ) )
+	{
+		active = true;
+		++mInputs;
+
+		switch( event.type )
+		{
+			case InputEvent::Type::zoomIn:
+				mZoomIn = event.pressed;
+				break;
+			case InputEvent::Type::zoomOut:
+				mZoomOut = event.pressed;
+				break;
+			case InputEvent::Type::look:
+				look_( mState.camera, event.dx, event.dy );
+				break;
+		}
+	}
+
+	auto& camera = mState.camera;
+	if( mZoomIn )
+		camera.radius -= kMovementPerSecond_ * aDt;
+	else if( mZoomOut )
+		camera.radius += kMovementPerSecond_ * aDt;
+
+	camera.radius = std::max( camera.radius, kMinRadius_ );
+
+	mState.sceneTime += double(aDt);
+
+	mTicks.fetch_add( 1, std::memory_order_relaxed );
+	return active;
+}
+
+void Simulation::publish_( Clock::time_point aTime ) noexcept
+{
+	mSnapshots[mBack] = Snapshot_{ mPrevious, mState, aTime, mInputs };
+	mBack = mMiddle.exchange( mBack | kFresh_, std::memory_order_acq_rel ) & kSlotMask_;
+}
+
+void Simulation::park_()
+{
+	std::unique_lock lock( mParkMutex );
+
+	mParked.store( true, std::memory_order_relaxed );
+	std::atomic_thread_fence( std::memory_order_seq_cst );
+
+	// Re-check for input that arrived before mParked was visible.
+	if( !mInput.empty() )
+	{
+		mParked.store( false, std::memory_order_relaxed );
+		return;
+	}
+
+	mParkCv.wait_for( lock, kParkTimeout_, [this] { 
+		return mWake || mQuit.load( std::memory_order_relaxed ); 
+	} );
+
+	mWake = false;
+	mParked.store( false, std::memory_order_relaxed );
+}
+
+Simulation::Snapshot_ const& Simulation::latest_() noexcept
+{
+	// Swap in the latest snapshot, if there is a new one.
+	if( mMiddle.load( std::memory_order_relaxed ) & kFresh_ )
+		mFront = mMiddle.exchange( mFront, std::memory_order_acq_rel ) & kSlotMask_;
+
+	return mSnapshots[mFront];
+}
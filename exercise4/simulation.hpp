@@ -0,0 +1,165 @@
+#ifndef SIMULATION_HPP_E2B7A94C_6D15_4F08_8C3A_91D4F0B7E256
+#define SIMULATION_HPP_E2B7A94C_6D15_4F08_8C3A_91D4F0B7E256
+
+#include <array>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "defaults.hpp"
+
+#include "../support/spsc_queue.hpp"
+
+struct CameraState
+{
+	float phi, theta;
+	float radius;
+};
+
+struct SimState
+{
+	CameraState camera;
+	double sceneTime; // drives the scene's animation
+};
+
+// Input, as sent from the GLFW callbacks (main thread) to the simulation
+struct InputEvent
+{
+	enum class Type : std::uint8_t
+	{
+		zoomIn,     // pressed = start/stop zooming in
+		zoomOut,    // pressed = start/stop zooming out
+		look        // dx, dy = cursor motion in pixels
+	};
+
+	Type type;
+	bool pressed;
+	float dx, dy;
+};
+
+// Fixed-step simulation thread
+//
+// The simulation advances the camera and the scene's animation at a fixed
+// tick rate on its own thread, independent of how long frames take to
+// render. Input reaches it through a lock-free SPSC queue. After each tick,
+// it publishes a snapshot with the previous and the current state. The
+// renderer picks up the latest snapshot and interpolates between the two
+// states, which hides the difference between the tick rate and the frame
+// rate.
+//
+// The snapshots are exchanged through three slots (writer, reader, and one
+// in between), so that neither side ever waits for the other.
+//
+// If parking is allowed, the thread stops ticking once a tick neither
+// received input nor moved the camera, and sleeps until the next push().
+// Time (and with it the scene's animation) does not advance while parked,
+// so this is only useful if nothing in the scene is animated.
+//
+// sample_latest() supports late latching of the camera: look input changes
+// the camera's orientation directly, so the main thread can apply the look
+// events that no tick has processed yet on top of the latest snapshot. The
+// camera then follows the cursor without waiting for the next tick, and
+// without the interpolation delay.
+//
+// push() and sample() must be called from the same thread (the main thread).
+class Simulation final
+{
+	public:
+		Simulation( SimState const& aInitial, double aTickRateHz );
+		~Simulation();
+
+		Simulation( Simulation const& ) = delete;
+		Simulation& operator= (Simulation const&) = delete;
+
+	public:
+		// Returns false (and drops the event) if the queue is full.
+		bool push( InputEvent const& ) noexcept;
+
+		// State at time aNow, interpolated between the latest two ticks.
+		SimState sample( Clock::time_point aNow ) noexcept;
+
+		// Like sample(), but the camera's orientation is the one after all
+		// look events pushed so far, including those that no tick has
+		// processed yet.
+		SimState sample_latest( Clock::time_point aNow ) noexcept;
+
+		// Number of events included in the state returned by the most recent
+		// sample() or sample_latest(). Events are numbered in the order they
+		// were pushed, starting at zero; see pushed().
+		std::uint64_t sampled_inputs() const noexcept;
+
+		// Number of events pushed so far (not counting dropped ones).
+		std::uint64_t pushed() const noexcept;
+
+		// True if the latest snapshot has processed all input pushed so far
+		// and the camera did not move in its tick. Ignores the scene time.
+		bool settled() noexcept;
+
+		void set_parking_allowed( bool ) noexcept;
+
+		std::uint64_t ticks() const noexcept;
+		std::size_t dropped_events() const noexcept;
+
+	private:
+		struct Snapshot_
+		{
+			SimState previous, current;
+			Clock::time_point currentTime;
+			std::uint64_t inputs; // events processed up to this tick
+		};
+
+		struct Look_
+		{
+			std::uint64_t sequence;
+			float dx, dy;
+		};
+
+		void run_();
+		bool tick_( float aDt ) noexcept;
+		void publish_( Clock::time_point ) noexcept;
+		void park_();
+
+		Snapshot_ const& latest_() noexcept;
+
+	private:
+		Clock::duration mTickLength;
+
+		SpscQueue<InputEvent, 1024> mInput;
+		std::size_t mDropped;
+		std::uint64_t mPushed; // main thread only
+
+		// Main thread only: look events that may not have been processed by
+		// a tick yet, for sample_latest().
+		std::deque<Look_> mLooks;
+		std::uint64_t mSampledInputs;
+
+		// Simulation thread only
+		SimState mState, mPrevious;
+		bool mZoomIn, mZoomOut;
+		std::uint64_t mInputs;
+		std::uint32_t mBack;
+
+		// Snapshot exchange. mMiddle holds a slot index and kFresh_ if that
+		// slot has not been picked up by the reader yet.
+		std::array<Snapshot_, 3> mSnapshots;
+		std::atomic<std::uint32_t> mMiddle;
+		std::uint32_t mFront; // main thread only
+
+		std::atomic<std::uint64_t> mTicks;
+		std::atomic<bool> mQuit;
+
+		// Parking
+		std::atomic<bool> mParkingAllowed, mParked;
+		std::mutex mParkMutex;
+		std::condition_variable mParkCv;
+		bool mWake;
+
+		std::thread mThread;
+};
+
+#endif // SIMULATION_HPP_E2B7A94C_6D15_4F08_8C3A_91D4F0B7E256
@@ -0,0 +1,566 @@
+#include "soft_raster.hpp"
+
+#include <array>
+#include <algorithm>
+
+#include <cmath>
+#include <cassert>
+
+#if defined(__AVX2__)
+#	include <immintrin.h>
+#endif
+
+#include <stb_image_write.h>
+
+#include "../support/error.hpp"
+
+namespace
+{
+	constexpr int kTileSize_ = 64; // pixels, must be a multiple of kSpan_
+	constexpr int kSpan_ = 8; // pixels per (vector) step
+
+	// Linear to sRGB conversion. The table is indexed with the linear value
+	// in [0, 1] scaled to kSrgbEntries_-1. 4096 entries are enough to get
+	// (within rounding) the same 8-bit results as the exact conversion.
+	constexpr std::size_t kSrgbEntries_ = 4096;
+
+	using SrgbTable_ = std::array<std::int32_t, kSrgbEntries_>;
+	SrgbTable_ const& srgb_table_();
+
+	std::uint32_t encode_( float aR, float aG, float aB ) noexcept;
+
+	struct Vertex_
+	{
+		Vec4f clip;
+		Vec3f color;
+	};
+
+	using Plane_ = SoftRasterizer::Plane_;
+	using Triangle_ = SoftRasterizer::Triangle_;
+
+	// Clips the triangle against the near plane (z >= -w). Returns the
+	// number of output vertices (0, 3 or 4).
+	std::size_t clip_near_( Vertex_ const (&aIn)[3], Vertex_ (&aOut)[4] ) noexcept;
+
+	// Returns false if the triangle is degenerate or covers no pixels.
+	bool setup_triangle_( Vertex_ const& aV0, Vertex_ const& aV1, Vertex_ const& aV2, int aWidth, int aHeight, Triangle_& aOut ) noexcept;
+
+	// Rasterizes the pixels [aX0, aX1] x [aY0, aY1] of a triangle. aX0 must
+	// be a multiple of kSpan_.
+#	if defined(__AVX2__)
+	void raster_avx2_( Triangle_ const&, int aX0, int aY0, int aX1, int aY1, std::uint32_t* aColor, float* aDepth, int aStride ) noexcept;
+#	else
+	void raster_scalar_( Triangle_ const&, int aX0, int aY0, int aX1, int aY1, std::uint32_t* aColor, float* aDepth, int aStride ) noexcept;
+#	endif
+}
+
+// SoftFramebuffer
+SoftFramebuffer::SoftFramebuffer( int aWidth, int aHeight )
+	: mWidth( aWidth )
+	, mHeight( aHeight )
+{
+	if( aWidth <= 0 || aHeight <= 0 )
+		throw Error( "SoftFramebuffer: invalid size %dx%d", aWidth, aHeight );
+
+	mStride = (aWidth + kTileSize_-1) / kTileSize_ * kTileSize_;
+	mRows = (aHeight + kTileSize_-1) / kTileSize_ * kTileSize_;
+
+	mColor.resize( std::size_t(mStride) * std::size_t(mRows) );
+	mDepth.resize( std::size_t(mStride) * std::size_t(mRows) );
+}
+
+void SoftFramebuffer::clear( Vec4f aColor, float aDepth )
+{
+	std::fill( mColor.begin(), mColor.end(), encode_( aColor.x, aColor.y, aColor.z ) );
+	std::fill( mDepth.begin(), mDepth.end(), aDepth );
+}
+
+int SoftFramebuffer::width() const noexcept
+{
+	return mWidth;
+}
+int SoftFramebuffer::height() const noexcept
+{
+	return mHeight;
+}
+
+void SoftFramebuffer::write_color_png( std::filesystem::path const& aPath ) const
+{
+	std::vector<std::uint8_t> pixels( std::size_t(mWidth) * std::size_t(mHeight) * 3 );
+
+	auto* out = pixels.data();
+	for( int y = mHeight; y-- > 0; )
+	{
+		auto const* row = mColor.data() + std::size_t(y) * std::size_t(mStride);
+		for( int x = 0; x < mWidth; ++x )
+		{
+			*out++ = std::uint8_t(row[x]);
+			*out++ = std::uint8_t(row[x] >> 8);
+			*out++ = std::uint8_t(row[x] >> 16);
+		}
+	}
+
+	if( !stbi_write_png( aPath.string().c_str(), mWidth, mHeight, 3, pixels.data(), mWidth*3 ) )
+		throw Error( "SoftFramebuffer: unable to write '%s'", aPath.string().c_str() );
+}
+
+void SoftFramebuffer::write_depth_png( std::filesystem::path const& aPath, float aNear, float aFar ) const
+{
+	std::vector<std::uint8_t> pixels( std::size_t(mWidth) * std::size_t(mHeight) );
+
+	auto* out = pixels.data();
+	for( int y = mHeight; y-- > 0; )
+	{
+		auto const* row = mDepth.data() + std::size_t(y) * std::size_t(mStride);
+		for( int x = 0; x < mWidth; ++x )
+		{
+			// Window depth -> view distance. Near is white, far is black.
+			float const ndc = 2.f * row[x] - 1.f;
+			float const dist = 2.f * aNear * aFar / (aFar + aNear - ndc * (aFar - aNear));
+			float const t = std::clamp( (dist - aNear) / (aFar - aNear), 0.f, 1.f );
+			*out++ = std::uint8_t(std::lround( 255.f * (1.f - t) ));
+		}
+	}
+
+	if( !stbi_write_png( aPath.string().c_str(), mWidth, mHeight, 1, pixels.data(), mWidth ) )
+		throw Error( "SoftFramebuffer: unable to write '%s'", aPath.string().c_str() );
+}
+
+// SoftRasterizer
+SoftRasterizer::SoftRasterizer( JobSystem& aJobs )
+	: mJobs( aJobs )
+	, mTriangleCount( 0 )
+	, mTilesX( 0 )
+	, mTilesY( 0 )
+{
+	mBins.resize( mJobs.thread_count() );
+}
+
+void SoftRasterizer::draw( SimpleMeshData const& aMesh, Mat44f const& aModel2Clip, Vec3f aTint )
+{
+	assert( aMesh.positions.size() == aMesh.colors.size() );
+
+	auto const triangles = aMesh.positions.size() / 3;
+	mDraws.emplace_back( Draw_{ &aMesh, aModel2Clip, aTint, mTriangleCount } );
+	mTriangleCount += triangles;
+}
+
+SoftRasterStats SoftRasterizer::render( SoftFramebuffer& aTarget )
+{
+	mTilesX = aTarget.mStride / kTileSize_;
+	mTilesY = aTarget.mRows / kTileSize_;
+
+	// Setup and binning. Each job gets a contiguous range of triangles.
+	mJobs.parallel_for( mBins.size(), [&] (std::size_t aRange, std::size_t) {
+		setup_( aRange, aTarget );
+	}, 1 );
+
+	// Rasterization, one tile at a time
+	mJobs.parallel_for( std::size_t(mTilesX) * std::size_t(mTilesY), [&] (std::size_t aTile, std::size_t) {
+		raster_tile_( aTile, aTarget );
+	}, 1 );
+
+	SoftRasterStats ret{ mTriangleCount, 0, 0 };
+	for( auto const& bins : mBins )
+	{
+		ret.culled += bins.culled;
+		ret.binned += bins.binned;
+	}
+
+	mDraws.clear();
+	mTriangleCount = 0;
+
+	return ret;
+}
+
+std::size_t SoftRasterizer::thread_count() const noexcept
+{
+	return mJobs.thread_count();
+}
+
+bool SoftRasterizer::uses_avx2() noexcept
+{
+#	if defined(__AVX2__)
+	return true;
+#	else
+	return false;
+#	endif
+}
+
+void SoftRasterizer::setup_( std::size_t aRange, SoftFramebuffer const& aTarget )
+{
+	auto& bins = mBins[aRange];
+
+	bins.triangles.clear();
+	bins.tiles.resize( std::size_t(mTilesX) * std::size_t(mTilesY) );
+	for( auto& tile : bins.tiles )
+		tile.clear();
+
+	bins.culled = 0;
+	bins.binned = 0;
+
+	auto const ranges = mBins.size();
+	auto const begin = mTriangleCount * aRange / ranges;
+	auto const end = mTriangleCount * (aRange+1) / ranges;
+
+	if( begin == end )
+		return;
+
+	// Find the draw containing the first triangle.
+	auto draw = std::upper_bound( mDraws.begin(), mDraws.end(), begin, [] (std::size_t aTriangle, Draw_ const& aDraw) {
+		return aTriangle < aDraw.firstTriangle;
+	} ) - 1;
+
+	auto const bin = [&] (Triangle_ const& aTriangle) {
+		auto const index = std::uint32_t(bins.triangles.size());
+		bins.triangles.emplace_back( aTriangle );
+
+		for( int ty = aTriangle.minY / kTileSize_; ty <= aTriangle.maxY / kTileSize_; ++ty )
+		{
+			for( int tx = aTriangle.minX / kTileSize_; tx <= aTriangle.maxX / kTileSize_; ++tx )
+			{
+				bins.tiles[std::size_t(ty) * std::size_t(mTilesX) + std::size_t(tx)].emplace_back( index );
+				++bins.binned;
+			}
+		}
+	};
+
+	for( auto i = begin; i < end; ++i )
+	{
+		while( i >= draw->firstTriangle + draw->mesh->positions.size()/3 )
+			++draw;
+
+		auto const& mesh = *draw->mesh;
+		auto const first = (i - draw->firstTriangle) * 3;
+
+		Vertex_ verts[3];
+		for( std::size_t j = 0; j < 3; ++j )
+		{
+			auto const& p = mesh.positions[first+j];
+			auto const& c = mesh.colors[first+j];
+
+			verts[j].clip = draw->model2clip * Vec4f{ p.x, p.y, p.z, 1.f };
+			verts[j].color = Vec3f{ c.x * draw->tint.x, c.y * draw->tint.y, c.z * draw->tint.z };
+		}
+
+		// Trivial reject: all vertices outside of the same frustum plane
+		bool outside = false;
+		for( std::size_t axis = 0; axis < 3 && !outside; ++axis )
+		{
+			bool allBelow = true, allAbove = true;
+			for( auto const& v : verts )
+			{
+				allBelow = allBelow && v.clip[axis] < -v.clip.w;
+				allAbove = allAbove && v.clip[axis] > v.clip.w;
+			}
+
+			outside = allBelow || allAbove;
+		}
+
+		if( outside )
+		{
+			++bins.culled;
+			continue;
+		}
+
+		Vertex_ clipped[4];
+		auto const count = clip_near_( verts, clipped );
+
+		bool any = false;
+		for( std::size_t j = 2; j < count; ++j )
+		{
+			Triangle_ tri;
+			if( setup_triangle_( clipped[0], clipped[j-1], clipped[j], aTarget.mWidth, aTarget.mHeight, tri ) )
+			{
+				bin( tri );
+				any = true;
+			}
+		}
+
+		if( !any )
+			++bins.culled;
+	}
+}
+
+void SoftRasterizer::raster_tile_( std::size_t aTile, SoftFramebuffer& aTarget )
+{
+	int const tileX0 = int(aTile % std::size_t(mTilesX)) * kTileSize_;
+	int const tileY0 = int(aTile / std::size_t(mTilesX)) * kTileSize_;
+
+	// Triangles are drawn in submission order: range 0 comes first.
+	for( auto const& bins : mBins )
+	{
+		for( auto const index : bins.tiles[aTile] )
+		{
+			auto const& tri = bins.triangles[index];
+
+			// Spans start at multiples of kSpan_. Pixels beyond the
+			// triangle's bounds fail the edge tests; pixels beyond the
+			// framebuffer's width land in the padding.
+			int const x0 = std::max( tri.minX, tileX0 ) & ~(kSpan_-1);
+			int const x1 = std::min( tri.maxX, tileX0 + kTileSize_-1 );
+			int const y0 = std::max( tri.minY, tileY0 );
+			int const y1 = std::min( tri.maxY, tileY0 + kTileSize_-1 );
+
+#			if defined(__AVX2__)
+			raster_avx2_( tri, x0, y0, x1, y1, aTarget.mColor.data(), aTarget.mDepth.data(), aTarget.mStride );
+#			else
+			raster_scalar_( tri, x0, y0, x1, y1, aTarget.mColor.data(), aTarget.mDepth.data(), aTarget.mStride );
+#			endif
+		}
+	}
+}
+
+namespace
+{
+	SrgbTable_ const& srgb_table_()
+	{
+		static SrgbTable_ const table = [] {
+			SrgbTable_ ret{};
+			for( std::size_t i = 0; i < kSrgbEntries_; ++i )
+			{
+				double const c = double(i) / double(kSrgbEntries_-1);
+				double const s = c <= 0.0031308 ? 12.92 * c : 1.055 * std::pow( c, 1.0/2.4 ) - 0.055;
+				ret[i] = std::int32_t(std::lround( 255.0 * s ));
+			}
+			return ret;
+		}();
+
+		return table;
+	}
+
+	std::int32_t srgb_lookup_( float aLinear ) noexcept
+	{
+		float const c = std::clamp( aLinear, 0.f, 1.f );
+		return srgb_table_()[std::size_t(std::lround( c * float(kSrgbEntries_-1) ))];
+	}
+
+	std::uint32_t encode_( float aR, float aG, float aB ) noexcept
+	{
+		return std::uint32_t(srgb_lookup_( aR ))
+			| std::uint32_t(srgb_lookup_( aG )) << 8
+			| std::uint32_t(srgb_lookup_( aB )) << 16
+			| 0xffu << 24
+		;
+	}
+
+	std::size_t clip_near_( Vertex_ const (&aIn)[3], Vertex_ (&aOut)[4] ) noexcept
+	{
+		// Sutherland-Hodgman against a single plane. Distance to the plane
+		// is z + w (>= 0 inside).
+		std::size_t count = 0;
+		for( std::size_t i = 0; i < 3; ++i )
+		{
+			auto const& a = aIn[i];
+			auto const& b = aIn[(i+1) % 3];
+
+			float const da = a.clip.z + a.clip.w;
+			float const db = b.clip.z + b.clip.w;
+
+			if( da >= 0.f )
+				aOut[count++] = a;
+
+			if( (da >= 0.f) != (db >= 0.f) )
+			{
+				float const t = da / (da - db);
+				aOut[count++] = Vertex_{
+					a.clip + t * (b.clip - a.clip),
+					a.color + t * (b.color - a.color)
+				};
+			}
+		}
+
+		return count;
+	}
+
+	bool setup_triangle_( Vertex_ const& aV0, Vertex_ const& aV1, Vertex_ const& aV2, int aWidth, int aHeight, Triangle_& aOut ) noexcept
+	{
+		Vertex_ const* const verts[3] = { &aV0, &aV1, &aV2 };
+
+		// Viewport transform. As in GL, y points up and pixel centers are at
+		// half-integer coordinates.
+		float x[3], y[3], z[3], invW[3];
+		for( std::size_t i = 0; i < 3; ++i )
+		{
+			auto const& c = verts[i]->clip;
+			if( !(c.w > 0.f) )
+				return false;
+
+			invW[i] = 1.f / c.w;
+			x[i] = (c.x * invW[i] * 0.5f + 0.5f) * float(aWidth);
+			y[i] = (c.y * invW[i] * 0.5f + 0.5f) * float(aHeight);
+			z[i] = c.z * invW[i] * 0.5f + 0.5f;
+		}
+
+		float const area = (x[1]-x[0]) * (y[2]-y[0]) - (x[2]-x[0]) * (y[1]-y[0]);
+		if( !(std::abs( area ) > 1e-8f) )
+			return false;
+
+		// Bounds, clamped to the framebuffer. Pixel (i, j) is covered if its
+		// center (i+0.5, j+0.5) is inside.
+		float const minX = std::min( { x[0], x[1], x[2] } );
+		float const maxX = std::max( { x[0], x[1], x[2] } );
+		float const minY = std::min( { y[0], y[1], y[2] } );
+		float const maxY = std::max( { y[0], y[1], y[2] } );
+
+		aOut.minX = std::max( 0, int(std::floor( std::max( minX - 0.5f, -1.f ) )) );
+		aOut.maxX = std::min( aWidth-1, int(std::ceil( std::min( maxX - 0.5f, float(aWidth) ) )) );
+		aOut.minY = std::max( 0, int(std::floor( std::max( minY - 0.5f, -1.f ) )) );
+		aOut.maxY = std::min( aHeight-1, int(std::ceil( std::min( maxY - 0.5f, float(aHeight) ) )) );
+
+		if( aOut.minX > aOut.maxX || aOut.minY > aOut.maxY )
+			return false;
+
+		// Edge i is opposite of vertex i. Dividing by the signed area yields
+		// barycentric coordinates, positive inside for either winding.
+		float const invArea = 1.f / area;
+		for( std::size_t i = 0; i < 3; ++i )
+		{
+			auto const j = (i+1) % 3, k = (i+2) % 3;
+			aOut.edge[i] = Plane_{
+				(y[j] - y[k]) * invArea,
+				(x[k] - x[j]) * invArea,
+				(x[j] * y[k] - x[k] * y[j]) * invArea
+			};
+		}
+
+		auto const interpolate = [&] (float aA, float aB, float aC) {
+			auto const& e = aOut.edge;
+			return Plane_{
+				e[0].a * aA + e[1].a * aB + e[2].a * aC,
+				e[0].b * aA + e[1].b * aB + e[2].b * aC,
+				e[0].c * aA + e[1].c * aB + e[2].c * aC
+			};
+		};
+
+		aOut.depth = interpolate( z[0], z[1], z[2] );
+		aOut.invW = interpolate( invW[0], invW[1], invW[2] );
+
+		for( std::size_t i = 0; i < 3; ++i )
+		{
+			aOut.color[i] = interpolate(
+				aV0.color[i] * invW[0],
+				aV1.color[i] * invW[1],
+				aV2.color[i] * invW[2]
+			);
+		}
+
+		return true;
+	}
+
+#	if defined(__AVX2__)
+	void raster_avx2_( Triangle_ const& aTri, int aX0, int aY0, int aX1, int aY1, std::uint32_t* aColor, float* aDepth, int aStride ) noexcept
+	{
+		static_assert( 8 == kSpan_ );
+
+		auto const* table = srgb_table_().data();
+
+		__m256 const offsets = _mm256_setr_ps( 0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f );
+		__m256 const zero = _mm256_setzero_ps();
+		__m256 const one = _mm256_set1_ps( 1.f );
+		__m256 const tableScale = _mm256_set1_ps( float(kSrgbEntries_-1) );
+		__m256i const alpha = _mm256_set1_epi32( std::int32_t(0xff000000u) );
+
+		// Plane coefficients: a is per pixel, b*y + c per row.
+		Plane_ const* const planes[] = {
+			&aTri.edge[0], &aTri.edge[1], &aTri.edge[2],
+			&aTri.depth, &aTri.invW,
+			&aTri.color[0], &aTri.color[1], &aTri.color[2]
+		};
+		constexpr std::size_t kPlanes = std::size(planes);
+
+		__m256 a[kPlanes];
+		for( std::size_t i = 0; i < kPlanes; ++i )
+			a[i] = _mm256_set1_ps( planes[i]->a );
+
+		auto const encode = [&] (__m256 aLinear) {
+			__m256 const c = _mm256_min_ps( _mm256_max_ps( aLinear, zero ), one );
+			__m256i const index = _mm256_cvtps_epi32( _mm256_mul_ps( c, tableScale ) );
+			return _mm256_i32gather_epi32( table, index, 4 );
+		};
+
+		for( int y = aY0; y <= aY1; ++y )
+		{
+			float const py = float(y) + 0.5f;
+			auto const row = std::size_t(y) * std::size_t(aStride);
+
+			__m256 rowC[kPlanes];
+			for( std::size_t i = 0; i < kPlanes; ++i )
+				rowC[i] = _mm256_set1_ps( planes[i]->b * py + planes[i]->c );
+
+			for( int x = aX0; x <= aX1; x += kSpan_ )
+			{
+				__m256 const px = _mm256_add_ps( _mm256_set1_ps( float(x) ), offsets );
+				auto const eval = [&] (std::size_t aPlane) {
+					return _mm256_add_ps( _mm256_mul_ps( a[aPlane], px ), rowC[aPlane] );
+				};
+
+				__m256 inside = _mm256_cmp_ps( eval( 0 ), zero, _CMP_GE_OQ );
+				inside = _mm256_and_ps( inside, _mm256_cmp_ps( eval( 1 ), zero, _CMP_GE_OQ ) );
+				inside = _mm256_and_ps( inside, _mm256_cmp_ps( eval( 2 ), zero, _CMP_GE_OQ ) );
+
+				if( 0 == _mm256_movemask_ps( inside ) )
+					continue;
+
+				float* const depth = aDepth + row + std::size_t(x);
+				__m256 const z = eval( 3 );
+				__m256 const oldZ = _mm256_loadu_ps( depth );
+
+				__m256 const pass = _mm256_and_ps( inside, _mm256_cmp_ps( z, oldZ, _CMP_LT_OQ ) );
+				if( 0 == _mm256_movemask_ps( pass ) )
+					continue;
+
+				_mm256_storeu_ps( depth, _mm256_blendv_ps( oldZ, z, pass ) );
+
+				__m256 const w = _mm256_div_ps( one, eval( 4 ) );
+				__m256i const r = encode( _mm256_mul_ps( eval( 5 ), w ) );
+				__m256i const g = encode( _mm256_mul_ps( eval( 6 ), w ) );
+				__m256i const b = encode( _mm256_mul_ps( eval( 7 ), w ) );
+
+				__m256i const rgba = _mm256_or_si256(
+					_mm256_or_si256( r, _mm256_slli_epi32( g, 8 ) ),
+					_mm256_or_si256( _mm256_slli_epi32( b, 16 ), alpha )
+				);
+
+				auto* const color = reinterpret_cast<__m256i*>(aColor + row + std::size_t(x));
+				__m256i const oldColor = _mm256_loadu_si256( color );
+				_mm256_storeu_si256( color, _mm256_blendv_epi8( oldColor, rgba, _mm256_castps_si256( pass ) ) );
+			}
+		}
+	}
+#	else // !__AVX2__
+	void raster_scalar_( Triangle_ const& aTri, int aX0, int aY0, int aX1, int aY1, std::uint32_t* aColor, float* aDepth, int aStride ) noexcept
+	{
+		auto const eval = [] (Plane_ const& aPlane, float aX, float aY) {
+			return aPlane.a * aX + aPlane.b * aY + aPlane.c;
+		};
+
+		for( int y = aY0; y <= aY1; ++y )
+		{
+			float const py = float(y) + 0.5f;
+			auto const row = std::size_t(y) * std::size_t(aStride);
+
+			for( int x = aX0; x <= aX1; ++x )
+			{
+				float const px = float(x) + 0.5f;
+
+				if( eval( aTri.edge[0], px, py ) < 0.f || eval( aTri.edge[1], px, py ) < 0.f || eval( aTri.edge[2], px, py ) < 0.f )
+					continue;
+
+				float const z = eval( aTri.depth, px, py );
+				if( !(z < aDepth[row + std::size_t(x)]) )
+					continue;
+
+				float const w = 1.f / eval( aTri.invW, px, py );
+
+				aDepth[row + std::size_t(x)] = z;
+				aColor[row + std::size_t(x)] = encode_(
+					eval( aTri.color[0], px, py ) * w,
+					eval( aTri.color[1], px, py ) * w,
+					eval( aTri.color[2], px, py ) * w
+				);
+			}
+		}
+	}
+#	endif // ~ __AVX2__
+}
@@ -0,0 +1,170 @@
+#ifndef SOFT_RASTER_HPP_5B8E0C47_93A1_4D26_B7F2_0E6C1A94D358
+#define SOFT_RASTER_HPP_5B8E0C47_93A1_4D26_B7F2_0E6C1A94D358
+
+#include <vector>
+#include <filesystem>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "simple_mesh.hpp"
+
+#include "../support/job_system.hpp"
+
+#include "../vmlib/vec3.hpp"
+#include "../vmlib/vec4.hpp"
+#include "../vmlib/mat44.hpp"
+
+// Software rendering mode
+//
+// Enabled with --software. The scene is rendered along the benchmark's camera
+// path by SoftRasterizer, without creating a window or an OpenGL context. The
+// last frame is written to path (color) and to path with the extension
+// replaced by .depth.png (depth). See options.hpp for the command line
+// options.
+struct SoftwareConfig
+{
+	bool enabled = false;
+
+	std::filesystem::path path;
+
+	int width = 1920;
+	int height = 1080;
+
+	std::size_t frames = 1;
+};
+
+
+// Color and depth buffer for the software rasterizer
+//
+// Like the default framebuffer, row 0 is the bottom row. Colors are stored as
+// sRGB-encoded RGBA8 (as with GL_FRAMEBUFFER_SRGB), depth as floats in
+// [0, 1]. Internally, both buffers are padded to a whole number of tiles.
+class SoftFramebuffer final
+{
+	public:
+		SoftFramebuffer( int aWidth, int aHeight );
+
+	public:
+		// aColor is linear, as passed to glClearColor().
+		void clear( Vec4f aColor, float aDepth = 1.f );
+
+		int width() const noexcept;
+		int height() const noexcept;
+
+		// Writes the color buffer as PNG (RGB, top row first).
+		void write_color_png( std::filesystem::path const& ) const;
+
+		// Writes the depth buffer as an 8-bit grayscale PNG. Depth is
+		// linearized with the given near and far planes, so that the image
+		// isn't almost entirely white.
+		void write_depth_png( std::filesystem::path const&, float aNear, float aFar ) const;
+
+	private:
+		friend class SoftRasterizer;
+
+		int mWidth, mHeight;
+		int mStride, mRows; // padded size
+
+		std::vector<std::uint32_t> mColor;
+		std::vector<float> mDepth;
+};
+
+struct SoftRasterStats
+{
+	std::size_t triangles; // submitted
+	std::size_t culled; // outside of the frustum or degenerate
+	std::size_t binned; // triangle-tile pairs
+};
+
+// Tiled software rasterizer
+//
+// Renders SimpleMeshData the same way as assets/ex4/default.vert/.frag:
+// positions are transformed by a model-to-clip matrix, and vertex colors are
+// multiplied by a per-draw tint and interpolated perspective-correctly.
+// Depth testing uses GL_LESS. There is no face culling.
+//
+// render() works in two parallel phases:
+//  1. Setup: the triangles are split into one contiguous range per thread
+//     of the job system. Each range's job transforms its triangles, clips them against the near
+//     plane, computes edge functions and interpolation planes, and bins the
+//     results into per-range lists for each 64x64 pixel tile.
+//  2. Raster: one job per tile. Each tile visits the per-range lists in
+//     order, so triangles are drawn in submission order
+//     and the result does not depend on the thread count.
+//
+// Tiles are rasterized in spans of 8 pixels. With AVX2 (e.g., with
+// -march=native on a supporting CPU), each span is one set of 8-wide vector
+// operations; otherwise, a scalar fallback is used.
+//
+// Edges are inclusive (no top-left rule). Shared edges may thus be drawn
+// twice, which makes no difference with opaque, depth-tested geometry.
+class SoftRasterizer final
+{
+	public:
+		explicit SoftRasterizer( JobSystem& );
+
+		SoftRasterizer( SoftRasterizer const& ) = delete;
+		SoftRasterizer& operator= (SoftRasterizer const&) = delete;
+
+	public:
+		// Queues a mesh for drawing. The mesh must stay alive until render().
+		void draw( SimpleMeshData const&, Mat44f const& aModel2Clip, Vec3f aTint );
+
+		// Draws all queued meshes into aTarget and clears the queue.
+		SoftRasterStats render( SoftFramebuffer& aTarget );
+
+		std::size_t thread_count() const noexcept;
+
+		static bool uses_avx2() noexcept;
+
+	public:
+		// Interpolation plane: value(x, y) = a*x + b*y + c
+		struct Plane_
+		{
+			float a, b, c;
+		};
+
+		// A triangle after setup. Edge functions are normalized to
+		// barycentric coordinates (inside if all three are >= 0).
+		struct Triangle_
+		{
+			Plane_ edge[3];
+			Plane_ depth;
+			Plane_ invW;
+			Plane_ color[3]; // color / w
+
+			int minX, minY, maxX, maxY; // inclusive pixel bounds
+		};
+
+	private:
+		struct Draw_
+		{
+			SimpleMeshData const* mesh;
+			Mat44f model2clip;
+			Vec3f tint;
+			std::size_t firstTriangle;
+		};
+
+		void setup_( std::size_t aRange, SoftFramebuffer const& );
+		void raster_tile_( std::size_t aTile, SoftFramebuffer& );
+
+	private:
+		JobSystem& mJobs;
+
+		std::vector<Draw_> mDraws;
+		std::size_t mTriangleCount;
+
+		// Per setup range
+		struct Bins_
+		{
+			std::vector<Triangle_> triangles;
+			std::vector<std::vector<std::uint32_t>> tiles;
+			std::size_t culled, binned;
+		};
+
+		std::vector<Bins_> mBins;
+		int mTilesX, mTilesY;
+};
+
+#endif // SOFT_RASTER_HPP_5B8E0C47_93A1_4D26_B7F2_0E6C1A94D358
@@ -0,0 +1,444 @@
+#include "texture_cook.hpp"
+
+#include <array>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <thread>
+#include <algorithm>
+#include <functional>
+#include <system_error>
+
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+
+#if defined(__SSE2__)
+#	include <immintrin.h>
+#endif
+
+#include "../support/error.hpp"
+
+namespace
+{
+	// File layout: header, followed by header.bytes bytes of pixel data
+	// (TextureImage::pixels).
+	constexpr std::uint32_t kMagic_ = 0x58455458; // "XTEX"
+	constexpr std::uint32_t kVersion_ = 1;
+
+	struct FileHeader_
+	{
+		std::uint32_t magic, version;
+		std::uint64_t key;
+
+		std::uint32_t width, height, levels;
+		std::uint8_t colorSpace;
+		std::uint8_t reserved[3];
+
+		std::uint64_t bytes;
+	};
+
+	static_assert( sizeof(FileHeader_) == 40 );
+
+	struct FileCloser_
+	{
+		void operator()( std::FILE* aFile ) const noexcept { std::fclose( aFile ); }
+	};
+
+	using File_ = std::unique_ptr<std::FILE, FileCloser_>;
+
+	// Conversion tables
+	constexpr std::size_t kEncodeSteps_ = 4096; // linear -> sRGB
+
+	struct Tables_
+	{
+		float srgbToLinear[256];
+		std::uint8_t linearToSrgb[kEncodeSteps_];
+	};
+
+	Tables_ const& tables_();
+
+	// One RGBA pixel of floats. With SSE, this is a single register.
+#	if defined(__SSE2__)
+	using Pixel_ = __m128;
+
+	inline Pixel_ pixel_zero_() noexcept { return _mm_setzero_ps(); }
+	inline Pixel_ pixel_load_( float const* aSrc ) noexcept { return _mm_loadu_ps( aSrc ); }
+	inline void pixel_store_( float* aDst, Pixel_ aPixel ) noexcept { _mm_storeu_ps( aDst, aPixel ); }
+
+	inline Pixel_ pixel_madd_( Pixel_ aAcc, float aWeight, Pixel_ aPixel ) noexcept
+	{
+		return _mm_add_ps( aAcc, _mm_mul_ps( _mm_set1_ps( aWeight ), aPixel ) );
+	}
+#	else // !__SSE2__
+	struct Pixel_
+	{
+		float v[4];
+	};
+
+	inline Pixel_ pixel_zero_() noexcept { return Pixel_{}; }
+	inline Pixel_ pixel_load_( float const* aSrc ) noexcept { Pixel_ ret; std::memcpy( ret.v, aSrc, sizeof(ret.v) ); return ret; }
+	inline void pixel_store_( float* aDst, Pixel_ aPixel ) noexcept { std::memcpy( aDst, aPixel.v, sizeof(aPixel.v) ); }
+
+	inline Pixel_ pixel_madd_( Pixel_ aAcc, float aWeight, Pixel_ aPixel ) noexcept
+	{
+		for( int i = 0; i < 4; ++i )
+			aAcc.v[i] += aWeight * aPixel.v[i];
+		return aAcc;
+	}
+#	endif // ~ __SSE2__
+
+	// Separable 2:1 downsampling kernel. Output pixel x covers source pixels
+	// 2x+first ... 2x+first+taps-1.
+	constexpr int kMaxTaps_ = 8;
+
+	struct Kernel_
+	{
+		int taps;
+		int first;
+		float weights[kMaxTaps_];
+	};
+
+	Kernel_ make_kernel_( MipFilter );
+
+	// Rows are converted to linear, premultiplied floats for filtering.
+	void decode_row_( std::uint8_t const* aSrc, std::uint32_t aWidth, TextureColorSpace, float* aOut ) noexcept;
+	void encode_row_( float const* aSrc, std::uint32_t aWidth, TextureColorSpace, std::uint8_t* aOut ) noexcept;
+
+	// Computes the level below aSource. aSourceBytes is used if aSource is
+	// empty (the finest level, which is never converted as a whole).
+	void downsample_(
+		Kernel_ const&,
+		TextureColorSpace,
+		std::uint32_t aSrcWidth, std::uint32_t aSrcHeight,
+		std::vector<float> const& aSource, std::uint8_t const* aSourceBytes,
+		std::uint32_t aDstWidth, std::uint32_t aDstHeight,
+		std::vector<float>* aDest, std::uint8_t* aDestBytes
+	);
+}
+
+std::uint32_t mip_level_count( std::uint32_t aWidth, std::uint32_t aHeight ) noexcept
+{
+	std::uint32_t levels = 1;
+	for( auto size = std::max( aWidth, aHeight ); size > 1; size >>= 1 )
+		++levels;
+	return levels;
+}
+
+std::uint32_t mip_extent( std::uint32_t aSize, std::uint32_t aLevel ) noexcept
+{
+	return std::max<std::uint32_t>( 1, aSize >> aLevel );
+}
+
+std::size_t mip_offset( std::uint32_t aWidth, std::uint32_t aHeight, std::uint32_t aLevel ) noexcept
+{
+	std::size_t offset = 0;
+	for( std::uint32_t level = 0; level < aLevel; ++level )
+		offset += std::size_t(mip_extent( aWidth, level )) * mip_extent( aHeight, level ) * kTextureBytesPerPixel;
+	return offset;
+}
+
+TextureImage build_mip_chain( std::uint8_t const* aPixels, std::uint32_t aWidth, std::uint32_t aHeight, TextureColorSpace aColorSpace, MipFilter aFilter )
+{
+	assert( aPixels && aWidth && aHeight );
+
+	TextureImage ret{};
+	ret.width = aWidth;
+	ret.height = aHeight;
+	ret.levels = mip_level_count( aWidth, aHeight );
+	ret.colorSpace = aColorSpace;
+	ret.pixels.resize( mip_offset( aWidth, aHeight, ret.levels ) );
+
+	// Level 0, flipped to bottom-up
+	auto const rowBytes = std::size_t(aWidth) * kTextureBytesPerPixel;
+	for( std::uint32_t y = 0; y < aHeight; ++y )
+		std::memcpy( ret.pixels.data() + y*rowBytes, aPixels + (aHeight-1-y)*rowBytes, rowBytes );
+
+	auto const kernel = make_kernel_( aFilter );
+
+	std::vector<float> source, dest;
+	for( std::uint32_t level = 1; level < ret.levels; ++level )
+	{
+		bool const last = level+1 == ret.levels;
+
+		downsample_(
+			kernel, aColorSpace,
+			mip_extent( aWidth, level-1 ), mip_extent( aHeight, level-1 ),
+			source, ret.pixels.data() + mip_offset( aWidth, aHeight, level-1 ),
+			mip_extent( aWidth, level ), mip_extent( aHeight, level ),
+			last ? nullptr : &dest, ret.pixels.data() + mip_offset( aWidth, aHeight, level )
+		);
+
+		std::swap( source, dest );
+	}
+
+	return ret;
+}
+
+bool read_cooked_texture( std::filesystem::path const& aPath, std::uint64_t aKey, TextureImage& aOut )
+{
+	File_ file( std::fopen( aPath.string().c_str(), "rb" ) );
+	if( !file )
+		return false;
+
+	FileHeader_ header{};
+	if( 1 != std::fread( &header, sizeof(header), 1, file.get() ) )
+		return false;
+
+	if( kMagic_ != header.magic || kVersion_ != header.version || aKey != header.key )
+		return false;
+
+	if( 0 == header.width || 0 == header.height || header.levels != mip_level_count( header.width, header.height ) || header.colorSpace > std::uint8_t(TextureColorSpace::linear) )
+		throw Error( "'%s': malformed cooked texture", aPath.string().c_str() );
+
+	auto const bytes = mip_offset( header.width, header.height, header.levels );
+	if( bytes != header.bytes )
+		throw Error( "'%s': malformed cooked texture (%llu bytes, expected %zu)", aPath.string().c_str(), static_cast<unsigned long long>(header.bytes), bytes );
+
+	aOut.width = header.width;
+	aOut.height = header.height;
+	aOut.levels = header.levels;
+	aOut.colorSpace = TextureColorSpace(header.colorSpace);
+	aOut.pixels.resize( bytes );
+
+	if( bytes != std::fread( aOut.pixels.data(), 1, bytes, file.get() ) )
+		throw Error( "'%s': cooked texture is truncated", aPath.string().c_str() );
+
+	return true;
+}
+
+void write_cooked_texture( std::filesystem::path const& aPath, std::uint64_t aKey, TextureImage const& aImage )
+{
+	assert( aImage.pixels.size() == mip_offset( aImage.width, aImage.height, aImage.levels ) );
+
+	// Several threads may cook the same texture.
+	auto temp = aPath;
+	temp += ".tmp" + std::to_string( std::hash<std::thread::id>{}( std::this_thread::get_id() ) );
+
+	FileHeader_ header{};
+	header.magic = kMagic_;
+	header.version = kVersion_;
+	header.key = aKey;
+	header.width = aImage.width;
+	header.height = aImage.height;
+	header.levels = aImage.levels;
+	header.colorSpace = std::uint8_t(aImage.colorSpace);
+	header.bytes = aImage.pixels.size();
+
+	{
+		File_ file( std::fopen( temp.string().c_str(), "wb" ) );
+		if( !file )
+			throw Error( "Unable to open '%s' for writing", temp.string().c_str() );
+
+		bool ok = 1 == std::fwrite( &header, sizeof(header), 1, file.get() );
+		ok = ok && aImage.pixels.size() == std::fwrite( aImage.pixels.data(), 1, aImage.pixels.size(), file.get() );
+		ok = 0 == std::fclose( file.release() ) && ok;
+
+		if( !ok )
+		{
+			std::error_code ec;
+			std::filesystem::remove( temp, ec );
+			throw Error( "Unable to write '%s'", temp.string().c_str() );
+		}
+	}
+
+	std::error_code ec;
+	std::filesystem::rename( temp, aPath, ec );
+	if( ec )
+	{
+		std::filesystem::remove( temp, ec );
+		throw Error( "Unable to rename '%s' to '%s': %s", temp.string().c_str(), aPath.string().c_str(), ec.message().c_str() );
+	}
+}
+
+namespace
+{
+	Tables_ const& tables_()
+	{
+		static Tables_ const tables = [] {
+			Tables_ ret{};
+			for( int i = 0; i < 256; ++i )
+			{
+				float const c = float(i) / 255.f;
+				ret.srgbToLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow( (c + 0.055f) / 1.055f, 2.4f );
+			}
+			for( std::size_t i = 0; i < kEncodeSteps_; ++i )
+			{
+				float const l = float(i) / float(kEncodeSteps_-1);
+				float const c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow( l, 1.f/2.4f ) - 0.055f;
+				ret.linearToSrgb[i] = std::uint8_t(std::clamp( c, 0.f, 1.f ) * 255.f + 0.5f);
+			}
+			return ret;
+		}();
+
+		return tables;
+	}
+
+	float bessel_i0_( float aX ) noexcept
+	{
+		// Power series; converges quickly for the small arguments used here.
+		float sum = 1.f, term = 1.f;
+		for( int k = 1; k < 20; ++k )
+		{
+			term *= (aX / (2.f * float(k))) * (aX / (2.f * float(k)));
+			sum += term;
+		}
+		return sum;
+	}
+
+	Kernel_ make_kernel_( MipFilter aFilter )
+	{
+		Kernel_ ret{};
+
+		if( MipFilter::box == aFilter )
+		{
+			ret.taps = 2;
+			ret.first = 0;
+			ret.weights[0] = ret.weights[1] = 0.5f;
+			return ret;
+		}
+
+		// Sinc at the output's Nyquist frequency, windowed over two output
+		// pixels on either side (= eight source pixels).
+		constexpr float kPi = 3.14159265358979f;
+		constexpr float kAlpha = 4.f; // window shape
+		constexpr float kRadius = 2.f; // in output pixels
+
+		ret.taps = kMaxTaps_;
+		ret.first = -(kMaxTaps_/2 - 1);
+
+		float sum = 0.f;
+		for( int i = 0; i < kMaxTaps_; ++i )
+		{
+			// Distance from the output pixel's center, in output pixels.
+			float const t = (float(i - kMaxTaps_/2) + 0.5f) * 0.5f;
+
+			float const sinc = std::sin( kPi * t ) / (kPi * t);
+			float const r = t / kRadius;
+			float const window = bessel_i0_( kAlpha * std::sqrt( std::max( 0.f, 1.f - r*r ) ) ) / bessel_i0_( kAlpha );
+
+			ret.weights[i] = sinc * window;
+			sum += ret.weights[i];
+		}
+
+		for( int i = 0; i < kMaxTaps_; ++i )
+			ret.weights[i] /= sum;
+
+		return ret;
+	}
+
+	void decode_row_( std::uint8_t const* aSrc, std::uint32_t aWidth, TextureColorSpace aColorSpace, float* aOut ) noexcept
+	{
+		auto const& tables = tables_();
+		bool const srgb = TextureColorSpace::srgb == aColorSpace;
+
+		for( std::uint32_t x = 0; x < aWidth; ++x, aSrc += 4, aOut += 4 )
+		{
+			float const a = float(aSrc[3]) / 255.f;
+			for( int c = 0; c < 3; ++c )
+				aOut[c] = (srgb ? tables.srgbToLinear[aSrc[c]] : float(aSrc[c]) / 255.f) * a;
+			aOut[3] = a;
+		}
+	}
+
+	void encode_row_( float const* aSrc, std::uint32_t aWidth, TextureColorSpace aColorSpace, std::uint8_t* aOut ) noexcept
+	{
+		auto const& tables = tables_();
+		bool const srgb = TextureColorSpace::srgb == aColorSpace;
+
+		for( std::uint32_t x = 0; x < aWidth; ++x, aSrc += 4, aOut += 4 )
+		{
+			// The Kaiser filter overshoots; clamp.
+			float const a = std::clamp( aSrc[3], 0.f, 1.f );
+			float const scale = a > 0.f ? 1.f / a : 0.f;
+
+			for( int c = 0; c < 3; ++c )
+			{
+				float const value = std::clamp( aSrc[c] * scale, 0.f, 1.f );
+				aOut[c] = srgb
+					? tables.linearToSrgb[std::size_t(value * float(kEncodeSteps_-1) + 0.5f)]
+					: std::uint8_t(value * 255.f + 0.5f)
+				;
+			}
+
+			aOut[3] = std::uint8_t(a * 255.f + 0.5f);
+		}
+	}
+
+	void downsample_( Kernel_ const& aKernel, TextureColorSpace aColorSpace, std::uint32_t aSrcWidth, std::uint32_t aSrcHeight, std::vector<float> const& aSource, std::uint8_t const* aSourceBytes, std::uint32_t aDstWidth, std::uint32_t aDstHeight, std::vector<float>* aDest, std::uint8_t* aDestBytes )
+	{
+		auto const taps = aKernel.taps;
+
+		auto const clamp_ = [] (std::int64_t aIndex, std::uint32_t aSize) {
+			return std::uint32_t(std::clamp<std::int64_t>( aIndex, 0, std::int64_t(aSize)-1 ));
+		};
+
+		// Horizontally filtered source rows; source row y lives in y % taps.
+		// The rows needed by one output row are consecutive, so they never
+		// collide.
+		std::vector<float> ring( std::size_t(taps) * aDstWidth * 4 );
+		std::array<std::int64_t, kMaxTaps_> ringRows;
+		ringRows.fill( -1 );
+
+		std::vector<float> decoded;
+		if( aSource.empty() )
+			decoded.resize( std::size_t(aSrcWidth) * 4 );
+
+		if( aDest )
+			aDest->resize( std::size_t(aDstWidth) * aDstHeight * 4 );
+
+		std::vector<float> outRow( std::size_t(aDstWidth) * 4 );
+
+		auto const filter_row_ = [&] (std::uint32_t aY) -> float const* {
+			auto const slot = aY % std::uint32_t(taps);
+			float* dst = ring.data() + std::size_t(slot) * aDstWidth * 4;
+			if( ringRows[slot] == aY )
+				return dst;
+
+			float const* src = nullptr;
+			if( aSource.empty() )
+			{
+				decode_row_( aSourceBytes + std::size_t(aY) * aSrcWidth * kTextureBytesPerPixel, aSrcWidth, aColorSpace, decoded.data() );
+				src = decoded.data();
+			}
+			else
+			{
+				src = aSource.data() + std::size_t(aY) * aSrcWidth * 4;
+			}
+
+			for( std::uint32_t x = 0; x < aDstWidth; ++x )
+			{
+				auto const base = std::int64_t(2*x) + aKernel.first;
+
+				Pixel_ acc = pixel_zero_();
+				for( int i = 0; i < taps; ++i )
+					acc = pixel_madd_( acc, aKernel.weights[i], pixel_load_( src + std::size_t(clamp_( base+i, aSrcWidth )) * 4 ) );
+
+				pixel_store_( dst + std::size_t(x) * 4, acc );
+			}
+
+			ringRows[slot] = aY;
+			return dst;
+		};
+
+		float const* rows[kMaxTaps_];
+		for( std::uint32_t y = 0; y < aDstHeight; ++y )
+		{
+			auto const base = std::int64_t(2*y) + aKernel.first;
+			for( int i = 0; i < taps; ++i )
+				rows[i] = filter_row_( clamp_( base+i, aSrcHeight ) );
+
+			float* out = aDest ? aDest->data() + std::size_t(y) * aDstWidth * 4 : outRow.data();
+			for( std::uint32_t x = 0; x < aDstWidth; ++x )
+			{
+				Pixel_ acc = pixel_zero_();
+				for( int i = 0; i < taps; ++i )
+					acc = pixel_madd_( acc, aKernel.weights[i], pixel_load_( rows[i] + std::size_t(x) * 4 ) );
+
+				pixel_store_( out + std::size_t(x) * 4, acc );
+			}
+
+			encode_row_( out, aDstWidth, aColorSpace, aDestBytes + std::size_t(y) * aDstWidth * kTextureBytesPerPixel );
+		}
+	}
+}
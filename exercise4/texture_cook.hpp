@@ -0,0 +1,71 @@
+#ifndef TEXTURE_COOK_HPP_5A9C13E7_2F84_4D6B_B03E_C71D8E4A2F95
+#define TEXTURE_COOK_HPP_5A9C13E7_2F84_4D6B_B03E_C71D8E4A2F95
+
+#include <vector>
+#include <filesystem>
+
+#include <cstddef>
+#include <cstdint>
+
+// How the color channels of a texture are encoded. Alpha is always linear.
+enum class TextureColorSpace : std::uint8_t
+{
+	srgb,   // colors (e.g., diffuse maps)
+	linear  // data (e.g., normal or roughness maps)
+};
+
+// Downsampling filter for mip generation
+enum class MipFilter : std::uint8_t
+{
+	box,    // 2x2 average
+	kaiser  // 8x8 Kaiser-windowed sinc; sharper, slightly slower
+};
+
+// An RGBA8 image with its full mip chain, as uploaded to the GPU
+//
+// Levels are stored finest first, each tightly packed. Rows are stored
+// bottom-up, as OpenGL expects them (i.e., OBJ texture coordinates with v=0
+// at the bottom of the image work as they are).
+struct TextureImage
+{
+	std::uint32_t width, height;
+	std::uint32_t levels;
+	TextureColorSpace colorSpace;
+
+	std::vector<std::uint8_t> pixels;
+};
+
+constexpr std::size_t kTextureBytesPerPixel = 4; // RGBA8
+
+// Number of levels in a full mip chain (down to 1x1).
+std::uint32_t mip_level_count( std::uint32_t aWidth, std::uint32_t aHeight ) noexcept;
+
+// Size of level aLevel along an axis of size aSize.
+std::uint32_t mip_extent( std::uint32_t aSize, std::uint32_t aLevel ) noexcept;
+
+// Offset of level aLevel in TextureImage::pixels.
+std::size_t mip_offset( std::uint32_t aWidth, std::uint32_t aHeight, std::uint32_t aLevel ) noexcept;
+
+// Builds the mip chain for an RGBA8 image with aWidth x aHeight pixels,
+// stored top-down (as returned by stb_image).
+//
+// Filtering happens in linear space, with premultiplied alpha, so that
+// neither sRGB colors darken nor transparent texels bleed into their
+// neighbours. Each level is computed from the previous one with a separable
+// filter; only a few rows of intermediate results are kept. Uses SSE if
+// available.
+TextureImage build_mip_chain( std::uint8_t const* aPixels, std::uint32_t aWidth, std::uint32_t aHeight, TextureColorSpace, MipFilter );
+
+
+// Cooked texture files
+//
+// A TextureImage with all of its levels, preceded by a small header that
+// includes aKey. The key should identify the source image and everything
+// that affects the result (see TextureLoader). read_cooked_texture() returns
+// false if the file doesn't exist or doesn't match aKey; it throws on I/O
+// errors and malformed files. write_cooked_texture() writes to a temporary
+// file first, so that readers never see partial files.
+bool read_cooked_texture( std::filesystem::path const&, std::uint64_t aKey, TextureImage& aOut );
+void write_cooked_texture( std::filesystem::path const&, std::uint64_t aKey, TextureImage const& );
+
+#endif // TEXTURE_COOK_HPP_5A9C13E7_2F84_4D6B_B03E_C71D8E4A2F95
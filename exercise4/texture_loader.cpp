@@ -0,0 +1,488 @@
+#include "texture_loader.hpp"
+
+#include <chrono>
+#include <memory>
+#include <utility>
+#include <algorithm>
+#include <exception>
+#include <system_error>
+
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+
+#include <stb_image.h>
+
+#include "../support/hash.hpp"
+#include "../support/error.hpp"
+#include "../support/checkpoint.hpp"
+
+namespace
+{
+	constexpr std::size_t kStagingBuffers_ = 3;
+	constexpr std::size_t kMinUploadBytes_ = 64*1024;
+
+	// Levels up to this size are uploaded for all textures before the larger
+	// levels of any.
+	constexpr std::uint32_t kPreviewExtent_ = 128;
+
+	// Marks a texture whose levels have all been planned for upload.
+	constexpr std::uint32_t kNoLevel_ = ~std::uint32_t(0);
+
+	// Part of each cache key; bump when the mip generation changes.
+	constexpr std::uint32_t kCookVersion_ = 1;
+
+	using Clock_ = std::chrono::steady_clock;
+
+	double ms_since_( Clock_::time_point aStart ) noexcept
+	{
+		return std::chrono::duration<double, std::milli>( Clock_::now() - aStart ).count();
+	}
+
+	struct ImageFree_
+	{
+		void operator()( stbi_uc* aPixels ) const noexcept { stbi_image_free( aPixels ); }
+	};
+}
+
+// TextureDecoder
+TextureDecoder::TextureDecoder( JobSystem& aJobSystem, TextureConfig const& aConfig, std::size_t aMaxPendingBytes )
+	: mJobSystem( aJobSystem )
+	, mConfig( aConfig )
+	, mMaxPendingBytes( aMaxPendingBytes )
+	, mPendingBytes( 0 )
+	, mDecoding( 0 )
+{
+	if( !mConfig.cacheDirectory.empty() )
+	{
+		std::error_code ec;
+		std::filesystem::create_directories( mConfig.cacheDirectory, ec );
+		if( ec )
+		{
+			std::fprintf( stderr, "Warning: unable to create texture cache directory '%s': %s. Texture cache disabled.\n", mConfig.cacheDirectory.string().c_str(), ec.message().c_str() );
+			mConfig.cacheDirectory.clear();
+		}
+	}
+
+	if( 0 == mConfig.threads )
+		mConfig.threads = std::max<std::size_t>( 2, mJobSystem.thread_count() ) - 1;
+
+	for( std::size_t i = 0; i < mConfig.files.size(); ++i )
+		decode( TextureId(i), mConfig.files[i], TextureColorSpace::srgb );
+}
+
+TextureDecoder::~TextureDecoder()
+{
+	{
+		std::scoped_lock lock( mMutex );
+		mJobs.clear();
+	}
+
+	mJobSystem.wait( mDecodes );
+}
+
+void TextureDecoder::decode( TextureId aId, std::filesystem::path aPath, TextureColorSpace aColorSpace )
+{
+	{
+		std::scoped_lock lock( mMutex );
+		mJobs.emplace_back( Job_{ aId, std::move(aPath), aColorSpace } );
+	}
+
+	dispatch_();
+}
+
+void TextureDecoder::collect( std::deque<Result>& aResults )
+{
+	{
+		std::scoped_lock lock( mMutex );
+		while( !mResults.empty() )
+		{
+			aResults.emplace_back( std::move(mResults.front()) );
+			mResults.pop_front();
+		}
+	}
+
+	dispatch_();
+}
+
+void TextureDecoder::release( std::size_t aBytes )
+{
+	std::scoped_lock lock( mMutex );
+	mPendingBytes -= aBytes;
+}
+
+TextureConfig const& TextureDecoder::config() const noexcept
+{
+	return mConfig;
+}
+
+void TextureDecoder::dispatch_()
+{
+	std::scoped_lock lock( mMutex );
+	while( !mJobs.empty() && mPendingBytes < mMaxPendingBytes && mDecoding < mConfig.threads )
+	{
+		++mDecoding;
+		mJobSystem.run_background( [this, job = std::move(mJobs.front())] {
+			auto result = cook_( job );
+
+			std::scoped_lock lock( mMutex );
+			mPendingBytes += result.image.pixels.size();
+			mResults.emplace_back( std::move(result) );
+			--mDecoding;
+		}, &mDecodes );
+
+		mJobs.pop_front();
+	}
+}
+
+TextureDecoder::Result TextureDecoder::cook_( Job_ const& aJob ) const
+{
+	Result ret{};
+	ret.id = aJob.id;
+
+	auto const pathString = aJob.path.string();
+
+	try
+	{
+		auto const startTime = Clock_::now();
+
+		std::error_code ec;
+		auto const fileSize = std::uint64_t(std::filesystem::file_size( aJob.path, ec ));
+		if( ec )
+			throw Error( "%s", ec.message().c_str() );
+
+		auto const fileTime = std::int64_t(std::filesystem::last_write_time( aJob.path, ec ).time_since_epoch().count());
+		if( ec )
+			throw Error( "%s", ec.message().c_str() );
+
+		std::uint64_t key = hash_string( aJob.path.generic_string() );
+		key = hash_bytes( &fileSize, sizeof(fileSize), key );
+		key = hash_bytes( &fileTime, sizeof(fileTime), key );
+		key = hash_bytes( &aJob.colorSpace, sizeof(aJob.colorSpace), key );
+		key = hash_bytes( &mConfig.filter, sizeof(mConfig.filter), key );
+		key = hash_bytes( &kCookVersion_, sizeof(kCookVersion_), key );
+
+		bool const cache = !mConfig.cacheDirectory.empty();
+		if( cache )
+		{
+			try
+			{
+				if( read_cooked_texture( cache_path_( key ), key, ret.image ) )
+				{
+					ret.fromCache = true;
+					ret.decodeMs = ms_since_( startTime );
+					return ret;
+				}
+			}
+			catch( std::exception const& eErr )
+			{
+				std::fprintf( stderr, "Warning: %s. Cooking it again.\n", eErr.what() );
+			}
+		}
+
+		int width = 0, height = 0, channels = 0;
+		std::unique_ptr<stbi_uc, ImageFree_> pixels( stbi_load( pathString.c_str(), &width, &height, &channels, 4 ) );
+		if( !pixels )
+			throw Error( "%s", stbi_failure_reason() );
+
+		auto const decodedTime = Clock_::now();
+		ret.decodeMs = std::chrono::duration<double, std::milli>( decodedTime - startTime ).count();
+
+		ret.image = build_mip_chain( pixels.get(), std::uint32_t(width), std::uint32_t(height), aJob.colorSpace, mConfig.filter );
+		ret.mipMs = ms_since_( decodedTime );
+
+		if( cache )
+		{
+			try
+			{
+				write_cooked_texture( cache_path_( key ), key, ret.image );
+				ret.cooked = true;
+			}
+			catch( std::exception const& eErr )
+			{
+				std::fprintf( stderr, "Warning: unable to cache texture '%s': %s\n", pathString.c_str(), eErr.what() );
+			}
+		}
+	}
+	catch( std::exception const& eErr )
+	{
+		ret.error = eErr.what();
+		ret.image = {};
+	}
+
+	return ret;
+}
+
+std::filesystem::path TextureDecoder::cache_path_( std::uint64_t aKey ) const
+{
+	char name[32];
+	std::snprintf( name, sizeof(name), "%016llx.tex", static_cast<unsigned long long>(aKey) );
+	return mConfig.cacheDirectory / name;
+}
+
+// TextureLoader
+TextureLoader::TextureLoader( GpuResources& aResources, TextureDecoder& aDecoder )
+	: mResources( aResources )
+	, mDecoder( aDecoder )
+	, mUploadBytes( aDecoder.config().uploadBytes )
+	, mMaxTextureSize( 0 )
+	, mNextStaging( 0 )
+	, mPlanned( 0 )
+	, mStats{}
+{
+	if( mUploadBytes < kMinUploadBytes_ )
+		throw Error( "TextureLoader: upload budget of %zu bytes is too small (minimum: %zu)", mUploadBytes, kMinUploadBytes_ );
+
+	glGetIntegerv( GL_MAX_TEXTURE_SIZE, &mMaxTextureSize );
+
+	for( std::size_t i = 0; i < kStagingBuffers_; ++i )
+		mStaging.emplace_back( Staging_{ mResources.create_buffer( GpuMemoryCategory::other, GLsizeiptr(mUploadBytes), nullptr, GL_MAP_WRITE_BIT ), nullptr } );
+
+	// Already queued by the decoder
+	for( auto const& file : mDecoder.config().files )
+	{
+		mTextures.emplace_back( Texture_{ file, State_::loading, {}, false, {}, kNoLevel_, 0 } );
+		++mStats.requested;
+	}
+}
+
+TextureLoader::~TextureLoader()
+{
+	for( auto& staging : mStaging )
+	{
+		if( staging.fence )
+			glDeleteSync( staging.fence );
+	}
+}
+
+TextureId TextureLoader::load( std::filesystem::path aPath, TextureColorSpace aColorSpace )
+{
+	auto const id = TextureId(mTextures.size());
+
+	mTextures.emplace_back( Texture_{ aPath, State_::loading, {}, false, {}, kNoLevel_, 0 } );
+	++mStats.requested;
+
+	mDecoder.decode( id, std::move(aPath), aColorSpace );
+	return id;
+}
+
+void TextureLoader::update()
+{
+	mDecoder.collect( mDecoded );
+
+	// Allocating storage for a large texture may take a while (some drivers
+	// clear it), so start at most one new texture per frame.
+	while( !mDecoded.empty() )
+	{
+		auto result = std::move(mDecoded.front());
+		mDecoded.pop_front();
+
+		mStats.decodeMs += result.decodeMs;
+		mStats.mipMs += result.mipMs;
+		mStats.cacheHits += result.fromCache;
+		mStats.cooked += result.cooked;
+
+		if( start_upload_( result ) )
+			break;
+	}
+
+	if( mUploads.empty() )
+		return;
+
+	auto& staging = mStaging[mNextStaging];
+	if( staging.fence )
+	{
+		GLenum const status = glClientWaitSync( staging.fence, 0, 0 );
+		if( GL_ALREADY_SIGNALED != status && GL_CONDITION_SATISFIED != status )
+		{
+			++mStats.busyFrames;
+			return;
+		}
+
+		glDeleteSync( staging.fence );
+		staging.fence = nullptr;
+	}
+
+	// Small levels of every texture first, then everything in order.
+	mCopies.clear();
+	mPlanned = 0;
+
+	std::size_t budget = mUploadBytes;
+	for( auto const id : mUploads )
+		plan_( id, kPreviewExtent_, budget );
+
+	for( auto const id : mUploads )
+	{
+		plan_( id, ~std::uint32_t(0), budget );
+		if( 0 == budget )
+			break;
+	}
+
+	if( mCopies.empty() )
+		return;
+
+	glBindBuffer( GL_PIXEL_UNPACK_BUFFER, staging.buffer.id() );
+
+	// The fence guarantees that the GPU is done with the buffer.
+	auto* const mapped = static_cast<std::uint8_t*>(glMapBufferRange( GL_PIXEL_UNPACK_BUFFER, 0, GLsizeiptr(mPlanned), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT ));
+	if( !mapped )
+		throw Error( "TextureLoader: unable to map staging buffer" );
+
+	for( auto const& copy : mCopies )
+	{
+		auto const& image = mTextures[copy.id].image;
+		auto const rowBytes = std::size_t(mip_extent( image.width, copy.level )) * kTextureBytesPerPixel;
+		auto const* src = image.pixels.data() + mip_offset( image.width, image.height, copy.level ) + copy.row * rowBytes;
+
+		std::memcpy( mapped + copy.offset, src, copy.rows * rowBytes );
+	}
+
+	glUnmapBuffer( GL_PIXEL_UNPACK_BUFFER );
+
+	for( auto const& copy : mCopies )
+	{
+		auto const& texture = mTextures[copy.id];
+		auto const& image = texture.image;
+
+		glBindTexture( GL_TEXTURE_2D, texture.texture.id() );
+		glTexSubImage2D( GL_TEXTURE_2D, GLint(copy.level), 0, GLint(copy.row), GLsizei(mip_extent( image.width, copy.level )), GLsizei(copy.rows), GL_RGBA, GL_UNSIGNED_BYTE, reinterpret_cast<void const*>(copy.offset) );
+
+		if( copy.row + copy.rows == mip_extent( image.height, copy.level ) )
+			finish_level_( copy );
+	}
+
+	glBindTexture( GL_TEXTURE_2D, 0 );
+	glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+
+	staging.fence = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+	mNextStaging = (mNextStaging + 1) % mStaging.size();
+
+	mStats.uploadedBytes += mPlanned;
+	++mStats.uploadFrames;
+
+	std::erase_if( mUploads, [this] (TextureId aId) {
+		return State_::uploading != mTextures[aId].state;
+	} );
+
+	OGL_CHECKPOINT_DEBUG();
+}
+
+GLuint TextureLoader::texture( TextureId aId ) const noexcept
+{
+	assert( aId < mTextures.size() );
+	auto const& texture = mTextures[aId];
+	return texture.usable ? texture.texture.id() : 0;
+}
+
+bool TextureLoader::complete( TextureId aId ) const noexcept
+{
+	assert( aId < mTextures.size() );
+	return State_::complete == mTextures[aId].state;
+}
+
+std::size_t TextureLoader::pending() const noexcept
+{
+	return mStats.requested - mStats.completed - mStats.failed;
+}
+
+TextureStats TextureLoader::stats() const
+{
+	return mStats;
+}
+
+bool TextureLoader::start_upload_( Result_& aResult )
+{
+	auto& texture = mTextures[aResult.id];
+	auto const& image = aResult.image;
+
+	if( aResult.error.empty() )
+	{
+		if( std::size_t(image.width) * kTextureBytesPerPixel > mUploadBytes )
+			aResult.error = "a single row exceeds the upload budget";
+		else if( image.width > std::uint32_t(mMaxTextureSize) || image.height > std::uint32_t(mMaxTextureSize) )
+			aResult.error = "larger than GL_MAX_TEXTURE_SIZE";
+	}
+
+	if( !aResult.error.empty() )
+	{
+		std::fprintf( stderr, "Warning: unable to load texture '%s': %s\n", texture.path.string().c_str(), aResult.error.c_str() );
+
+		texture.state = State_::failed;
+		++mStats.failed;
+
+		mDecoder.release( image.pixels.size() );
+		return false;
+	}
+
+	auto const format = TextureColorSpace::srgb == image.colorSpace ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+	texture.texture = mResources.create_texture_2d( GpuMemoryCategory::texture, GLsizei(image.levels), format, GLsizei(image.width), GLsizei(image.height) );
+
+	// Nothing is sampled before the coarsest level is in; see finish_level_().
+	glBindTexture( GL_TEXTURE_2D, texture.texture.id() );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, GLint(image.levels-1) );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, GLint(image.levels-1) );
+	glBindTexture( GL_TEXTURE_2D, 0 );
+
+	texture.state = State_::uploading;
+	texture.nextLevel = image.levels-1;
+	texture.nextRow = 0;
+	texture.image = std::move(aResult.image);
+
+	mUploads.emplace_back( aResult.id );
+	return true;
+}
+
+void TextureLoader::plan_( TextureId aId, std::uint32_t aMaxExtent, std::size_t& aBudget )
+{
+	auto& texture = mTextures[aId];
+	auto const& image = texture.image;
+
+	while( kNoLevel_ != texture.nextLevel )
+	{
+		auto const level = texture.nextLevel;
+		auto const width = mip_extent( image.width, level );
+		auto const height = mip_extent( image.height, level );
+
+		if( std::max( width, height ) > aMaxExtent )
+			return;
+
+		auto const rowBytes = std::size_t(width) * kTextureBytesPerPixel;
+		auto const rows = std::uint32_t(std::min<std::size_t>( height - texture.nextRow, aBudget / rowBytes ));
+		if( 0 == rows )
+			return;
+
+		mCopies.emplace_back( Copy_{ aId, level, texture.nextRow, rows, mPlanned } );
+		mPlanned += rows * rowBytes;
+		aBudget -= rows * rowBytes;
+
+		texture.nextRow += rows;
+		if( texture.nextRow == height )
+		{
+			texture.nextRow = 0;
+			texture.nextLevel = 0 == level ? kNoLevel_ : level-1;
+		}
+	}
+}
+
+void TextureLoader::finish_level_( Copy_ const& aCopy )
+{
+	auto& texture = mTextures[aCopy.id];
+
+	// Levels complete coarsest first, so all levels from here on down are
+	// in place. The texture is bound by the caller.
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, GLint(aCopy.level) );
+	texture.usable = true;
+
+	if( 0 == aCopy.level )
+	{
+		texture.state = State_::complete;
+		++mStats.completed;
+
+		mDecoder.release( texture.image.pixels.size() );
+		texture.image = {};
+	}
+}
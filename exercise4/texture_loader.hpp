@@ -0,0 +1,240 @@
+#ifndef TEXTURE_LOADER_HPP_E3B61D08_9C27_4F5A_A84D_3F0E92C7B516
+#define TEXTURE_LOADER_HPP_E3B61D08_9C27_4F5A_A84D_3F0E92C7B516
+
+#include <glad/glad.h>
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <filesystem>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "texture_cook.hpp"
+
+#include "../support/job_system.hpp"
+#include "../support/gpu_resources.hpp"
+
+struct TextureConfig
+{
+	std::vector<std::filesystem::path> files; // loaded at startup (sRGB)
+
+	std::filesystem::path cacheDirectory = "texturecache"; // empty = disabled
+	MipFilter filter = MipFilter::box;
+
+	std::size_t uploadBytes = 8*1024*1024; // per frame
+	std::size_t threads = 0; // concurrent decodes; 0 = one per job system thread, minus one
+};
+
+struct TextureStats
+{
+	std::size_t requested;
+	std::size_t completed; // all levels uploaded
+	std::size_t failed;
+	std::size_t cacheHits; // loaded from cooked files
+	std::size_t cooked; // cooked files written
+
+	std::uint64_t uploadedBytes;
+	std::size_t uploadFrames; // frames that uploaded something
+	std::size_t busyFrames; // frames that skipped uploading, since the GPU still used the staging buffer
+
+	// Decode job time, summed over all threads
+	double decodeMs; // stb_image, or reading cooked files
+	double mipMs;
+};
+
+using TextureId = std::uint32_t;
+
+// Background half of TextureLoader
+//
+// Queued files are handled by background jobs (see JobSystem). These either
+// read a cooked version of the file from the cache directory, or decode it
+// with stb_image, generate its mip chain (see build_mip_chain()) and write
+// the cooked version for the next run. Cooked files are named after a hash of
+// the file's path, size and modification time, and of the loading options,
+// so changed images are cooked again. The cache is best-effort: its errors
+// are printed, but never fatal.
+//
+// Decoded images waiting for upload are limited to aMaxPendingBytes; beyond
+// that, no new decodes start. At most TextureConfig::threads decodes run at
+// a time.
+//
+// The decoder doesn't use OpenGL, so it can be created before there is a
+// context. It queues TextureConfig::files right away, as the first ids; the
+// TextureLoader that it is handed to picks them up from there. Must only be
+// used from one thread.
+class TextureDecoder final
+{
+	public:
+		struct Result
+		{
+			TextureId id;
+			TextureImage image;
+			std::string error; // if not empty, image is invalid
+
+			bool fromCache, cooked;
+			double decodeMs, mipMs;
+		};
+
+	public:
+		TextureDecoder( JobSystem&, TextureConfig const&, std::size_t aMaxPendingBytes = 512*1024*1024 );
+		~TextureDecoder();
+
+		TextureDecoder( TextureDecoder const& ) = delete;
+		TextureDecoder& operator= (TextureDecoder const&) = delete;
+
+	public:
+		void decode( TextureId, std::filesystem::path, TextureColorSpace );
+
+		// Moves finished results to aResults, and starts more decodes.
+		void collect( std::deque<Result>& aResults );
+
+		// Accounts for aBytes of decoded images having been freed.
+		void release( std::size_t aBytes );
+
+		TextureConfig const& config() const noexcept;
+
+	private:
+		struct Job_
+		{
+			TextureId id;
+			std::filesystem::path path;
+			TextureColorSpace colorSpace;
+		};
+
+		// Starts decodes for queued files, as far as the limits allow.
+		void dispatch_();
+		Result cook_( Job_ const& ) const;
+
+		std::filesystem::path cache_path_( std::uint64_t aKey ) const;
+
+	private:
+		JobSystem& mJobSystem;
+		TextureConfig mConfig;
+		std::size_t mMaxPendingBytes;
+
+		JobCounter mDecodes;
+
+		// Shared with the decode jobs
+		std::mutex mMutex;
+
+		std::deque<Job_> mJobs; // not yet dispatched
+		std::deque<Result> mResults;
+		std::size_t mPendingBytes; // decoded, but not yet uploaded
+		std::size_t mDecoding;
+};
+
+// Asynchronous texture loading
+//
+// load() only queues the file with the TextureDecoder.
+//
+// Decoded images are uploaded by update(), at most TextureConfig::uploadBytes
+// per frame. Data is copied into one of a ring of pixel unpack buffers, and
+// transferred with glTexSubImage2D() from there, so the driver can copy it
+// asynchronously; a fence per buffer ensures that it's only reused once the
+// GPU is done with it (otherwise that frame's upload is skipped). Large
+// levels are split into bands of rows and spread over several frames.
+//
+// Mip levels are uploaded coarsest first, and GL_TEXTURE_BASE_LEVEL follows
+// the finest complete level: a texture can be used as soon as texture()
+// returns a name, and gets sharper while the rest arrives. The small levels
+// of all queued textures are uploaded before the large levels of any.
+//
+// Images that can't be loaded print a warning; their texture() stays 0.
+//
+// Must only be used from the thread of the GL context.
+class TextureLoader final
+{
+	public:
+		// Takes over the files that aDecoder has queued already. The decoder
+		// must outlive the loader.
+		TextureLoader( GpuResources&, TextureDecoder& aDecoder );
+		~TextureLoader();
+
+		TextureLoader( TextureLoader const& ) = delete;
+		TextureLoader& operator= (TextureLoader const&) = delete;
+
+	public:
+		TextureId load( std::filesystem::path, TextureColorSpace = TextureColorSpace::srgb );
+
+		// Uploads decoded images. Call once per frame, before drawing.
+		void update();
+
+		// 0 until the coarsest level has been uploaded.
+		GLuint texture( TextureId ) const noexcept;
+		bool complete( TextureId ) const noexcept;
+
+		// Textures that have neither completed nor failed
+		std::size_t pending() const noexcept;
+
+		TextureStats stats() const;
+
+	private:
+		using Result_ = TextureDecoder::Result;
+
+		enum class State_ : std::uint8_t
+		{
+			loading,
+			uploading,
+			complete,
+			failed
+		};
+
+		struct Texture_
+		{
+			std::filesystem::path path;
+			State_ state;
+
+			GpuTexture texture;
+			bool usable; // at least one level uploaded
+
+			TextureImage image; // while uploading
+			std::uint32_t nextLevel; // counts down
+			std::uint32_t nextRow;
+		};
+
+		struct Copy_
+		{
+			TextureId id;
+			std::uint32_t level;
+			std::uint32_t row, rows;
+			std::size_t offset; // in the staging buffer
+		};
+
+		// Creates the texture for a decoded image. Returns false if the image
+		// failed to load (or is unsuitable).
+		bool start_upload_( Result_& );
+
+		// Plans copies of the levels of aTexture (coarsest first) whose
+		// larger side doesn't exceed aMaxExtent, as far as aBudget allows.
+		void plan_( TextureId, std::uint32_t aMaxExtent, std::size_t& aBudget );
+
+		void finish_level_( Copy_ const& );
+
+	private:
+		GpuResources& mResources;
+		TextureDecoder& mDecoder;
+		std::size_t mUploadBytes; // per frame
+		GLint mMaxTextureSize;
+
+		std::vector<Texture_> mTextures;
+		std::deque<Result_> mDecoded; // waiting for a texture to be created
+		std::deque<TextureId> mUploads; // in order of arrival
+
+		struct Staging_
+		{
+			GpuBuffer buffer;
+			GLsync fence;
+		};
+
+		std::vector<Staging_> mStaging;
+		std::size_t mNextStaging;
+		std::vector<Copy_> mCopies;
+		std::size_t mPlanned; // bytes in mCopies
+
+		TextureStats mStats;
+};
+
+#endif // TEXTURE_LOADER_HPP_E3B61D08_9C27_4F5A_A84D_3F0E92C7B516
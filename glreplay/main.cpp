@@ -0,0 +1,854 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <tuple>
+#include <string>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <typeinfo>
+#include <filesystem>
+#include <type_traits>
+#include <unordered_map>
+
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include "../support/error.hpp"
+#include "../support/gl_trace.hpp"
+
+// glreplay: plays back a trace recorded with exercise4's --gl-capture option
+// (see support/gl_capture.hpp and support/gl_trace.hpp).
+//
+// The setup is replayed once. The recorded frames are then replayed in a
+// loop. Each frame ends with glFinish(), so that the frame's total time
+// includes the GPU's work. Calls are timed individually on the CPU; the
+// report lists the time per function and per frame.
+//
+// Usage: glreplay [--loops N] [--headless] TRACE
+//
+//   --loops N     number of times the frames are replayed (default: 10)
+//   --headless    create the context without a window system (GLFW null
+//                 platform + EGL). This is the default if neither DISPLAY
+//                 nor WAYLAND_DISPLAY is set.
+//
+// Pointers to memory that the driver writes (glGetIntegerv(), ...) point to
+// scratch memory during replay. Pointers that were recorded as offsets (into
+// a bound buffer) are passed unchanged.
+namespace
+{
+	using Clock_ = std::chrono::steady_clock;
+
+	struct Options_
+	{
+		std::filesystem::path trace;
+		std::size_t loops = 10;
+		bool headless = false;
+	};
+
+	Options_ parse_options_( int aArgc, char* aArgv[] );
+
+	// Trace contents
+	class Reader_
+	{
+		public:
+			Reader_( std::byte const* aBegin, std::byte const* aEnd )
+				: mBegin( aBegin ), mCur( aBegin ), mEnd( aEnd )
+			{}
+
+			template< typename tType >
+			tType read()
+			{
+				tType ret;
+				std::memcpy( &ret, bytes( sizeof(tType) ), sizeof(tType) );
+				return ret;
+			}
+
+			std::byte const* bytes( std::size_t aSize )
+			{
+				if( std::size_t(mEnd - mCur) < aSize )
+					throw Error( "Truncated trace (at offset %zu)", offset() );
+
+				auto const* ret = mCur;
+				mCur += aSize;
+				return ret;
+			}
+
+			std::size_t offset() const noexcept { return std::size_t(mCur - mBegin); }
+			void seek( std::size_t aOffset ) noexcept { mCur = mBegin + aOffset; }
+
+		private:
+			std::byte const* mBegin;
+			std::byte const* mCur;
+			std::byte const* mEnd;
+	};
+
+	struct CallStats_
+	{
+		std::size_t calls;
+		Clock_::duration total, max;
+	};
+
+	// Replay state
+	struct Replay_
+	{
+		// Real functions, indexed by GLTraceFunction
+		void* functions[std::size_t(GLTraceFunction::count)];
+
+		std::unordered_map<std::uint64_t, GLsync> syncs;
+		std::unordered_map<GLuint, std::byte*> mappings;
+
+		GLint unpackAlignment = 4;
+
+		// Names are checked during the first pass only. Later loops create
+		// the frames' objects again, under new names.
+		bool checkNames = true;
+		std::size_t nameMismatches = 0;
+		std::size_t skipped = 0;
+
+		// Only counted while timing is on (i.e., not during setup)
+		bool timing = false;
+		CallStats_ stats[std::size_t(GLTraceFunction::count)];
+	};
+
+	Replay_ gReplay_{};
+
+	// Scratch memory for outputs, one slot per argument position. Pages that
+	// are never written aren't backed by memory, so slots can be generous.
+	constexpr std::size_t kScratchSlots_ = 12;
+	constexpr std::size_t kScratchSlotSize_ = 64*1024*1024;
+
+	std::unique_ptr<std::byte[]> gScratch_;
+
+	// Replays one call record (after its tag)
+	using ReplayFn_ = void (*)( Reader_& );
+
+	struct Trace_
+	{
+		std::vector<std::byte> data;
+		std::size_t recordsBegin;
+
+		// Maps the trace's function indices to local ones
+		std::vector<ReplayFn_> replay;
+	};
+
+	Trace_ load_trace_( std::filesystem::path const& );
+
+	enum class Stop_ { frame, end };
+	Stop_ replay_until_boundary_( Trace_ const&, Reader_& );
+
+	void report_( std::vector<std::vector<double>> const& aSubmitMs, std::vector<std::vector<double>> const& aTotalMs );
+
+	void glfw_callback_error_( int, char const* );
+
+	struct GLFWCleanupHelper
+	{
+		~GLFWCleanupHelper();
+	};
+	struct GLFWWindowDeleter
+	{
+		~GLFWWindowDeleter();
+		GLFWwindow* window;
+	};
+}
+
+int main( int aArgc, char* aArgv[] ) try
+{
+	Options_ const options = parse_options_( aArgc, aArgv );
+
+	Trace_ const trace = load_trace_( options.trace );
+
+	if( options.headless )
+		glfwInitHint( GLFW_PLATFORM, GLFW_PLATFORM_NULL );
+
+	if( GLFW_TRUE != glfwInit() )
+	{
+		char const* msg = nullptr;
+		int ecode = glfwGetError( &msg );
+		throw Error( "glfwInit() failed with '%s' (%d)", msg, ecode );
+	}
+
+	GLFWCleanupHelper cleanupHelper;
+
+	glfwSetErrorCallback( &glfw_callback_error_ );
+
+	// Same context as exercise4, except that it is never shown.
+	glfwWindowHint( GLFW_SRGB_CAPABLE, GLFW_TRUE );
+	glfwWindowHint( GLFW_DOUBLEBUFFER, GLFW_TRUE );
+	glfwWindowHint( GLFW_CONTEXT_VERSION_MAJOR, 4 );
+	glfwWindowHint( GLFW_CONTEXT_VERSION_MINOR, 3 );
+	glfwWindowHint( GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE );
+	glfwWindowHint( GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE );
+	glfwWindowHint( GLFW_VISIBLE, GLFW_FALSE );
+	glfwWindowHint( GLFW_DEPTH_BITS, 24 );
+
+	if( options.headless )
+		glfwWindowHint( GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API );
+
+	GLFWwindow* window = glfwCreateWindow( 1280, 720, "glreplay", nullptr, nullptr );
+	if( !window )
+	{
+		char const* msg = nullptr;
+		int ecode = glfwGetError( &msg );
+		throw Error( "glfwCreateWindow() failed with '%s' (%d)", msg, ecode );
+	}
+
+	GLFWWindowDeleter windowDeleter{ window };
+
+	glfwMakeContextCurrent( window );
+
+	if( !gladLoadGLLoader( (GLADloadproc)&glfwGetProcAddress ) )
+		throw Error( "gladLoaDGLLoader() failed - cannot load GL API!" );
+
+	std::printf( "RENDERER %s\n", glGetString( GL_RENDERER ) );
+
+#	define GLTRACE_FUNCTION_( name, flags ) gReplay_.functions[std::size_t(GLTraceFunction::name)] = reinterpret_cast<void*>(glad_gl##name);
+	GLTRACE_FUNCTIONS( GLTRACE_FUNCTION_ )
+#	undef GLTRACE_FUNCTION_
+
+	gScratch_.reset( new std::byte[kScratchSlots_*kScratchSlotSize_] );
+
+	Reader_ reader( trace.data.data(), trace.data.data() + trace.data.size() );
+	reader.seek( trace.recordsBegin );
+
+	// Setup
+	auto const setupStart = Clock_::now();
+	if( Stop_::end == replay_until_boundary_( trace, reader ) )
+		throw Error( "Trace '%s' contains no frames", options.trace.string().c_str() );
+
+	glFinish();
+	std::printf( "Setup: %.2f ms\n", std::chrono::duration<double, std::milli>(Clock_::now()-setupStart).count() );
+
+	// Frames
+	std::size_t const framesBegin = reader.offset();
+	std::vector<std::vector<double>> submitMs, totalMs; // [frame][loop]
+
+	gReplay_.timing = true;
+	for( std::size_t loop = 0; loop < options.loops; ++loop )
+	{
+		reader.seek( framesBegin );
+
+		for( std::size_t frame = 0; ; ++frame )
+		{
+			auto const frameStart = Clock_::now();
+			auto const stop = replay_until_boundary_( trace, reader );
+			auto const submitted = Clock_::now();
+
+			if( Stop_::end == stop )
+				break;
+
+			glFinish();
+			auto const finished = Clock_::now();
+
+			if( frame >= submitMs.size() )
+			{
+				submitMs.emplace_back();
+				totalMs.emplace_back();
+			}
+
+			submitMs[frame].emplace_back( std::chrono::duration<double, std::milli>(submitted-frameStart).count() );
+			totalMs[frame].emplace_back( std::chrono::duration<double, std::milli>(finished-frameStart).count() );
+		}
+
+		gReplay_.checkNames = false;
+	}
+
+	report_( submitMs, totalMs );
+
+	return 0;
+}
+catch( std::exception const& eErr )
+{
+	std::fprintf( stderr, "Top-level Exception (%s):\n", typeid(eErr).name() );
+	std::fprintf( stderr, "%s\n", eErr.what() );
+	std::fprintf( stderr, "Bye.\n" );
+	return 1;
+}
+
+namespace
+{
+	// Arguments
+	template< typename tType >
+	tType read_arg_( Reader_& aIn )
+	{
+		if constexpr( std::is_same_v<tType, GLsync> )
+		{
+			// Syncs created before the capture started are unknown; they
+			// become null.
+			auto const it = gReplay_.syncs.find( aIn.read<std::uint64_t>() );
+			return gReplay_.syncs.end() != it ? it->second : nullptr;
+		}
+		else if constexpr( std::is_pointer_v<tType> && std::is_function_v<std::remove_pointer_t<tType>> )
+		{
+			// Callbacks point into the capturing process.
+			aIn.read<std::uint64_t>();
+			return nullptr;
+		}
+		else if constexpr( std::is_pointer_v<tType> )
+		{
+			return reinterpret_cast<tType>(std::uintptr_t(aIn.read<std::uint64_t>()));
+		}
+		else
+		{
+			return aIn.read<tType>();
+		}
+	}
+
+	// Results are compared against the replay's, so pointers and GLsync
+	// handles are read as they are.
+	template< typename tType >
+	tType read_result_( Reader_& aIn )
+	{
+		if constexpr( std::is_pointer_v<tType> )
+			return reinterpret_cast<tType>(std::uintptr_t(aIn.read<std::uint64_t>()));
+		else
+			return aIn.read<tType>();
+	}
+
+	template< typename tType >
+	void redirect_output_( tType& aArg, std::size_t aSlot )
+	{
+		using Pointee_ = std::remove_pointer_t<tType>;
+		if constexpr( std::is_pointer_v<tType> && !std::is_const_v<Pointee_> && !std::is_function_v<Pointee_> && !std::is_same_v<tType, GLsync> )
+		{
+			if( aArg )
+				aArg = reinterpret_cast<tType>(gScratch_.get() + aSlot*kScratchSlotSize_);
+		}
+	}
+
+	void const* read_data_( Reader_& aIn, std::size_t aSize )
+	{
+		if( !aIn.read<std::uint8_t>() )
+			return nullptr;
+
+		return aIn.bytes( aSize );
+	}
+
+	// Copies an array out of the trace, which doesn't align its contents.
+	template< typename tType >
+	tType const* read_array_( Reader_& aIn, std::size_t aCount, std::vector<tType>& aStorage )
+	{
+		aStorage.resize( aCount );
+		std::memcpy( aStorage.data(), aIn.bytes( aCount*sizeof(tType) ), aCount*sizeof(tType) );
+		return aStorage.data();
+	}
+
+	// Inputs and outputs behind pointers, mirroring the Payload_ classes in
+	// gl_capture.cpp. before() gets the arguments as recorded in aRecorded,
+	// and may modify the ones that are passed (aArgs). Outputs already point
+	// to scratch memory in aArgs. Returning false skips the call.
+	struct NoPayload_
+	{
+		template< typename tArgs > static bool before( Reader_&, tArgs&, tArgs const& ) { return true; }
+		template< typename... tArgs > static void after( Reader_&, tArgs const&... ) {}
+	};
+
+	template< GLTraceFunction >
+	struct Payload_ : NoPayload_
+	{};
+
+	template<> struct Payload_<GLTraceFunction::BufferData> : NoPayload_
+	{
+		template< typename tArgs > static bool before( Reader_& aIn, tArgs& aArgs, tArgs const& )
+		{
+			std::get<2>( aArgs ) = read_data_( aIn, std::size_t(std::get<1>( aArgs )) );
+			return true;
+		}
+	};
+	template<> struct Payload_<GLTraceFunction::BufferStorage> : Payload_<GLTraceFunction::BufferData>
+	{};
+	template<> struct Payload_<GLTraceFunction::BufferSubData> : NoPayload_
+	{
+		template< typename tArgs > static bool before( Reader_& aIn, tArgs& aArgs, tArgs const& )
+		{
+			std::get<3>( aArgs ) = read_data_( aIn, std::size_t(std::get<2>( aArgs )) );
+			return true;
+		}
+	};
+	template<> struct Payload_<GLTraceFunction::ClearBufferData> : NoPayload_
+	{
+		template< typename tArgs > static bool before( Reader_& aIn, tArgs& aArgs, tArgs const& )
+		{
+			std::get<4>( aArgs ) = read_data_( aIn, gl_trace_image_size( 1, 1, std::get<2>( aArgs ), std::get<3>( aArgs ), 1 ) );
+			return true;
+		}
+	};
+
+	template<> struct Payload_<GLTraceFunction::ShaderSource> : NoPayload_
+	{
+		template< typename tArgs > static bool before( Reader_& aIn, tArgs& aArgs, tArgs const& )
+		{
+			static std::vector<GLchar const*> strings;
+			static std::vector<GLint> lengths;
+
+			auto const count = std::size_t(std::max( std::get<1>( aArgs ), 0 ));
+			strings.resize( count );
+			lengths.resize( count );
+
+			for( std::size_t i = 0; i < count; ++i )
+			{
+				auto const length = aIn.read<std::uint32_t>();
+				strings[i] = reinterpret_cast<GLchar const*>(aIn.bytes( length ));
+				lengths[i] = GLint(length);
+			}
+
+			std::get<2>( aArgs ) = strings.data();
+			std::get<3>( aArgs ) = lengths.data();
+			return true;
+		}
+	};
+	template<> struct Payload_<GLTraceFunction::ProgramBinary> : NoPayload_
+	{
+		template< typename tArgs > static bool before( Reader_& aIn, tArgs& aArgs, tArgs const& )
+		{
+			std::get<2>( aArgs ) = read_data_( aIn, std::size_t(std::get<3>( aArgs )) );
+			return true;
+		}
+	};
+	template<> struct Payload_<GLTraceFunction::ProgramUniformMatrix4fv> : NoPayload_
+	{
+		template< typename tArgs > static bool before( Reader_& aIn, tArgs& aArgs, tArgs const& )
+		{
+			static std::vector<GLfloat> values;
+
+			auto const count = std::size_t(std::get<2>( aArgs )) * 16;
+			std::get<4>( aArgs ) = aIn.read<std::uint8_t>() ? read_array_( aIn, count, values ) : nullptr;
+			return true;
+		}
+	};
+
+	template<> struct Payload_<GLTraceFunction::DebugMessageControl> : NoPayload_
+	{
+		template< typename tArgs > static bool before( Reader_& aIn, tArgs& aArgs, tArgs const& )
+		{
+			static std::vector<GLuint> ids;
+			std::get<4>( aArgs ) = aIn.read<std::uint8_t>() ? read_array_( aIn, std::size_t(std::get<3>( aArgs )), ids ) : nullptr;
+			return true;
+		}
+	};
+	template<> struct Payload_<GLTraceFunction::GetProgramResourceiv> : NoPayload_
+	{
+		template< typename tArgs > static bool before( Reader_& aIn, tArgs& aArgs, tArgs const& )
+		{
+			static std::vector<GLenum> props;
+			std::get<4>( aArgs ) = aIn.read<std::uint8_t>() ? read_array_( aIn, std::size_t(std::get<3>( aArgs )), props ) : nullptr;
+			return true;
+		}
+	};
+
+	// Object names
+	struct DeletePayload_ : NoPayload_
+	{
+		template< typename tArgs > static bool before( Reader_& aIn, tArgs& aArgs, tArgs const& )
+		{
+			static std::vector<GLuint> names;
+			std::get<1>( aArgs ) = read_array_( aIn, std::size_t(std::max( std::get<0>( aArgs ), 0 )), names );
+			return true;
+		}
+	};
+	struct GenPayload_ : NoPayload_
+	{
+		template< typename tArgs > static void after( Reader_& aIn, tArgs const& aArgs )
+		{
+			static std::vector<GLuint> names;
+			auto const count = std::size_t(std::max( std::get<0>( aArgs ), 0 ));
+
+			auto const* recorded = read_array_( aIn, count, names );
+			if( gReplay_.checkNames && 0 != std::memcmp( recorded, std::get<1>( aArgs ), count*sizeof(GLuint) ) )
+				++gReplay_.nameMismatches;
+		}
+	};
+	struct CreatePayload_ : NoPayload_
+	{
+		template< typename tArgs > static void after( Reader_&, tArgs const&, GLuint aResult, GLuint aRecorded )
+		{
+			if( gReplay_.checkNames && aResult != aRecorded )
+				++gReplay_.nameMismatches;
+		}
+	};
+
+	template<> struct Payload_<GLTraceFunction::DeleteBuffers> : DeletePayload_ {};
+	template<> struct Payload_<GLTraceFunction::DeleteFramebuffers> : DeletePayload_ {};
+	template<> struct Payload_<GLTraceFunction::DeleteQueries> : DeletePayload_ {};
+	template<> struct Payload_<GLTraceFunction::DeleteTextures> : DeletePayload_ {};
+	template<> struct Payload_<GLTraceFunction::DeleteVertexArrays> : DeletePayload_ {};
+	template<> struct Payload_<GLTraceFunction::GenBuffers> : GenPayload_ {};
+	template<> struct Payload_<GLTraceFunction::GenFramebuffers> : GenPayload_ {};
+	template<> struct Payload_<GLTraceFunction::GenQueries> : GenPayload_ {};
+	template<> struct Payload_<GLTraceFunction::GenTextures> : GenPayload_ {};
+	template<> struct Payload_<GLTraceFunction::GenVertexArrays> : GenPayload_ {};
+	template<> struct Payload_<GLTraceFunction::CreateProgram> : CreatePayload_ {};
+	template<> struct Payload_<GLTraceFunction::CreateShader> : CreatePayload_ {};
+
+	// Pixel transfers
+	template<> struct Payload_<GLTraceFunction::PixelStorei> : NoPayload_
+	{
+		template< typename tArgs > static void after( Reader_&, tArgs const& aArgs )
+		{
+			if( GL_UNPACK_ALIGNMENT == std::get<0>( aArgs ) )
+				gReplay_.unpackAlignment = std::get<1>( aArgs );
+		}
+	};
+	template<> struct Payload_<GLTraceFunction::TexImage2D> : NoPayload_
+	{
+		template< typename tArgs > static bool before( Reader_& aIn, tArgs& aArgs, tArgs const& )
+		{
+			auto const size = gl_trace_image_size( std::get<3>( aArgs ), std::get<4>( aArgs ), std::get<6>( aArgs ), std::get<7>( aArgs ), gReplay_.unpackAlignment );
+
+			// Not recorded: null, or an offset into the unpack buffer.
+			if( auto const* pixels = read_data_( aIn, size ) )
+				std::get<8>( aArgs ) = pixels;
+
+			return true;
+		}
+	};
+	template<> struct Payload_<GLTraceFunction::TexSubImage2D> : NoPayload_
+	{
+		template< typename tArgs > static bool before( Reader_& aIn, tArgs& aArgs, tArgs const& )
+		{
+			auto const size = gl_trace_image_size( std::get<4>( aArgs ), std::get<5>( aArgs ), std::get<6>( aArgs ), std::get<7>( aArgs ), gReplay_.unpackAlignment );
+
+			// Not recorded: an offset into the unpack buffer.
+			if( auto const* pixels = read_data_( aIn, size ) )
+				std::get<8>( aArgs ) = pixels;
+
+			return true;
+		}
+	};
+	template<> struct Payload_<GLTraceFunction::ReadPixels> : NoPayload_
+	{
+		template< typename tArgs > static bool before( Reader_& aIn, tArgs& aArgs, tArgs const& aRecorded )
+		{
+			// Offset into the pack buffer
+			if( aIn.read<std::uint8_t>() )
+				std::get<6>( aArgs ) = std::get<6>( aRecorded );
+
+			return true;
+		}
+	};
+
+	// Syncs
+	template<> struct Payload_<GLTraceFunction::FenceSync> : NoPayload_
+	{
+		template< typename tArgs > static void after( Reader_&, tArgs const&, GLsync aResult, GLsync aRecorded )
+		{
+			gReplay_.syncs[std::uint64_t(reinterpret_cast<std::uintptr_t>(aRecorded))] = aResult;
+		}
+	};
+	template<> struct Payload_<GLTraceFunction::ClientWaitSync> : NoPayload_
+	{
+		template< typename tArgs > static bool before( Reader_&, tArgs& aArgs, tArgs const& )
+		{
+			if( std::get<0>( aArgs ) )
+				return true;
+
+			++gReplay_.skipped;
+			return false;
+		}
+	};
+
+	// Mappings
+	template<> struct Payload_<GLTraceFunction::MapBufferRange> : NoPayload_
+	{
+		template< typename tArgs > static void after( Reader_& aIn, tArgs const&, void* aResult, void* )
+		{
+			auto const buffer = GLuint(aIn.read<std::uint32_t>());
+			if( aResult )
+				gReplay_.mappings[buffer] = static_cast<std::byte*>(aResult);
+		}
+	};
+	template<> struct Payload_<GLTraceFunction::UnmapBuffer> : NoPayload_
+	{
+		static inline GLuint sBuffer = 0;
+
+		template< typename tArgs > static bool before( Reader_& aIn, tArgs&, tArgs const& )
+		{
+			sBuffer = GLuint(aIn.read<std::uint32_t>());
+			return true;
+		}
+		template< typename tArgs > static void after( Reader_&, tArgs const&, GLboolean, GLboolean )
+		{
+			gReplay_.mappings.erase( sBuffer );
+		}
+	};
+
+	void replay_mapped_write_( Reader_& aIn )
+	{
+		auto const buffer = GLuint(aIn.read<std::uint32_t>());
+		auto const offset = std::size_t(aIn.read<std::uint64_t>());
+		auto const size = std::size_t(aIn.read<std::uint64_t>());
+		auto const* data = aIn.bytes( size );
+
+		auto const it = gReplay_.mappings.find( buffer );
+		if( gReplay_.mappings.end() == it )
+			throw Error( "Mapped write to buffer %u, which isn't mapped", buffer );
+
+		std::memcpy( it->second + offset, data, size );
+	}
+
+	// Generic replay of one call
+	template< GLTraceFunction tFn, typename tPfn >
+	struct ReplayCall_;
+
+	template< GLTraceFunction tFn, typename tRet, typename... tArgs >
+	struct ReplayCall_< tFn, tRet (APIENTRYP)(tArgs...) >
+	{
+		static void replay( Reader_& aIn )
+		{
+			using Args_ = std::tuple<tArgs...>;
+
+			// Braced initialization reads the arguments in order.
+			Args_ const recorded{ read_arg_<tArgs>( aIn )... };
+			Args_ args = recorded;
+
+			[&args]<std::size_t... tIdx>( std::index_sequence<tIdx...> ) {
+				(redirect_output_( std::get<tIdx>( args ), tIdx ), ...);
+			}( std::index_sequence_for<tArgs...>{} );
+
+			bool const call = Payload_<tFn>::before( aIn, args, recorded );
+
+			auto const real = reinterpret_cast<tRet (APIENTRYP)(tArgs...)>( gReplay_.functions[std::size_t(tFn)] );
+			if( call && !real )
+				throw Error( "gl%s() was recorded, but is not available", kGLTraceFunctionNames[std::size_t(tFn)] );
+
+			auto const start = Clock_::now();
+			if constexpr( std::is_void_v<tRet> )
+			{
+				if( call )
+					std::apply( real, args );
+
+				record_( start, call );
+				Payload_<tFn>::after( aIn, args );
+			}
+			else
+			{
+				tRet result{};
+				if( call )
+					result = std::apply( real, args );
+
+				record_( start, call );
+
+				tRet const recordedResult = read_result_<tRet>( aIn );
+				Payload_<tFn>::after( aIn, args, result, recordedResult );
+			}
+		}
+
+		static void record_( Clock_::time_point aStart, bool aCalled )
+		{
+			if( !gReplay_.timing || !aCalled )
+				return;
+
+			auto const elapsed = Clock_::now() - aStart;
+
+			auto& stats = gReplay_.stats[std::size_t(tFn)];
+			++stats.calls;
+			stats.total += elapsed;
+			stats.max = std::max( stats.max, elapsed );
+		}
+	};
+
+	ReplayFn_ const kReplayFunctions_[] = {
+#		define GLTRACE_REPLAY_( name, flags ) &ReplayCall_<GLTraceFunction::name, decltype(glad_gl##name)>::replay,
+		GLTRACE_FUNCTIONS( GLTRACE_REPLAY_ )
+#		undef GLTRACE_REPLAY_
+	};
+
+	static_assert( std::size(kReplayFunctions_) == std::size_t(GLTraceFunction::count) );
+}
+
+namespace
+{
+	Options_ parse_options_( int aArgc, char* aArgv[] )
+	{
+		Options_ ret;
+
+		bool forceHeadless = false;
+		for( int i = 1; i < aArgc; ++i )
+		{
+			char const* arg = aArgv[i];
+
+			if( 0 == std::strcmp( arg, "--loops" ) )
+			{
+				if( i+1 >= aArgc )
+					throw Error( "Option '--loops' requires a value" );
+
+				char* end = nullptr;
+				char const* value = aArgv[++i];
+				auto const loops = std::strtoull( value, &end, 10 );
+				if( end == value || '\0' != *end || '-' == value[0] || 0 == loops )
+					throw Error( "Option '--loops': expected a positive integer, got '%s'", value );
+
+				ret.loops = std::size_t(loops);
+			}
+			else if( 0 == std::strcmp( arg, "--headless" ) )
+			{
+				forceHeadless = true;
+			}
+			else if( '-' == arg[0] )
+			{
+				throw Error( "Unknown command line argument '%s'", arg );
+			}
+			else if( !ret.trace.empty() )
+			{
+				throw Error( "Only one trace may be given (got '%s' and '%s')", ret.trace.string().c_str(), arg );
+			}
+			else
+			{
+				ret.trace = arg;
+			}
+		}
+
+		if( ret.trace.empty() )
+			throw Error( "Usage: %s [--loops N] [--headless] TRACE", aArgc > 0 ? aArgv[0] : "glreplay" );
+
+		bool const haveDisplay = std::getenv( "DISPLAY" ) || std::getenv( "WAYLAND_DISPLAY" );
+		ret.headless = forceHeadless || !haveDisplay;
+
+		return ret;
+	}
+
+	Trace_ load_trace_( std::filesystem::path const& aPath )
+	{
+		Trace_ ret;
+
+		std::FILE* fin = std::fopen( aPath.string().c_str(), "rb" );
+		if( !fin )
+			throw Error( "Unable to open trace '%s'", aPath.string().c_str() );
+
+		std::error_code ec;
+		auto const size = std::filesystem::file_size( aPath, ec );
+
+		ret.data.resize( ec ? 0 : std::size_t(size) );
+		bool const ok = !ec && ret.data.size() == std::fread( ret.data.data(), 1, ret.data.size(), fin );
+		std::fclose( fin );
+
+		if( !ok )
+			throw Error( "Unable to read trace '%s'", aPath.string().c_str() );
+
+		Reader_ reader( ret.data.data(), ret.data.data() + ret.data.size() );
+
+		auto const magic = reader.read<std::uint32_t>();
+		auto const version = reader.read<std::uint32_t>();
+		if( kGLTraceMagic != magic || kGLTraceVersion != version )
+			throw Error( "'%s' is not a GL trace (or was recorded by an incompatible version)", aPath.string().c_str() );
+
+		auto const count = reader.read<std::uint32_t>();
+		for( std::uint32_t i = 0; i < count; ++i )
+		{
+			auto const length = reader.read<std::uint16_t>();
+			std::string const name( reinterpret_cast<char const*>(reader.bytes( length )), length );
+
+			ReplayFn_ fn = nullptr;
+			for( std::size_t j = 0; j < std::size_t(GLTraceFunction::count); ++j )
+			{
+				if( name == kGLTraceFunctionNames[j] )
+					fn = kReplayFunctions_[j];
+			}
+
+			// Unknown functions are only an error if they were called, see
+			// replay_until_boundary_().
+			ret.replay.emplace_back( fn );
+		}
+
+		ret.recordsBegin = reader.offset();
+		return ret;
+	}
+
+	Stop_ replay_until_boundary_( Trace_ const& aTrace, Reader_& aIn )
+	{
+		while( true )
+		{
+			auto const tag = aIn.read<std::uint16_t>();
+
+			switch( GLTraceTag(tag) )
+			{
+				case GLTraceTag::frame: return Stop_::frame;
+				case GLTraceTag::end: return Stop_::end;
+
+				case GLTraceTag::mappedWrite:
+					replay_mapped_write_( aIn );
+					continue;
+			}
+
+			if( tag >= aTrace.replay.size() || !aTrace.replay[tag] )
+				throw Error( "Unknown record %u at offset %zu", unsigned(tag), aIn.offset()-sizeof(tag) );
+
+			aTrace.replay[tag]( aIn );
+		}
+	}
+
+	void report_( std::vector<std::vector<double>> const& aSubmitMs, std::vector<std::vector<double>> const& aTotalMs )
+	{
+		auto const mean = [] (std::vector<double> const& aValues) {
+			double sum = 0.0;
+			for( auto const value : aValues )
+				sum += value;
+			return aValues.empty() ? 0.0 : sum / double(aValues.size());
+		};
+
+		std::printf( "Frames: %zu, replayed %zu times\n", aSubmitMs.size(), aSubmitMs.empty() ? 0 : aSubmitMs.front().size() );
+		std::printf( "  frame   submit mean/max (ms)     total mean/max (ms)\n" );
+
+		std::vector<double> allTotal;
+		for( std::size_t i = 0; i < aSubmitMs.size(); ++i )
+		{
+			auto const& submit = aSubmitMs[i];
+			auto const& total = aTotalMs[i];
+			allTotal.insert( allTotal.end(), total.begin(), total.end() );
+
+			std::printf( "  %5zu   %9.3f %9.3f      %9.3f %9.3f\n", i, mean( submit ), *std::max_element( submit.begin(), submit.end() ), mean( total ), *std::max_element( total.begin(), total.end() ) );
+		}
+
+		std::printf( "Mean frame time: %.3f ms\n", mean( allTotal ) );
+
+		// Functions, by total time
+		std::vector<std::size_t> order;
+		for( std::size_t i = 0; i < std::size_t(GLTraceFunction::count); ++i )
+		{
+			if( gReplay_.stats[i].calls )
+				order.emplace_back( i );
+		}
+
+		std::sort( order.begin(), order.end(), [] (std::size_t aX, std::size_t aY) {
+			return gReplay_.stats[aX].total > gReplay_.stats[aY].total;
+		} );
+
+		std::printf( "Calls (all frames):\n" );
+		std::printf( "  %-34s %10s %12s %10s %10s\n", "function", "calls", "total (ms)", "mean (us)", "max (us)" );
+		for( auto const i : order )
+		{
+			auto const& stats = gReplay_.stats[i];
+			auto const totalMs = std::chrono::duration<double, std::milli>(stats.total).count();
+			auto const maxUs = std::chrono::duration<double, std::micro>(stats.max).count();
+
+			std::printf( "  gl%-32s %10zu %12.3f %10.3f %10.3f\n", kGLTraceFunctionNames[i], stats.calls, totalMs, 1000.0 * totalMs / double(stats.calls), maxUs );
+		}
+
+		if( gReplay_.nameMismatches )
+			std::printf( "Warning: %zu calls returned different object names than when recorded. The replay is likely incorrect.\n", gReplay_.nameMismatches );
+		if( gReplay_.skipped )
+			std::printf( "Note: skipped %zu waits on syncs created before the capture started.\n", gReplay_.skipped );
+	}
+}
+
+namespace
+{
+	void glfw_callback_error_( int aErrNum, char const* aErrDesc )
+	{
+		std::fprintf( stderr, "GLFW error: %s (%d)\n", aErrDesc, aErrNum );
+	}
+
+	GLFWCleanupHelper::~GLFWCleanupHelper()
+	{
+		glfwTerminate();
+	}
+
+	GLFWWindowDeleter::~GLFWWindowDeleter()
+	{
+		if( window )
+			glfwDestroyWindow( window );
+	}
+}
@@ -1,3 +1,8 @@
+newoption {
+	trigger = "gl-no-error",
+	description = "Release builds: request a GL_KHR_no_error context and compile out GL error checkpoints"
+}
+
 workspace "COMP3811-glcode"
 	language "C++"
 	cppdialect "C++20"
@@ -66,6 +71,11 @@ workspace "COMP3811-glcode"
 		optimize "On"
 		defines { "NDEBUG=1" }
 
+	-- GL_KHR_no_error context, and no error checkpoints. See
+	-- support/checkpoint.hpp. (A no-error context can't be a debug context.)
+	filter { "release", "options:gl-no-error" }
+		defines { "OGL_NO_ERROR=1" }
+
 	filter "*"
 
 -- Third party dependencies
@@ -102,7 +112,8 @@ project "exercise4-shaders"
 		"assets/ex4/*.geom",
 		"assets/ex4/*.tesc",
 		"assets/ex4/*.tese",
-		"assets/ex4/*.comp"
+		"assets/ex4/*.comp",
+		"assets/ex4/*.glsl"
 	}
 
 	kind "Utility"
@@ -111,6 +122,22 @@ project "exercise4-shaders"
 	files( shaders )
 
 
+project "glreplay"
+	local sources = { 
+		"glreplay/**.cpp",
+		"glreplay/**.hpp"
+	}
+
+	kind "ConsoleApp"
+	location "glreplay"
+
+	files( sources )
+
+	links "support"
+
+	links "x-glad"
+	links "x-glfw"
+
 project "support"
 	local sources = { 
 		"support/**.cpp",
@@ -25,6 +25,11 @@ namespace
 	}
 }
 
+void set_gl_checkpoints_enabled( bool aEnabled ) noexcept
+{
+	detail::gCheckpointsEnabled = aEnabled;
+}
+
 namespace detail
 {
 	void check_gl_error( char const* aSourceFile, int aSourceLine )
@@ -1,10 +1,23 @@
 #ifndef CHECKPOINT_HPP_3DFDA796_469C_4D37_B904_1C8D8FAE207B
 #define CHECKPOINT_HPP_3DFDA796_469C_4D37_B904_1C8D8FAE207B
 
-#define OGL_CHECKPOINT_ALWAYS() do {                                \
-		::detail::check_gl_error( __FILE__, __LINE__ );             \
+// Checkpoints call glGetError() and throw if there was an error. Note that
+// glGetError() may force the driver to synchronize with its worker thread.
+//
+// Checkpoints can be turned off at runtime with set_gl_checkpoints_enabled(),
+// e.g., when errors are collected through the debug output instead (see
+// GLDebugMode::deferred in debug_output.hpp). With OGL_NO_ERROR (premake5
+// --gl-no-error, release builds only), the context is created with
+// GL_KHR_no_error and checkpoints compile to nothing.
+#if defined(OGL_NO_ERROR)
+#	define OGL_CHECKPOINT_ALWAYS()  do {} while(0)
+#else
+#	define OGL_CHECKPOINT_ALWAYS() do {                                \
+		if( ::detail::gCheckpointsEnabled )                           \
+			::detail::check_gl_error( __FILE__, __LINE__ );         \
 	} while(0)                                                      \
 	/*ENDM*/
+#endif
 
 #if defined(NDEBUG)
 #	define OGL_CHECKPOINT_DEBUG()   do {} while(0)
@@ -12,10 +25,13 @@
 #	define OGL_CHECKPOINT_DEBUG()   OGL_CHECKPOINT_ALWAYS()
 #endif
 
+void set_gl_checkpoints_enabled( bool ) noexcept;
+
 namespace detail
 {
+	inline bool gCheckpointsEnabled = true;
+
 	void check_gl_error( char const*, int );
 }
 
 #endif // CHECKPOINT_HPP_3DFDA796_469C_4D37_B904_1C8D8FAE207B
-
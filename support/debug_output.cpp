@@ -1,11 +1,20 @@
 #include "debug_output.hpp"
 
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <algorithm>
+#include <unordered_map>
+
 #include <cstdio>
 #include <cassert>
+#include <cstdint>
+#include <cstring>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include "hash.hpp"
 #include "error.hpp"
 #include "checkpoint.hpp"
 
@@ -15,32 +24,244 @@ namespace
 #	if !defined(NDEBUG)
 	void GLAPIENTRY callback_gldebug_( GLenum, GLenum, GLuint, GLenum, GLsizei, GLchar const*, void const* );
 #	endif // ~ !NDEBUG
+
+	// Deferred mode
+	void GLAPIENTRY callback_gldebug_deferred_( GLenum, GLenum, GLuint, GLenum, GLsizei, GLchar const*, void const* );
+
+	char const* type_str_( GLenum ) noexcept;
+	char const* severity_str_( GLenum ) noexcept;
+
+	using Clock_ = std::chrono::steady_clock;
+
+	// Per site, at most this many messages are printed per window.
+	constexpr std::size_t kReportsPerWindow_ = 5;
+	constexpr Clock_::duration kReportWindow_ = std::chrono::seconds( 1 );
+
+	// Queued message. Longer messages are truncated.
+	struct Message_
+	{
+		GLenum source, type, severity;
+		GLuint id;
+		char text[240];
+	};
+
+	// Bounded lock-free multi-producer single-consumer queue
+	//
+	// With asynchronous debug output, the driver may invoke the callback
+	// from several of its threads at once, so SpscQueue is not enough. Each
+	// slot carries a sequence number (as in D. Vyukov's bounded MPMC queue).
+	// Producers claim a slot by advancing mTail with a CAS, fill it, and then
+	// publish it by bumping its sequence number. The consumer frees the slot
+	// for the next round the same way.
+	class MessageRing_ final
+	{
+		public:
+			MessageRing_() noexcept
+			{
+				for( std::size_t i = 0; i < kCapacity; ++i )
+					mSlots[i].sequence.store( i, std::memory_order_relaxed );
+			}
+
+		public:
+			bool try_push( GLenum aSource, GLenum aType, GLuint aId, GLenum aSeverity, GLsizei aLength, char const* aText ) noexcept
+			{
+				auto pos = mTail.load( std::memory_order_relaxed );
+				for( ;; )
+				{
+					auto& slot = mSlots[pos & (kCapacity-1)];
+					auto const sequence = slot.sequence.load( std::memory_order_acquire );
+					auto const diff = std::intptr_t(sequence) - std::intptr_t(pos);
+
+					if( diff < 0 )
+						return false; // full
+
+					if( 0 == diff && mTail.compare_exchange_weak( pos, pos+1, std::memory_order_relaxed ) )
+					{
+						auto& message = slot.message;
+						message.source = aSource;
+						message.type = aType;
+						message.severity = aSeverity;
+						message.id = aId;
+
+						// aLength excludes the terminator; it may be negative
+						// if the driver didn't provide it.
+						auto const length = std::min( aLength >= 0 ? std::size_t(aLength) : std::strlen( aText ), sizeof(message.text)-1 );
+						std::memcpy( message.text, aText, length );
+						message.text[length] = '\0';
+
+						slot.sequence.store( pos+1, std::memory_order_release );
+						return true;
+					}
+
+					if( 0 != diff )
+						pos = mTail.load( std::memory_order_relaxed );
+				}
+			}
+
+			bool try_pop( Message_& aMessage ) noexcept
+			{
+				auto& slot = mSlots[mHead & (kCapacity-1)];
+				if( slot.sequence.load( std::memory_order_acquire ) != mHead+1 )
+					return false;
+
+				aMessage = slot.message;
+				slot.sequence.store( mHead + kCapacity, std::memory_order_release );
+				++mHead;
+				return true;
+			}
+
+		private:
+			static constexpr std::size_t kCapacity = 256;
+
+			struct Slot_
+			{
+				std::atomic<std::size_t> sequence;
+				Message_ message;
+			};
+
+			Slot_ mSlots[kCapacity];
+
+			alignas(64) std::atomic<std::size_t> mTail{ 0 };
+			alignas(64) std::size_t mHead = 0; // consumer only
+	};
+
+	struct Site_
+	{
+		GLenum type, severity;
+		std::string text;
+
+		Clock_::time_point windowStart;
+		std::size_t reported; // in the current window
+		std::size_t suppressed;
+	};
+
+	bool gDeferred_ = false;
+
+	MessageRing_ gMessages_;
+	std::atomic<std::size_t> gDropped_{ 0 };
+
+	// Only used by drain_gl_debug_output()
+	std::unordered_map<std::uint64_t, Site_> gSites_;
 }
 
-void setup_gl_debug_output()
+void setup_gl_debug_output( GLDebugMode aMode )
 {
-#	if !defined(NDEBUG)
 	OGL_CHECKPOINT_ALWAYS();
 
 	// glDebugMessageCallback() was standardized in 4.3, so it's not available
 	// Apple. The extension (ARB_debug_output), which predates standardization
 	// doesn't seem to exist on Apple either.
 #	if !defined(__APPLE__)
+	GLint flags = 0;
+	glGetIntegerv( GL_CONTEXT_FLAGS, &flags );
+
+	if( GLDebugMode::deferred == aMode && !(flags & GL_CONTEXT_FLAG_DEBUG_BIT) )
+	{
+		// Outside of a debug context, the driver may not report anything.
+		// Disabling the checkpoints would then hide errors entirely.
+		std::fprintf( stderr, "Note: not a debug context; GL errors are checked synchronously.\n" );
+	}
+	else if( GLDebugMode::deferred == aMode )
+	{
+		glDebugMessageCallback( &callback_gldebug_deferred_, nullptr );
+		glEnable( GL_DEBUG_OUTPUT );
+
+		// Let the driver report messages whenever it gets to them, instead
+		// of on the thread and at the time of the offending call.
+		glDisable( GL_DEBUG_OUTPUT_SYNCHRONOUS );
+
+		// "Other" messages can be numerous (see callback_gldebug_()). Have
+		// the driver drop them, rather than queueing them only to discard
+		// them.
+		glDebugMessageControl( GL_DONT_CARE, GL_DEBUG_TYPE_OTHER, GL_DONT_CARE, 0, nullptr, GL_FALSE );
+
+		OGL_CHECKPOINT_ALWAYS();
+
+		gDeferred_ = true;
+		set_gl_checkpoints_enabled( false );
+		return;
+	}
+
+#	if !defined(NDEBUG)
 	glDebugMessageCallback( &callback_gldebug_, nullptr );
 	glEnable( GL_DEBUG_OUTPUT );
 
 	// Make sure the callback is called synchronously and from the same thread.
 	// This makes the debugger more useful.
 	glEnable( GL_DEBUG_OUTPUT_SYNCHRONOUS );
+#	endif // ~ !NDEBUG
+#	else // defined(__APPLE__)
+	if( GLDebugMode::deferred == aMode )
+		std::fprintf( stderr, "Note: debug output is not available; GL errors are checked synchronously.\n" );
 #	endif // ~ __APPLE__
 
 	OGL_CHECKPOINT_ALWAYS();
-#	endif // ~ !NDEBUG
+}
+
+std::size_t drain_gl_debug_output()
+{
+	if( !gDeferred_ )
+		return 0;
+
+	auto const now = Clock_::now();
+
+	auto const report_suppressed = [] (Site_& aSite) {
+		if( 0 == aSite.suppressed )
+			return;
+
+		std::fprintf( stderr, "OpenGL Debug: %s [%s]: %s (repeated %zu more times)\n", severity_str_(aSite.severity), type_str_(aSite.type), aSite.text.c_str(), aSite.suppressed );
+		aSite.suppressed = 0;
+	};
+
+	std::size_t count = 0;
+
+	Message_ message;
+	while( gMessages_.try_pop( message ) )
+	{
+		++count;
+
+		// Some drivers use the same ID for all errors, so the text is part of
+		// the key as well.
+		std::uint32_t const ids[] = { message.source, message.type, message.id };
+		auto const key = hash_string( message.text, hash_bytes( ids, sizeof(ids) ) );
+
+		auto it = gSites_.find( key );
+		if( gSites_.end() == it )
+			it = gSites_.emplace( key, Site_{ message.type, message.severity, message.text, now, 0, 0 } ).first;
+		auto& site = it->second;
+
+		if( now - site.windowStart >= kReportWindow_ )
+		{
+			report_suppressed( site );
+			site.windowStart = now;
+			site.reported = 0;
+		}
+
+		if( site.reported >= kReportsPerWindow_ )
+		{
+			++site.suppressed;
+			continue;
+		}
+
+		++site.reported;
+		std::fprintf( stderr, "OpenGL Debug: %s [%s]: %s\n", severity_str_(message.severity), type_str_(message.type), message.text );
+	}
+
+	// Sites that went quiet still report what they suppressed.
+	for( auto& [key, site] : gSites_ )
+	{
+		if( now - site.windowStart >= kReportWindow_ )
+			report_suppressed( site );
+	}
+
+	if( auto const dropped = gDropped_.exchange( 0, std::memory_order_relaxed ) )
+		std::fprintf( stderr, "OpenGL Debug: %zu message(s) dropped (queue full)\n", dropped );
+
+	return count;
 }
 
 namespace
 {
-#	if !defined(NDEBUG)
 	char const* type_str_( GLenum aType ) noexcept
 	{
 		switch( aType )
@@ -71,6 +292,7 @@ namespace
 		return "<unknown severity>";
 	}
 
+#	if !defined(NDEBUG)
 	void GLAPIENTRY callback_gldebug_( GLenum, GLenum aType, GLuint, GLenum aSeverity, GLsizei, GLchar const* aMessage, void const* /*aUser*/ )
 	{
 		// "Other" can be a bit spammy at times. However, it can include fairly
@@ -87,5 +309,11 @@ namespace
 			assert( false );
 	}
 #	endif // ~ !NDEBUG
-}
 
+	void GLAPIENTRY callback_gldebug_deferred_( GLenum aSource, GLenum aType, GLuint aId, GLenum aSeverity, GLsizei aLength, GLchar const* aMessage, void const* /*aUser*/ )
+	{
+		// May run on any thread. Must not block, allocate or call GL.
+		if( !gMessages_.try_push( aSource, aType, aId, aSeverity, aLength, aMessage ) )
+			gDropped_.fetch_add( 1, std::memory_order_relaxed );
+	}
+}
@@ -1,6 +1,28 @@
 #ifndef DEBUG_OUTPUT_HPP_91C7C3DF_B7F1_4025_B682_2456DFD7C05D
 #define DEBUG_OUTPUT_HPP_91C7C3DF_B7F1_4025_B682_2456DFD7C05D
 
-void setup_gl_debug_output();
+#include <cstddef>
+
+enum class GLDebugMode
+{
+	// Debug builds only: messages are printed from a synchronous callback,
+	// which asserts on errors. Checkpoints stay enabled.
+	synchronous,
+
+	// Any build: the driver reports messages asynchronously. They are queued
+	// in a lock-free ring buffer and printed by drain_gl_debug_output().
+	// Checkpoints are disabled, so nothing forces the driver to synchronize.
+	// Requires a debug context; without one, falls back to synchronous.
+	deferred
+};
+
+void setup_gl_debug_output( GLDebugMode = GLDebugMode::synchronous );
+
+// In deferred mode, prints the messages queued since the last call; call
+// once per frame. Messages are aggregated per site (source, type, ID and
+// text): each site prints at most a few messages per second, and the number
+// of suppressed ones is reported later. Returns the number of messages taken
+// from the queue. Does nothing in synchronous mode.
+std::size_t drain_gl_debug_output();
 
 #endif // DEBUG_OUTPUT_HPP_91C7C3DF_B7F1_4025_B682_2456DFD7C05D
@@ -0,0 +1,70 @@
+#include "frame_pacer.hpp"
+
+#include <chrono>
+
+#include "error.hpp"
+
+namespace
+{
+	constexpr GLuint64 kFenceTimeoutNs_ = 1'000'000'000; // 1s
+}
+
+FramePacer::FramePacer( std::size_t aMaxFramesInFlight )
+	: mMaxFramesInFlight( aMaxFramesInFlight )
+	, mWaitedMs( 0.0 )
+	, mStalls( 0 )
+{
+	if( 0 == aMaxFramesInFlight )
+		throw Error( "FramePacer: need at least one frame in flight (got zero)" );
+}
+
+FramePacer::~FramePacer()
+{
+	for( auto const fence : mFences )
+		glDeleteSync( fence );
+}
+
+void FramePacer::wait()
+{
+	while( mFences.size() >= mMaxFramesInFlight )
+	{
+		auto const fence = mFences.front();
+
+		// The flush bit makes sure that the fence is actually submitted;
+		// otherwise we might wait forever. Polling first keeps frames that
+		// are already done out of the statistics.
+		auto res = glClientWaitSync( fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0 );
+		if( GL_TIMEOUT_EXPIRED == res )
+		{
+			++mStalls;
+
+			auto const start = std::chrono::steady_clock::now();
+			do
+			{
+				res = glClientWaitSync( fence, 0, kFenceTimeoutNs_ );
+			} while( GL_TIMEOUT_EXPIRED == res );
+
+			mWaitedMs += std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+		}
+
+		mFences.pop_front();
+		glDeleteSync( fence );
+
+		if( GL_WAIT_FAILED == res )
+			throw Error( "FramePacer: glClientWaitSync() failed" );
+	}
+}
+
+void FramePacer::end_frame()
+{
+	mFences.emplace_back( glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 ) );
+}
+
+double FramePacer::waited_ms() const noexcept
+{
+	return mWaitedMs;
+}
+std::size_t FramePacer::stalls() const noexcept
+{
+	return mStalls;
+}
@@ -0,0 +1,49 @@
+#ifndef FRAME_PACER_HPP_9D1E62B4_57A3_4C0F_8E2B_C4A7F3168D05
+#define FRAME_PACER_HPP_9D1E62B4_57A3_4C0F_8E2B_C4A7F3168D05
+
+#include <glad/glad.h>
+
+#include <deque>
+
+#include <cstddef>
+
+// Limits the number of frames that the GPU may lag behind the CPU.
+//
+// Drivers typically let the CPU queue up several frames. This keeps the GPU
+// busy, but each queued frame adds a frame of latency between the input that
+// the CPU sampled and the moment the result appears. With a limit of one,
+// the CPU only starts a new frame once the GPU has finished the previous
+// one, so that input sampled afterwards is as fresh as possible.
+//
+// end_frame() inserts a fence after each frame (i.e., after the swap);
+// wait() waits for the oldest fences until fewer than the limit are in
+// flight. Unlike glFinish(), this doesn't drain the pipeline of the frame
+// that is being submitted, and the wait happens at a point of the caller's
+// choosing (before sampling input).
+class FramePacer final
+{
+	public:
+		explicit FramePacer( std::size_t aMaxFramesInFlight );
+		~FramePacer();
+
+		FramePacer( FramePacer const& ) = delete;
+		FramePacer& operator= (FramePacer const&) = delete;
+
+	public:
+		void wait();
+		void end_frame();
+
+		// Total time spent waiting in wait(), and the number of waits that
+		// actually had to block.
+		double waited_ms() const noexcept;
+		std::size_t stalls() const noexcept;
+
+	private:
+		std::size_t mMaxFramesInFlight;
+		std::deque<GLsync> mFences;
+
+		double mWaitedMs;
+		std::size_t mStalls;
+};
+
+#endif // FRAME_PACER_HPP_9D1E62B4_57A3_4C0F_8E2B_C4A7F3168D05
@@ -0,0 +1,488 @@
+#include "gl_capture.hpp"
+
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+#include "error.hpp"
+#include "gl_trace.hpp"
+
+namespace
+{
+	// Buffered data is written to the file in chunks of this size.
+	constexpr std::size_t kFlushThreshold_ = 4*1024*1024;
+
+	// Mapped memory is compared in blocks of this size. Runs of changed
+	// blocks are recorded.
+	constexpr std::size_t kMappedBlock_ = 256;
+
+	struct Mapping_
+	{
+		GLuint buffer;
+		std::byte const* data;
+		std::size_t size;
+
+		std::vector<std::byte> shadow; // last recorded contents
+	};
+
+	struct Capture_
+	{
+		std::FILE* file = nullptr;
+		std::vector<std::byte> pending;
+
+		std::size_t frames = 0;
+		bool setupDone = false;
+
+		// Set by any call other than a draw; see gl_capture.hpp
+		bool checkMappings = true;
+
+		GLint unpackAlignment = 4;
+		std::vector<Mapping_> mappings;
+
+		GLCaptureStats stats{};
+	};
+
+	// Read by every wrapper
+	bool gCapturing_ = false;
+
+	Capture_ gCapture_;
+	GLADloadproc gLoader_ = nullptr;
+
+	// Real function pointers, indexed by GLTraceFunction
+	void* gReal_[std::size_t(GLTraceFunction::count)] = {};
+
+	// Queries made by the recorder itself go to the real functions, so that
+	// they don't end up in the trace.
+	void real_get_integerv_( GLenum aName, GLint* aValue )
+	{
+		reinterpret_cast<PFNGLGETINTEGERVPROC>(gReal_[std::size_t(GLTraceFunction::GetIntegerv)])( aName, aValue );
+	}
+
+	void flush_();
+	void write_( void const* aData, std::size_t aSize )
+	{
+		auto const* bytes = static_cast<std::byte const*>(aData);
+		gCapture_.pending.insert( gCapture_.pending.end(), bytes, bytes+aSize );
+
+		if( gCapture_.pending.size() >= kFlushThreshold_ )
+			flush_();
+	}
+
+	template< typename tType >
+	void write_value_( tType aValue )
+	{
+		if constexpr( std::is_pointer_v<tType> )
+		{
+			auto const value = std::uint64_t(reinterpret_cast<std::uintptr_t>(aValue));
+			write_( &value, sizeof(value) );
+		}
+		else
+		{
+			static_assert( std::is_arithmetic_v<tType> );
+			write_( &aValue, sizeof(aValue) );
+		}
+	}
+
+	void write_data_( void const* aData, std::size_t aSize )
+	{
+		std::uint8_t const present = aData ? 1 : 0;
+		write_value_( present );
+
+		if( aData )
+			write_( aData, aSize );
+	}
+
+	void write_names_( GLsizei aCount, GLuint const* aNames )
+	{
+		if( aCount > 0 )
+			write_( aNames, std::size_t(aCount) * sizeof(GLuint) );
+	}
+
+	GLuint bound_buffer_( GLenum aTarget )
+	{
+		GLenum binding = 0;
+		switch( aTarget )
+		{
+			case GL_ARRAY_BUFFER: binding = GL_ARRAY_BUFFER_BINDING; break;
+			case GL_ELEMENT_ARRAY_BUFFER: binding = GL_ELEMENT_ARRAY_BUFFER_BINDING; break;
+			case GL_COPY_READ_BUFFER: binding = GL_COPY_READ_BUFFER_BINDING; break;
+			case GL_COPY_WRITE_BUFFER: binding = GL_COPY_WRITE_BUFFER_BINDING; break;
+			case GL_PIXEL_PACK_BUFFER: binding = GL_PIXEL_PACK_BUFFER_BINDING; break;
+			case GL_PIXEL_UNPACK_BUFFER: binding = GL_PIXEL_UNPACK_BUFFER_BINDING; break;
+			case GL_UNIFORM_BUFFER: binding = GL_UNIFORM_BUFFER_BINDING; break;
+			case GL_SHADER_STORAGE_BUFFER: binding = GL_SHADER_STORAGE_BUFFER_BINDING; break;
+			case GL_DRAW_INDIRECT_BUFFER: binding = GL_DRAW_INDIRECT_BUFFER_BINDING; break;
+			case GL_DISPATCH_INDIRECT_BUFFER: binding = GL_DISPATCH_INDIRECT_BUFFER_BINDING; break;
+			case GL_ATOMIC_COUNTER_BUFFER: binding = GL_ATOMIC_COUNTER_BUFFER_BINDING; break;
+			case GL_QUERY_BUFFER: binding = GL_QUERY_BUFFER_BINDING; break;
+			case GL_TRANSFORM_FEEDBACK_BUFFER: binding = GL_TRANSFORM_FEEDBACK_BUFFER_BINDING; break;
+			case GL_PARAMETER_BUFFER: binding = GL_PARAMETER_BUFFER_BINDING; break;
+			default: return 0;
+		}
+
+		GLint buffer = 0;
+		real_get_integerv_( binding, &buffer );
+		return GLuint(buffer);
+	}
+
+	void record_mapped_writes_()
+	{
+		for( auto& mapping : gCapture_.mappings )
+		{
+			auto const emit = [&mapping] (std::size_t aOffset, std::size_t aSize) {
+				auto const tag = std::uint16_t(GLTraceTag::mappedWrite);
+				auto const offset = std::uint64_t(aOffset), size = std::uint64_t(aSize);
+				write_value_( tag );
+				write_value_( std::uint32_t(mapping.buffer) );
+				write_value_( offset );
+				write_value_( size );
+				write_( mapping.data + aOffset, aSize );
+
+				std::memcpy( mapping.shadow.data() + aOffset, mapping.data + aOffset, aSize );
+				gCapture_.stats.mappedBytes += aSize;
+			};
+
+			// Nothing is known about the contents of a new mapping.
+			if( mapping.shadow.empty() )
+			{
+				mapping.shadow.resize( mapping.size );
+				emit( 0, mapping.size );
+				continue;
+			}
+
+			constexpr auto kNone = ~std::size_t(0);
+			std::size_t runStart = kNone;
+			for( std::size_t offset = 0; ; offset += kMappedBlock_ )
+			{
+				bool const end = offset >= mapping.size;
+				bool const changed = !end && 0 != std::memcmp( mapping.data + offset, mapping.shadow.data() + offset, std::min( kMappedBlock_, mapping.size-offset ) );
+
+				if( changed && kNone == runStart )
+				{
+					runStart = offset;
+				}
+				else if( !changed && kNone != runStart )
+				{
+					emit( runStart, std::min( offset, mapping.size ) - runStart );
+					runStart = kNone;
+				}
+
+				if( end )
+					break;
+			}
+		}
+	}
+
+	void begin_call_( GLTraceFunction aFunction )
+	{
+		bool const consumes = (kGLTraceFunctionFlags[std::size_t(aFunction)] & kGLTraceDraw) || GLTraceFunction::UnmapBuffer == aFunction;
+
+		if( consumes && gCapture_.checkMappings )
+			record_mapped_writes_();
+
+		gCapture_.checkMappings = !consumes;
+
+		auto const tag = std::uint16_t(aFunction);
+		write_value_( tag );
+		++gCapture_.stats.calls;
+	}
+
+	// Inputs and outputs behind pointers, see gl_trace.hpp. before() runs
+	// after the arguments were written, after() after the result.
+	struct NoPayload_
+	{
+		template< typename... tArgs > static void before( tArgs const&... ) {}
+		template< typename... tArgs > static void after( tArgs const&... ) {}
+	};
+
+	template< GLTraceFunction >
+	struct Payload_ : NoPayload_
+	{};
+
+	template<> struct Payload_<GLTraceFunction::BufferData> : NoPayload_
+	{
+		static void before( GLenum, GLsizeiptr aSize, void const* aData, GLenum ) { write_data_( aData, std::size_t(aSize) ); }
+	};
+	template<> struct Payload_<GLTraceFunction::BufferStorage> : NoPayload_
+	{
+		static void before( GLenum, GLsizeiptr aSize, void const* aData, GLbitfield ) { write_data_( aData, std::size_t(aSize) ); }
+	};
+	template<> struct Payload_<GLTraceFunction::BufferSubData> : NoPayload_
+	{
+		static void before( GLenum, GLintptr, GLsizeiptr aSize, void const* aData ) { write_data_( aData, std::size_t(aSize) ); }
+	};
+	template<> struct Payload_<GLTraceFunction::ClearBufferData> : NoPayload_
+	{
+		static void before( GLenum, GLenum, GLenum aFormat, GLenum aType, void const* aData ) { write_data_( aData, gl_trace_image_size( 1, 1, aFormat, aType, 1 ) ); }
+	};
+
+	template<> struct Payload_<GLTraceFunction::ShaderSource> : NoPayload_
+	{
+		static void before( GLuint, GLsizei aCount, GLchar const* const* aStrings, GLint const* aLengths )
+		{
+			for( GLsizei i = 0; i < aCount; ++i )
+			{
+				auto const length = std::uint32_t(aLengths && aLengths[i] >= 0 ? std::size_t(aLengths[i]) : std::strlen( aStrings[i] ));
+				write_value_( length );
+				write_( aStrings[i], length );
+			}
+		}
+	};
+	template<> struct Payload_<GLTraceFunction::ProgramBinary> : NoPayload_
+	{
+		static void before( GLuint, GLenum, void const* aBinary, GLsizei aLength ) { write_data_( aBinary, std::size_t(aLength) ); }
+	};
+	template<> struct Payload_<GLTraceFunction::ProgramUniformMatrix4fv> : NoPayload_
+	{
+		static void before( GLuint, GLint, GLsizei aCount, GLboolean, GLfloat const* aValue ) { write_data_( aValue, std::size_t(aCount) * 16 * sizeof(GLfloat) ); }
+	};
+
+	template<> struct Payload_<GLTraceFunction::DebugMessageControl> : NoPayload_
+	{
+		static void before( GLenum, GLenum, GLenum, GLsizei aCount, GLuint const* aIds, GLboolean ) { write_data_( aIds, std::size_t(aCount) * sizeof(GLuint) ); }
+	};
+	template<> struct Payload_<GLTraceFunction::GetProgramResourceiv> : NoPayload_
+	{
+		static void before( GLuint, GLenum, GLuint, GLsizei aPropCount, GLenum const* aProps, GLsizei, GLsizei*, GLint* ) { write_data_( aProps, std::size_t(aPropCount) * sizeof(GLenum) ); }
+	};
+
+	// Object names
+	struct DeletePayload_ : NoPayload_
+	{
+		static void before( GLsizei aCount, GLuint const* aNames ) { write_names_( aCount, aNames ); }
+	};
+	struct GenPayload_ : NoPayload_
+	{
+		static void after( GLsizei aCount, GLuint const* aNames ) { write_names_( aCount, aNames ); }
+	};
+
+	template<> struct Payload_<GLTraceFunction::DeleteBuffers> : DeletePayload_ {};
+	template<> struct Payload_<GLTraceFunction::DeleteFramebuffers> : DeletePayload_ {};
+	template<> struct Payload_<GLTraceFunction::DeleteQueries> : DeletePayload_ {};
+	template<> struct Payload_<GLTraceFunction::DeleteTextures> : DeletePayload_ {};
+	template<> struct Payload_<GLTraceFunction::DeleteVertexArrays> : DeletePayload_ {};
+	template<> struct Payload_<GLTraceFunction::GenBuffers> : GenPayload_ {};
+	template<> struct Payload_<GLTraceFunction::GenFramebuffers> : GenPayload_ {};
+	template<> struct Payload_<GLTraceFunction::GenQueries> : GenPayload_ {};
+	template<> struct Payload_<GLTraceFunction::GenTextures> : GenPayload_ {};
+	template<> struct Payload_<GLTraceFunction::GenVertexArrays> : GenPayload_ {};
+
+	// Pixel transfers. Pointers are offsets into the pack/unpack buffer if
+	// one is bound; otherwise, uploads are recorded and downloads go to
+	// scratch memory during replay.
+	template<> struct Payload_<GLTraceFunction::PixelStorei> : NoPayload_
+	{
+		static void after( GLenum aName, GLint aValue )
+		{
+			if( GL_UNPACK_ALIGNMENT == aName )
+				gCapture_.unpackAlignment = aValue;
+		}
+	};
+	template<> struct Payload_<GLTraceFunction::TexImage2D> : NoPayload_
+	{
+		static void before( GLenum, GLint, GLint, GLsizei aWidth, GLsizei aHeight, GLint, GLenum aFormat, GLenum aType, void const* aPixels )
+		{
+			bool const client = aPixels && 0 == bound_buffer_( GL_PIXEL_UNPACK_BUFFER );
+			write_data_( client ? aPixels : nullptr, gl_trace_image_size( aWidth, aHeight, aFormat, aType, gCapture_.unpackAlignment ) );
+		}
+	};
+	template<> struct Payload_<GLTraceFunction::TexSubImage2D> : NoPayload_
+	{
+		static void before( GLenum, GLint, GLint, GLint, GLsizei aWidth, GLsizei aHeight, GLenum aFormat, GLenum aType, void const* aPixels )
+		{
+			bool const client = aPixels && 0 == bound_buffer_( GL_PIXEL_UNPACK_BUFFER );
+			write_data_( client ? aPixels : nullptr, gl_trace_image_size( aWidth, aHeight, aFormat, aType, gCapture_.unpackAlignment ) );
+		}
+	};
+	template<> struct Payload_<GLTraceFunction::ReadPixels> : NoPayload_
+	{
+		static void before( GLint, GLint, GLsizei, GLsizei, GLenum, GLenum, void* )
+		{
+			std::uint8_t const packBuffer = 0 != bound_buffer_( GL_PIXEL_PACK_BUFFER );
+			write_value_( packBuffer );
+		}
+	};
+
+	// Mappings
+	template<> struct Payload_<GLTraceFunction::MapBufferRange> : NoPayload_
+	{
+		static void after( GLenum aTarget, GLintptr, GLsizeiptr aLength, GLbitfield aAccess, void* aResult )
+		{
+			auto const buffer = bound_buffer_( aTarget );
+			write_value_( std::uint32_t(buffer) );
+
+			if( aResult && (aAccess & GL_MAP_WRITE_BIT) )
+				gCapture_.mappings.emplace_back( Mapping_{ buffer, static_cast<std::byte const*>(aResult), std::size_t(aLength), {} } );
+		}
+	};
+	template<> struct Payload_<GLTraceFunction::UnmapBuffer> : NoPayload_
+	{
+		static void before( GLenum aTarget )
+		{
+			write_value_( std::uint32_t(bound_buffer_( aTarget )) );
+		}
+		static void after( GLenum aTarget, GLboolean )
+		{
+			auto const buffer = bound_buffer_( aTarget );
+			std::erase_if( gCapture_.mappings, [buffer] (Mapping_ const& aMapping) {
+				return aMapping.buffer == buffer;
+			} );
+		}
+	};
+
+	// Recording wrapper for one function
+	template< GLTraceFunction tFn, typename tPfn >
+	struct Hook_;
+
+	template< GLTraceFunction tFn, typename tRet, typename... tArgs >
+	struct Hook_< tFn, tRet (APIENTRYP)(tArgs...) >
+	{
+		static tRet APIENTRY call( tArgs... aArgs )
+		{
+			auto const real = reinterpret_cast<tRet (APIENTRYP)(tArgs...)>( gReal_[std::size_t(tFn)] );
+			if( !gCapturing_ )
+				return real( aArgs... );
+
+			begin_call_( tFn );
+			(write_value_( aArgs ), ...);
+			Payload_<tFn>::before( aArgs... );
+
+			if constexpr( std::is_void_v<tRet> )
+			{
+				real( aArgs... );
+				Payload_<tFn>::after( aArgs... );
+			}
+			else
+			{
+				tRet const ret = real( aArgs... );
+				write_value_( ret );
+				Payload_<tFn>::after( aArgs..., ret );
+				return ret;
+			}
+		}
+	};
+
+	void* const kHooks_[] = {
+#		define GLTRACE_HOOK_( name, flags ) reinterpret_cast<void*>(&Hook_<GLTraceFunction::name, decltype(glad_gl##name)>::call),
+		GLTRACE_FUNCTIONS( GLTRACE_HOOK_ )
+#		undef GLTRACE_HOOK_
+	};
+
+	static_assert( std::size(kHooks_) == std::size_t(GLTraceFunction::count) );
+
+	void* capture_loader_( char const* aName )
+	{
+		void* const real = gLoader_( aName );
+		if( !real || 0 != std::strncmp( aName, "gl", 2 ) )
+			return real;
+
+		for( std::size_t i = 0; i < std::size_t(GLTraceFunction::count); ++i )
+		{
+			if( 0 == std::strcmp( aName+2, kGLTraceFunctionNames[i] ) )
+			{
+				gReal_[i] = real;
+				return kHooks_[i];
+			}
+		}
+
+		return real;
+	}
+
+	void flush_()
+	{
+		auto& capture = gCapture_;
+		if( capture.pending.empty() || !capture.file )
+			return;
+
+		if( capture.pending.size() != std::fwrite( capture.pending.data(), 1, capture.pending.size(), capture.file ) )
+		{
+			// This runs inside of GL calls, so don't throw.
+			std::fprintf( stderr, "Warning: unable to write GL capture. Capture stopped.\n" );
+			std::fclose( capture.file );
+			capture.file = nullptr;
+			gCapturing_ = false;
+		}
+
+		capture.stats.bytes += capture.pending.size();
+		capture.pending.clear();
+	}
+}
+
+GLADloadproc gl_capture_begin( GLCaptureConfig const& aConfig, GLADloadproc aLoader )
+{
+	if( gCapture_.file )
+		throw Error( "gl_capture_begin(): a capture is already running" );
+
+	std::FILE* file = std::fopen( aConfig.path.string().c_str(), "wb" );
+	if( !file )
+		throw Error( "gl_capture_begin(): unable to open '%s' for writing", aConfig.path.string().c_str() );
+
+	gCapture_ = Capture_{};
+	gCapture_.file = file;
+	gCapture_.frames = aConfig.frames;
+	gLoader_ = aLoader;
+
+	write_value_( kGLTraceMagic );
+	write_value_( kGLTraceVersion );
+	write_value_( std::uint32_t(GLTraceFunction::count) );
+
+	for( auto const* name : kGLTraceFunctionNames )
+	{
+		auto const length = std::uint16_t(std::strlen( name ));
+		write_value_( length );
+		write_( name, length );
+	}
+
+	gCapturing_ = true;
+	return &capture_loader_;
+}
+
+void gl_capture_frame()
+{
+	if( !gCapturing_ )
+		return;
+
+	write_value_( std::uint16_t(GLTraceTag::frame) );
+	gCapture_.checkMappings = true;
+
+	if( !gCapture_.setupDone )
+	{
+		gCapture_.setupDone = true;
+		return;
+	}
+
+	if( ++gCapture_.stats.frames >= gCapture_.frames )
+		gl_capture_end();
+}
+
+void gl_capture_end()
+{
+	if( !gCapture_.file )
+		return;
+
+	if( gCapturing_ )
+		write_value_( std::uint16_t(GLTraceTag::end) );
+
+	flush_();
+
+	if( gCapture_.file )
+		std::fclose( gCapture_.file );
+
+	gCapture_.file = nullptr;
+	gCapture_.mappings.clear();
+	gCapturing_ = false;
+}
+
+bool gl_capture_active() noexcept
+{
+	return gCapturing_;
+}
+
+GLCaptureStats gl_capture_stats() noexcept
+{
+	return gCapture_.stats;
+}
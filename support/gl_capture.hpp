@@ -0,0 +1,61 @@
+#ifndef GL_CAPTURE_HPP_F31113C9_373B_44E6_8FEB_83D8F20184DC
+#define GL_CAPTURE_HPP_F31113C9_373B_44E6_8FEB_83D8F20184DC
+
+#include <glad/glad.h>
+
+#include <filesystem>
+
+#include <cstddef>
+
+// GL command capture
+//
+// Records GL calls, with their arguments and the data that they reference
+// (buffer contents, shader sources, program binaries, ...), into a binary
+// trace that the glreplay tool plays back. See gl_trace.hpp for the format.
+//
+// Capturing hooks into glad's loader: the loader returned by
+// gl_capture_begin() hands glad a recording wrapper for each function listed
+// in gl_trace.hpp, so capturing must begin before gladLoadGLLoader(). Calls
+// made before the first gl_capture_frame() are setup; after that, each
+// gl_capture_frame() ends a frame. Once the requested number of frames has
+// been recorded, the trace is closed and the wrappers just forward calls.
+//
+// Memory written through write mappings (e.g., UniformRing's persistent
+// mapping) is compared against its last recorded contents before a draw or
+// dispatch, if any other GL call was made since the last draw or dispatch.
+// Changed ranges are recorded. Writes to mapped memory between two
+// consecutive draws (without any GL call in between) are thus not seen.
+//
+// Only a single thread may make GL calls while capturing.
+struct GLCaptureConfig
+{
+	bool enabled = false;
+
+	std::filesystem::path path;
+	std::size_t frames = 10;
+};
+
+struct GLCaptureStats
+{
+	std::size_t calls;
+	std::size_t frames;
+	std::size_t mappedBytes; // recorded from write mappings
+	std::size_t bytes; // size of the trace
+};
+
+// Starts capturing to aConfig.path. Returns the loader to pass to
+// gladLoadGLLoader(), which in turn gets the functions from aLoader. Throws
+// if the file can't be created.
+GLADloadproc gl_capture_begin( GLCaptureConfig const&, GLADloadproc aLoader );
+
+// Marks the end of the setup, or of a frame.
+void gl_capture_frame();
+
+// Closes the trace early (e.g., at exit). Does nothing if no capture is
+// running.
+void gl_capture_end();
+
+bool gl_capture_active() noexcept;
+GLCaptureStats gl_capture_stats() noexcept;
+
+#endif // GL_CAPTURE_HPP_F31113C9_373B_44E6_8FEB_83D8F20184DC
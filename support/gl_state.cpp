@@ -0,0 +1,248 @@
+#include "gl_state.hpp"
+
+#include <algorithm>
+
+std::size_t GLStateStats::total_issued() const noexcept
+{
+	std::size_t ret = 0;
+	for( auto const count : issued )
+		ret += count;
+	return ret;
+}
+std::size_t GLStateStats::total_elided() const noexcept
+{
+	std::size_t ret = 0;
+	for( auto const count : elided )
+		ret += count;
+	return ret;
+}
+
+GLStateCache::GLStateCache()
+	: mFrame{}
+	, mTotal{}
+	, mFrames( 0 )
+{
+	invalidate();
+}
+
+bool GLStateCache::use_program( GLuint aProgram )
+{
+	if( !count_( GLStateCall::program, !mProgramValid || aProgram != mProgram ) )
+		return false;
+
+	glUseProgram( aProgram );
+	mProgram = aProgram;
+	mProgramValid = true;
+	return true;
+}
+
+bool GLStateCache::bind_vertex_array( GLuint aVertexArray )
+{
+	if( !count_( GLStateCall::vertexArray, !mVertexArrayValid || aVertexArray != mVertexArray ) )
+		return false;
+
+	glBindVertexArray( aVertexArray );
+	mVertexArray = aVertexArray;
+	mVertexArrayValid = true;
+	return true;
+}
+
+bool GLStateCache::bind_buffer( GLenum aTarget, GLuint aBuffer )
+{
+	// Part of the VAO's state, see class comment.
+	if( GL_ELEMENT_ARRAY_BUFFER == aTarget )
+	{
+		count_( GLStateCall::buffer, true );
+		glBindBuffer( aTarget, aBuffer );
+		return true;
+	}
+
+	auto const* binding = find_binding_( aTarget, kGeneric_ );
+	if( !count_( GLStateCall::buffer, !binding || aBuffer != binding->buffer ) )
+		return false;
+
+	glBindBuffer( aTarget, aBuffer );
+	set_binding_( aTarget, kGeneric_, aBuffer, -1, 0 );
+	return true;
+}
+
+bool GLStateCache::bind_buffer_base( GLenum aTarget, GLuint aIndex, GLuint aBuffer )
+{
+	auto const* binding = find_binding_( aTarget, aIndex );
+	if( !count_( GLStateCall::indexedBuffer, !binding || aBuffer != binding->buffer || -1 != binding->offset ) )
+		return false;
+
+	glBindBufferBase( aTarget, aIndex, aBuffer );
+
+	// Also binds the buffer to the generic binding point.
+	set_binding_( aTarget, aIndex, aBuffer, -1, 0 );
+	set_binding_( aTarget, kGeneric_, aBuffer, -1, 0 );
+	return true;
+}
+
+bool GLStateCache::bind_buffer_range( GLenum aTarget, GLuint aIndex, GLuint aBuffer, GLintptr aOffset, GLsizeiptr aSize )
+{
+	auto const* binding = find_binding_( aTarget, aIndex );
+	if( !count_( GLStateCall::indexedBuffer, !binding || aBuffer != binding->buffer || aOffset != binding->offset || aSize != binding->size ) )
+		return false;
+
+	glBindBufferRange( aTarget, aIndex, aBuffer, aOffset, aSize );
+
+	set_binding_( aTarget, aIndex, aBuffer, aOffset, aSize );
+	set_binding_( aTarget, kGeneric_, aBuffer, -1, 0 );
+	return true;
+}
+
+bool GLStateCache::enable( GLenum aCapability )
+{
+	return set_enabled( aCapability, true );
+}
+bool GLStateCache::disable( GLenum aCapability )
+{
+	return set_enabled( aCapability, false );
+}
+bool GLStateCache::set_enabled( GLenum aCapability, bool aEnabled )
+{
+	auto it = std::find_if( mCapabilities.begin(), mCapabilities.end(), [aCapability] (Capability_ const& aCap) {
+		return aCap.capability == aCapability;
+	} );
+
+	if( !count_( GLStateCall::capability, mCapabilities.end() == it || aEnabled != it->enabled ) )
+		return false;
+
+	if( aEnabled )
+		glEnable( aCapability );
+	else
+		glDisable( aCapability );
+
+	if( mCapabilities.end() == it )
+		mCapabilities.emplace_back( Capability_{ aCapability, aEnabled } );
+	else
+		it->enabled = aEnabled;
+
+	return true;
+}
+
+bool GLStateCache::polygon_mode( GLenum aMode )
+{
+	if( !count_( GLStateCall::polygonMode, !mPolygonModeValid || aMode != mPolygonMode ) )
+		return false;
+
+	glPolygonMode( GL_FRONT_AND_BACK, aMode );
+	mPolygonMode = aMode;
+	mPolygonModeValid = true;
+	return true;
+}
+
+bool GLStateCache::viewport( GLint aX, GLint aY, GLsizei aWidth, GLsizei aHeight )
+{
+	GLint const viewport[4] = { aX, aY, aWidth, aHeight };
+	if( !count_( GLStateCall::viewport, !mViewportValid || !std::equal( viewport, viewport+4, mViewport ) ) )
+		return false;
+
+	glViewport( aX, aY, aWidth, aHeight );
+	std::copy( viewport, viewport+4, mViewport );
+	mViewportValid = true;
+	return true;
+}
+
+bool GLStateCache::clear_color( float aRed, float aGreen, float aBlue, float aAlpha )
+{
+	float const color[4] = { aRed, aGreen, aBlue, aAlpha };
+	if( !count_( GLStateCall::clearColor, !mClearColorValid || !std::equal( color, color+4, mClearColor ) ) )
+		return false;
+
+	glClearColor( aRed, aGreen, aBlue, aAlpha );
+	std::copy( color, color+4, mClearColor );
+	mClearColorValid = true;
+	return true;
+}
+
+void GLStateCache::invalidate() noexcept
+{
+	mProgramValid = mVertexArrayValid = false;
+	mProgram = mVertexArray = 0;
+
+	mBindings.clear();
+	mCapabilities.clear();
+
+	mPolygonModeValid = false;
+	mPolygonMode = GL_FILL;
+
+	mViewportValid = false;
+	std::fill( mViewport, mViewport+4, 0 );
+
+	mClearColorValid = false;
+	std::fill( mClearColor, mClearColor+4, 0.f );
+}
+
+GLStateStats GLStateCache::end_frame() noexcept
+{
+	auto const frame = mFrame;
+
+	for( std::size_t i = 0; i < std::size_t(GLStateCall::count); ++i )
+	{
+		mTotal.issued[i] += frame.issued[i];
+		mTotal.elided[i] += frame.elided[i];
+	}
+
+	mFrame = GLStateStats{};
+	++mFrames;
+
+	return frame;
+}
+
+GLStateStats const& GLStateCache::total_stats() const noexcept
+{
+	return mTotal;
+}
+
+std::size_t GLStateCache::frames() const noexcept
+{
+	return mFrames;
+}
+
+bool GLStateCache::count_( GLStateCall aCall, bool aIssue ) noexcept
+{
+	auto const index = std::size_t(aCall);
+	++(aIssue ? mFrame.issued[index] : mFrame.elided[index]);
+	return aIssue;
+}
+
+GLStateCache::Binding_* GLStateCache::find_binding_( GLenum aTarget, GLuint aIndex ) noexcept
+{
+	// Only a handful of bindings are ever in use.
+	for( auto& binding : mBindings )
+	{
+		if( binding.target == aTarget && binding.index == aIndex )
+			return &binding;
+	}
+
+	return nullptr;
+}
+
+void GLStateCache::set_binding_( GLenum aTarget, GLuint aIndex, GLuint aBuffer, GLintptr aOffset, GLsizeiptr aSize )
+{
+	if( auto* binding = find_binding_( aTarget, aIndex ) )
+		*binding = Binding_{ aTarget, aIndex, aBuffer, aOffset, aSize };
+	else
+		mBindings.emplace_back( Binding_{ aTarget, aIndex, aBuffer, aOffset, aSize } );
+}
+
+char const* gl_state_call_name( GLStateCall aCall ) noexcept
+{
+	switch( aCall )
+	{
+		case GLStateCall::program: return "program";
+		case GLStateCall::vertexArray: return "vertex array";
+		case GLStateCall::buffer: return "buffer";
+		case GLStateCall::indexedBuffer: return "indexed buffer";
+		case GLStateCall::capability: return "enable/disable";
+		case GLStateCall::polygonMode: return "polygon mode";
+		case GLStateCall::viewport: return "viewport";
+		case GLStateCall::clearColor: return "clear color";
+		case GLStateCall::count: break;
+	}
+
+	return "<unknown>";
+}
@@ -0,0 +1,134 @@
+#ifndef GL_STATE_HPP_D3A355C7_4968_4A42_9246_A47E7F1707F6
+#define GL_STATE_HPP_D3A355C7_4968_4A42_9246_A47E7F1707F6
+
+#include <glad/glad.h>
+
+#include <vector>
+
+#include <cstddef>
+
+// Kinds of calls made through GLStateCache
+enum class GLStateCall : std::size_t
+{
+	program,        // glUseProgram()
+	vertexArray,    // glBindVertexArray()
+	buffer,         // glBindBuffer()
+	indexedBuffer,  // glBindBufferBase(), glBindBufferRange()
+	capability,     // glEnable(), glDisable()
+	polygonMode,    // glPolygonMode()
+	viewport,       // glViewport()
+	clearColor,     // glClearColor()
+
+	count
+};
+
+struct GLStateStats
+{
+	std::size_t issued[std::size_t(GLStateCall::count)];
+	std::size_t elided[std::size_t(GLStateCall::count)];
+
+	std::size_t total_issued() const noexcept;
+	std::size_t total_elided() const noexcept;
+};
+
+// Cache of GL state that elides redundant calls
+//
+// Each setter compares the requested state with the last state set through
+// the cache, and only calls into the GL if it differs. Setters return true if
+// they made a GL call. Initially, all state is unknown, so the first call of
+// each kind is always issued.
+//
+// The cache only knows about state that was set through it. Code that changes
+// the same state directly must either restore it (e.g., bind 0 again if the
+// cache hasn't bound anything else to that target) or call invalidate().
+// Likewise, deleting a bound buffer or VAO unbinds it in the GL; call
+// invalidate() afterwards, since the name may be reused. Element array buffer
+// bindings belong to the VAO and are therefore not cached.
+//
+// Calls are counted per kind, both issued and elided. end_frame() returns the
+// counts for the frame and adds them to the totals.
+//
+// Must only be used from the thread of the GL context.
+class GLStateCache final
+{
+	public:
+		GLStateCache();
+
+		GLStateCache( GLStateCache const& ) = delete;
+		GLStateCache& operator= (GLStateCache const&) = delete;
+
+	public:
+		bool use_program( GLuint );
+		bool bind_vertex_array( GLuint );
+
+		bool bind_buffer( GLenum aTarget, GLuint aBuffer );
+		bool bind_buffer_base( GLenum aTarget, GLuint aIndex, GLuint aBuffer );
+		bool bind_buffer_range( GLenum aTarget, GLuint aIndex, GLuint aBuffer, GLintptr aOffset, GLsizeiptr aSize );
+
+		bool enable( GLenum aCapability );
+		bool disable( GLenum aCapability );
+		bool set_enabled( GLenum aCapability, bool aEnabled );
+
+		// Core profiles only support GL_FRONT_AND_BACK.
+		bool polygon_mode( GLenum aMode );
+
+		bool viewport( GLint aX, GLint aY, GLsizei aWidth, GLsizei aHeight );
+		bool clear_color( float aRed, float aGreen, float aBlue, float aAlpha );
+
+		// Forgets all state. The next call of each kind is issued.
+		void invalidate() noexcept;
+
+	public:
+		GLStateStats end_frame() noexcept;
+
+		GLStateStats const& total_stats() const noexcept;
+		std::size_t frames() const noexcept;
+
+	private:
+		// Indexed bindings use kGeneric_ for the target's generic binding.
+		static constexpr GLuint kGeneric_ = ~GLuint(0);
+
+		struct Binding_
+		{
+			GLenum target;
+			GLuint index;
+
+			GLuint buffer;
+			GLintptr offset; // -1: whole buffer (glBindBufferBase)
+			GLsizeiptr size;
+		};
+
+		struct Capability_
+		{
+			GLenum capability;
+			bool enabled;
+		};
+
+		bool count_( GLStateCall, bool aIssue ) noexcept;
+
+		Binding_* find_binding_( GLenum aTarget, GLuint aIndex ) noexcept;
+		void set_binding_( GLenum aTarget, GLuint aIndex, GLuint aBuffer, GLintptr aOffset, GLsizeiptr aSize );
+
+	private:
+		bool mProgramValid, mVertexArrayValid;
+		GLuint mProgram, mVertexArray;
+
+		std::vector<Binding_> mBindings;
+		std::vector<Capability_> mCapabilities;
+
+		bool mPolygonModeValid;
+		GLenum mPolygonMode;
+
+		bool mViewportValid;
+		GLint mViewport[4];
+
+		bool mClearColorValid;
+		float mClearColor[4];
+
+		GLStateStats mFrame, mTotal;
+		std::size_t mFrames;
+};
+
+char const* gl_state_call_name( GLStateCall ) noexcept;
+
+#endif // GL_STATE_HPP_D3A355C7_4968_4A42_9246_A47E7F1707F6
@@ -0,0 +1,41 @@
+#include "gl_trace.hpp"
+
+#include <glad/glad.h>
+
+std::size_t gl_trace_image_size( int aWidth, int aHeight, unsigned aFormat, unsigned aType, int aAlignment ) noexcept
+{
+	std::size_t components = 0;
+	switch( aFormat )
+	{
+		case GL_RED: case GL_RED_INTEGER: case GL_DEPTH_COMPONENT: case GL_STENCIL_INDEX: components = 1; break;
+		case GL_RG: case GL_RG_INTEGER: case GL_DEPTH_STENCIL: components = 2; break;
+		case GL_RGB: case GL_RGB_INTEGER: case GL_BGR: components = 3; break;
+		case GL_RGBA: case GL_RGBA_INTEGER: case GL_BGRA: components = 4; break;
+		default: return 0;
+	}
+
+	std::size_t pixel = 0;
+	switch( aType )
+	{
+		case GL_UNSIGNED_BYTE: case GL_BYTE: pixel = components; break;
+		case GL_UNSIGNED_SHORT: case GL_SHORT: case GL_HALF_FLOAT: pixel = 2*components; break;
+		case GL_UNSIGNED_INT: case GL_INT: case GL_FLOAT: pixel = 4*components; break;
+
+		// Packed types hold all components in one value.
+		case GL_UNSIGNED_INT_24_8: case GL_UNSIGNED_INT_8_8_8_8: case GL_UNSIGNED_INT_8_8_8_8_REV:
+		case GL_UNSIGNED_INT_2_10_10_10_REV: case GL_UNSIGNED_INT_10F_11F_11F_REV:
+			pixel = 4;
+			break;
+
+		default: return 0;
+	}
+
+	if( aWidth <= 0 || aHeight <= 0 )
+		return 0;
+
+	auto const alignment = std::size_t(aAlignment > 0 ? aAlignment : 1);
+	auto const row = (std::size_t(aWidth) * pixel + alignment-1) / alignment * alignment;
+
+	// The last row isn't padded.
+	return row * std::size_t(aHeight-1) + std::size_t(aWidth) * pixel;
+}
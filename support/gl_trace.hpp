@@ -0,0 +1,179 @@
+#ifndef GL_TRACE_HPP_CC26B97C_BEA9_419C_8310_67E6D0C2CD86
+#define GL_TRACE_HPP_CC26B97C_BEA9_419C_8310_67E6D0C2CD86
+
+#include <cstddef>
+#include <cstdint>
+
+// GL command trace format, shared by the recorder (gl_capture.hpp) and the
+// glreplay tool.
+//
+// All values are stored in native byte order. A trace starts with a header:
+//
+//	u32 magic (kGLTraceMagic), u32 version (kGLTraceVersion)
+//	u32 function count; for each function: u16 name length, name
+//
+// followed by records, each starting with a u16 tag. Tags below the function
+// count are calls to the function of that index in the header's table:
+//
+//	arguments   each in order; pointers and GLsync handles as u64, all other
+//	            types with their native size
+//	inputs      data referenced by pointer arguments, where the function
+//	            reads it (e.g., glBufferData()'s data, glShaderSource()'s
+//	            strings). Function specific, see gl_capture.cpp.
+//	result      if the function returns a value, encoded like an argument
+//	outputs     function specific, e.g. the names returned by glGen*().
+//
+// Other tags are listed in GLTraceTag.
+//
+// Object names are recorded as they are. Replaying in a fresh context with
+// the same driver normally produces the same names, since objects are
+// created in the same order; glreplay checks this.
+enum class GLTraceTag : std::uint16_t
+{
+	// Memory written by the CPU through a mapping (glMapBufferRange() with
+	// GL_MAP_WRITE_BIT). u32 buffer, u64 offset relative to the start of the
+	// mapping, u64 size, data.
+	mappedWrite = 0xfffd,
+
+	// End of a frame. Calls before the first boundary are setup.
+	frame = 0xfffe,
+
+	end = 0xffff
+};
+
+constexpr std::uint32_t kGLTraceMagic = 0x52544c47; // "GLTR"
+constexpr std::uint32_t kGLTraceVersion = 1;
+
+// Function flags
+constexpr unsigned kGLTraceDraw = 1; // reads buffer data (draws, dispatches)
+
+// Recorded functions: every function used by exercise4 and support/, plus
+// the ones that glad itself calls while loading. Calls to any other function
+// are not recorded. The header of each trace lists the names, so entries may
+// be added anywhere. Inputs and outputs behind pointers need handling both in
+// gl_capture.cpp and in glreplay.
+#define GLTRACE_FUNCTIONS( X ) \
+	X( ActiveTexture, 0 ) \
+	X( AttachShader, 0 ) \
+	X( BeginQuery, 0 ) \
+	X( BindBuffer, 0 ) \
+	X( BindBufferBase, 0 ) \
+	X( BindBufferRange, 0 ) \
+	X( BindFramebuffer, 0 ) \
+	X( BindImageTexture, 0 ) \
+	X( BindTexture, 0 ) \
+	X( BindVertexArray, 0 ) \
+	X( BlitFramebuffer, 0 ) \
+	X( BufferData, 0 ) \
+	X( BufferStorage, 0 ) \
+	X( BufferSubData, 0 ) \
+	X( CheckFramebufferStatus, 0 ) \
+	X( Clear, 0 ) \
+	X( ClearBufferData, 0 ) \
+	X( ClearColor, 0 ) \
+	X( ClientWaitSync, 0 ) \
+	X( CompileShader, 0 ) \
+	X( CreateProgram, 0 ) \
+	X( CreateShader, 0 ) \
+	X( DebugMessageCallback, 0 ) \
+	X( DebugMessageControl, 0 ) \
+	X( DeleteBuffers, 0 ) \
+	X( DeleteFramebuffers, 0 ) \
+	X( DeleteProgram, 0 ) \
+	X( DeleteQueries, 0 ) \
+	X( DeleteShader, 0 ) \
+	X( DeleteSync, 0 ) \
+	X( DeleteTextures, 0 ) \
+	X( DeleteVertexArrays, 0 ) \
+	X( Disable, 0 ) \
+	X( DispatchCompute, kGLTraceDraw ) \
+	X( DrawArraysInstancedBaseInstance, kGLTraceDraw ) \
+	X( Enable, 0 ) \
+	X( EnableVertexAttribArray, 0 ) \
+	X( EndQuery, 0 ) \
+	X( FenceSync, 0 ) \
+	X( Finish, 0 ) \
+	X( Flush, 0 ) \
+	X( FramebufferTexture2D, 0 ) \
+	X( GenBuffers, 0 ) \
+	X( GenFramebuffers, 0 ) \
+	X( GenQueries, 0 ) \
+	X( GenTextures, 0 ) \
+	X( GenVertexArrays, 0 ) \
+	X( GetError, 0 ) \
+	X( GetInteger64v, 0 ) \
+	X( GetIntegerv, 0 ) \
+	X( GetProgramBinary, 0 ) \
+	X( GetProgramInfoLog, 0 ) \
+	X( GetProgramInterfaceiv, 0 ) \
+	X( GetProgramResourceName, 0 ) \
+	X( GetProgramResourceiv, 0 ) \
+	X( GetProgramiv, 0 ) \
+	X( GetQueryObjectui64v, 0 ) \
+	X( GetQueryObjectuiv, 0 ) \
+	X( GetShaderInfoLog, 0 ) \
+	X( GetShaderiv, 0 ) \
+	X( GetString, 0 ) \
+	X( GetStringi, 0 ) \
+	X( LinkProgram, 0 ) \
+	X( MapBufferRange, 0 ) \
+	X( MaxShaderCompilerThreadsARB, 0 ) \
+	X( MaxShaderCompilerThreadsKHR, 0 ) \
+	X( MemoryBarrier, 0 ) \
+	X( MultiDrawArraysIndirect, kGLTraceDraw ) \
+	X( MultiDrawArraysIndirectCount, kGLTraceDraw ) \
+	X( PixelStorei, 0 ) \
+	X( PolygonMode, 0 ) \
+	X( ProgramBinary, 0 ) \
+	X( ProgramParameteri, 0 ) \
+	X( ProgramUniform1f, 0 ) \
+	X( ProgramUniform1i, 0 ) \
+	X( ProgramUniform1ui, 0 ) \
+	X( ProgramUniform2f, 0 ) \
+	X( ProgramUniform3f, 0 ) \
+	X( ProgramUniform4f, 0 ) \
+	X( ProgramUniformMatrix4fv, 0 ) \
+	X( QueryCounter, 0 ) \
+	X( ReadBuffer, 0 ) \
+	X( ReadPixels, 0 ) \
+	X( ShaderSource, 0 ) \
+	X( TexImage2D, 0 ) \
+	X( TexParameteri, 0 ) \
+	X( TexStorage2D, 0 ) \
+	X( TexSubImage2D, 0 ) \
+	X( Uniform1i, 0 ) \
+	X( UnmapBuffer, 0 ) \
+	X( UseProgram, 0 ) \
+	X( VertexAttribDivisor, 0 ) \
+	X( VertexAttribIPointer, 0 ) \
+	X( VertexAttribPointer, 0 ) \
+	X( Viewport, 0 )
+
+enum class GLTraceFunction : std::uint16_t
+{
+#	define GLTRACE_ENUM_( name, flags ) name,
+	GLTRACE_FUNCTIONS( GLTRACE_ENUM_ )
+#	undef GLTRACE_ENUM_
+
+	count
+};
+
+// Names without the "gl" prefix, indexed by GLTraceFunction
+inline constexpr char const* kGLTraceFunctionNames[] = {
+#	define GLTRACE_NAME_( name, flags ) #name,
+	GLTRACE_FUNCTIONS( GLTRACE_NAME_ )
+#	undef GLTRACE_NAME_
+};
+
+inline constexpr unsigned kGLTraceFunctionFlags[] = {
+#	define GLTRACE_FLAGS_( name, flags ) flags,
+	GLTRACE_FUNCTIONS( GLTRACE_FLAGS_ )
+#	undef GLTRACE_FLAGS_
+};
+
+// Size in bytes of a w x h image with the given format and type, with rows
+// padded to aAlignment (GL_PACK_ALIGNMENT/GL_UNPACK_ALIGNMENT). Returns 0
+// for combinations that are not supported by the trace.
+std::size_t gl_trace_image_size( int aWidth, int aHeight, unsigned aFormat, unsigned aType, int aAlignment ) noexcept;
+
+#endif // GL_TRACE_HPP_CC26B97C_BEA9_419C_8310_67E6D0C2CD86
@@ -0,0 +1,267 @@
+#include "gpu_resources.hpp"
+
+#include <algorithm>
+
+#include <cstdio>
+
+#include "error.hpp"
+#include "checkpoint.hpp"
+
+namespace
+{
+	double mib_( std::size_t aBytes ) noexcept
+	{
+		return double(aBytes) / (1024.*1024.);
+	}
+}
+
+std::size_t GpuMemoryStats::total_bytes() const noexcept
+{
+	std::size_t ret = pendingBytes;
+	for( auto const count : bytes )
+		ret += count;
+	return ret;
+}
+
+GpuResources::GpuResources( GpuMemoryConfig aConfig )
+	: mConfig( aConfig )
+	, mStats{}
+	, mOverBudget( false )
+{}
+
+GpuResources::~GpuResources()
+{
+	// Handles released during the last frame haven't been fenced yet.
+	// Nothing is in use anymore at this point, so wait for the GPU once.
+	if( !mRetired.empty() || !mInFlight.empty() )
+		glFinish();
+
+	for( auto& batch : mInFlight )
+	{
+		glDeleteSync( batch.fence );
+		delete_batch_( batch.objects );
+	}
+
+	delete_batch_( mRetired );
+}
+
+GpuBuffer GpuResources::create_buffer( GpuMemoryCategory aCategory, GLsizeiptr aSize, void const* aData, GLbitfield aStorageFlags )
+{
+	if( aSize <= 0 )
+		throw Error( "GpuResources::create_buffer(): invalid size %lld", static_cast<long long>(aSize) );
+
+	OGL_CHECKPOINT_ALWAYS();
+
+	GLuint buffer = 0;
+	glGenBuffers( 1, &buffer );
+	glBindBuffer( GL_COPY_WRITE_BUFFER, buffer );
+
+	if( GLAD_GL_VERSION_4_4 )
+	{
+		glBufferStorage( GL_COPY_WRITE_BUFFER, aSize, aData, aStorageFlags );
+	}
+	else
+	{
+		GLenum usage = (aStorageFlags & (GL_DYNAMIC_STORAGE_BIT | GL_MAP_WRITE_BIT)) ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW;
+		if( aStorageFlags & GL_MAP_READ_BIT )
+			usage = GL_STREAM_READ; // readback
+
+		glBufferData( GL_COPY_WRITE_BUFFER, aSize, aData, usage );
+	}
+
+	glBindBuffer( GL_COPY_WRITE_BUFFER, 0 );
+
+	OGL_CHECKPOINT_ALWAYS();
+
+	return GpuBuffer( this, buffer, aCategory, std::size_t(aSize) );
+}
+
+GpuVertexArray GpuResources::create_vertex_array()
+{
+	GLuint vao = 0;
+	glGenVertexArrays( 1, &vao );
+
+	return GpuVertexArray( this, vao );
+}
+
+GpuTexture GpuResources::create_texture_2d( GpuMemoryCategory aCategory, GLsizei aLevels, GLenum aInternalFormat, GLsizei aWidth, GLsizei aHeight )
+{
+	auto const bytes = texture_bytes( aInternalFormat, aLevels, aWidth, aHeight );
+	if( 0 == bytes || aLevels <= 0 )
+		throw Error( "GpuResources::create_texture_2d(): invalid texture %dx%d, %d levels, format 0x%x", int(aWidth), int(aHeight), int(aLevels), unsigned(aInternalFormat) );
+
+	OGL_CHECKPOINT_ALWAYS();
+
+	GLuint texture = 0;
+	glGenTextures( 1, &texture );
+	glBindTexture( GL_TEXTURE_2D, texture );
+
+	if( GLAD_GL_VERSION_4_2 )
+	{
+		glTexStorage2D( GL_TEXTURE_2D, aLevels, aInternalFormat, aWidth, aHeight );
+	}
+	else
+	{
+		// Any format/type pair that matches the internal format will do, since
+		// no data is passed.
+		for( GLsizei level = 0; level < aLevels; ++level )
+			glTexImage2D( GL_TEXTURE_2D, level, GLint(aInternalFormat), std::max( 1, aWidth >> level ), std::max( 1, aHeight >> level ), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr );
+
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, aLevels-1 );
+	}
+
+	glBindTexture( GL_TEXTURE_2D, 0 );
+
+	OGL_CHECKPOINT_ALWAYS();
+
+	return GpuTexture( this, texture, aCategory, bytes );
+}
+
+std::size_t GpuResources::end_frame()
+{
+	if( !mRetired.empty() )
+	{
+		GLsync const fence = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+		mInFlight.emplace_back( Batch_{ fence, std::move(mRetired) } );
+		mRetired.clear();
+	}
+
+	// Batches complete in order. Don't flush: the frame's end does that.
+	std::size_t deleted = 0;
+	while( !mInFlight.empty() )
+	{
+		auto& batch = mInFlight.front();
+
+		GLenum const status = glClientWaitSync( batch.fence, 0, 0 );
+		if( GL_ALREADY_SIGNALED != status && GL_CONDITION_SATISFIED != status )
+			break;
+
+		glDeleteSync( batch.fence );
+		deleted += delete_batch_( batch.objects );
+
+		mInFlight.pop_front();
+	}
+
+	if( mOverBudget && mConfig.budget && mStats.total_bytes() <= mConfig.budget )
+		mOverBudget = false;
+
+	return deleted;
+}
+
+GpuMemoryStats const& GpuResources::stats() const noexcept
+{
+	return mStats;
+}
+GpuMemoryConfig const& GpuResources::config() const noexcept
+{
+	return mConfig;
+}
+
+void GpuResources::acquire_( GpuResourceType aType, GpuMemoryCategory aCategory, std::size_t aBytes ) noexcept
+{
+	++mStats.objects[std::size_t(aType)];
+	mStats.bytes[std::size_t(aCategory)] += aBytes;
+
+	auto const total = mStats.total_bytes();
+	mStats.peakBytes = std::max( mStats.peakBytes, total );
+
+	if( mConfig.budget && total > mConfig.budget && aBytes )
+	{
+		++mStats.overBudget;
+
+		if( !mOverBudget )
+		{
+			std::fprintf( stderr, "Warning: GPU memory budget exceeded: %.1f MiB in use (%.1f MiB pending deletion), budget is %.1f MiB\n", mib_( total ), mib_( mStats.pendingBytes ), mib_( mConfig.budget ) );
+			mOverBudget = true;
+		}
+	}
+}
+
+void GpuResources::release_( GpuResourceType aType, GLuint aId, GpuMemoryCategory aCategory, std::size_t aBytes ) noexcept
+{
+	--mStats.objects[std::size_t(aType)];
+	mStats.bytes[std::size_t(aCategory)] -= aBytes;
+
+	++mStats.pendingObjects;
+	mStats.pendingBytes += aBytes;
+
+	mRetired.emplace_back( Retired_{ aType, aId, aBytes } );
+}
+
+void GpuResources::delete_( GpuResourceType aType, GLuint aId ) noexcept
+{
+	switch( aType )
+	{
+		case GpuResourceType::buffer: glDeleteBuffers( 1, &aId ); break;
+		case GpuResourceType::vertexArray: glDeleteVertexArrays( 1, &aId ); break;
+		case GpuResourceType::program: glDeleteProgram( aId ); break;
+		case GpuResourceType::texture: glDeleteTextures( 1, &aId ); break;
+		case GpuResourceType::count: break;
+	}
+}
+
+std::size_t GpuResources::delete_batch_( std::vector<Retired_> const& aObjects ) noexcept
+{
+	std::vector<GLuint> buffers, vaos, textures;
+	for( auto const& object : aObjects )
+	{
+		switch( object.type )
+		{
+			case GpuResourceType::buffer: buffers.emplace_back( object.id ); break;
+			case GpuResourceType::vertexArray: vaos.emplace_back( object.id ); break;
+			case GpuResourceType::program: glDeleteProgram( object.id ); break;
+			case GpuResourceType::texture: textures.emplace_back( object.id ); break;
+			case GpuResourceType::count: break;
+		}
+
+		--mStats.pendingObjects;
+		mStats.pendingBytes -= object.bytes;
+	}
+
+	if( !buffers.empty() )
+		glDeleteBuffers( GLsizei(buffers.size()), buffers.data() );
+	if( !vaos.empty() )
+		glDeleteVertexArrays( GLsizei(vaos.size()), vaos.data() );
+	if( !textures.empty() )
+		glDeleteTextures( GLsizei(textures.size()), textures.data() );
+
+	mStats.deleted += aObjects.size();
+	return aObjects.size();
+}
+
+char const* gpu_memory_category_name( GpuMemoryCategory aCategory ) noexcept
+{
+	switch( aCategory )
+	{
+		case GpuMemoryCategory::vertex: return "vertex";
+		case GpuMemoryCategory::indirect: return "indirect";
+		case GpuMemoryCategory::texture: return "texture";
+		case GpuMemoryCategory::other: return "other";
+		case GpuMemoryCategory::count: break;
+	}
+
+	return "?";
+}
+
+std::size_t texture_bytes( GLenum aInternalFormat, GLsizei aLevels, GLsizei aWidth, GLsizei aHeight ) noexcept
+{
+	std::size_t texel = 0;
+	switch( aInternalFormat )
+	{
+		case GL_R8: texel = 1; break;
+		case GL_RG8: case GL_R16F: texel = 2; break;
+		case GL_RGBA8: case GL_SRGB8_ALPHA8: case GL_R32F: case GL_RG16F: texel = 4; break;
+		case GL_RGBA16F: case GL_RG32F: texel = 8; break;
+		case GL_RGBA32F: texel = 16; break;
+		default: return 0;
+	}
+
+	if( aWidth <= 0 || aHeight <= 0 )
+		return 0;
+
+	std::size_t ret = 0;
+	for( GLsizei level = 0; level < aLevels; ++level )
+		ret += std::size_t(std::max( 1, aWidth >> level )) * std::size_t(std::max( 1, aHeight >> level )) * texel;
+
+	return ret;
+}
@@ -0,0 +1,268 @@
+#ifndef GPU_RESOURCES_HPP_6E21D0B4_8A7F_4C39_B5E2_1F94C07A3D68
+#define GPU_RESOURCES_HPP_6E21D0B4_8A7F_4C39_B5E2_1F94C07A3D68
+
+#include <glad/glad.h>
+
+#include <deque>
+#include <vector>
+#include <utility>
+
+#include <cstddef>
+
+// Kinds of objects managed by GpuResources
+enum class GpuResourceType : std::size_t
+{
+	buffer,
+	vertexArray,
+	program,
+	texture,
+
+	count
+};
+
+// What buffer memory is used for. Only buffers have a size; other objects
+// are counted, but take no bytes.
+enum class GpuMemoryCategory : std::size_t
+{
+	vertex,    // vertex attributes
+	indirect,  // GPU culling: object data, draw commands
+	texture,   // texture images, including all mip levels
+	other,
+
+	count
+};
+
+// Budget for GpuResources. Exceeding it isn't an error: allocations still
+// succeed, but are reported (see GpuMemoryStats::overBudget), so that the
+// caller can unload something.
+struct GpuMemoryConfig
+{
+	std::size_t budget = 0; // bytes, 0 = none
+};
+
+struct GpuMemoryStats
+{
+	std::size_t bytes[std::size_t(GpuMemoryCategory::count)]; // live
+	std::size_t objects[std::size_t(GpuResourceType::count)]; // live
+
+	std::size_t pendingBytes; // released, waiting for the GPU
+	std::size_t pendingObjects;
+
+	std::size_t peakBytes; // of live + pending
+	std::size_t deleted; // objects, in total
+	std::size_t overBudget; // allocations that exceeded the budget
+
+	std::size_t total_bytes() const noexcept; // live + pending
+};
+
+class GpuResources;
+
+// Owning handle for a GL object
+//
+// Move-only. Releasing the handle (destruction, reset(), or assigning another
+// handle) hands the object back to its GpuResources, which deletes it once
+// the GPU is done with it. Without a GpuResources, the object is deleted
+// right away.
+template< GpuResourceType tType >
+class GpuHandle final
+{
+	public:
+		GpuHandle() noexcept = default;
+
+		// Takes ownership of aId (which may be 0). aBytes are accounted for
+		// under aCategory until the object is deleted.
+		GpuHandle( GpuResources* aOwner, GLuint aId, GpuMemoryCategory = GpuMemoryCategory::other, std::size_t aBytes = 0 ) noexcept;
+
+		~GpuHandle();
+
+		GpuHandle( GpuHandle const& ) = delete;
+		GpuHandle& operator= (GpuHandle const&) = delete;
+
+		GpuHandle( GpuHandle&& ) noexcept;
+		GpuHandle& operator= (GpuHandle&&) noexcept;
+
+	public:
+		GLuint id() const noexcept { return mId; }
+		std::size_t bytes() const noexcept { return mBytes; }
+
+		explicit operator bool() const noexcept { return 0 != mId; }
+
+		void reset() noexcept;
+
+	private:
+		GpuResources* mOwner = nullptr;
+		GLuint mId = 0;
+
+		GpuMemoryCategory mCategory = GpuMemoryCategory::other;
+		std::size_t mBytes = 0;
+};
+
+using GpuBuffer = GpuHandle<GpuResourceType::buffer>;
+using GpuVertexArray = GpuHandle<GpuResourceType::vertexArray>;
+using GpuProgram = GpuHandle<GpuResourceType::program>;
+using GpuTexture = GpuHandle<GpuResourceType::texture>;
+
+// Lifetime manager for GL buffers, VAOs, programs and textures
+//
+// Objects released during a frame may still be used by commands that the
+// GPU hasn't executed yet. Deleting them right away is legal, but may make
+// the driver wait or keep them alive in ways that aren't visible to the
+// application. Instead, released objects are collected, and end_frame()
+// inserts a fence behind them. They are deleted (in one call per type) by a
+// later end_frame(), once the fence has signaled. Nothing ever waits for the
+// GPU, except the destructor.
+//
+// Memory is accounted for per GpuMemoryCategory. Released objects count as
+// pending until they are deleted, and pending bytes count against the budget.
+// The first allocation that exceeds the budget prints a warning; the next
+// warning is printed once usage has dropped below the budget again.
+//
+// Deleting an object unbinds it, and its name may be reused afterwards. If a
+// GLStateCache is in use, invalidate it when end_frame() returns a non-zero
+// count.
+//
+// Must only be used from the thread of the GL context, and must outlive all
+// handles that it created.
+class GpuResources final
+{
+	public:
+		explicit GpuResources( GpuMemoryConfig = {} );
+		~GpuResources();
+
+		GpuResources( GpuResources const& ) = delete;
+		GpuResources& operator= (GpuResources const&) = delete;
+
+	public:
+		// Creates a buffer of aSize bytes. With GL 4.4, the buffer has
+		// immutable storage (glBufferStorage() with aStorageFlags);
+		// otherwise, glBufferData() is used with a usage derived from the
+		// flags. aData may be null.
+		GpuBuffer create_buffer(
+			GpuMemoryCategory,
+			GLsizeiptr aSize,
+			void const* aData = nullptr,
+			GLbitfield aStorageFlags = 0
+		);
+
+		GpuVertexArray create_vertex_array();
+
+		// Creates a 2D texture with aLevels mip levels of undefined contents.
+		// With GL 4.2, the storage is immutable (glTexStorage2D()); otherwise
+		// each level is allocated with glTexImage2D(). aInternalFormat must be
+		// one of the formats known to texture_bytes().
+		GpuTexture create_texture_2d(
+			GpuMemoryCategory,
+			GLsizei aLevels,
+			GLenum aInternalFormat,
+			GLsizei aWidth,
+			GLsizei aHeight
+		);
+
+		// Fences the objects released since the last call, and deletes the
+		// ones that the GPU is done with. Returns the number of objects
+		// deleted. Call once per frame, after its last draw.
+		std::size_t end_frame();
+
+		GpuMemoryStats const& stats() const noexcept;
+		GpuMemoryConfig const& config() const noexcept;
+
+	private:
+		template< GpuResourceType > friend class GpuHandle;
+
+		void acquire_( GpuResourceType, GpuMemoryCategory, std::size_t aBytes ) noexcept;
+		void release_( GpuResourceType, GLuint, GpuMemoryCategory, std::size_t aBytes ) noexcept;
+
+		// Deletes the given objects right away (no accounting).
+		static void delete_( GpuResourceType, GLuint ) noexcept;
+
+		struct Retired_
+		{
+			GpuResourceType type;
+			GLuint id;
+			std::size_t bytes;
+		};
+
+		std::size_t delete_batch_( std::vector<Retired_> const& ) noexcept;
+
+	private:
+		GpuMemoryConfig mConfig;
+		GpuMemoryStats mStats;
+
+		bool mOverBudget;
+
+		std::vector<Retired_> mRetired; // since the last end_frame()
+
+		struct Batch_
+		{
+			GLsync fence;
+			std::vector<Retired_> objects;
+		};
+
+		std::deque<Batch_> mInFlight;
+};
+
+char const* gpu_memory_category_name( GpuMemoryCategory ) noexcept;
+
+// Size of a 2D texture with aLevels mip levels, as used for accounting.
+// Returns 0 for unsupported internal formats.
+std::size_t texture_bytes( GLenum aInternalFormat, GLsizei aLevels, GLsizei aWidth, GLsizei aHeight ) noexcept;
+
+
+// Implementation of GpuHandle
+template< GpuResourceType tType > inline
+GpuHandle<tType>::GpuHandle( GpuResources* aOwner, GLuint aId, GpuMemoryCategory aCategory, std::size_t aBytes ) noexcept
+	: mOwner( aOwner )
+	, mId( aId )
+	, mCategory( aCategory )
+	, mBytes( aBytes )
+{
+	if( mOwner && mId )
+		mOwner->acquire_( tType, mCategory, mBytes );
+}
+
+template< GpuResourceType tType > inline
+GpuHandle<tType>::~GpuHandle()
+{
+	reset();
+}
+
+template< GpuResourceType tType > inline
+GpuHandle<tType>::GpuHandle( GpuHandle&& aOther ) noexcept
+	: mOwner( aOther.mOwner )
+	, mId( std::exchange( aOther.mId, 0 ) )
+	, mCategory( aOther.mCategory )
+	, mBytes( std::exchange( aOther.mBytes, 0 ) )
+{}
+
+template< GpuResourceType tType > inline
+GpuHandle<tType>& GpuHandle<tType>::operator= (GpuHandle&& aOther) noexcept
+{
+	if( this != &aOther )
+	{
+		reset();
+
+		mOwner = aOther.mOwner;
+		mId = std::exchange( aOther.mId, 0 );
+		mCategory = aOther.mCategory;
+		mBytes = std::exchange( aOther.mBytes, 0 );
+	}
+
+	return *this;
+}
+
+template< GpuResourceType tType > inline
+void GpuHandle<tType>::reset() noexcept
+{
+	if( 0 == mId )
+		return;
+
+	if( mOwner )
+		mOwner->release_( tType, mId, mCategory, mBytes );
+	else
+		GpuResources::delete_( tType, mId );
+
+	mId = 0;
+	mBytes = 0;
+}
+
+#endif // GPU_RESOURCES_HPP_6E21D0B4_8A7F_4C39_B5E2_1F94C07A3D68
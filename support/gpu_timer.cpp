@@ -0,0 +1,104 @@
+#include "gpu_timer.hpp"
+
+#include <cassert>
+
+#include "error.hpp"
+
+GpuFrameTimer::GpuFrameTimer( std::size_t aMaxFramesInFlight, bool aKeepHistory )
+	: mQueries( aMaxFramesInFlight, 0 )
+	, mOldest( 0 )
+	, mInFlight( 0 )
+	, mActive( false )
+	, mKeepHistory( aKeepHistory )
+	, mLatestMs( -1.0 )
+{
+	if( 0 == aMaxFramesInFlight )
+		throw Error( "GpuFrameTimer: need at least one query (got zero)" );
+
+	glGenQueries( GLsizei(mQueries.size()), mQueries.data() );
+}
+
+GpuFrameTimer::~GpuFrameTimer()
+{
+	if( mActive )
+		glEndQuery( GL_TIME_ELAPSED );
+
+	glDeleteQueries( GLsizei(mQueries.size()), mQueries.data() );
+}
+
+void GpuFrameTimer::begin_frame()
+{
+	assert( !mActive );
+
+	// Pick up any results that are ready. If the ring is full, we have no
+	// choice but to wait for the oldest query.
+	collect_( false );
+	if( mInFlight == mQueries.size() )
+		collect_( true );
+
+	auto const slot = (mOldest + mInFlight) % mQueries.size();
+	glBeginQuery( GL_TIME_ELAPSED, mQueries[slot] );
+	mActive = true;
+}
+void GpuFrameTimer::end_frame()
+{
+	assert( mActive );
+
+	glEndQuery( GL_TIME_ELAPSED );
+	mActive = false;
+	++mInFlight;
+}
+
+void GpuFrameTimer::finish()
+{
+	assert( !mActive );
+
+	while( mInFlight )
+		collect_( true );
+}
+
+std::vector<double> const& GpuFrameTimer::samples_ms() const noexcept
+{
+	return mSamplesMs;
+}
+void GpuFrameTimer::take_new_samples_ms( std::vector<double>& aOut )
+{
+	aOut.clear();
+	aOut.swap( mNewSamplesMs );
+}
+double GpuFrameTimer::latest_ms() const noexcept
+{
+	return mLatestMs;
+}
+
+void GpuFrameTimer::collect_( bool aWait )
+{
+	// Results are collected strictly in order, so that samples_ms() matches
+	// the order in which frames were issued. When waiting, only the oldest
+	// query is waited for.
+	while( mInFlight )
+	{
+		auto const query = mQueries[mOldest];
+
+		if( !aWait )
+		{
+			GLuint available = GL_FALSE;
+			glGetQueryObjectuiv( query, GL_QUERY_RESULT_AVAILABLE, &available );
+			if( GL_TRUE != available )
+				break;
+		}
+
+		GLuint64 elapsedNs = 0;
+		glGetQueryObjectui64v( query, GL_QUERY_RESULT, &elapsedNs );
+		mLatestMs = double(elapsedNs) * 1e-6;
+		mNewSamplesMs.emplace_back( mLatestMs );
+		if( mKeepHistory )
+			mSamplesMs.emplace_back( mLatestMs );
+
+		mOldest = (mOldest + 1) % mQueries.size();
+		--mInFlight;
+
+		if( aWait )
+			break;
+	}
+}
@@ -0,0 +1,69 @@
+#ifndef GPU_TIMER_HPP_15ED2ADB_780A_47E9_8FF4_ABF325FDB22D
+#define GPU_TIMER_HPP_15ED2ADB_780A_47E9_8FF4_ABF325FDB22D
+
+#include <glad/glad.h>
+
+#include <vector>
+
+#include <cstddef>
+
+// Measures GPU time per frame with GL_TIME_ELAPSED queries.
+//
+// Query results become available a few frames after they were issued. To
+// avoid stalling the pipeline, the queries are kept in a ring, and results
+// are only read back once the GL reports that they are available. If all
+// queries in the ring are still in flight when a new frame begins, the oldest
+// one is waited for. The ring size therefore also bounds the number of frames
+// that the CPU can run ahead of the GPU.
+//
+// With aKeepHistory, all frame times are kept for samples_ms() (e.g., for a
+// benchmark report). Otherwise, only the times collected since the last
+// take_new_samples_ms() are kept, so that a timer that runs for a whole
+// interactive session doesn't grow without bound.
+//
+// Note: GL_TIME_ELAPSED queries cannot be nested. Only one GpuFrameTimer may
+// be active between begin_frame() and end_frame() at any time.
+class GpuFrameTimer final
+{
+	public:
+		explicit GpuFrameTimer( std::size_t aMaxFramesInFlight = 4, bool aKeepHistory = true );
+		~GpuFrameTimer();
+
+		GpuFrameTimer( GpuFrameTimer const& ) = delete;
+		GpuFrameTimer& operator= (GpuFrameTimer const&) = delete;
+
+	public:
+		void begin_frame();
+		void end_frame();
+
+		// Wait for all outstanding queries and collect their results.
+		void finish();
+
+		// Frame times in milliseconds, in the order that the frames were
+		// issued. Only includes frames whose results have been collected.
+		// Empty without aKeepHistory.
+		std::vector<double> const& samples_ms() const noexcept;
+
+		// Replaces the contents of aOut with the frame times collected since
+		// the last call, in order. Reuses aOut's storage.
+		void take_new_samples_ms( std::vector<double>& aOut );
+
+		// Most recent collected frame time in milliseconds (or a negative
+		// value if no results have been collected yet).
+		double latest_ms() const noexcept;
+
+	private:
+		void collect_( bool aWait );
+
+	private:
+		std::vector<GLuint> mQueries;
+		std::size_t mOldest, mInFlight;
+		bool mActive;
+		bool mKeepHistory;
+
+		std::vector<double> mSamplesMs;
+		std::vector<double> mNewSamplesMs;
+		double mLatestMs;
+};
+
+#endif // GPU_TIMER_HPP_15ED2ADB_780A_47E9_8FF4_ABF325FDB22D
@@ -0,0 +1,42 @@
+#ifndef HASH_HPP_4C0E92B7_1A5D_4E63_8F27_D3B96A0E51C4
+#define HASH_HPP_4C0E92B7_1A5D_4E63_8F27_D3B96A0E51C4
+
+#include <string_view>
+
+#include <cstddef>
+#include <cstdint>
+
+// 64-bit FNV-1a. Not suitable against adversarial input, but cheap, simple
+// and good enough for cache keys. Hashes can be chained by passing the
+// previous result as aSeed.
+constexpr std::uint64_t kHashSeed = 0xcbf29ce484222325ull;
+
+constexpr
+std::uint64_t hash_bytes( void const* aData, std::size_t aSize, std::uint64_t aSeed = kHashSeed ) noexcept
+{
+	auto const* bytes = static_cast<unsigned char const*>(aData);
+
+	std::uint64_t hash = aSeed;
+	for( std::size_t i = 0; i < aSize; ++i )
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ull;
+	}
+
+	return hash;
+}
+
+constexpr
+std::uint64_t hash_string( std::string_view aString, std::uint64_t aSeed = kHashSeed ) noexcept
+{
+	std::uint64_t hash = aSeed;
+	for( char const c : aString )
+	{
+		hash ^= static_cast<unsigned char>(c);
+		hash *= 0x100000001b3ull;
+	}
+
+	return hash;
+}
+
+#endif // HASH_HPP_4C0E92B7_1A5D_4E63_8F27_D3B96A0E51C4
@@ -0,0 +1,380 @@
+#include "job_system.hpp"
+
+#include <chrono>
+#include <utility>
+
+#include <cassert>
+
+#include "error.hpp"
+
+namespace
+{
+	// wait(): yields this many times while looking for work, before it
+	// blocks on the counter. While blocked, it still checks for new work
+	// this often.
+	constexpr std::size_t kWaitSpins_ = 64;
+	constexpr auto kWaitPollInterval_ = std::chrono::milliseconds( 1 );
+
+	thread_local JobSystem const* tSystem_ = nullptr;
+	thread_local std::size_t tIndex_ = 0;
+
+	// Set while the thread runs a background job.
+	thread_local bool tInBackground_ = false;
+}
+
+// JobSystem
+JobSystem::JobSystem( std::size_t aThreadCount )
+	: mThreadCount( aThreadCount )
+	, mSharedCount( 0 )
+	, mBackgroundCount( 0 )
+	, mEpoch( 0 )
+	, mSleepers( 0 )
+	, mQuit( false )
+{
+	if( tSystem_ )
+		throw Error( "JobSystem: the calling thread already belongs to a job system" );
+
+	if( 0 == mThreadCount )
+		mThreadCount = std::max( 1u, std::thread::hardware_concurrency() );
+
+	// At least one worker, for the background jobs.
+	auto const threads = std::max<std::size_t>( mThreadCount, 2 );
+
+	mThreads.reserve( threads );
+	for( std::size_t i = 0; i < threads; ++i )
+		mThreads.emplace_back( std::make_unique<Thread_>() );
+
+	tSystem_ = this;
+	tIndex_ = 0;
+
+	mWorkers.reserve( threads-1 );
+	for( std::size_t i = 1; i < threads; ++i )
+		mWorkers.emplace_back( [this, i] { worker_( i ); } );
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::scoped_lock lock( mSleepMutex );
+		mQuit = true;
+	}
+
+	mWakeCv.notify_all();
+
+	for( auto& worker : mWorkers )
+		worker.join();
+
+	// Jobs that were never waited for
+	for( auto& thread : mThreads )
+	{
+		Job_* job = nullptr;
+		while( thread->deque.try_steal( job ) )
+			delete job;
+	}
+
+	for( auto* job : mShared )
+		delete job;
+	for( auto* job : mBackground )
+		delete job;
+
+	if( this == tSystem_ )
+		tSystem_ = nullptr;
+}
+
+void JobSystem::run( std::function<void()> aTask, JobCounter* aCounter )
+{
+	push_( make_job_( std::move(aTask), aCounter, false ) );
+}
+
+void JobSystem::run_after( JobCounter& aDependency, std::function<void()> aTask, JobCounter* aCounter )
+{
+	JobCounter* const dependencies[] = { &aDependency };
+	run_after( dependencies, std::move(aTask), aCounter );
+}
+
+void JobSystem::run_after( std::span<JobCounter* const> aDependencies, std::function<void()> aTask, JobCounter* aCounter )
+{
+	push_after_( make_job_( std::move(aTask), aCounter, false ), aDependencies );
+}
+
+void JobSystem::run_background( std::function<void()> aTask, JobCounter* aCounter )
+{
+	push_( make_job_( std::move(aTask), aCounter, true ) );
+}
+
+void JobSystem::run_background_after( std::span<JobCounter* const> aDependencies, std::function<void()> aTask, JobCounter* aCounter )
+{
+	push_after_( make_job_( std::move(aTask), aCounter, true ), aDependencies );
+}
+
+void JobSystem::push_after_( Job_* aJob, std::span<JobCounter* const> aDependencies )
+{
+	// One extra blocker, so that the job can't start before it has been
+	// registered with all of its dependencies.
+	aJob->blockers.store( aDependencies.size() + 1, std::memory_order_relaxed );
+
+	for( auto* dependency : aDependencies )
+	{
+		// See execute_(): the last job of a dependency checks for waiting
+		// jobs with the mutex held.
+		std::scoped_lock lock( dependency->mMutex );
+		if( 0 != dependency->mPending.load( std::memory_order_relaxed ) )
+			dependency->mWaiting.emplace_back( aJob );
+		else
+			aJob->blockers.fetch_sub( 1, std::memory_order_relaxed );
+	}
+
+	if( 1 == aJob->blockers.fetch_sub( 1, std::memory_order_acq_rel ) )
+		push_( aJob );
+}
+
+void JobSystem::wait( JobCounter& aCounter )
+{
+	auto const index = index_();
+
+	for( std::size_t idle = 0; 0 != aCounter.mPending.load( std::memory_order_acquire ); )
+	{
+		if( auto* job = find_( index, tInBackground_ ) )
+		{
+			execute_( job, index );
+			idle = 0;
+			continue;
+		}
+
+		if( ++idle < kWaitSpins_ )
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		// The remaining jobs are running elsewhere.
+		std::unique_lock lock( aCounter.mMutex );
+		aCounter.mDoneCv.wait_for( lock, kWaitPollInterval_, [&aCounter] {
+			return 0 == aCounter.mPending.load( std::memory_order_relaxed );
+		} );
+	}
+
+	// The last job may still hold the mutex (see execute_()). Once we get
+	// it, that job is done with the counter, and the caller may destroy it.
+	std::scoped_lock lock( aCounter.mMutex );
+}
+
+std::size_t JobSystem::thread_count() const noexcept
+{
+	return mThreadCount;
+}
+
+JobStats JobSystem::stats() const noexcept
+{
+	JobStats ret{};
+	for( auto const& thread : mThreads )
+	{
+		ret.jobs += thread->jobs.load( std::memory_order_relaxed );
+		ret.stolen += thread->stolen.load( std::memory_order_relaxed );
+		ret.background += thread->background.load( std::memory_order_relaxed );
+	}
+
+	return ret;
+}
+
+void JobSystem::worker_( std::size_t aIndex )
+{
+	tSystem_ = this;
+	tIndex_ = aIndex;
+
+	for( ;; )
+	{
+		auto const epoch = mEpoch.load();
+
+		if( auto* job = find_( aIndex, true ) )
+		{
+			execute_( job, aIndex );
+			continue;
+		}
+
+		// Nothing to do. Sleep, unless something was submitted since the
+		// search started. Pairs with signal_(): either it sees mSleepers, or
+		// we see the new epoch.
+		std::unique_lock lock( mSleepMutex );
+		if( mQuit )
+			return;
+
+		mSleepers.fetch_add( 1 );
+		mWakeCv.wait( lock, [&] { return mQuit || epoch != mEpoch.load(); } );
+		mSleepers.fetch_sub( 1 );
+
+		if( mQuit )
+			return;
+	}
+}
+
+JobSystem::Job_* JobSystem::make_job_( std::function<void()> aTask, JobCounter* aCounter, bool aBackground )
+{
+	if( aCounter )
+		aCounter->mPending.fetch_add( 1, std::memory_order_relaxed );
+
+	// Work that a background job hands out is background work, too.
+	bool const background = aBackground || (kForeign_ != index_() && tInBackground_);
+	return new Job_{ std::move(aTask), aCounter, background };
+}
+
+void JobSystem::push_( Job_* aJob )
+{
+	auto const index = index_();
+	if( aJob->background )
+	{
+		std::scoped_lock lock( mQueueMutex );
+		mBackground.emplace_back( aJob );
+		mBackgroundCount.fetch_add( 1, std::memory_order_relaxed );
+	}
+	else if( kForeign_ != index )
+	{
+		// A full deque means that there is plenty of work queued already.
+		if( !mThreads[index]->deque.try_push( aJob ) )
+		{
+			execute_( aJob, index );
+			return;
+		}
+	}
+	else
+	{
+		std::scoped_lock lock( mQueueMutex );
+		mShared.emplace_back( aJob );
+		mSharedCount.fetch_add( 1, std::memory_order_relaxed );
+	}
+
+	signal_();
+}
+
+void JobSystem::signal_()
+{
+	mEpoch.fetch_add( 1 );
+
+	if( 0 != mSleepers.load() )
+	{
+		// Taking the mutex ensures that a worker that is about to sleep
+		// either sees the new epoch or receives the notification.
+		{
+			std::scoped_lock lock( mSleepMutex );
+		}
+
+		mWakeCv.notify_one();
+	}
+}
+
+JobSystem::Job_* JobSystem::find_( std::size_t aIndex, bool aBackground )
+{
+	Job_* job = nullptr;
+
+	if( kForeign_ != aIndex && mThreads[aIndex]->deque.try_pop( job ) )
+		return job;
+
+	if( 0 != mSharedCount.load( std::memory_order_relaxed ) )
+	{
+		std::scoped_lock lock( mQueueMutex );
+		if( !mShared.empty() )
+		{
+			job = mShared.front();
+			mShared.pop_front();
+			mSharedCount.fetch_sub( 1, std::memory_order_relaxed );
+			return job;
+		}
+	}
+
+	// Steal, starting with the next thread, so that thieves spread out. A
+	// failed steal means that another thread took the item; only give up on
+	// a victim once it looks empty.
+	auto const count = mThreads.size();
+	auto const first = kForeign_ != aIndex ? aIndex+1 : 0;
+	for( std::size_t i = 0; i < count; ++i )
+	{
+		auto const victim = (first + i) % count;
+		if( victim == aIndex )
+			continue;
+
+		auto& deque = mThreads[victim]->deque;
+		while( !deque.empty() )
+		{
+			if( deque.try_steal( job ) )
+			{
+				if( kForeign_ != aIndex )
+					mThreads[aIndex]->stolen.fetch_add( 1, std::memory_order_relaxed );
+
+				return job;
+			}
+		}
+	}
+
+	if( aBackground && 0 != mBackgroundCount.load( std::memory_order_relaxed ) )
+	{
+		std::scoped_lock lock( mQueueMutex );
+		if( !mBackground.empty() )
+		{
+			job = mBackground.front();
+			mBackground.pop_front();
+			mBackgroundCount.fetch_sub( 1, std::memory_order_relaxed );
+			return job;
+		}
+	}
+
+	return nullptr;
+}
+
+void JobSystem::execute_( Job_* aJob, std::size_t aIndex )
+{
+	// Restored afterwards: a background job may run inside a wait() of a
+	// regular one on a worker, and vice versa.
+	bool const wasInBackground = std::exchange( tInBackground_, aJob->background );
+	aJob->task();
+	tInBackground_ = wasInBackground;
+
+	if( kForeign_ != aIndex )
+	{
+		auto& thread = *mThreads[aIndex];
+		(aJob->background ? thread.background : thread.jobs).fetch_add( 1, std::memory_order_relaxed );
+	}
+
+	auto* counter = aJob->counter;
+	delete aJob;
+
+	if( !counter )
+		return;
+
+	std::vector<Job_*> ready;
+
+	{
+		std::scoped_lock lock( counter->mMutex );
+		if( 1 == counter->mPending.fetch_sub( 1, std::memory_order_acq_rel ) )
+		{
+			ready.swap( counter->mWaiting );
+			counter->mDoneCv.notify_all();
+		}
+	}
+
+	for( auto* job : ready )
+	{
+		if( 1 == job->blockers.fetch_sub( 1, std::memory_order_acq_rel ) )
+			push_( job );
+	}
+}
+
+std::size_t JobSystem::index_() const noexcept
+{
+	return this == tSystem_ ? tIndex_ : kForeign_;
+}
+
+
+// JobCounter
+JobCounter::JobCounter() noexcept
+	: mPending( 0 )
+{}
+
+JobCounter::~JobCounter()
+{
+	assert( 0 == mPending.load( std::memory_order_relaxed ) );
+}
+
+bool JobCounter::done() const noexcept
+{
+	return 0 == mPending.load( std::memory_order_acquire );
+}
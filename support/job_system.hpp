@@ -0,0 +1,210 @@
+#ifndef JOB_SYSTEM_HPP_2E7A5C90_D13B_4F6E_8A04_97C2B5E1F368
+#define JOB_SYSTEM_HPP_2E7A5C90_D13B_4F6E_8A04_97C2B5E1F368
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <span>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <condition_variable>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "ws_deque.hpp"
+
+class JobCounter;
+
+struct JobStats
+{
+	std::size_t jobs; // run() and run_after() jobs executed
+	std::size_t stolen; // of those, taken from another thread's deque
+	std::size_t background; // run_background() jobs executed
+};
+
+// Work-stealing job system
+//
+// One pool of threads for all CPU work, so that independent parts of the
+// program (e.g., the frame's draw list and texture decoding) share the cores
+// instead of each oversubscribing them with their own threads.
+//
+// Each thread that belongs to the system (the workers, and the thread that
+// created the system) owns a Chase-Lev deque (see ws_deque.hpp). Jobs that
+// it submits go to the bottom of its own deque, and it takes its next job
+// from there, newest first. Idle threads steal from the top of the others'
+// deques, oldest first. Other threads submit through a shared queue.
+// Workers without work sleep until something is submitted.
+//
+// Jobs report to an optional JobCounter, which counts the jobs that haven't
+// finished. wait() blocks until a counter reaches zero; while waiting, the
+// calling thread runs jobs itself. run_after() holds a job back until one or
+// more counters reach zero, which expresses dependencies between jobs.
+//
+// Jobs that run for a long time (e.g., decoding an image) should be
+// submitted with run_background() or run_background_after(). These are only
+// picked up by workers that found nothing else to do, and never by a thread
+// inside wait(): a frame that waits for its draw list doesn't end up
+// decoding a texture. Jobs submitted by a background job (e.g., by its
+// parallel_for()) are background jobs as well, and a background job that
+// waits may run other background jobs. The system always starts at least
+// one worker, so that background jobs make progress even with a thread
+// count of one.
+//
+// Jobs must not throw, and must not block on anything but wait(). Wait for
+// all jobs before destroying the system.
+class JobSystem final
+{
+	public:
+		// aThreadCount includes the calling thread; zero selects one thread
+		// per hardware thread.
+		explicit JobSystem( std::size_t aThreadCount = 0 );
+		~JobSystem();
+
+		JobSystem( JobSystem const& ) = delete;
+		JobSystem& operator= (JobSystem const&) = delete;
+
+	public:
+		void run( std::function<void()>, JobCounter* = nullptr );
+		void run_after( JobCounter& aDependency, std::function<void()>, JobCounter* = nullptr );
+		void run_after( std::span<JobCounter* const> aDependencies, std::function<void()>, JobCounter* = nullptr );
+		void run_background( std::function<void()>, JobCounter* = nullptr );
+		void run_background_after( std::span<JobCounter* const> aDependencies, std::function<void()>, JobCounter* = nullptr );
+
+		void wait( JobCounter& );
+
+		// Calls aBody( begin, end ) for consecutive ranges that cover
+		// [0, aCount), in parallel, and returns once all are done. Ranges
+		// hold aGrain items (except for the last one). Zero picks a grain
+		// that gives each thread a few ranges to balance the load.
+		template< typename tBody >
+		void parallel_for( std::size_t aCount, tBody const& aBody, std::size_t aGrain = 0 );
+
+		// Threads used by parallel_for(), including the calling thread.
+		std::size_t thread_count() const noexcept;
+
+		JobStats stats() const noexcept;
+
+	private:
+		friend class JobCounter;
+
+		struct Job_
+		{
+			std::function<void()> task;
+			JobCounter* counter;
+			bool background;
+
+			// run_after(): dependencies that haven't finished yet
+			std::atomic<std::size_t> blockers{ 0 };
+		};
+
+		static constexpr std::size_t kDequeSize_ = 4096;
+
+		// Per thread; index 0 is the creating thread.
+		struct alignas(64) Thread_
+		{
+			WorkStealingDeque<Job_*, kDequeSize_> deque;
+
+			std::atomic<std::size_t> jobs{ 0 }, stolen{ 0 }, background{ 0 };
+		};
+
+		void worker_( std::size_t aIndex );
+
+		Job_* make_job_( std::function<void()>, JobCounter*, bool aBackground );
+		void push_after_( Job_*, std::span<JobCounter* const> );
+		void push_( Job_* );
+		void signal_();
+
+		// Own deque, shared queue, other threads' deques, and if allowed, the
+		// background queue.
+		Job_* find_( std::size_t aIndex, bool aBackground );
+		void execute_( Job_*, std::size_t aIndex );
+
+		// Index of the calling thread, or kForeign_.
+		std::size_t index_() const noexcept;
+
+		static constexpr std::size_t kForeign_ = ~std::size_t(0);
+
+	private:
+		std::size_t mThreadCount;
+		std::vector<std::unique_ptr<Thread_>> mThreads;
+
+		std::mutex mQueueMutex;
+		std::deque<Job_*> mShared, mBackground;
+		std::atomic<std::size_t> mSharedCount, mBackgroundCount;
+
+		// Sleeping workers. mEpoch changes with every submission.
+		std::mutex mSleepMutex;
+		std::condition_variable mWakeCv;
+		std::atomic<std::uint64_t> mEpoch;
+		std::atomic<std::size_t> mSleepers;
+		bool mQuit;
+
+		std::vector<std::thread> mWorkers;
+};
+
+// Counts unfinished jobs, see JobSystem
+//
+// Submitting a job increments the counter, finishing it decrements it. A
+// counter may be reused once it has reached zero. Wait for it before
+// destroying it.
+class JobCounter final
+{
+	public:
+		JobCounter() noexcept;
+		~JobCounter();
+
+		JobCounter( JobCounter const& ) = delete;
+		JobCounter& operator= (JobCounter const&) = delete;
+
+	public:
+		bool done() const noexcept;
+
+	private:
+		friend class JobSystem;
+
+		// Decrements happen with mMutex held, so that a thread that saw zero
+		// can't destroy the counter while the last job still touches it.
+		std::atomic<std::size_t> mPending;
+
+		mutable std::mutex mMutex;
+		std::condition_variable mDoneCv;
+		std::vector<JobSystem::Job_*> mWaiting; // run_after()
+};
+
+
+template< typename tBody >
+void JobSystem::parallel_for( std::size_t aCount, tBody const& aBody, std::size_t aGrain )
+{
+	if( 0 == aGrain )
+		aGrain = std::max<std::size_t>( 1, aCount / (4*mThreadCount) );
+
+	auto const ranges = (aCount + aGrain-1) / aGrain;
+
+	// Not worth involving anybody else. Callers may rely on the grain (e.g.,
+	// one item per range), so keep to it here, too.
+	if( ranges <= 1 || 1 == mThreadCount )
+	{
+		for( std::size_t i = 0; i < ranges; ++i )
+			aBody( i*aGrain, std::min( (i+1)*aGrain, aCount ) );
+		return;
+	}
+
+	JobCounter counter;
+
+	for( std::size_t i = 1; i < ranges; ++i )
+	{
+		run( [&aBody, i, aGrain, aCount] {
+			aBody( i*aGrain, std::min( (i+1)*aGrain, aCount ) );
+		}, &counter );
+	}
+
+	aBody( std::size_t(0), aGrain );
+
+	wait( counter );
+}
+
+#endif // JOB_SYSTEM_HPP_2E7A5C90_D13B_4F6E_8A04_97C2B5E1F368
@@ -1,22 +1,68 @@
 #include "program.hpp"
 
+#include <string>
 #include <vector>
+#include <numeric>
 #include <utility>
+#include <filesystem>
+#include <string_view>
+#include <algorithm>
 
 #include <cstdio>
+#include <cstring>
 
 #include <glad/glad.h>
 
+#include "hash.hpp"
 #include "error.hpp"
 #include "checkpoint.hpp"
+#include "program_cache.hpp"
 
 namespace
 {
-	GLuint load_shader_( 
+	std::vector<GLchar> load_source_( 
+		char const* aSourcePath
+	);
+
+	// Source of a stage after preprocessing. GLSL refers to files by their
+	// "source string number", which is their index in files.
+	struct Preprocessed_
+	{
+		std::vector<GLchar> text;
+		std::vector<std::filesystem::path> files;
+	};
+
+	// Resolves #include lines and injects aDefines (see ShaderProgram).
+	Preprocessed_ preprocess_(
+		std::filesystem::path const& aSourcePath,
+		std::vector<ShaderDefine> const& aDefines
+	);
+
+	// "path", or "path (0: path, 1: included, ...)" if files were included
+	std::string describe_files_( 
+		std::vector<std::filesystem::path> const& aFiles
+	);
+
+	// Starts compiling a shader. The result is checked by check_shader_().
+	GLuint compile_shader_( 
+		GLenum aShaderType, 
+		std::vector<GLchar> const& aSource
+	);
+
+	// Throws if the shader failed to compile. Prints its log otherwise.
+	void check_shader_(
+		GLuint aShader,
 		GLenum aShaderType, 
 		char const* aSourcePath
 	);
 
+	// Bytes reserved for a uniform's shadow copy
+	std::size_t shadow_size_( GLenum aType ) noexcept;
+
+	// True for types that are set with glUniform1i() besides GL_INT, i.e.,
+	// bool, samplers and images.
+	bool set_as_int_( GLenum aType ) noexcept;
+
 	// lightweight std::experimental::scope_exit alternative
 	// Not the most complete or convenient implementation...
 	template< typename tFunc >
@@ -36,110 +82,450 @@ namespace
 	}
 }
 
-ShaderProgram::ShaderProgram( std::vector<ShaderSource> aShaderSources )
-	: mProgram( 0 )
-	, mSources( std::move(aShaderSources) )
+ShaderProgram::ShaderProgram( std::vector<ShaderSource> aShaderSources, ProgramBinaryCache* aCache, std::vector<ShaderDefine> aDefines, GpuResources* aResources )
+	: mSources( std::move(aShaderSources) )
+	, mDefines( std::move(aDefines) )
+	, mCache( aCache )
+	, mResources( aResources )
+	, mPending{ 0, {}, {}, 0, false }
+	, mUniformStats{}
 {
 	reload();
 }
 
 ShaderProgram::~ShaderProgram()
 {
-	if( 0 != mProgram )
-		glDeleteProgram( mProgram );
+	for( auto const shader : mPending.shaders )
+		glDeleteShader( shader );
+
+	if( 0 != mPending.program )
+		glDeleteProgram( mPending.program );
 }
 
 ShaderProgram::ShaderProgram( ShaderProgram&& aOther ) noexcept
-	: mProgram( std::exchange( aOther.mProgram, 0 ) )
+	: mProgram( std::move(aOther.mProgram) )
 	, mSources( std::move(aOther.mSources) )
+	, mDefines( std::move(aOther.mDefines) )
+	, mCache( aOther.mCache )
+	, mResources( aOther.mResources )
+	, mPending( std::exchange( aOther.mPending, Build_{ 0, {}, {}, 0, false } ) )
+	, mUniforms( std::move(aOther.mUniforms) )
+	, mUniformOrder( std::move(aOther.mUniformOrder) )
+	, mUniformBlocks( std::move(aOther.mUniformBlocks) )
+	, mShadows( std::move(aOther.mShadows) )
+	, mShadowData( std::move(aOther.mShadowData) )
+	, mUniformStats( aOther.mUniformStats )
 {}
 ShaderProgram& ShaderProgram::operator= (ShaderProgram&& aOther) noexcept
 {
 	std::swap( mProgram, aOther.mProgram );
 	std::swap( mSources, aOther.mSources );
+	std::swap( mDefines, aOther.mDefines );
+	std::swap( mCache, aOther.mCache );
+	std::swap( mResources, aOther.mResources );
+	std::swap( mPending, aOther.mPending );
+	std::swap( mUniforms, aOther.mUniforms );
+	std::swap( mUniformOrder, aOther.mUniformOrder );
+	std::swap( mUniformBlocks, aOther.mUniformBlocks );
+	std::swap( mShadows, aOther.mShadows );
+	std::swap( mShadowData, aOther.mShadowData );
+	std::swap( mUniformStats, aOther.mUniformStats );
 	return *this;
 }
 
 GLuint ShaderProgram::programId() const noexcept
 {
-	return mProgram;
+	return mProgram.id();
 }
 
 void ShaderProgram::reload()
 {
-	// Space to hold the shaders when we load them
-	std::vector<GLuint> shaders;
-	shaders.reserve( mSources.size() );
+	// Load and preprocess sources. The cache key covers each stage's type
+	// and preprocessed source, and thus includes and defines.
+	std::vector<std::vector<GLchar>> sources;
+	sources.reserve( mSources.size() );
 
-	// Ensure that shaders are cleaned up properly, regardless of how we leave
-	// the function (e.g., either by returning or by exception)
-	auto const scopeShaders_ = scope_exit_( [&shaders] {
-		for( auto const shader : shaders )
-			glDeleteShader( shader );
-	} );
+	std::vector<std::string> files;
+	files.reserve( mSources.size() );
 
-	// Load shaders
 	for( auto const& source : mSources )
-		shaders.emplace_back( load_shader_( source.type, source.sourcePath.c_str() ) );
+	{
+		auto stage = preprocess_( source.sourcePath, mDefines );
+		sources.emplace_back( std::move(stage.text) );
+		files.emplace_back( describe_files_( stage.files ) );
+	}
+
+	bool const useCache = mCache && mCache->enabled();
+
+	std::uint64_t key = 0;
+	if( useCache )
+	{
+		key = mCache->driver_hash();
+		for( std::size_t i = 0; i < mSources.size(); ++i )
+		{
+			std::uint64_t const header[] = { mSources[i].type, sources[i].size() };
+			key = hash_bytes( header, sizeof(header), key );
+			key = hash_bytes( sources[i].data(), sources[i].size(), key );
+		}
+	}
+
+	// Drop the previous pending build, if any. It's outdated.
+	for( auto const shader : mPending.shaders )
+		glDeleteShader( shader );
+
+	if( 0 != mPending.program )
+		glDeleteProgram( mPending.program );
+
+	mPending = Build_{ 0, {}, std::move(files), key, false };
 
 	// Create program object
 	OGL_CHECKPOINT_ALWAYS();
 
 	GLuint prog = glCreateProgram();
 
-	// Ensure that the program is cleaned up. 
+	// Warm start: skip compilation entirely if the cache has a binary.
+	if( useCache )
+	{
+		if( mCache->load( key, prog ) )
+		{
+			mPending.program = prog;
+			mPending.fromCache = true;
+			return;
+		}
 
-	/* There is a small trick here. If we successfully compile and link the new
-	 * program, we will replace the value of the "prog" variable with the old
-	 * program's ID. In this case, the following will delete the old program
-	 * (if there was any). If we do not reach the end (e.g. exception thrown),
-	 * the new program ID will still be in the "prog" variable, and we will
-	 * delete it appropriately. (However, the old program in mProgram is left
-	 * intact).
-	 */
-	auto const scopeProgram_ = scope_exit_( [&prog] {
-		if( 0 != prog )
-			glDeleteProgram( prog );
-	} );
+		// A refused binary leaves the program object unlinked. Start over
+		// with a fresh one.
+		glDeleteProgram( prog );
+		prog = glCreateProgram();
+	}
+
+	mPending.program = prog;
+
+	// Compile and link, but don't query the results. With parallel shader
+	// compilation, these calls return right away; querying the status would
+	// wait for the driver to finish. finish_() checks the results later.
+	mPending.shaders.reserve( mSources.size() );
+	for( std::size_t i = 0; i < mSources.size(); ++i )
+		mPending.shaders.emplace_back( compile_shader_( mSources[i].type, sources[i] ) );
 
 	// Link individual shaders to create the final shader program
-	for( auto const shader : shaders )
+	for( auto const shader : mPending.shaders )
 		glAttachShader( prog, shader );
 
+	if( useCache )
+		glProgramParameteri( prog, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE );
+
 	glLinkProgram( prog );
 
+	OGL_CHECKPOINT_ALWAYS();
+}
+
+bool ShaderProgram::poll()
+{
+	if( 0 == mPending.program )
+		return false;
+
+	if( GLAD_GL_KHR_parallel_shader_compile || GLAD_GL_ARB_parallel_shader_compile )
 	{
+		GLint done = GL_FALSE;
+		glGetProgramiv( mPending.program, GL_COMPLETION_STATUS_KHR, &done );
+
+		if( GL_TRUE != done )
+			return false;
+	}
+
+	return finish_();
+}
+
+bool ShaderProgram::wait()
+{
+	if( 0 == mPending.program )
+		return false;
+
+	return finish_();
+}
+
+bool ShaderProgram::pending() const noexcept
+{
+	return 0 != mPending.program;
+}
+
+bool ShaderProgram::finish_()
+{
+	auto build = std::exchange( mPending, Build_{ 0, {}, {}, 0, false } );
+
+	// Ensure that shaders are cleaned up properly, regardless of how we leave
+	// the function (e.g., either by returning or by exception)
+	auto const scopeShaders_ = scope_exit_( [&build] {
+		for( auto const shader : build.shaders )
+			glDeleteShader( shader );
+	} );
+
+	/* If we do not reach the end (e.g. exception thrown), the new program ID
+	 * will still be in build.program, and we will delete it appropriately.
+	 * (The old program in mProgram is left intact in that case.) On success,
+	 * mProgram takes over the new program, see below.
+	 */
+	auto const scopeProgram_ = scope_exit_( [&build] {
+		if( 0 != build.program )
+			glDeleteProgram( build.program );
+	} );
+
+	if( !build.fromCache )
+	{
+		// Report compile errors first; they are more useful than the
+		// resulting link error.
+		for( std::size_t i = 0; i < build.shaders.size(); ++i )
+			check_shader_( build.shaders[i], mSources[i].type, build.files[i].c_str() );
+
 		// Get info log
 		GLint logLength = 0;
-		glGetProgramiv( prog, GL_INFO_LOG_LENGTH, &logLength );
+		glGetProgramiv( build.program, GL_INFO_LOG_LENGTH, &logLength );
 
 		std::vector<GLchar> log;
 		if( logLength )
 		{
 			log.resize( logLength );
-			glGetProgramInfoLog( prog, GLsizei(log.size()), nullptr, log.data() );
+			glGetProgramInfoLog( build.program, GLsizei(log.size()), nullptr, log.data() );
 		}
 
 		// Check link status
 		GLint status = 0;
-		glGetProgramiv( prog, GL_LINK_STATUS, &status );
+		glGetProgramiv( build.program, GL_LINK_STATUS, &status );
 
 		if( GL_TRUE != status )
 			throw Error( "Shader program linking failed: \n%s\n", log.data() );
 
 		if( !log.empty() )
 			std::fprintf( stderr, "Note: shader program linking log:\n%s\n", log.data() );
+
+		if( mCache && mCache->enabled() )
+			mCache->store( build.cacheKey, build.program );
 	}
-	
+
 	OGL_CHECKPOINT_ALWAYS();
 
-	// Replace the old shader program (if any) with the new one
-	std::swap( mProgram, prog );
+	// Replace the old shader program (if any) with the new one. The old one
+	// may still be in use by frames in flight; with a GpuResources, it is
+	// deleted once they are done.
+	mProgram = GpuProgram( mResources, std::exchange( build.program, 0 ) );
+
+	reflect_();
+	return true;
+}
+
+bool ShaderProgram::set_uniform( UniformName aName, GLint aValue )
+{
+	auto const location = update_shadow_( aName, GL_INT, &aValue, sizeof(aValue) );
+	if( location < 0 )
+		return false;
+
+	glProgramUniform1i( mProgram.id(), location, aValue );
+	return true;
+}
+bool ShaderProgram::set_uniform( UniformName aName, GLuint aValue )
+{
+	auto const location = update_shadow_( aName, GL_UNSIGNED_INT, &aValue, sizeof(aValue) );
+	if( location < 0 )
+		return false;
+
+	glProgramUniform1ui( mProgram.id(), location, aValue );
+	return true;
+}
+bool ShaderProgram::set_uniform( UniformName aName, float aValue )
+{
+	auto const location = update_shadow_( aName, GL_FLOAT, &aValue, sizeof(aValue) );
+	if( location < 0 )
+		return false;
+
+	glProgramUniform1f( mProgram.id(), location, aValue );
+	return true;
+}
+bool ShaderProgram::set_uniform( UniformName aName, Vec2f aValue )
+{
+	auto const location = update_shadow_( aName, GL_FLOAT_VEC2, &aValue, sizeof(aValue) );
+	if( location < 0 )
+		return false;
+
+	glProgramUniform2f( mProgram.id(), location, aValue.x, aValue.y );
+	return true;
+}
+bool ShaderProgram::set_uniform( UniformName aName, Vec3f aValue )
+{
+	auto const location = update_shadow_( aName, GL_FLOAT_VEC3, &aValue, sizeof(aValue) );
+	if( location < 0 )
+		return false;
+
+	glProgramUniform3f( mProgram.id(), location, aValue.x, aValue.y, aValue.z );
+	return true;
+}
+bool ShaderProgram::set_uniform( UniformName aName, Vec4f aValue )
+{
+	auto const location = update_shadow_( aName, GL_FLOAT_VEC4, &aValue, sizeof(aValue) );
+	if( location < 0 )
+		return false;
+
+	glProgramUniform4f( mProgram.id(), location, aValue.x, aValue.y, aValue.z, aValue.w );
+	return true;
+}
+bool ShaderProgram::set_uniform( UniformName aName, Mat44f const& aValue )
+{
+	auto const location = update_shadow_( aName, GL_FLOAT_MAT4, &aValue, sizeof(aValue) );
+	if( location < 0 )
+		return false;
+
+	// Mat44f is row-major.
+	glProgramUniformMatrix4fv( mProgram.id(), location, 1, GL_TRUE, aValue.v );
+	return true;
+}
+
+std::span<UniformInfo const> ShaderProgram::uniforms() const noexcept
+{
+	return mUniforms;
+}
+std::span<UniformBlockInfo const> ShaderProgram::uniform_blocks() const noexcept
+{
+	return mUniformBlocks;
+}
+
+UniformInfo const* ShaderProgram::find_uniform( UniformName aName ) const noexcept
+{
+	auto const it = std::lower_bound( mUniformOrder.begin(), mUniformOrder.end(), aName.hash, [this] (std::uint32_t aIndex, std::uint64_t aHash) {
+		return mUniforms[aIndex].hash < aHash;
+	} );
+
+	if( mUniformOrder.end() == it || mUniforms[*it].hash != aName.hash )
+		return nullptr;
+
+	return &mUniforms[*it];
+}
+UniformBlockInfo const* ShaderProgram::find_uniform_block( UniformName aName ) const noexcept
+{
+	// There are only ever a few blocks.
+	for( auto const& block : mUniformBlocks )
+	{
+		if( block.hash == aName.hash )
+			return &block;
+	}
+
+	return nullptr;
+}
+
+UniformStats ShaderProgram::uniform_stats() const noexcept
+{
+	return mUniformStats;
+}
+
+void ShaderProgram::reflect_()
+{
+	mUniforms.clear();
+	mUniformOrder.clear();
+	mUniformBlocks.clear();
+	mShadows.clear();
+	mShadowData.clear();
+
+	std::vector<GLchar> name;
+
+	auto const resource_name = [&] (GLenum aInterface, GLuint aIndex) {
+		GLint maxLength = 0;
+		glGetProgramInterfaceiv( mProgram.id(), aInterface, GL_MAX_NAME_LENGTH, &maxLength );
+		name.resize( std::size_t(std::max( maxLength, 1 )) );
+
+		GLsizei length = 0;
+		glGetProgramResourceName( mProgram.id(), aInterface, aIndex, GLsizei(name.size()), &length, name.data() );
+		return std::string_view( name.data(), std::size_t(length) );
+	};
+
+	// Uniforms in the default block
+	GLint uniformCount = 0;
+	glGetProgramInterfaceiv( mProgram.id(), GL_UNIFORM, GL_ACTIVE_RESOURCES, &uniformCount );
+
+	for( GLint i = 0; i < uniformCount; ++i )
+	{
+		GLenum const props[] = { GL_BLOCK_INDEX, GL_TYPE, GL_LOCATION, GL_ARRAY_SIZE };
+		GLint values[std::size(props)]{};
+		glGetProgramResourceiv( mProgram.id(), GL_UNIFORM, GLuint(i), GLsizei(std::size(props)), props, GLsizei(std::size(values)), nullptr, values );
+
+		if( -1 != values[0] )
+			continue;
+
+		auto const fullName = resource_name( GL_UNIFORM, GLuint(i) );
+		auto baseName = fullName;
+		if( baseName.ends_with( "[0]" ) )
+			baseName.remove_suffix( 3 );
+
+		auto const type = GLenum(values[1]);
+		mUniforms.emplace_back( UniformInfo{ std::string(fullName), hash_string( baseName ), type, values[2], values[3] } );
+
+		mShadows.emplace_back( Shadow_{ std::uint32_t(mShadowData.size()), false } );
+		mShadowData.resize( mShadowData.size() + shadow_size_( type ) );
+	}
+
+	mUniformOrder.resize( mUniforms.size() );
+	std::iota( mUniformOrder.begin(), mUniformOrder.end(), 0u );
+	std::sort( mUniformOrder.begin(), mUniformOrder.end(), [this] (std::uint32_t aA, std::uint32_t aB) {
+		return mUniforms[aA].hash < mUniforms[aB].hash;
+	} );
+
+	// Uniform blocks
+	GLint blockCount = 0;
+	glGetProgramInterfaceiv( mProgram.id(), GL_UNIFORM_BLOCK, GL_ACTIVE_RESOURCES, &blockCount );
+
+	for( GLint i = 0; i < blockCount; ++i )
+	{
+		GLenum const props[] = { GL_BUFFER_BINDING, GL_BUFFER_DATA_SIZE };
+		GLint values[std::size(props)]{};
+		glGetProgramResourceiv( mProgram.id(), GL_UNIFORM_BLOCK, GLuint(i), GLsizei(std::size(props)), props, GLsizei(std::size(values)), nullptr, values );
+
+		auto const blockName = resource_name( GL_UNIFORM_BLOCK, GLuint(i) );
+		mUniformBlocks.emplace_back( UniformBlockInfo{ std::string(blockName), hash_string( blockName ), values[0], values[1] } );
+	}
+
+	OGL_CHECKPOINT_DEBUG();
+}
+
+GLint ShaderProgram::update_shadow_( UniformName aName, GLenum aType, void const* aData, std::size_t aSize )
+{
+	auto const* uniform = find_uniform( aName );
+	if( !uniform )
+		return -1;
+
+	if( aType != uniform->type && !(GL_INT == aType && set_as_int_( uniform->type )) )
+		throw Error( "Uniform '%s' has type 0x%04x, but was set with a value of type 0x%04x", uniform->name.c_str(), uniform->type, aType );
+
+	auto& shadow = mShadows[std::size_t(uniform - mUniforms.data())];
+	auto* data = mShadowData.data() + shadow.offset;
+
+	if( shadow.valid && 0 == std::memcmp( data, aData, aSize ) )
+	{
+		++mUniformStats.skipped;
+		return -1;
+	}
+
+	std::memcpy( data, aData, aSize );
+	shadow.valid = true;
+
+	++mUniformStats.issued;
+	return uniform->location;
+}
+
+bool enable_parallel_shader_compile()
+{
+	// 0xFFFFFFFF = as many threads as the implementation wants.
+	if( GLAD_GL_KHR_parallel_shader_compile )
+		glMaxShaderCompilerThreadsKHR( 0xFFFFFFFFu );
+	else if( GLAD_GL_ARB_parallel_shader_compile )
+		glMaxShaderCompilerThreadsARB( 0xFFFFFFFFu );
+	else
+		return false;
+
+	OGL_CHECKPOINT_ALWAYS();
+	return true;
 }
 
 namespace
 {
-	GLuint load_shader_( GLenum aShaderType, char const* aSourcePath )
+	std::vector<GLchar> load_source_( char const* aSourcePath )
 	{
 		// Load the shader source code from file
 		std::vector<GLchar> source;
@@ -162,9 +548,9 @@ namespace
 				if( 0 == ret )
 				{
 					if( auto const err = std::ferror( fin ) )
-						throw Error( "load_shader_(): error while reading from '%s': %d (%zu bytes read, %zu total)", aSourcePath, err, read, length );
+						throw Error( "load_source_(): error while reading from '%s': %d (%zu bytes read, %zu total)", aSourcePath, err, read, length );
 					if( std::feof( fin ) )
-						throw Error( "load_shader_(): unexpected EOF in '%s' (%zu bytes read, %zu total)", aSourcePath, read, length );
+						throw Error( "load_source_(): unexpected EOF in '%s' (%zu bytes read, %zu total)", aSourcePath, read, length );
 				}
 			
 				read += ret;
@@ -172,9 +558,126 @@ namespace
 		}
 		else
 		{
-			throw Error( "load_shader_(): unable to open input file '%s'", aSourcePath );
+			throw Error( "load_source_(): unable to open input file '%s'", aSourcePath );
 		}
 
+		return source;
+	}
+
+	Preprocessed_ preprocess_( std::filesystem::path const& aSourcePath, std::vector<ShaderDefine> const& aDefines )
+	{
+		// Guards against include cycles. Since each file is included only
+		// once, these can only happen through differently spelled paths.
+		constexpr std::size_t kMaxIncludeDepth = 32;
+
+		Preprocessed_ ret;
+
+		auto const append = [&ret] (std::string_view aText) {
+			ret.text.insert( ret.text.end(), aText.begin(), aText.end() );
+		};
+		auto const append_line_directive = [&] (std::size_t aLine, std::size_t aFile) {
+			append( "#line " + std::to_string( aLine ) + " " + std::to_string( aFile ) + "\n" );
+		};
+
+		bool injected = false;
+
+		auto const expand = [&] (auto const& aSelf, std::filesystem::path const& aPath, std::size_t aDepth) -> void {
+			auto const file = ret.files.size();
+			ret.files.emplace_back( aPath );
+
+			auto const source = load_source_( aPath.string().c_str() );
+			std::string_view rest( source.data(), source.size() );
+
+			for( std::size_t lineNumber = 1; !rest.empty(); ++lineNumber )
+			{
+				auto const eol = rest.find( '\n' );
+				auto const line = rest.substr( 0, eol );
+				rest.remove_prefix( std::string_view::npos == eol ? rest.size() : eol+1 );
+
+				// Directives may have whitespace before and after the '#'.
+				auto directive = line;
+				directive.remove_prefix( std::min( directive.find_first_not_of( " \t" ), directive.size() ) );
+
+				if( directive.starts_with( '#' ) )
+				{
+					directive.remove_prefix( 1 );
+					directive.remove_prefix( std::min( directive.find_first_not_of( " \t" ), directive.size() ) );
+				}
+				else
+				{
+					directive = {};
+				}
+
+				if( directive.starts_with( "include" ) )
+				{
+					auto const open = directive.find( '"' );
+					auto const close = std::string_view::npos == open ? open : directive.find( '"', open+1 );
+					if( std::string_view::npos == close )
+						throw Error( "%s:%zu: malformed #include (expected #include \"file\")", aPath.string().c_str(), lineNumber );
+
+					auto const name = directive.substr( open+1, close-open-1 );
+					auto const included = (aPath.parent_path() / name).lexically_normal();
+
+					if( ret.files.end() != std::find( ret.files.begin(), ret.files.end(), included ) )
+					{
+						append( "\n" );
+						continue;
+					}
+
+					if( aDepth >= kMaxIncludeDepth )
+						throw Error( "%s:%zu: #include nested too deeply", aPath.string().c_str(), lineNumber );
+
+					append_line_directive( 1, ret.files.size() );
+					aSelf( aSelf, included, aDepth+1 );
+					append_line_directive( lineNumber+1, file );
+					continue;
+				}
+
+				append( line );
+				append( "\n" );
+
+				if( 0 == file && !injected && directive.starts_with( "version" ) )
+				{
+					for( auto const& define : aDefines )
+						append( "#define " + define.name + " " + define.value + "\n" );
+
+					if( !aDefines.empty() )
+						append_line_directive( lineNumber+1, file );
+
+					injected = true;
+				}
+			}
+		};
+
+		expand( expand, aSourcePath.lexically_normal(), 0 );
+
+		if( !injected && !aDefines.empty() )
+			throw Error( "%s: no #version line to insert defines after", aSourcePath.string().c_str() );
+
+		return ret;
+	}
+
+	std::string describe_files_( std::vector<std::filesystem::path> const& aFiles )
+	{
+		std::string ret = aFiles.front().string();
+		if( 1 == aFiles.size() )
+			return ret;
+
+		ret += " (";
+		for( std::size_t i = 0; i < aFiles.size(); ++i )
+		{
+			if( i )
+				ret += ", ";
+
+			ret += std::to_string( i ) + ": " + aFiles[i].string();
+		}
+		ret += ")";
+
+		return ret;
+	}
+
+	GLuint compile_shader_( GLenum aShaderType, std::vector<GLchar> const& aSource )
+	{
 		// Create shader object
 		OGL_CHECKPOINT_ALWAYS();
 
@@ -182,10 +685,10 @@ namespace
 
 		// Compile shader
 		GLchar const* sources[] = {
-			source.data()
+			aSource.data()
 		};
 		GLsizei lengths[] = {
-			GLsizei(source.size())
+			GLsizei(aSource.size())
 		};
 
 		glShaderSource( shader, sizeof(sources)/sizeof(sources[0]), sources, lengths );
@@ -194,19 +697,24 @@ namespace
 
 		OGL_CHECKPOINT_ALWAYS();
 
+		return shader;
+	}
+
+	void check_shader_( GLuint aShader, GLenum aShaderType, char const* aSourcePath )
+	{
 		// Get compile info log
 		/* The compile log is mainly relevant if there is an error. However, on some
 		 * systems, it can include additional information even if compilation was
 		 * successful. This might include warnings and/or usage hints.
 		 */
 		GLint logLength = 0;
-		glGetShaderiv( shader, GL_INFO_LOG_LENGTH, &logLength );
+		glGetShaderiv( aShader, GL_INFO_LOG_LENGTH, &logLength );
 
 		std::vector<GLchar> log;
 		if( logLength )
 		{
 			log.resize( logLength );
-			glGetShaderInfoLog( shader, GLsizei(log.size()), nullptr, log.data() );
+			glGetShaderInfoLog( aShader, GLsizei(log.size()), nullptr, log.data() );
 		}
 
 		char const* shaderTypeName = "unknown shader";
@@ -222,19 +730,44 @@ namespace
 
 		// Check compile status
 		GLint status = 0;
-		glGetShaderiv( shader, GL_COMPILE_STATUS, &status );
+		glGetShaderiv( aShader, GL_COMPILE_STATUS, &status );
 
 		if( GL_TRUE != status )
-		{
-			glDeleteShader( shader );
 			throw Error( "%s \"%s\" compilation failed:\n%s\n", shaderTypeName, aSourcePath, log.data() );
-		}
 
 		if( !log.empty() )
 			std::fprintf( stderr, "Note: %s \"%s\" log:\n%s\n", shaderTypeName, aSourcePath, log.data() );
 
 		OGL_CHECKPOINT_ALWAYS();
+	}
 
-		return shader;
+	std::size_t shadow_size_( GLenum aType ) noexcept
+	{
+		// Only single values (no arrays) are set, up to a mat4.
+		return GL_FLOAT_MAT4 == aType ? sizeof(Mat44f) : sizeof(Vec4f);
+	}
+
+	bool set_as_int_( GLenum aType ) noexcept
+	{
+		switch( aType )
+		{
+			// Non-opaque types have their own setters (or none).
+			case GL_FLOAT: case GL_FLOAT_VEC2: case GL_FLOAT_VEC3: case GL_FLOAT_VEC4:
+			case GL_DOUBLE: case GL_DOUBLE_VEC2: case GL_DOUBLE_VEC3: case GL_DOUBLE_VEC4:
+			case GL_INT: case GL_INT_VEC2: case GL_INT_VEC3: case GL_INT_VEC4:
+			case GL_UNSIGNED_INT: case GL_UNSIGNED_INT_VEC2: case GL_UNSIGNED_INT_VEC3: case GL_UNSIGNED_INT_VEC4:
+			case GL_BOOL_VEC2: case GL_BOOL_VEC3: case GL_BOOL_VEC4:
+			case GL_FLOAT_MAT2: case GL_FLOAT_MAT3: case GL_FLOAT_MAT4:
+			case GL_FLOAT_MAT2x3: case GL_FLOAT_MAT2x4: case GL_FLOAT_MAT3x2:
+			case GL_FLOAT_MAT3x4: case GL_FLOAT_MAT4x2: case GL_FLOAT_MAT4x3:
+			case GL_DOUBLE_MAT2: case GL_DOUBLE_MAT3: case GL_DOUBLE_MAT4:
+			case GL_DOUBLE_MAT2x3: case GL_DOUBLE_MAT2x4: case GL_DOUBLE_MAT3x2:
+			case GL_DOUBLE_MAT3x4: case GL_DOUBLE_MAT4x2: case GL_DOUBLE_MAT4x3:
+				return false;
+
+			// GL_BOOL, samplers, images and atomic counters
+			default:
+				return true;
+		}
 	}
 }
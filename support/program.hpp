@@ -3,12 +3,108 @@
 
 #include <glad/glad.h>
 
+#include <span>
 #include <string>
 #include <vector>
+#include <string_view>
 
 #include <cstdint>
 #include <cstdlib>
 
+#include "hash.hpp"
+#include "gpu_resources.hpp"
+
+#include "../vmlib/vec2.hpp"
+#include "../vmlib/vec3.hpp"
+#include "../vmlib/vec4.hpp"
+#include "../vmlib/mat44.hpp"
+
+class ProgramBinaryCache;
+
+// Name of a uniform (or uniform block), identified by its hash. Declare
+// these as constexpr to hash the names at compile time:
+//
+//	constexpr UniformName kSourceLevel_{ "uSourceLevel" };
+struct UniformName
+{
+	constexpr UniformName( char const* aName ) noexcept
+		: hash( hash_string( aName ) )
+	{}
+	constexpr UniformName( std::string_view aName ) noexcept
+		: hash( hash_string( aName ) )
+	{}
+
+	std::uint64_t hash;
+};
+
+// Active uniform in the default uniform block, as reported by the GL after
+// linking. Uniforms in named blocks are not included.
+struct UniformInfo
+{
+	std::string name; // arrays: "name[0]"
+	std::uint64_t hash; // of the name without "[0]"
+
+	GLenum type;
+	GLint location;
+	GLint arraySize;
+};
+
+struct UniformBlockInfo
+{
+	std::string name;
+	std::uint64_t hash;
+
+	GLint binding;
+	GLint dataSize; // bytes
+};
+
+struct UniformStats
+{
+	std::size_t issued; // values passed to the GL
+	std::size_t skipped; // values that were unchanged
+};
+
+// Preprocessor definition, injected as "#define name value" into each stage
+// right after its #version line. The value may be empty.
+struct ShaderDefine
+{
+	std::string name;
+	std::string value;
+};
+
+// Shader program, built from source files.
+//
+// Sources are preprocessed before they are handed to the driver:
+//  - #include "file" lines are replaced by the contents of file, which is
+//    looked up relative to the including file. Each file is included at most
+//    once per stage. #line directives are inserted, so that the driver's
+//    messages refer to the right line; compile errors list which file each
+//    source string number refers to. Note that #include lines are recognized
+//    even inside block comments and inactive #if blocks.
+//  - the program's defines are inserted after the #version line.
+// See ShaderVariants for building several variants of the same sources.
+//
+// Building is asynchronous: the constructor and reload() only hand the
+// sources to the driver and return. If the driver compiles in the background
+// (see enable_parallel_shader_compile()), poll() picks up the result once it
+// is ready, without blocking. Until then, programId() keeps returning the
+// previous program (or 0 before the first build has completed). wait()
+// blocks until the pending build is done.
+//
+// If a ProgramBinaryCache is given, builds first look for a cached binary of
+// the program (keyed on the stages' types and sources), and only compile
+// from source if there is none. Newly compiled programs are added to the
+// cache. The cache must outlive the program.
+//
+// If a GpuResources is given, replaced programs (after a reload) and the
+// final program are handed to it, so that they are only deleted once frames
+// in flight are done with them. It must outlive the program.
+//
+// After linking, the program's active uniforms and uniform blocks are
+// reflected. set_uniform() looks uniforms up by the hash of their name and
+// keeps a copy of each value that it set. If the value did not change, no GL
+// call is made. The copies are reset when a new build is swapped in.
+// Uniforms that are not active (e.g., optimized away) are ignored.
 class ShaderProgram final
 {
 	public:
@@ -20,7 +116,10 @@ class ShaderProgram final
 
 	public:
 		explicit ShaderProgram( 
-			std::vector<ShaderSource> = {}
+			std::vector<ShaderSource> = {},
+			ProgramBinaryCache* = nullptr,
+			std::vector<ShaderDefine> = {},
+			GpuResources* = nullptr
 		);
 
 		~ShaderProgram();
@@ -34,11 +133,91 @@ class ShaderProgram final
 	public:
 		GLuint programId() const noexcept;
 
+		// Starts a new build from the source files, replacing any pending
+		// one. Throws if a source file (or an included file) cannot be read.
 		void reload();
 
+		// If the pending build has finished, swaps in the new program and
+		// returns true. Throws if it failed to compile or link; the previous
+		// program stays in use in that case.
+		bool poll();
+
+		// Like poll(), but waits for the pending build to finish.
+		bool wait();
+
+		bool pending() const noexcept;
+
+	public:
+		// Setters return true if the value was passed to the GL, and false
+		// if it was unchanged (or if the uniform is not active). They throw
+		// if the uniform's type doesn't match. The GLint overload also sets
+		// bool, sampler and image uniforms.
+		bool set_uniform( UniformName, GLint );
+		bool set_uniform( UniformName, GLuint );
+		bool set_uniform( UniformName, float );
+		bool set_uniform( UniformName, Vec2f );
+		bool set_uniform( UniformName, Vec3f );
+		bool set_uniform( UniformName, Vec4f );
+		bool set_uniform( UniformName, Mat44f const& );
+
+		std::span<UniformInfo const> uniforms() const noexcept;
+		std::span<UniformBlockInfo const> uniform_blocks() const noexcept;
+
+		// Returns nullptr if there is no such active uniform (block).
+		UniformInfo const* find_uniform( UniformName ) const noexcept;
+		UniformBlockInfo const* find_uniform_block( UniformName ) const noexcept;
+
+		UniformStats uniform_stats() const noexcept;
+
+	private:
+		struct Build_
+		{
+			GLuint program; // 0 = no build pending
+			std::vector<GLuint> shaders;
+			std::vector<std::string> files; // per shader, for messages
+
+			std::uint64_t cacheKey;
+			bool fromCache;
+		};
+
+		struct Shadow_
+		{
+			std::uint32_t offset; // in mShadowData
+			bool valid;
+		};
+
+		bool finish_();
+		void reflect_();
+
+		// Returns the uniform's location if aData differs from the shadow
+		// copy (and updates the copy), or -1 if no GL call is needed.
+		GLint update_shadow_( UniformName, GLenum aType, void const* aData, std::size_t aSize );
+
 	private:
-		GLuint mProgram;
+		GpuProgram mProgram;
 		std::vector<ShaderSource> mSources;
+		std::vector<ShaderDefine> mDefines;
+
+		ProgramBinaryCache* mCache;
+		GpuResources* mResources;
+
+		Build_ mPending;
+
+		// Reflection. mUniformOrder indexes mUniforms, sorted by hash.
+		std::vector<UniformInfo> mUniforms;
+		std::vector<std::uint32_t> mUniformOrder;
+		std::vector<UniformBlockInfo> mUniformBlocks;
+
+		std::vector<Shadow_> mShadows; // parallel to mUniforms
+		std::vector<std::byte> mShadowData;
+
+		UniformStats mUniformStats;
 };
 
+// Allows the driver to compile shaders and link programs on background
+// threads, if it supports GL_KHR_parallel_shader_compile (or the ARB
+// version). Returns false if it doesn't; builds then complete synchronously
+// in poll()/wait().
+bool enable_parallel_shader_compile();
+
 #endif // PROGRAM_HPP_39793FD2_7845_47A7_9E21_6DDAD42C9A09
@@ -0,0 +1,216 @@
+#include "program_cache.hpp"
+
+#include <vector>
+#include <algorithm>
+#include <system_error>
+
+#include <cstdio>
+#include <cstring>
+
+#include "hash.hpp"
+#include "checkpoint.hpp"
+
+namespace
+{
+	// File layout: header, followed by header.length bytes of binary data.
+	constexpr std::uint32_t kMagic_ = 0x42505247; // "GRPB"
+	constexpr std::uint32_t kVersion_ = 1;
+
+	struct FileHeader_
+	{
+		std::uint32_t magic, version;
+		std::uint64_t key;
+		std::uint32_t format; // GLenum returned by glGetProgramBinary()
+		std::uint32_t length;
+	};
+
+	std::uint64_t hash_gl_string_( GLenum aName, std::uint64_t aSeed ) noexcept
+	{
+		auto const* str = reinterpret_cast<char const*>(glGetString( aName ));
+		return hash_string( str ? str : "", aSeed );
+	}
+}
+
+ProgramBinaryCache::ProgramBinaryCache( std::filesystem::path aDirectory )
+	: mDirectory( std::move(aDirectory) )
+	, mDriverHash( kHashSeed )
+	, mEnabled( false )
+	, mStats{}
+{
+	GLint formats = 0;
+	glGetIntegerv( GL_NUM_PROGRAM_BINARY_FORMATS, &formats );
+
+	if( formats <= 0 )
+	{
+		std::fprintf( stderr, "Note: driver supports no program binary formats; shader cache disabled.\n" );
+		return;
+	}
+
+	std::vector<GLint> supported( std::size_t(formats), 0 );
+	glGetIntegerv( GL_PROGRAM_BINARY_FORMATS, supported.data() );
+	mFormats.assign( supported.begin(), supported.end() );
+
+	mDriverHash = hash_gl_string_( GL_VENDOR, mDriverHash );
+	mDriverHash = hash_gl_string_( GL_RENDERER, mDriverHash );
+	mDriverHash = hash_gl_string_( GL_VERSION, mDriverHash );
+
+	std::error_code ec;
+	std::filesystem::create_directories( mDirectory, ec );
+	if( ec )
+	{
+		std::fprintf( stderr, "Warning: unable to create shader cache directory '%s': %s. Shader cache disabled.\n", mDirectory.string().c_str(), ec.message().c_str() );
+		return;
+	}
+
+	mEnabled = true;
+}
+
+bool ProgramBinaryCache::enabled() const noexcept
+{
+	return mEnabled;
+}
+
+std::uint64_t ProgramBinaryCache::driver_hash() const noexcept
+{
+	return mDriverHash;
+}
+
+bool ProgramBinaryCache::load( std::uint64_t aKey, GLuint aProgram )
+{
+	if( !mEnabled )
+		return false;
+
+	auto const path = path_( aKey );
+
+	FileHeader_ header{};
+	std::vector<std::uint8_t> binary;
+
+	{
+		std::FILE* fin = std::fopen( path.string().c_str(), "rb" );
+		if( !fin )
+		{
+			++mStats.misses;
+			return false;
+		}
+
+		// A corrupt length could ask for up to 4 GiB, so it must fit in what
+		// is left of the file before anything is allocated.
+		std::error_code sizeEc;
+		auto const fileSize = std::filesystem::file_size( path, sizeEc );
+
+		bool ok = !sizeEc
+			&& 1 == std::fread( &header, sizeof(header), 1, fin )
+			&& kMagic_ == header.magic
+			&& kVersion_ == header.version
+			&& aKey == header.key
+			&& fileSize >= sizeof(header)
+			&& header.length <= fileSize - sizeof(header)
+		;
+
+		if( ok )
+		{
+			binary.resize( header.length );
+			ok = header.length == std::fread( binary.data(), 1, binary.size(), fin );
+		}
+
+		std::fclose( fin );
+
+		if( !ok )
+		{
+			std::fprintf( stderr, "Warning: ignoring corrupt shader cache entry '%s'\n", path.string().c_str() );
+
+			std::error_code ec;
+			std::filesystem::remove( path, ec );
+
+			++mStats.misses;
+			return false;
+		}
+	}
+
+	// A format that the driver no longer supports would raise
+	// GL_INVALID_ENUM. Other refused binaries only fail to link, which is
+	// how the spec reports them; no glGetError() (and no sync) is needed.
+	bool const supported = mFormats.end() != std::find( mFormats.begin(), mFormats.end(), GLenum(header.format) );
+
+	GLint status = GL_FALSE;
+	if( supported )
+	{
+		glProgramBinary( aProgram, GLenum(header.format), binary.data(), GLsizei(binary.size()) );
+		glGetProgramiv( aProgram, GL_LINK_STATUS, &status );
+	}
+
+	if( GL_TRUE != status )
+	{
+		std::error_code ec;
+		std::filesystem::remove( path, ec );
+
+		++mStats.rejected;
+		++mStats.misses;
+		return false;
+	}
+
+	++mStats.hits;
+	return true;
+}
+
+void ProgramBinaryCache::store( std::uint64_t aKey, GLuint aProgram )
+{
+	if( !mEnabled )
+		return;
+
+	GLint length = 0;
+	glGetProgramiv( aProgram, GL_PROGRAM_BINARY_LENGTH, &length );
+
+	if( length <= 0 )
+		return;
+
+	std::vector<std::uint8_t> binary( static_cast<std::size_t>(length) );
+
+	GLenum format = 0;
+	GLsizei written = 0;
+	glGetProgramBinary( aProgram, length, &written, &format, binary.data() );
+
+	OGL_CHECKPOINT_ALWAYS();
+
+	FileHeader_ const header{ kMagic_, kVersion_, aKey, std::uint32_t(format), std::uint32_t(written) };
+
+	// Write to a temporary file first, so that a concurrently starting
+	// instance never sees a partial entry.
+	auto const path = path_( aKey );
+	auto tempPath = path;
+	tempPath += ".tmp";
+
+	bool ok = false;
+	if( std::FILE* fout = std::fopen( tempPath.string().c_str(), "wb" ) )
+	{
+		ok = 1 == std::fwrite( &header, sizeof(header), 1, fout )
+			&& std::size_t(written) == std::fwrite( binary.data(), 1, std::size_t(written), fout )
+		;
+		ok = (0 == std::fclose( fout )) && ok;
+	}
+
+	std::error_code ec;
+	if( ok )
+		std::filesystem::rename( tempPath, path, ec );
+
+	if( !ok || ec )
+	{
+		std::fprintf( stderr, "Warning: unable to write shader cache entry '%s'\n", path.string().c_str() );
+		std::filesystem::remove( tempPath, ec );
+		return;
+	}
+
+	++mStats.stored;
+}
+
+ProgramCacheStats ProgramBinaryCache::stats() const noexcept
+{
+	return mStats;
+}
+
+std::filesystem::path ProgramBinaryCache::path_( std::uint64_t aKey ) const
+{
+	char name[32];
+	std::snprintf( name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(aKey) );
+	return mDirectory / name;
+}
@@ -0,0 +1,74 @@
+#ifndef PROGRAM_CACHE_HPP_8D3A61F0_57C2_4B9E_A04D_2E7F19C6B385
+#define PROGRAM_CACHE_HPP_8D3A61F0_57C2_4B9E_A04D_2E7F19C6B385
+
+#include <glad/glad.h>
+
+#include <vector>
+#include <filesystem>
+
+#include <cstddef>
+#include <cstdint>
+
+struct ProgramCacheStats
+{
+	std::size_t hits; // programs loaded from a binary
+	std::size_t misses; // no (usable) binary, compiled from source
+	std::size_t rejected; // binaries that the driver refused
+	std::size_t stored; // binaries written
+};
+
+// On-disk cache of linked program binaries (glGetProgramBinary()).
+//
+// Each binary is stored in its own file, named after its key. Keys combine a
+// hash of the program's sources (computed by the caller, see ShaderProgram)
+// with a hash of the GL_VENDOR, GL_RENDERER and GL_VERSION strings, so that
+// binaries from a different driver are never tried. Drivers may still
+// refuse a binary (e.g., after an update that didn't change the version
+// string); such binaries are deleted, and the caller falls back to
+// compiling from source.
+//
+// The cache is best-effort: I/O errors are reported to stderr, but never
+// thrown. If the driver doesn't support any binary formats, the cache is
+// disabled.
+//
+// Requires a current OpenGL context, and must only be used from its thread.
+class ProgramBinaryCache final
+{
+	public:
+		explicit ProgramBinaryCache( std::filesystem::path aDirectory );
+
+		ProgramBinaryCache( ProgramBinaryCache const& ) = delete;
+		ProgramBinaryCache& operator= (ProgramBinaryCache const&) = delete;
+
+	public:
+		bool enabled() const noexcept;
+
+		// Seed for the key of a program. Sources are hashed on top of this.
+		std::uint64_t driver_hash() const noexcept;
+
+		// Loads the binary for aKey into aProgram (a new program object).
+		// Returns false if there is no binary, or if the driver refused it.
+		// In the latter case, aProgram is unusable and should be deleted.
+		bool load( std::uint64_t aKey, GLuint aProgram );
+
+		// Stores the binary of the linked program aProgram. The program
+		// should have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT.
+		void store( std::uint64_t aKey, GLuint aProgram );
+
+		ProgramCacheStats stats() const noexcept;
+
+	private:
+		std::filesystem::path path_( std::uint64_t aKey ) const;
+
+	private:
+		std::filesystem::path mDirectory;
+		std::uint64_t mDriverHash;
+		bool mEnabled;
+
+		// GL_PROGRAM_BINARY_FORMATS
+		std::vector<GLenum> mFormats;
+
+		ProgramCacheStats mStats;
+};
+
+#endif // PROGRAM_CACHE_HPP_8D3A61F0_57C2_4B9E_A04D_2E7F19C6B385
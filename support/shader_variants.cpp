@@ -0,0 +1,88 @@
+#include "shader_variants.hpp"
+
+#include <string>
+#include <utility>
+#include <algorithm>
+
+#include "hash.hpp"
+
+ShaderVariants::ShaderVariants( std::vector<ShaderProgram::ShaderSource> aSources, ProgramBinaryCache* aCache, GpuResources* aResources )
+	: mSources( std::move(aSources) )
+	, mCache( aCache )
+	, mResources( aResources )
+{}
+
+ShaderProgram& ShaderVariants::get( std::span<ShaderDefine const> aDefines )
+{
+	auto const key = hash( aDefines );
+
+	// Sorted, so that the generated source (and thus the program binary
+	// cache key) doesn't depend on the order either.
+	std::vector<ShaderDefine> defines( aDefines.begin(), aDefines.end() );
+	std::sort( defines.begin(), defines.end(), [] (ShaderDefine const& aA, ShaderDefine const& aB) {
+		return aA.name < aB.name || (aA.name == aB.name && aA.value < aB.value);
+	} );
+
+	auto const same = [] (ShaderDefine const& aA, ShaderDefine const& aB) {
+		return aA.name == aB.name && aA.value == aB.value;
+	};
+
+	auto const [first, last] = mVariants.equal_range( key );
+	for( auto it = first; last != it; ++it )
+	{
+		auto const& known = it->second.defines;
+		if( std::equal( known.begin(), known.end(), defines.begin(), defines.end(), same ) )
+			return it->second.program;
+	}
+
+	auto const it = mVariants.emplace( key, Variant_{ defines, ShaderProgram( mSources, mCache, defines, mResources ) } );
+	return it->second.program;
+}
+
+void ShaderVariants::reload()
+{
+	for( auto& [key, variant] : mVariants )
+		variant.program.reload();
+}
+
+bool ShaderVariants::poll()
+{
+	bool swapped = false;
+	for( auto& [key, variant] : mVariants )
+		swapped = variant.program.poll() || swapped;
+
+	return swapped;
+}
+
+bool ShaderVariants::wait()
+{
+	bool swapped = false;
+	for( auto& [key, variant] : mVariants )
+		swapped = variant.program.wait() || swapped;
+
+	return swapped;
+}
+
+bool ShaderVariants::pending() const noexcept
+{
+	return std::any_of( mVariants.begin(), mVariants.end(), [] (auto const& aVariant) {
+		return aVariant.second.program.pending();
+	} );
+}
+
+std::size_t ShaderVariants::size() const noexcept
+{
+	return mVariants.size();
+}
+
+std::uint64_t ShaderVariants::hash( std::span<ShaderDefine const> aDefines ) noexcept
+{
+	// The hashes of the individual defines are combined with an addition,
+	// which is commutative. Name and value are separated by a zero byte,
+	// which can't appear in either.
+	std::uint64_t ret = 0;
+	for( auto const& define : aDefines )
+		ret += hash_string( define.value, hash_bytes( "", 1, hash_string( define.name ) ) );
+
+	return ret;
+}
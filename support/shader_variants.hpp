@@ -0,0 +1,74 @@
+#ifndef SHADER_VARIANTS_HPP_03A15A63_4040_4A8A_9404_4A9D0857B161
+#define SHADER_VARIANTS_HPP_03A15A63_4040_4A8A_9404_4A9D0857B161
+
+#include <span>
+#include <vector>
+#include <unordered_map>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "program.hpp"
+
+// Variants of a shader program, built from the same sources with different
+// sets of defines (see ShaderProgram and ShaderDefine).
+//
+// Variants are built lazily: get() creates the program for a define set the
+// first time that set is requested, and returns the existing one after that.
+// Combinations that are never requested are never compiled. As with any
+// ShaderProgram, a new variant's build is asynchronous; call wait() on it
+// (or on all variants) before first use.
+//
+// Define sets are looked up by a hash of their names and values, and then
+// compared in full, so colliding sets still get separate variants. The order
+// of the defines does not matter.
+//
+//	ShaderVariants variants( { { GL_COMPUTE_SHADER, "foo.comp" } }, cache );
+//	ShaderDefine const fast[] = { { "FAST", "1" } };
+//	glUseProgram( variants.get( fast ).programId() );
+class ShaderVariants final
+{
+	public:
+		explicit ShaderVariants( 
+			std::vector<ShaderProgram::ShaderSource>,
+			ProgramBinaryCache* = nullptr,
+			GpuResources* = nullptr
+		);
+
+		ShaderVariants( ShaderVariants const& ) = delete;
+		ShaderVariants& operator= (ShaderVariants const&) = delete;
+
+	public:
+		// Returns the variant for aDefines, and starts building it if it
+		// doesn't exist yet. References remain valid for the lifetime of
+		// the ShaderVariants object.
+		ShaderProgram& get( std::span<ShaderDefine const> aDefines = {} );
+
+		// Like ShaderProgram::reload(), poll() and wait(), for each variant
+		// that has been requested so far. poll() and wait() return true if
+		// any variant was swapped in.
+		void reload();
+		bool poll();
+		bool wait();
+
+		bool pending() const noexcept;
+
+		std::size_t size() const noexcept;
+
+		static std::uint64_t hash( std::span<ShaderDefine const> ) noexcept;
+
+	private:
+		std::vector<ShaderProgram::ShaderSource> mSources;
+		ProgramBinaryCache* mCache;
+		GpuResources* mResources;
+
+		struct Variant_
+		{
+			std::vector<ShaderDefine> defines; // sorted by name
+			ShaderProgram program;
+		};
+
+		std::unordered_multimap<std::uint64_t, Variant_> mVariants;
+};
+
+#endif // SHADER_VARIANTS_HPP_03A15A63_4040_4A8A_9404_4A9D0857B161
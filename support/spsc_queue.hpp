@@ -0,0 +1,88 @@
+#ifndef SPSC_QUEUE_HPP_7C1D58A2_40E3_4B8F_A9D6_2E6F13B0C875
+#define SPSC_QUEUE_HPP_7C1D58A2_40E3_4B8F_A9D6_2E6F13B0C875
+
+#include <array>
+#include <atomic>
+#include <type_traits>
+
+#include <cstddef>
+
+// Bounded lock-free single-producer single-consumer queue.
+//
+// Exactly one thread may call try_push() and exactly one (other) thread may
+// call try_pop(). Neither call blocks or allocates. tCapacity must be a power
+// of two; the queue holds at most tCapacity items.
+//
+// The head and tail indices increase monotonically and are reduced modulo
+// the capacity on access. Each side keeps a cached copy of the other side's
+// index, so that the shared cache line is only read when the queue looks
+// full (producer) or empty (consumer).
+template< typename tItem, std::size_t tCapacity >
+class SpscQueue final
+{
+	static_assert( tCapacity > 0 && 0 == (tCapacity & (tCapacity-1)), "SpscQueue: capacity must be a power of two" );
+	static_assert( std::is_trivially_copyable_v<tItem>, "SpscQueue: items must be trivially copyable" );
+
+	public:
+		SpscQueue() = default;
+
+		SpscQueue( SpscQueue const& ) = delete;
+		SpscQueue& operator= (SpscQueue const&) = delete;
+
+	public:
+		// Producer: returns false if the queue is full.
+		bool try_push( tItem const& aItem ) noexcept
+		{
+			auto const tail = mTail.load( std::memory_order_relaxed );
+			if( tail - mCachedHead == tCapacity )
+			{
+				mCachedHead = mHead.load( std::memory_order_acquire );
+				if( tail - mCachedHead == tCapacity )
+					return false;
+			}
+
+			mItems[tail & (tCapacity-1)] = aItem;
+			mTail.store( tail+1, std::memory_order_release );
+			return true;
+		}
+
+		// Consumer: returns false if the queue is empty.
+		bool try_pop( tItem& aItem ) noexcept
+		{
+			auto const head = mHead.load( std::memory_order_relaxed );
+			if( head == mCachedTail )
+			{
+				mCachedTail = mTail.load( std::memory_order_acquire );
+				if( head == mCachedTail )
+					return false;
+			}
+
+			aItem = mItems[head & (tCapacity-1)];
+			mHead.store( head+1, std::memory_order_release );
+			return true;
+		}
+
+		// Consumer: true if there is nothing to pop.
+		bool empty() noexcept
+		{
+			auto const head = mHead.load( std::memory_order_relaxed );
+			if( head != mCachedTail )
+				return false;
+
+			mCachedTail = mTail.load( std::memory_order_acquire );
+			return head == mCachedTail;
+		}
+
+	private:
+		// Producer side
+		alignas(64) std::atomic<std::size_t> mTail{ 0 };
+		std::size_t mCachedHead = 0;
+
+		// Consumer side
+		alignas(64) std::atomic<std::size_t> mHead{ 0 };
+		std::size_t mCachedTail = 0;
+
+		alignas(64) std::array<tItem, tCapacity> mItems{};
+};
+
+#endif // SPSC_QUEUE_HPP_7C1D58A2_40E3_4B8F_A9D6_2E6F13B0C875
@@ -0,0 +1,179 @@
+#include "task_graph.hpp"
+
+#include <utility>
+#include <algorithm>
+
+#include "error.hpp"
+
+TaskGraph::TaskGraph( JobSystem& aJobs )
+	: mJobs( aJobs )
+	, mCreated( Clock_::now() )
+	, mWaitedMs( 0.0 )
+{}
+
+TaskGraph::~TaskGraph()
+{
+	for( auto& task : mTasks )
+		mJobs.wait( task.done );
+}
+
+TaskGraph::Task TaskGraph::add( std::string aName, std::function<void()> aFunc, std::initializer_list<Task> aDependencies )
+{
+	return add_( std::move(aName), std::move(aFunc), aDependencies, false );
+}
+
+TaskGraph::Task TaskGraph::add_background( std::string aName, std::function<void()> aFunc, std::initializer_list<Task> aDependencies )
+{
+	return add_( std::move(aName), std::move(aFunc), aDependencies, true );
+}
+
+TaskGraph::Task TaskGraph::add_( std::string aName, std::function<void()> aFunc, std::initializer_list<Task> aDependencies, bool aBackground )
+{
+	auto const id = mTasks.size();
+
+	// Jobs only get pointers: mTasks itself may change while they run.
+	std::vector<Task_*> dependencies;
+	std::vector<JobCounter*> counters;
+	for( auto const dependency : aDependencies )
+	{
+		if( dependency >= id )
+			throw Error( "TaskGraph: task '%s' depends on unknown task %zu", aName.c_str(), dependency );
+
+		dependencies.emplace_back( &mTasks[dependency] );
+		counters.emplace_back( &mTasks[dependency].done );
+	}
+
+	auto& task = mTasks.emplace_back();
+	task.name = std::move(aName);
+	task.dependencies.assign( aDependencies );
+
+	auto job = [task = &task, dependencies = std::move(dependencies), func = std::move(aFunc)] {
+		for( auto const* dependency : dependencies )
+		{
+			if( dependency->error )
+			{
+				task->error = dependency->error;
+				return;
+			}
+		}
+
+		task->start = Clock_::now();
+
+		try
+		{
+			func();
+		}
+		catch( ... )
+		{
+			task->error = std::current_exception();
+		}
+
+		task->end = Clock_::now();
+	};
+
+	if( aBackground )
+		mJobs.run_background_after( counters, std::move(job), &task.done );
+	else
+		mJobs.run_after( counters, std::move(job), &task.done );
+
+	return id;
+}
+
+void TaskGraph::wait( Task aTask )
+{
+	auto& task = mTasks.at( aTask );
+
+	auto const start = Clock_::now();
+	mJobs.wait( task.done );
+	mWaitedMs += std::chrono::duration<double, std::milli>( Clock_::now() - start ).count();
+
+	if( task.error )
+		std::rethrow_exception( task.error );
+}
+
+bool TaskGraph::done( Task aTask ) const
+{
+	return mTasks.at( aTask ).done.done();
+}
+
+TaskGraphStats TaskGraph::stats() const
+{
+	TaskGraphStats ret{};
+	ret.tasks = mTasks.size();
+	ret.waitedMs = mWaitedMs;
+
+	std::vector<std::pair<double, Task>> memo( mTasks.size(), { -1.0, 0 } );
+
+	auto last = mCreated;
+	for( std::size_t i = 0; i < mTasks.size(); ++i )
+	{
+		auto const& task = mTasks[i];
+		if( task.error )
+			++ret.failed;
+
+		ret.workMs += ms_( i );
+		ret.criticalMs = std::max( ret.criticalMs, chain_( i, memo ).first );
+		last = std::max( last, task.end );
+	}
+
+	ret.elapsedMs = std::chrono::duration<double, std::milli>( last - mCreated ).count();
+	return ret;
+}
+
+std::string TaskGraph::critical_path() const
+{
+	if( mTasks.empty() )
+		return {};
+
+	std::vector<std::pair<double, Task>> memo( mTasks.size(), { -1.0, 0 } );
+
+	Task end = 0;
+	for( std::size_t i = 0; i < mTasks.size(); ++i )
+	{
+		if( chain_( i, memo ).first > chain_( end, memo ).first )
+			end = i;
+	}
+
+	std::vector<Task> path{ end };
+	while( memo[path.back()].second != path.back() )
+		path.emplace_back( memo[path.back()].second );
+
+	std::string ret;
+	for( auto it = path.rbegin(); it != path.rend(); ++it )
+	{
+		if( !ret.empty() )
+			ret += " > ";
+
+		ret += mTasks[*it].name;
+	}
+
+	return ret;
+}
+
+double TaskGraph::ms_( Task aTask ) const
+{
+	auto const& task = mTasks[aTask];
+	if( Clock_::time_point{} == task.start )
+		return 0.0;
+
+	return std::chrono::duration<double, std::milli>( task.end - task.start ).count();
+}
+
+std::pair<double, TaskGraph::Task> TaskGraph::chain_( Task aTask, std::vector<std::pair<double, Task>>& aMemo ) const
+{
+	// Dependencies always have smaller indices, so the recursion ends.
+	if( aMemo[aTask].first >= 0.0 )
+		return aMemo[aTask];
+
+	std::pair<double, Task> ret{ 0.0, aTask };
+	for( auto const dependency : mTasks[aTask].dependencies )
+	{
+		auto const ms = chain_( dependency, aMemo ).first;
+		if( ms > ret.first || ret.second == aTask )
+			ret = { ms, dependency };
+	}
+
+	ret.first += ms_( aTask );
+	aMemo[aTask] = ret;
+	return ret;
+}
@@ -0,0 +1,108 @@
+#ifndef TASK_GRAPH_HPP_6F0B3D84_A2E9_4C71_9D5A_1E8C47B2F630
+#define TASK_GRAPH_HPP_6F0B3D84_A2E9_4C71_9D5A_1E8C47B2F630
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <utility>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+
+#include <cstddef>
+
+#include "job_system.hpp"
+
+struct TaskGraphStats
+{
+	std::size_t tasks;
+	std::size_t failed; // threw, or a dependency did
+
+	double workMs; // run time of all tasks, summed
+	double elapsedMs; // from the creation of the graph to the last task's end
+	double criticalMs; // run time of the longest chain of dependent tasks
+	double waitedMs; // spent in wait()
+};
+
+// Named tasks with dependencies, run on a JobSystem
+//
+// add() submits a task right away; it starts once all of its dependencies
+// have finished. Independent tasks thus run in parallel, and the graph as a
+// whole takes about as long as its longest chain of dependent tasks (given
+// enough threads). wait() waits for a single task, so that the caller can
+// go on with its own work (e.g., things that need the OpenGL context) and
+// only block on the results it actually needs next. done() checks whether a
+// task has finished without blocking, for results that are picked up
+// whenever they become available.
+//
+// Tasks that nothing waits for soon (e.g., results that are only needed
+// after the first frame) should be added with add_background(). They run as
+// background jobs (see JobSystem), so that a wait() for a task that is needed
+// right away doesn't end up running them on the waiting thread.
+//
+// Unlike plain jobs, tasks may throw. The exception is rethrown by wait().
+// Tasks that depend on a failed task don't run, and fail with the same
+// exception.
+//
+// Tasks are added and waited for by the thread that created the graph. The
+// destructor waits for all tasks (ignoring their errors); data that tasks
+// refer to must outlive the graph.
+class TaskGraph final
+{
+	public:
+		using Task = std::size_t;
+
+		explicit TaskGraph( JobSystem& );
+		~TaskGraph();
+
+		TaskGraph( TaskGraph const& ) = delete;
+		TaskGraph& operator= (TaskGraph const&) = delete;
+
+	public:
+		Task add( std::string aName, std::function<void()>, std::initializer_list<Task> aDependencies = {} );
+		Task add_background( std::string aName, std::function<void()>, std::initializer_list<Task> aDependencies = {} );
+
+		void wait( Task );
+
+		// True once the task has finished (or failed); wait() then returns
+		// (or throws) right away.
+		bool done( Task ) const;
+
+		// Only meaningful once all tasks have finished.
+		TaskGraphStats stats() const;
+
+		// Names of the tasks on the longest chain, e.g., "a > b > c".
+		std::string critical_path() const;
+
+	private:
+		using Clock_ = std::chrono::steady_clock;
+
+		struct Task_
+		{
+			std::string name;
+			std::vector<Task> dependencies;
+
+			JobCounter done;
+			std::exception_ptr error;
+
+			Clock_::time_point start, end; // unset if the task didn't run
+		};
+
+		Task add_( std::string, std::function<void()>, std::initializer_list<Task>, bool aBackground );
+
+		double ms_( Task ) const;
+
+		// Longest chain ending with aTask; its run time and the task before
+		// aTask on it (or aTask if there is none).
+		std::pair<double, Task> chain_( Task, std::vector<std::pair<double, Task>>& aMemo ) const;
+
+	private:
+		JobSystem& mJobs;
+		Clock_::time_point mCreated;
+
+		std::deque<Task_> mTasks; // stable addresses
+		double mWaitedMs;
+};
+
+#endif // TASK_GRAPH_HPP_6F0B3D84_A2E9_4C71_9D5A_1E8C47B2F630
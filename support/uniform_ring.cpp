@@ -0,0 +1,217 @@
+#include "uniform_ring.hpp"
+
+#include <numeric>
+#include <algorithm>
+
+#include <cassert>
+#include <cstdint>
+
+#include "error.hpp"
+#include "checkpoint.hpp"
+
+namespace
+{
+	constexpr GLuint64 kFenceTimeoutNs_ = 1'000'000'000; // 1s
+
+	void wait_and_delete_( GLsync& );
+
+	std::size_t align_up_( std::size_t aValue, std::size_t aAlignment ) noexcept
+	{
+		return (aValue + aAlignment-1) / aAlignment * aAlignment;
+	}
+}
+
+UniformRing::UniformRing( std::size_t aBytesPerFrame, std::size_t aFrameCount )
+	: mBuffer( 0 )
+	, mRegionSize( 0 )
+	, mAlignment( 0 )
+	, mFences( aFrameCount, nullptr )
+	, mRegion( 0 )
+	, mCursor( 0 )
+	, mInFrame( false )
+	, mMapped( nullptr )
+{
+	if( 0 == aFrameCount || 0 == aBytesPerFrame )
+		throw Error( "UniformRing: invalid size (%zu bytes x %zu frames)", aBytesPerFrame, aFrameCount );
+
+	GLint uboAlign = 0, ssboAlign = 0;
+	glGetIntegerv( GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uboAlign );
+	glGetIntegerv( GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &ssboAlign );
+
+	// Both alignments are required to be powers of two, so the larger of the
+	// two satisfies both.
+	mAlignment = std::max<std::size_t>( { 16, std::size_t(uboAlign), std::size_t(ssboAlign) } );
+	mRegionSize = align_up_( aBytesPerFrame, mAlignment );
+
+	auto const totalSize = GLsizeiptr(mRegionSize * aFrameCount);
+
+	OGL_CHECKPOINT_ALWAYS();
+
+	glGenBuffers( 1, &mBuffer );
+	glBindBuffer( GL_COPY_WRITE_BUFFER, mBuffer );
+
+	if( GLAD_GL_VERSION_4_4 )
+	{
+		GLbitfield const flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage( GL_COPY_WRITE_BUFFER, totalSize, nullptr, flags );
+		mMapped = static_cast<std::byte*>(glMapBufferRange( GL_COPY_WRITE_BUFFER, 0, totalSize, flags ));
+	}
+
+	if( !mMapped )
+	{
+		glBufferData( GL_COPY_WRITE_BUFFER, totalSize, nullptr, GL_DYNAMIC_DRAW );
+		mStaging.resize( mRegionSize );
+	}
+
+	glBindBuffer( GL_COPY_WRITE_BUFFER, 0 );
+
+	OGL_CHECKPOINT_ALWAYS();
+}
+
+UniformRing::~UniformRing()
+{
+	for( auto& fence : mFences )
+	{
+		if( fence )
+			glDeleteSync( fence );
+	}
+
+	// Deleting the buffer implicitly unmaps it.
+	if( mBuffer )
+		glDeleteBuffers( 1, &mBuffer );
+}
+
+void UniformRing::begin_frame()
+{
+	assert( !mInFrame );
+
+	mRegion = (mRegion + 1) % mFences.size();
+	if( mFences[mRegion] )
+		wait_and_delete_( mFences[mRegion] );
+
+	mCursor = 0;
+	mInFrame = true;
+}
+
+RingAllocation UniformRing::allocate( std::size_t aBytes )
+{
+	assert( mInFrame );
+
+	auto const size = align_up_( std::max<std::size_t>( aBytes, 1 ), mAlignment );
+	if( mCursor + size > mRegionSize )
+		throw Error( "UniformRing: out of space (%zu bytes requested, %zu of %zu in use)", aBytes, mCursor, mRegionSize );
+
+	auto const offset = mCursor;
+	mCursor += size;
+
+	std::byte* base = mMapped ? mMapped + mRegion*mRegionSize : mStaging.data();
+	return RingAllocation{
+		base + offset,
+		GLintptr(mRegion*mRegionSize + offset),
+		GLsizeiptr(aBytes)
+	};
+}
+
+void UniformRing::flush()
+{
+	assert( mInFrame );
+
+	// Coherent persistent mappings need no explicit flush: writes become
+	// visible to commands issued after them.
+	if( mMapped || 0 == mCursor )
+		return;
+
+	glBindBuffer( GL_COPY_WRITE_BUFFER, mBuffer );
+	glBufferSubData( GL_COPY_WRITE_BUFFER, GLintptr(mRegion*mRegionSize), GLsizeiptr(mCursor), mStaging.data() );
+	glBindBuffer( GL_COPY_WRITE_BUFFER, 0 );
+}
+
+void UniformRing::end_frame()
+{
+	assert( mInFrame );
+	assert( !mFences[mRegion] );
+
+	mFences[mRegion] = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+	mInFrame = false;
+}
+
+GLuint UniformRing::bufferId() const noexcept
+{
+	return mBuffer;
+}
+bool UniformRing::persistent() const noexcept
+{
+	return nullptr != mMapped;
+}
+
+std::size_t UniformRing::bytes_per_frame() const noexcept
+{
+	return mRegionSize;
+}
+
+
+DrawIdBuffer::DrawIdBuffer( std::size_t aMaxDraws )
+	: mBuffer( 0 )
+	, mMaxDraws( aMaxDraws )
+{
+	std::vector<std::uint32_t> ids( aMaxDraws );
+	std::iota( ids.begin(), ids.end(), 0u );
+
+	glGenBuffers( 1, &mBuffer );
+	glBindBuffer( GL_ARRAY_BUFFER, mBuffer );
+	glBufferData( GL_ARRAY_BUFFER, GLsizeiptr(ids.size() * sizeof(std::uint32_t)), ids.data(), GL_STATIC_DRAW );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+}
+
+DrawIdBuffer::~DrawIdBuffer()
+{
+	if( mBuffer )
+		glDeleteBuffers( 1, &mBuffer );
+}
+
+void DrawIdBuffer::attach( GLuint aVao, GLuint aLocation ) const
+{
+	glBindVertexArray( aVao );
+	glBindBuffer( GL_ARRAY_BUFFER, mBuffer );
+
+	glVertexAttribIPointer( aLocation, 1, GL_UNSIGNED_INT, 0, nullptr );
+	glVertexAttribDivisor( aLocation, 1 );
+	glEnableVertexAttribArray( aLocation );
+
+	glBindVertexArray( 0 );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+}
+
+std::size_t DrawIdBuffer::max_draws() const noexcept
+{
+	return mMaxDraws;
+}
+
+namespace
+{
+	void wait_and_delete_( GLsync& aFence )
+	{
+		// The flush bit makes sure that the fence is actually submitted;
+		// otherwise we might wait forever. It's only needed for the first
+		// wait.
+		GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+		for( ;; )
+		{
+			auto const res = glClientWaitSync( aFence, flags, kFenceTimeoutNs_ );
+			if( GL_ALREADY_SIGNALED == res || GL_CONDITION_SATISFIED == res )
+				break;
+
+			if( GL_WAIT_FAILED == res )
+			{
+				glDeleteSync( aFence );
+				aFence = nullptr;
+				throw Error( "glClientWaitSync() failed" );
+			}
+
+			flags = 0;
+		}
+
+		glDeleteSync( aFence );
+		aFence = nullptr;
+	}
+}
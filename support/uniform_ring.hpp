@@ -0,0 +1,118 @@
+#ifndef UNIFORM_RING_HPP_3348D9A5_5421_4417_98F0_F706DFBEBBC2
+#define UNIFORM_RING_HPP_3348D9A5_5421_4417_98F0_F706DFBEBBC2
+
+#include <glad/glad.h>
+
+#include <vector>
+
+#include <cstddef>
+
+// Ring buffer for per-frame shader data (uniform and shader storage blocks)
+//
+// The buffer is split into a number of regions (three by default). Each frame
+// writes into its own region. After the frame's draws have been submitted, a
+// fence is inserted; the region is only reused once that fence has signaled.
+// The CPU can therefore fill the next region while the GPU still reads from
+// the previous ones, without any implicit synchronization in the driver.
+//
+// With OpenGL 4.4 (glBufferStorage), the buffer is mapped once, persistently
+// and coherently, and data is written directly into it. On older versions,
+// data is staged in system memory and uploaded with glBufferSubData() in
+// flush().
+//
+// Usage, per frame:
+//
+//	ring.begin_frame();
+//	auto const alloc = ring.allocate( sizeof(Foo) );
+//	new (alloc.data) Foo{ ... };
+//	ring.flush();
+//	glBindBufferRange( GL_UNIFORM_BUFFER, 0, ring.bufferId(), alloc.offset, alloc.size );
+//	... draw ...
+//	ring.end_frame();
+//
+// Note: the mapped memory may be write-combined. Only write to it; reading
+// back from it can be very slow.
+struct RingAllocation
+{
+	void* data;
+	GLintptr offset; // relative to the start of the buffer
+	GLsizeiptr size;
+};
+
+class UniformRing final
+{
+	public:
+		explicit UniformRing( 
+			std::size_t aBytesPerFrame, 
+			std::size_t aFrameCount = 3
+		);
+		~UniformRing();
+
+		UniformRing( UniformRing const& ) = delete;
+		UniformRing& operator= (UniformRing const&) = delete;
+
+	public:
+		// Waits (if necessary) until the GPU has finished with the next
+		// region, and makes it the current one.
+		void begin_frame();
+
+		// Allocations are aligned such that they can be bound as both uniform
+		// and shader storage buffer ranges. Throws if the current region is
+		// exhausted.
+		RingAllocation allocate( std::size_t aBytes );
+
+		// Makes the current frame's data visible to the GL. Must be called
+		// before the data is used by any draws.
+		void flush();
+
+		// Fences the current region. Call after the last draw that uses it.
+		void end_frame();
+
+	public:
+		GLuint bufferId() const noexcept;
+		bool persistent() const noexcept;
+
+		std::size_t bytes_per_frame() const noexcept;
+
+	private:
+		GLuint mBuffer;
+		std::size_t mRegionSize, mAlignment;
+
+		std::vector<GLsync> mFences;
+		std::size_t mRegion, mCursor;
+		bool mInFrame;
+
+		std::byte* mMapped; // persistent mapping, or null
+		std::vector<std::byte> mStaging; // fallback only
+};
+
+
+// Static buffer containing the sequence 0, 1, ..., N-1 (as 32-bit unsigned
+// integers).
+//
+// Bound as an instanced vertex attribute (divisor 1), the attribute's value is
+// the draw's base instance. Drawing with glDrawArraysInstancedBaseInstance()
+// (or indirect draws) with an instance count of one and baseInstance set to
+// the draw ID therefore passes the draw ID to the vertex shader. This is
+// equivalent to gl_DrawID/gl_BaseInstance, which are not available in GL 4.3.
+class DrawIdBuffer final
+{
+	public:
+		explicit DrawIdBuffer( std::size_t aMaxDraws );
+		~DrawIdBuffer();
+
+		DrawIdBuffer( DrawIdBuffer const& ) = delete;
+		DrawIdBuffer& operator= (DrawIdBuffer const&) = delete;
+
+	public:
+		// Sets up attribute aLocation of aVao to source the draw ID.
+		void attach( GLuint aVao, GLuint aLocation ) const;
+
+		std::size_t max_draws() const noexcept;
+
+	private:
+		GLuint mBuffer;
+		std::size_t mMaxDraws;
+};
+
+#endif // UNIFORM_RING_HPP_3348D9A5_5421_4417_98F0_F706DFBEBBC2
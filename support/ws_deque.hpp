@@ -0,0 +1,104 @@
+#ifndef WS_DEQUE_HPP_B84F2D61_0C7A_4E93_95D8_6A1E3F27C04B
+#define WS_DEQUE_HPP_B84F2D61_0C7A_4E93_95D8_6A1E3F27C04B
+
+#include <array>
+#include <atomic>
+#include <type_traits>
+
+#include <cstddef>
+#include <cstdint>
+
+// Bounded lock-free work-stealing deque (Chase-Lev)
+//
+// The owning thread pushes and pops items at the bottom (LIFO), any other
+// thread may steal items from the top (FIFO). Only the owner may call
+// try_push() and try_pop(); try_steal() may be called from any thread.
+// Neither call blocks or allocates. tCapacity must be a power of two.
+//
+// This follows the formulation with C11 atomics by Le, Pop, Cohen and Zappa
+// Nardelli ("Correct and Efficient Work-Stealing for Weak Memory Models",
+// PPoPP 2013), without the resizing: a full deque rejects the push, and the
+// owner is expected to deal with the item itself.
+template< typename tItem, std::size_t tCapacity >
+class WorkStealingDeque final
+{
+	static_assert( tCapacity > 0 && 0 == (tCapacity & (tCapacity-1)), "WorkStealingDeque: capacity must be a power of two" );
+	static_assert( std::is_trivially_copyable_v<tItem>, "WorkStealingDeque: items must be trivially copyable" );
+
+	public:
+		WorkStealingDeque() = default;
+
+		WorkStealingDeque( WorkStealingDeque const& ) = delete;
+		WorkStealingDeque& operator= (WorkStealingDeque const&) = delete;
+
+	public:
+		// Owner: returns false if the deque is full.
+		bool try_push( tItem const& aItem ) noexcept
+		{
+			auto const bottom = mBottom.load( std::memory_order_relaxed );
+			auto const top = mTop.load( std::memory_order_acquire );
+			if( bottom - top >= std::int64_t(tCapacity) )
+				return false;
+
+			mItems[std::size_t(bottom) & (tCapacity-1)].store( aItem, std::memory_order_relaxed );
+			std::atomic_thread_fence( std::memory_order_release );
+			mBottom.store( bottom+1, std::memory_order_relaxed );
+			return true;
+		}
+
+		// Owner: returns false if the deque is empty (or the last item was
+		// stolen concurrently).
+		bool try_pop( tItem& aItem ) noexcept
+		{
+			auto const bottom = mBottom.load( std::memory_order_relaxed ) - 1;
+			mBottom.store( bottom, std::memory_order_relaxed );
+			std::atomic_thread_fence( std::memory_order_seq_cst );
+			auto top = mTop.load( std::memory_order_relaxed );
+
+			if( top > bottom )
+			{
+				// Empty
+				mBottom.store( bottom+1, std::memory_order_relaxed );
+				return false;
+			}
+
+			aItem = mItems[std::size_t(bottom) & (tCapacity-1)].load( std::memory_order_relaxed );
+			if( top < bottom )
+				return true;
+
+			// Last item: race the thieves for it.
+			bool const won = mTop.compare_exchange_strong( top, top+1, std::memory_order_seq_cst, std::memory_order_relaxed );
+			mBottom.store( bottom+1, std::memory_order_relaxed );
+			return won;
+		}
+
+		// Any thread: returns false if the deque is empty, or if another
+		// thread took the item first.
+		bool try_steal( tItem& aItem ) noexcept
+		{
+			auto top = mTop.load( std::memory_order_acquire );
+			std::atomic_thread_fence( std::memory_order_seq_cst );
+			auto const bottom = mBottom.load( std::memory_order_acquire );
+
+			if( top >= bottom )
+				return false;
+
+			aItem = mItems[std::size_t(top) & (tCapacity-1)].load( std::memory_order_relaxed );
+			return mTop.compare_exchange_strong( top, top+1, std::memory_order_seq_cst, std::memory_order_relaxed );
+		}
+
+		// Any thread: approximate, for heuristics only.
+		bool empty() const noexcept
+		{
+			return mTop.load( std::memory_order_relaxed ) >= mBottom.load( std::memory_order_relaxed );
+		}
+
+	private:
+		// Thieves (top) and the owner (bottom) on separate cache lines
+		alignas(64) std::atomic<std::int64_t> mTop{ 0 };
+		alignas(64) std::atomic<std::int64_t> mBottom{ 0 };
+
+		alignas(64) std::array<std::atomic<tItem>, tCapacity> mItems{};
+};
+
+#endif // WS_DEQUE_HPP_B84F2D61_0C7A_4E93_95D8_6A1E3F27C04B
@@ -11,6 +11,7 @@
         GL_ARB_debug_output,
         GL_ARB_gl_spirv,
         GL_ARB_multi_draw_indirect,
+        GL_ARB_parallel_shader_compile,
         GL_ARB_shader_ballot,
         GL_ARB_shader_clock,
         GL_ARB_shader_group_vote,
@@ -22,16 +23,17 @@
         GL_EXT_semaphore,
         GL_EXT_semaphore_fd,
         GL_EXT_semaphore_win32,
-        GL_KHR_debug
+        GL_KHR_debug,
+        GL_KHR_parallel_shader_compile
     Loader: True
     Local files: False
     Omit khrplatform: False
     Reproducible: False
 
     Commandline:
-        --profile="core" --api="gl=4.6" --generator="c" --spec="gl" --extensions="GL_ARB_bindless_texture,GL_ARB_debug_output,GL_ARB_gl_spirv,GL_ARB_multi_draw_indirect,GL_ARB_shader_ballot,GL_ARB_shader_clock,GL_ARB_shader_group_vote,GL_EXT_debug_label,GL_EXT_debug_marker,GL_EXT_memory_object,GL_EXT_memory_object_fd,GL_EXT_memory_object_win32,GL_EXT_semaphore,GL_EXT_semaphore_fd,GL_EXT_semaphore_win32,GL_KHR_debug"
+        --profile="core" --api="gl=4.6" --generator="c" --spec="gl" --extensions="GL_ARB_bindless_texture,GL_ARB_debug_output,GL_ARB_gl_spirv,GL_ARB_multi_draw_indirect,GL_ARB_parallel_shader_compile,GL_ARB_shader_ballot,GL_ARB_shader_clock,GL_ARB_shader_group_vote,GL_EXT_debug_label,GL_EXT_debug_marker,GL_EXT_memory_object,GL_EXT_memory_object_fd,GL_EXT_memory_object_win32,GL_EXT_semaphore,GL_EXT_semaphore_fd,GL_EXT_semaphore_win32,GL_KHR_debug,GL_KHR_parallel_shader_compile"
     Online:
-        https://glad.dav1d.de/#profile=core&language=c&specification=gl&loader=on&api=gl%3D4.6&extensions=GL_ARB_bindless_texture&extensions=GL_ARB_debug_output&extensions=GL_ARB_gl_spirv&extensions=GL_ARB_multi_draw_indirect&extensions=GL_ARB_shader_ballot&extensions=GL_ARB_shader_clock&extensions=GL_ARB_shader_group_vote&extensions=GL_EXT_debug_label&extensions=GL_EXT_debug_marker&extensions=GL_EXT_memory_object&extensions=GL_EXT_memory_object_fd&extensions=GL_EXT_memory_object_win32&extensions=GL_EXT_semaphore&extensions=GL_EXT_semaphore_fd&extensions=GL_EXT_semaphore_win32&extensions=GL_KHR_debug
+        https://glad.dav1d.de/#profile=core&language=c&specification=gl&loader=on&api=gl%3D4.6&extensions=GL_ARB_bindless_texture&extensions=GL_ARB_debug_output&extensions=GL_ARB_gl_spirv&extensions=GL_ARB_multi_draw_indirect&extensions=GL_ARB_parallel_shader_compile&extensions=GL_ARB_shader_ballot&extensions=GL_ARB_shader_clock&extensions=GL_ARB_shader_group_vote&extensions=GL_EXT_debug_label&extensions=GL_EXT_debug_marker&extensions=GL_EXT_memory_object&extensions=GL_EXT_memory_object_fd&extensions=GL_EXT_memory_object_win32&extensions=GL_EXT_semaphore&extensions=GL_EXT_semaphore_fd&extensions=GL_EXT_semaphore_win32&extensions=GL_KHR_debug&extensions=GL_KHR_parallel_shader_compile
 */
 
 
@@ -3724,6 +3726,8 @@ GLAPI PFNGLPOLYGONOFFSETCLAMPPROC glad_glPolygonOffsetClamp;
 #define GL_DEBUG_SEVERITY_HIGH_ARB 0x9146
 #define GL_DEBUG_SEVERITY_MEDIUM_ARB 0x9147
 #define GL_DEBUG_SEVERITY_LOW_ARB 0x9148
+#define GL_MAX_SHADER_COMPILER_THREADS_ARB 0x91B0
+#define GL_COMPLETION_STATUS_ARB 0x91B1
 #define GL_SHADER_BINARY_FORMAT_SPIR_V_ARB 0x9551
 #define GL_SPIR_V_BINARY_ARB 0x9552
 #define GL_PROGRAM_PIPELINE_OBJECT_EXT 0x8A4F
@@ -3804,6 +3808,8 @@ GLAPI PFNGLPOLYGONOFFSETCLAMPPROC glad_glPolygonOffsetClamp;
 #define GL_CONTEXT_FLAG_DEBUG_BIT_KHR 0x00000002
 #define GL_STACK_OVERFLOW_KHR 0x0503
 #define GL_STACK_UNDERFLOW_KHR 0x0504
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
 #ifndef GL_ARB_bindless_texture
 #define GL_ARB_bindless_texture 1
 GLAPI int GLAD_GL_ARB_bindless_texture;
@@ -3883,6 +3889,13 @@ GLAPI PFNGLSPECIALIZESHADERARBPROC glad_glSpecializeShaderARB;
 #define GL_ARB_multi_draw_indirect 1
 GLAPI int GLAD_GL_ARB_multi_draw_indirect;
 #endif
+#ifndef GL_ARB_parallel_shader_compile
+#define GL_ARB_parallel_shader_compile 1
+GLAPI int GLAD_GL_ARB_parallel_shader_compile;
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSARBPROC)(GLuint count);
+GLAPI PFNGLMAXSHADERCOMPILERTHREADSARBPROC glad_glMaxShaderCompilerThreadsARB;
+#define glMaxShaderCompilerThreadsARB glad_glMaxShaderCompilerThreadsARB
+#endif
 #ifndef GL_ARB_shader_ballot
 #define GL_ARB_shader_ballot 1
 GLAPI int GLAD_GL_ARB_shader_ballot;
@@ -4075,6 +4088,13 @@ typedef void (APIENTRYP PFNGLGETPOINTERVKHRPROC)(GLenum pname, void **params);
 GLAPI PFNGLGETPOINTERVKHRPROC glad_glGetPointervKHR;
 #define glGetPointervKHR glad_glGetPointervKHR
 #endif
+#ifndef GL_KHR_parallel_shader_compile
+#define GL_KHR_parallel_shader_compile 1
+GLAPI int GLAD_GL_KHR_parallel_shader_compile;
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+GLAPI PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glad_glMaxShaderCompilerThreadsKHR;
+#define glMaxShaderCompilerThreadsKHR glad_glMaxShaderCompilerThreadsKHR
+#endif
 
 #ifdef __cplusplus
 }
@@ -11,6 +11,7 @@
         GL_ARB_debug_output,
         GL_ARB_gl_spirv,
         GL_ARB_multi_draw_indirect,
+        GL_ARB_parallel_shader_compile,
         GL_ARB_shader_ballot,
         GL_ARB_shader_clock,
         GL_ARB_shader_group_vote,
@@ -22,16 +23,17 @@
         GL_EXT_semaphore,
         GL_EXT_semaphore_fd,
         GL_EXT_semaphore_win32,
-        GL_KHR_debug
+        GL_KHR_debug,
+        GL_KHR_parallel_shader_compile
     Loader: True
     Local files: False
     Omit khrplatform: False
     Reproducible: False
 
     Commandline:
-        --profile="core" --api="gl=4.6" --generator="c" --spec="gl" --extensions="GL_ARB_bindless_texture,GL_ARB_debug_output,GL_ARB_gl_spirv,GL_ARB_multi_draw_indirect,GL_ARB_shader_ballot,GL_ARB_shader_clock,GL_ARB_shader_group_vote,GL_EXT_debug_label,GL_EXT_debug_marker,GL_EXT_memory_object,GL_EXT_memory_object_fd,GL_EXT_memory_object_win32,GL_EXT_semaphore,GL_EXT_semaphore_fd,GL_EXT_semaphore_win32,GL_KHR_debug"
+        --profile="core" --api="gl=4.6" --generator="c" --spec="gl" --extensions="GL_ARB_bindless_texture,GL_ARB_debug_output,GL_ARB_gl_spirv,GL_ARB_multi_draw_indirect,GL_ARB_parallel_shader_compile,GL_ARB_shader_ballot,GL_ARB_shader_clock,GL_ARB_shader_group_vote,GL_EXT_debug_label,GL_EXT_debug_marker,GL_EXT_memory_object,GL_EXT_memory_object_fd,GL_EXT_memory_object_win32,GL_EXT_semaphore,GL_EXT_semaphore_fd,GL_EXT_semaphore_win32,GL_KHR_debug,GL_KHR_parallel_shader_compile"
     Online:
-        https://glad.dav1d.de/#profile=core&language=c&specification=gl&loader=on&api=gl%3D4.6&extensions=GL_ARB_bindless_texture&extensions=GL_ARB_debug_output&extensions=GL_ARB_gl_spirv&extensions=GL_ARB_multi_draw_indirect&extensions=GL_ARB_shader_ballot&extensions=GL_ARB_shader_clock&extensions=GL_ARB_shader_group_vote&extensions=GL_EXT_debug_label&extensions=GL_EXT_debug_marker&extensions=GL_EXT_memory_object&extensions=GL_EXT_memory_object_fd&extensions=GL_EXT_memory_object_win32&extensions=GL_EXT_semaphore&extensions=GL_EXT_semaphore_fd&extensions=GL_EXT_semaphore_win32&extensions=GL_KHR_debug
+        https://glad.dav1d.de/#profile=core&language=c&specification=gl&loader=on&api=gl%3D4.6&extensions=GL_ARB_bindless_texture&extensions=GL_ARB_debug_output&extensions=GL_ARB_gl_spirv&extensions=GL_ARB_multi_draw_indirect&extensions=GL_ARB_parallel_shader_compile&extensions=GL_ARB_shader_ballot&extensions=GL_ARB_shader_clock&extensions=GL_ARB_shader_group_vote&extensions=GL_EXT_debug_label&extensions=GL_EXT_debug_marker&extensions=GL_EXT_memory_object&extensions=GL_EXT_memory_object_fd&extensions=GL_EXT_memory_object_win32&extensions=GL_EXT_semaphore&extensions=GL_EXT_semaphore_fd&extensions=GL_EXT_semaphore_win32&extensions=GL_KHR_debug&extensions=GL_KHR_parallel_shader_compile
 */
 
 #include <stdio.h>
@@ -992,6 +994,7 @@ int GLAD_GL_ARB_bindless_texture = 0;
 int GLAD_GL_ARB_debug_output = 0;
 int GLAD_GL_ARB_gl_spirv = 0;
 int GLAD_GL_ARB_multi_draw_indirect = 0;
+int GLAD_GL_ARB_parallel_shader_compile = 0;
 int GLAD_GL_ARB_shader_ballot = 0;
 int GLAD_GL_ARB_shader_clock = 0;
 int GLAD_GL_ARB_shader_group_vote = 0;
@@ -1004,6 +1007,7 @@ int GLAD_GL_EXT_semaphore = 0;
 int GLAD_GL_EXT_semaphore_fd = 0;
 int GLAD_GL_EXT_semaphore_win32 = 0;
 int GLAD_GL_KHR_debug = 0;
+int GLAD_GL_KHR_parallel_shader_compile = 0;
 PFNGLGETTEXTUREHANDLEARBPROC glad_glGetTextureHandleARB = NULL;
 PFNGLGETTEXTURESAMPLERHANDLEARBPROC glad_glGetTextureSamplerHandleARB = NULL;
 PFNGLMAKETEXTUREHANDLERESIDENTARBPROC glad_glMakeTextureHandleResidentARB = NULL;
@@ -1025,6 +1029,7 @@ PFNGLDEBUGMESSAGEINSERTARBPROC glad_glDebugMessageInsertARB = NULL;
 PFNGLDEBUGMESSAGECALLBACKARBPROC glad_glDebugMessageCallbackARB = NULL;
 PFNGLGETDEBUGMESSAGELOGARBPROC glad_glGetDebugMessageLogARB = NULL;
 PFNGLSPECIALIZESHADERARBPROC glad_glSpecializeShaderARB = NULL;
+PFNGLMAXSHADERCOMPILERTHREADSARBPROC glad_glMaxShaderCompilerThreadsARB = NULL;
 PFNGLLABELOBJECTEXTPROC glad_glLabelObjectEXT = NULL;
 PFNGLGETOBJECTLABELEXTPROC glad_glGetObjectLabelEXT = NULL;
 PFNGLINSERTEVENTMARKEREXTPROC glad_glInsertEventMarkerEXT = NULL;
@@ -1073,6 +1078,7 @@ PFNGLGETOBJECTLABELKHRPROC glad_glGetObjectLabelKHR = NULL;
 PFNGLOBJECTPTRLABELKHRPROC glad_glObjectPtrLabelKHR = NULL;
 PFNGLGETOBJECTPTRLABELKHRPROC glad_glGetObjectPtrLabelKHR = NULL;
 PFNGLGETPOINTERVKHRPROC glad_glGetPointervKHR = NULL;
+PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glad_glMaxShaderCompilerThreadsKHR = NULL;
 static void load_GL_VERSION_1_0(GLADloadproc load) {
 	if(!GLAD_GL_VERSION_1_0) return;
 	glad_glCullFace = (PFNGLCULLFACEPROC)load("glCullFace");
@@ -1868,6 +1874,10 @@ static void load_GL_ARB_multi_draw_indirect(GLADloadproc load) {
 	glad_glMultiDrawArraysIndirect = (PFNGLMULTIDRAWARRAYSINDIRECTPROC)load("glMultiDrawArraysIndirect");
 	glad_glMultiDrawElementsIndirect = (PFNGLMULTIDRAWELEMENTSINDIRECTPROC)load("glMultiDrawElementsIndirect");
 }
+static void load_GL_ARB_parallel_shader_compile(GLADloadproc load) {
+	if(!GLAD_GL_ARB_parallel_shader_compile) return;
+	glad_glMaxShaderCompilerThreadsARB = (PFNGLMAXSHADERCOMPILERTHREADSARBPROC)load("glMaxShaderCompilerThreadsARB");
+}
 static void load_GL_EXT_debug_label(GLADloadproc load) {
 	if(!GLAD_GL_EXT_debug_label) return;
 	glad_glLabelObjectEXT = (PFNGLLABELOBJECTEXTPROC)load("glLabelObjectEXT");
@@ -1956,12 +1966,17 @@ static void load_GL_KHR_debug(GLADloadproc load) {
 	glad_glGetObjectPtrLabelKHR = (PFNGLGETOBJECTPTRLABELKHRPROC)load("glGetObjectPtrLabelKHR");
 	glad_glGetPointervKHR = (PFNGLGETPOINTERVKHRPROC)load("glGetPointervKHR");
 }
+static void load_GL_KHR_parallel_shader_compile(GLADloadproc load) {
+	if(!GLAD_GL_KHR_parallel_shader_compile) return;
+	glad_glMaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)load("glMaxShaderCompilerThreadsKHR");
+}
 static int find_extensionsGL(void) {
 	if (!get_exts()) return 0;
 	GLAD_GL_ARB_bindless_texture = has_ext("GL_ARB_bindless_texture");
 	GLAD_GL_ARB_debug_output = has_ext("GL_ARB_debug_output");
 	GLAD_GL_ARB_gl_spirv = has_ext("GL_ARB_gl_spirv");
 	GLAD_GL_ARB_multi_draw_indirect = has_ext("GL_ARB_multi_draw_indirect");
+	GLAD_GL_ARB_parallel_shader_compile = has_ext("GL_ARB_parallel_shader_compile");
 	GLAD_GL_ARB_shader_ballot = has_ext("GL_ARB_shader_ballot");
 	GLAD_GL_ARB_shader_clock = has_ext("GL_ARB_shader_clock");
 	GLAD_GL_ARB_shader_group_vote = has_ext("GL_ARB_shader_group_vote");
@@ -1974,6 +1989,7 @@ static int find_extensionsGL(void) {
 	GLAD_GL_EXT_semaphore_fd = has_ext("GL_EXT_semaphore_fd");
 	GLAD_GL_EXT_semaphore_win32 = has_ext("GL_EXT_semaphore_win32");
 	GLAD_GL_KHR_debug = has_ext("GL_KHR_debug");
+	GLAD_GL_KHR_parallel_shader_compile = has_ext("GL_KHR_parallel_shader_compile");
 	free_exts();
 	return 1;
 }
@@ -2070,6 +2086,7 @@ int gladLoadGLLoader(GLADloadproc load) {
 	load_GL_ARB_debug_output(load);
 	load_GL_ARB_gl_spirv(load);
 	load_GL_ARB_multi_draw_indirect(load);
+	load_GL_ARB_parallel_shader_compile(load);
 	load_GL_EXT_debug_label(load);
 	load_GL_EXT_debug_marker(load);
 	load_GL_EXT_memory_object(load);
@@ -2079,6 +2096,7 @@ int gladLoadGLLoader(GLADloadproc load) {
 	load_GL_EXT_semaphore_fd(load);
 	load_GL_EXT_semaphore_win32(load);
 	load_GL_KHR_debug(load);
+	load_GL_KHR_parallel_shader_compile(load);
 	return GLVersion.major != 0 || GLVersion.minor != 0;
 }
 
@@ -1,9 +1,12 @@
 #ifndef MAT44_HPP_E7187A26_469E_48AD_A3D2_63150F05A4CA
 #define MAT44_HPP_E7187A26_469E_48AD_A3D2_63150F05A4CA
 
+#include <array>
 #include <cmath>
 #include <cassert>
 #include <cstdlib>
+#include <utility>
+#include <type_traits>
 
 #include "vec3.hpp"
 #include "vec4.hpp"
@@ -61,69 +64,365 @@ constexpr Vec4f operator*(Mat44f const& aLeft, Vec4f const& aRight) noexcept
     };
 }
 
+// Matrix kinds
+//
+// The make_*() functions below return a Mat44fSparse<Kind> instead of a plain
+// Mat44f. It converts to a Mat44f implicitly, but its type also records
+// which entries are known to be zero or one: a scaling is diagonal, a
+// translation only touches the last column, and so on. Products of two such
+// matrices are specialised on the kinds at compile time: terms with a known
+// zero factor are skipped, factors known to be one are not multiplied, and
+// the result carries the kind of the product. For example
+//
+//   make_translation( p ) * make_rotation_y( a ) * make_scaling( s, s, s )
+//
+// is a Mat44fAffine built from 9 multiplications instead of 128, and
+// projection * world2camera (Mat44fPerspective * Mat44fAffine) needs 16
+// instead of 64. The kind only describes the sparsity pattern. A
+// Mat44fRotationY is any matrix with the zeros and ones of a rotation about
+// the Y-axis, it is not guaranteed to be orthonormal.
+//
+// Chains are folded left to right. Each intermediate has a (usually sparse)
+// kind, so every step stays cheap. Lazy expression nodes are deliberately not
+// used: evaluating a nested product element by element recomputes the inner
+// products for each element.
+//
+// Mat44f itself is the projective kind, i.e., a matrix without known
+// structure. Products with a plain Mat44f on either side still skip the
+// known zeros of the other factor and return a Mat44f.
+enum class Mat44Kind
+{
+    scaling,     // diagonal, w-w entry one
+    translation, // identity except the first three entries of the last column
+    rotationX,   // identity except the Y-Z block
+    rotationY,   // identity except the X-Z entries
+    rotationZ,   // identity except the X-Y block
+    perspective, // the sparsity of make_perspective_projection()
+    affine,      // last row is (0, 0, 0, 1)
+    projective   // no known structure; this is Mat44f
+};
+
+namespace detail
+{
+    enum class Mat44Entry : unsigned char { zero, one, any };
+    using Mat44Pattern = std::array<Mat44Entry, 16>;
+
+    // Rows of '0' (zero), '1' (one) and 'x' (anything), row-major.
+    constexpr Mat44Pattern mat44_pattern(char const (&aRows)[17]) noexcept
+    {
+        Mat44Pattern pattern{};
+        for (std::size_t i = 0; i < 16; ++i)
+        {
+            pattern[i] = '0' == aRows[i] ? Mat44Entry::zero
+                : ('1' == aRows[i] ? Mat44Entry::one : Mat44Entry::any);
+        }
+        return pattern;
+    }
+
+    constexpr Mat44Pattern mat44_pattern(Mat44Kind aKind) noexcept
+    {
+        switch (aKind)
+        {
+            case Mat44Kind::scaling:     return mat44_pattern("x000" "0x00" "00x0" "0001");
+            case Mat44Kind::translation: return mat44_pattern("100x" "010x" "001x" "0001");
+            case Mat44Kind::rotationX:   return mat44_pattern("1000" "0xx0" "0xx0" "0001");
+            case Mat44Kind::rotationY:   return mat44_pattern("x0x0" "0100" "x0x0" "0001");
+            case Mat44Kind::rotationZ:   return mat44_pattern("xx00" "xx00" "0010" "0001");
+            case Mat44Kind::perspective: return mat44_pattern("x000" "0x00" "00xx" "00x0");
+            case Mat44Kind::affine:      return mat44_pattern("xxxx" "xxxx" "xxxx" "0001");
+            case Mat44Kind::projective:  break;
+        }
+        return mat44_pattern("xxxx" "xxxx" "xxxx" "xxxx");
+    }
+
+    // Whether aMatrix has the known zeros and ones of aKind.
+    constexpr bool mat44_matches(Mat44Kind aKind, Mat44f const& aMatrix) noexcept
+    {
+        auto const pattern = mat44_pattern(aKind);
+        for (std::size_t i = 0; i < 16; ++i)
+        {
+            if (Mat44Entry::zero == pattern[i] && 0.f != aMatrix.v[i])
+                return false;
+            if (Mat44Entry::one == pattern[i] && 1.f != aMatrix.v[i])
+                return false;
+        }
+        return true;
+    }
+}
+
+// Matrix of a known kind. The entries are read-only, so that the known zeros
+// and ones can't be changed behind the kind's back. Convert to a Mat44f to
+// modify entries.
+template< Mat44Kind tKind >
+class Mat44fSparse
+{
+    static_assert( tKind != Mat44Kind::projective, "Use Mat44f for matrices without known structure" );
+
+    public:
+        static constexpr Mat44Kind kind = tKind;
+
+        // aMatrix must have the zeros and ones of the kind (asserted).
+        constexpr explicit Mat44fSparse(Mat44f const& aMatrix) noexcept
+            : mMatrix(aMatrix)
+        {
+            assert(detail::mat44_matches(tKind, aMatrix));
+        }
+
+    public:
+        constexpr const float& operator()(std::size_t aI, std::size_t aJ) const noexcept
+        {
+            return mMatrix(aI, aJ);
+        }
+
+        constexpr Mat44f const& matrix() const noexcept
+        {
+            return mMatrix;
+        }
+
+        constexpr operator Mat44f() const noexcept
+        {
+            return mMatrix;
+        }
+
+    private:
+        Mat44f mMatrix;
+};
+
+// Mat44fOf<kind> is Mat44f for the projective kind, Mat44fSparse<> otherwise.
+template< Mat44Kind tKind >
+using Mat44fOf = std::conditional_t<tKind == Mat44Kind::projective, Mat44f, Mat44fSparse<tKind>>;
+
+using Mat44fScaling = Mat44fSparse<Mat44Kind::scaling>;
+using Mat44fTranslation = Mat44fSparse<Mat44Kind::translation>;
+using Mat44fRotationX = Mat44fSparse<Mat44Kind::rotationX>;
+using Mat44fRotationY = Mat44fSparse<Mat44Kind::rotationY>;
+using Mat44fRotationZ = Mat44fSparse<Mat44Kind::rotationZ>;
+using Mat44fPerspective = Mat44fSparse<Mat44Kind::perspective>;
+using Mat44fAffine = Mat44fSparse<Mat44Kind::affine>;
+
+namespace detail
+{
+
+    constexpr Mat44Pattern mat44_product_pattern(Mat44Pattern const& aLeft, Mat44Pattern const& aRight) noexcept
+    {
+        Mat44Pattern result{};
+        for (std::size_t i = 0; i < 4; ++i)
+        {
+            for (std::size_t j = 0; j < 4; ++j)
+            {
+                std::size_t terms = 0;
+                bool ones = true;
+                for (std::size_t k = 0; k < 4; ++k)
+                {
+                    auto const l = aLeft[i * 4 + k], r = aRight[k * 4 + j];
+                    if (Mat44Entry::zero == l || Mat44Entry::zero == r)
+                        continue;
+
+                    ++terms;
+                    ones = ones && Mat44Entry::one == l && Mat44Entry::one == r;
+                }
+
+                result[i * 4 + j] = 0 == terms ? Mat44Entry::zero
+                    : (1 == terms && ones ? Mat44Entry::one : Mat44Entry::any);
+            }
+        }
+        return result;
+    }
+
+    // The first (sparsest) kind whose pattern admits the product's pattern.
+    constexpr Mat44Kind mat44_product_kind(Mat44Kind aLeft, Mat44Kind aRight) noexcept
+    {
+        auto const product = mat44_product_pattern(mat44_pattern(aLeft), mat44_pattern(aRight));
+
+        constexpr Mat44Kind kCandidates[] = {
+            Mat44Kind::scaling, Mat44Kind::translation,
+            Mat44Kind::rotationX, Mat44Kind::rotationY, Mat44Kind::rotationZ,
+            Mat44Kind::perspective, Mat44Kind::affine
+        };
+
+        for (auto const kind : kCandidates)
+        {
+            auto const pattern = mat44_pattern(kind);
+
+            bool admits = true;
+            for (std::size_t i = 0; i < 16; ++i)
+                admits = admits && (Mat44Entry::any == pattern[i] || product[i] == pattern[i]);
+
+            if (admits)
+                return kind;
+        }
+        return Mat44Kind::projective;
+    }
+
+    template< Mat44Entry tLeft, Mat44Entry tRight >
+    constexpr float mat44_term(float aLeft, float aRight) noexcept
+    {
+        if constexpr (Mat44Entry::one == tLeft && Mat44Entry::one == tRight)
+            return 1.f;
+        else if constexpr (Mat44Entry::one == tLeft)
+            return aRight;
+        else if constexpr (Mat44Entry::one == tRight)
+            return aLeft;
+        else
+            return aLeft * aRight;
+    }
+
+    // Sum of the terms k >= tK of entry (tI, tJ), skipping those with a zero
+    // factor. Sums in the same order as the dense product.
+    template< Mat44Kind tLeft, Mat44Kind tRight, std::size_t tI, std::size_t tJ, std::size_t tK, bool tStarted >
+    constexpr float mat44_sum(float aSum, Mat44f const& aLeft, Mat44f const& aRight) noexcept
+    {
+        if constexpr (4 == tK)
+        {
+            return aSum;
+        }
+        else
+        {
+            constexpr auto l = mat44_pattern(tLeft)[tI * 4 + tK];
+            constexpr auto r = mat44_pattern(tRight)[tK * 4 + tJ];
+
+            if constexpr (Mat44Entry::zero == l || Mat44Entry::zero == r)
+            {
+                return mat44_sum<tLeft, tRight, tI, tJ, tK + 1, tStarted>(aSum, aLeft, aRight);
+            }
+            else
+            {
+                float const term = mat44_term<l, r>(aLeft.v[tI * 4 + tK], aRight.v[tK * 4 + tJ]);
+                if constexpr (tStarted)
+                    return mat44_sum<tLeft, tRight, tI, tJ, tK + 1, true>(aSum + term, aLeft, aRight);
+                else
+                    return mat44_sum<tLeft, tRight, tI, tJ, tK + 1, true>(term, aLeft, aRight);
+            }
+        }
+    }
+
+    template< Mat44Kind tLeft, Mat44Kind tRight, std::size_t... tIJ >
+    constexpr Mat44fOf<mat44_product_kind(tLeft, tRight)> mat44_multiply(Mat44f const& aLeft, Mat44f const& aRight, std::index_sequence<tIJ...>) noexcept
+    {
+        Mat44f result{};
+        ((result.v[tIJ] = mat44_sum<tLeft, tRight, tIJ / 4, tIJ % 4, 0, false>(0.f, aLeft, aRight)), ...);
+        return Mat44fOf<mat44_product_kind(tLeft, tRight)>(result);
+    }
+
+    template< Mat44Kind tKind, std::size_t tI, std::size_t tK, bool tStarted >
+    constexpr float mat44_row_dot(float aSum, Mat44f const& aLeft, Vec4f const& aRight) noexcept
+    {
+        if constexpr (4 == tK)
+        {
+            return aSum;
+        }
+        else
+        {
+            constexpr auto l = mat44_pattern(tKind)[tI * 4 + tK];
+
+            if constexpr (Mat44Entry::zero == l)
+            {
+                return mat44_row_dot<tKind, tI, tK + 1, tStarted>(aSum, aLeft, aRight);
+            }
+            else
+            {
+                float const term = mat44_term<l, Mat44Entry::any>(aLeft.v[tI * 4 + tK], aRight[tK]);
+                if constexpr (tStarted)
+                    return mat44_row_dot<tKind, tI, tK + 1, true>(aSum + term, aLeft, aRight);
+                else
+                    return mat44_row_dot<tKind, tI, tK + 1, true>(term, aLeft, aRight);
+            }
+        }
+    }
+}
+
+// Products of matrices with known kinds. These are exact matches and are
+// preferred over the Mat44f overloads above (which need a conversion).
+template< Mat44Kind tLeft, Mat44Kind tRight >
+constexpr auto operator*(Mat44fSparse<tLeft> const& aLeft, Mat44fSparse<tRight> const& aRight) noexcept
+{
+    return detail::mat44_multiply<tLeft, tRight>(aLeft.matrix(), aRight.matrix(), std::make_index_sequence<16>{});
+}
+template< Mat44Kind tLeft >
+constexpr Mat44f operator*(Mat44fSparse<tLeft> const& aLeft, Mat44f const& aRight) noexcept
+{
+    return detail::mat44_multiply<tLeft, Mat44Kind::projective>(aLeft.matrix(), aRight, std::make_index_sequence<16>{});
+}
+template< Mat44Kind tRight >
+constexpr Mat44f operator*(Mat44f const& aLeft, Mat44fSparse<tRight> const& aRight) noexcept
+{
+    return detail::mat44_multiply<Mat44Kind::projective, tRight>(aLeft, aRight.matrix(), std::make_index_sequence<16>{});
+}
+
+template< Mat44Kind tKind >
+constexpr Vec4f operator*(Mat44fSparse<tKind> const& aLeft, Vec4f const& aRight) noexcept
+{
+    return Vec4f{
+        detail::mat44_row_dot<tKind, 0, 0, false>(0.f, aLeft.matrix(), aRight),
+        detail::mat44_row_dot<tKind, 1, 0, false>(0.f, aLeft.matrix(), aRight),
+        detail::mat44_row_dot<tKind, 2, 0, false>(0.f, aLeft.matrix(), aRight),
+        detail::mat44_row_dot<tKind, 3, 0, false>(0.f, aLeft.matrix(), aRight)
+    };
+}
+
 // Rotation around X-axis
-inline Mat44f make_rotation_x(float aAngle) noexcept
+inline Mat44fRotationX make_rotation_x(float aAngle) noexcept
 {
     float c = std::cos(aAngle);
     float s = std::sin(aAngle);
-    return {{
+    return Mat44fRotationX(Mat44f{{
         1.f, 0.f, 0.f, 0.f,
         0.f, c,   -s,  0.f,
         0.f, s,    c,  0.f,
         0.f, 0.f,  0.f, 1.f
-    }};
+    }});
 }
 
 // Rotation around Y-axis
-inline Mat44f make_rotation_y(float aAngle) noexcept
+inline Mat44fRotationY make_rotation_y(float aAngle) noexcept
 {
     float c = std::cos(aAngle);
     float s = std::sin(aAngle);
-    return {{
+    return Mat44fRotationY(Mat44f{{
         c,   0.f, s, 0.f,
         0.f, 1.f, 0.f, 0.f,
        -s,   0.f, c, 0.f,
         0.f, 0.f, 0.f, 1.f
-    }};
+    }});
 }
 
-inline Mat44f make_scaling(float scaleX, float scaleY, float scaleZ) {
-    return Mat44f{{
+inline Mat44fScaling make_scaling(float scaleX, float scaleY, float scaleZ) noexcept {
+    return Mat44fScaling(Mat44f{{
         scaleX, 0.0f,  0.0f,  0.0f,
         0.0f,  scaleY, 0.0f,  0.0f,
         0.0f,  0.0f,  scaleZ, 0.0f,
         0.0f,  0.0f,  0.0f,  1.0f
-    }};
+    }});
 }
 
 
 
 // Rotation around Z-axis
-inline Mat44f make_rotation_z(float aAngle) noexcept
+inline Mat44fRotationZ make_rotation_z(float aAngle) noexcept
 {
     float c = std::cos(aAngle);
     float s = std::sin(aAngle);
-    return {{
+    return Mat44fRotationZ(Mat44f{{
         c,   -s,  0.f, 0.f,
         s,    c,  0.f, 0.f,
         0.f,  0.f, 1.f, 0.f,
         0.f,  0.f, 0.f, 1.f
-    }};
+    }});
 }
 
 // Translation matrix
-inline Mat44f make_translation(Vec3f aTranslation) noexcept
+inline Mat44fTranslation make_translation(Vec3f aTranslation) noexcept
 {
-    return {{
+    return Mat44fTranslation(Mat44f{{
         1.f, 0.f, 0.f, aTranslation.x,
         0.f, 1.f, 0.f, aTranslation.y,
         0.f, 0.f, 1.f, aTranslation.z,
         0.f, 0.f, 0.f, 1.f
-    }};
+    }});
 }
 
 // Perspective projection matrix
-inline Mat44f make_perspective_projection(float aFovInRadians, float aAspect, float aNear, float aFar) noexcept
+inline Mat44fPerspective make_perspective_projection(float aFovInRadians, float aAspect, float aNear, float aFar) noexcept
 {
     // Convert field of view to radians if given in degrees
     float tanHalfFov = std::tan(aFovInRadians / 2.f);
@@ -132,12 +431,12 @@ inline Mat44f make_perspective_projection(float aFovInRadians, float aAspect, fl
     float a = -(aFar + aNear) / (aFar - aNear);
     float b = -(2.f * aFar * aNear) / (aFar - aNear);
 
-    return {{
+    return Mat44fPerspective(Mat44f{{
         sx,  0.f, 0.f, 0.f,
         0.f, sy,  0.f, 0.f,
         0.f, 0.f,  a,  b,
         0.f, 0.f, -1.f, 0.f
-    }};
+    }});
 }
 
 # endif
\ No newline at end of file
@@ -128,6 +128,16 @@ float dot( Vec3f aLeft, Vec3f aRight ) noexcept
 	;
 }
 
+constexpr
+Vec3f cross( Vec3f aLeft, Vec3f aRight ) noexcept
+{
+	return Vec3f{
+		aLeft.y * aRight.z - aLeft.z * aRight.y,
+		aLeft.z * aRight.x - aLeft.x * aRight.z,
+		aLeft.x * aRight.y - aLeft.y * aRight.x
+	};
+}
+
 inline
 float length( Vec3f aVec ) noexcept
 {